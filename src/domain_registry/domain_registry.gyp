@@ -13,20 +13,111 @@
 # limitations under the License.
 
 {
+  'variables': {
+    # Set to 1 to search large sibling groups with a branchless search
+    # over tables stored in Eytzinger order. Must match the value used
+    # for registry_tables_generator.gyp.
+    'domain_registry_eytzinger_layout%': 0,
+
+    # Set to 1 to look up hostnames with the suffix-hash engine instead
+    # of walking the trie.
+    'domain_registry_suffix_hash%': 0,
+
+    # Set to 1 to look up hostnames with the DAFSA engine, which
+    # searches a compact byte-coded automaton of all rules instead of
+    # the trie.
+    'domain_registry_dafsa%': 0,
+
+    # Set to 1 to look up hostnames with the matcher engine, which runs
+    # generated code that matches all rules with nested switch
+    # statements instead of searching any tables.
+    'domain_registry_matcher%': 0,
+
+    # Set to a power of two to cache that many registry lengths per
+    # thread, in front of GetRegistryLengthN and friends. 0 disables
+    # the cache.
+    'domain_registry_result_cache_size%': 0,
+
+    # Set to 1 to count the events on the lookup path, per thread, for
+    # GetRegistryStats. 0 compiles the counters out.
+    'domain_registry_stats%': 0,
+
+    # Set to 1 to build domain_registry_fuzz_test as a libFuzzer target
+    # instead of a standalone executable, and to instrument the library
+    # for coverage. Needs clang.
+    'domain_registry_libfuzzer%': 0,
+  },
+  'target_defaults': {
+    'conditions': [
+      ['domain_registry_eytzinger_layout==1', {
+        'defines': [ 'DOMAIN_REGISTRY_EYTZINGER_LAYOUT' ],
+      }],
+      ['domain_registry_suffix_hash==1', {
+        'defines': [ 'DOMAIN_REGISTRY_SUFFIX_HASH' ],
+      }],
+      ['domain_registry_dafsa==1', {
+        'defines': [ 'DOMAIN_REGISTRY_DAFSA' ],
+      }],
+      ['domain_registry_matcher==1', {
+        'defines': [ 'DOMAIN_REGISTRY_MATCHER' ],
+      }],
+      ['domain_registry_result_cache_size!=0', {
+        'defines': [
+          'DOMAIN_REGISTRY_RESULT_CACHE_SIZE=<(domain_registry_result_cache_size)',
+        ],
+      }],
+      ['domain_registry_stats==1', {
+        'defines': [ 'DOMAIN_REGISTRY_STATS' ],
+      }],
+      ['domain_registry_libfuzzer==1', {
+        'cflags': [ '-fsanitize=fuzzer-no-link' ],
+      }],
+    ],
+  },
   'targets': [
     {
       'target_name': 'domain_registry_lib',
       'type': 'static_library',
       'dependencies': [
+        # For registry_tables_genfiles/trie_node_layout.h, which
+        # private/trie_node.h includes.
+        '../registry_tables_generator/registry_tables_generator.gyp:generate_registry_tables',
         'assert_lib',
       ],
+      'export_dependent_settings': [
+        '../registry_tables_generator/registry_tables_generator.gyp:generate_registry_tables',
+      ],
       'sources': [
+        'private/dafsa_search.c',
+        'private/dafsa_search.h',
+        'private/hash_util.h',
+        'private/hostname_scanner.c',
+        'private/hostname_scanner.h',
+        'private/matcher_search.c',
+        'private/matcher_search.h',
+        'private/prefetch.h',
+        'private/punycode.c',
+        'private/punycode.h',
+        'private/registry_blob.c',
+        'private/registry_blob.h',
+        'private/registry_overlay.c',
+        'private/registry_overlay.h',
         'private/registry_search.c',
+        'private/registry_stats.c',
+        'private/registry_stats.h',
+        'private/registry_tables.c',
+        'private/registry_tables.h',
         'private/registry_types.h',
+        'private/result_cache.c',
+        'private/result_cache.h',
         'private/string_util.h',
+        'private/suffix_hash_search.c',
+        'private/suffix_hash_search.h',
         'private/trie_node.h',
         'private/trie_search.c',
         'private/trie_search.h',
+        'private/url_host.c',
+        'private/url_host.h',
       ],
       'include_dirs': [
         '..',
@@ -36,6 +127,15 @@
           '..',
         ],
       },
+      'conditions': [
+        # registry_tables.c uses pthread keys to clean up after threads
+        # that exit.
+        ['OS=="linux" or OS=="freebsd" or OS=="openbsd" or OS=="solaris"', {
+          'link_settings': {
+            'libraries': [ '-lpthread' ],
+          },
+        }],
+      ],
     },
     {
       'target_name': 'init_registry_tables_lib',
@@ -46,6 +146,70 @@
       ],
       'sources': [
         'private/init_registry_tables.c',
+        'private/init_registry_tables.h',
+      ],
+      'include_dirs': [
+        '..',
+      ],
+      'conditions': [
+        ['domain_registry_suffix_hash==1', {
+          'dependencies': [ 'init_suffix_hash_table_lib' ],
+        }],
+        ['domain_registry_dafsa==1', {
+          'dependencies': [ 'init_dafsa_lib' ],
+        }],
+        ['domain_registry_matcher==1', {
+          'dependencies': [ 'init_registry_matcher_lib' ],
+        }],
+      ],
+    },
+    {
+      # The suffix hash table and the functions that install it. Only
+      # linked into builds that use the suffix-hash engine, and into
+      # the perf and fuzz tests, which compare all engines.
+      'target_name': 'init_suffix_hash_table_lib',
+      'type': 'static_library',
+      'dependencies': [
+        '../registry_tables_generator/registry_tables_generator.gyp:generate_registry_tables',
+        'domain_registry_lib',
+      ],
+      'sources': [
+        'private/init_registry_tables.h',
+        'private/init_suffix_hash_table.c',
+      ],
+      'include_dirs': [
+        '..',
+      ],
+    },
+    {
+      # The DAFSA and the functions that install it, linked the same way
+      # as init_suffix_hash_table_lib.
+      'target_name': 'init_dafsa_lib',
+      'type': 'static_library',
+      'dependencies': [
+        '../registry_tables_generator/registry_tables_generator.gyp:generate_registry_tables',
+        'domain_registry_lib',
+      ],
+      'sources': [
+        'private/init_dafsa.c',
+        'private/init_registry_tables.h',
+      ],
+      'include_dirs': [
+        '..',
+      ],
+    },
+    {
+      # The generated matcher and the functions that install it, linked
+      # the same way as init_suffix_hash_table_lib.
+      'target_name': 'init_registry_matcher_lib',
+      'type': 'static_library',
+      'dependencies': [
+        '../registry_tables_generator/registry_tables_generator.gyp:generate_registry_tables',
+        'domain_registry_lib',
+      ],
+      'sources': [
+        'private/init_registry_matcher.c',
+        'private/init_registry_tables.h',
       ],
       'include_dirs': [
         '..',
@@ -76,6 +240,26 @@
         '..',
       ],
     },
+    {
+      # Engine switching and flag parsing shared by the perf, scaling
+      # and fuzz tests.
+      'target_name': 'lookup_engine_lib',
+      'type': 'static_library',
+      'dependencies': [
+        'domain_registry_lib',
+        'init_dafsa_lib',
+        'init_registry_matcher_lib',
+        'init_registry_tables_lib',
+        'init_suffix_hash_table_lib',
+      ],
+      'sources': [
+        'testing/lookup_engine.c',
+        'testing/lookup_engine.h',
+      ],
+      'include_dirs': [
+        '..',
+      ],
+    },
     {
       'target_name': 'domain_registry_test',
       'type': 'executable',
@@ -89,9 +273,16 @@
       ],
       'sources': [
         'domain_registry_test.cc',
+        'private/hostname_scanner_test.cc',
+        'private/punycode_test.cc',
+        'private/registry_blob_test.cc',
+        'private/registry_overlay_test.cc',
         'private/registry_search_test.cc',
+        'private/registry_stats_test.cc',
+        'private/registry_tables_test.cc',
         'private/string_util_test.cc',
         'private/trie_search_test.cc',
+        'private/url_host_test.cc',
       ],
       'conditions': [
         ['OS=="linux" or OS=="freebsd" or OS=="openbsd" or OS=="solaris"', {
@@ -107,11 +298,62 @@
       'dependencies': [
         '../registry_tables_generator/registry_tables_generator.gyp:generate_registry_tables',
         'domain_registry_lib',
+        'init_dafsa_lib',
+        'init_registry_matcher_lib',
         'init_registry_tables_lib',
+        'init_suffix_hash_table_lib',
+        'lookup_engine_lib',
       ],
       'sources': [
         'domain_registry_perf_test.c',
       ],
     },
+    {
+      'target_name': 'domain_registry_scaling_perf_test',
+      'suppress_wildcard': 1,
+      'type': 'executable',
+      'dependencies': [
+        '../registry_tables_generator/registry_tables_generator.gyp:generate_registry_tables',
+        'domain_registry_lib',
+        'init_dafsa_lib',
+        'init_registry_matcher_lib',
+        'init_registry_tables_lib',
+        'init_suffix_hash_table_lib',
+        'lookup_engine_lib',
+      ],
+      'sources': [
+        'domain_registry_scaling_perf_test.c',
+      ],
+      'conditions': [
+        ['OS=="linux" or OS=="freebsd" or OS=="openbsd" or OS=="solaris"', {
+          'cflags': [ '-pthread' ],
+          'ldflags': [ '-pthread' ],
+        }],
+      ],
+    },
+    {
+      'target_name': 'domain_registry_fuzz_test',
+      'suppress_wildcard': 1,
+      'type': 'executable',
+      'dependencies': [
+        '../registry_tables_generator/registry_tables_generator.gyp:generate_registry_tables',
+        'domain_registry_lib',
+        'init_dafsa_lib',
+        'init_registry_matcher_lib',
+        'init_registry_tables_lib',
+        'init_suffix_hash_table_lib',
+        'lookup_engine_lib',
+      ],
+      'sources': [
+        'domain_registry_fuzz_test.c',
+      ],
+      'conditions': [
+        ['domain_registry_libfuzzer==1', {
+          'defines': [ 'DOMAIN_REGISTRY_LIBFUZZER' ],
+          'cflags': [ '-fsanitize=fuzzer' ],
+          'ldflags': [ '-fsanitize=fuzzer' ],
+        }],
+      ],
+    },
   ],
 }
@@ -26,10 +26,32 @@ extern "C" {
 /*
  * Call once at program startup to enable domain registry
  * search. Calls to GetRegistryLength will crash if this is not
- * called.
+ * called. May be called again later, e.g. to return to the built-in
+ * tables after InitializeDomainRegistryFromFile; see there.
  */
 void InitializeDomainRegistry(void);
 
+/*
+ * Alternative to InitializeDomainRegistry that loads the registry
+ * tables from the binary file written by registry_tables_generator.py
+ * (registry_tables.bin), so that rule updates can be deployed without
+ * rebuilding. The file is mapped read-only and its tables are used in
+ * place, so processes that load the same file share its memory. The
+ * file must not be modified while it is loaded; replace it with a new
+ * file instead. Lookups use the trie, even in builds that enable
+ * another lookup engine. Returns 1 on success. Returns 0, leaving the
+ * current tables installed, if the file cannot be mapped, is corrupt,
+ * or was generated for a different version or table layout.
+ *
+ * May be called at any time to reload the tables, while other threads
+ * look up hostnames. Lookups are never blocked: those already in
+ * progress finish with the previous tables, and later ones use the
+ * new tables. This waits until no lookup uses the previous tables,
+ * then unmaps the file they were loaded from, if any. Calls from
+ * different threads are serialized.
+ */
+int InitializeDomainRegistryFromFile(const char* path);
+
 /*
  * Finds the length in bytes of the registrar portion of the host in
  * the given hostname.  Returns 0 if the hostname is invalid or has no
@@ -80,6 +102,372 @@ size_t GetRegistryLength(const char* hostname);
  */
 size_t GetRegistryLengthAllowUnknownRegistries(const char* hostname);
 
+/*
+ * Like GetRegistryLength and GetRegistryLengthAllowUnknownRegistries,
+ * but take a hostname of hostname_len bytes that does not need to be
+ * null-terminated (e.g. a slice of a request header or of a TLS SNI
+ * extension). The hostname is searched in place, without making a
+ * copy: these functions do not allocate memory and are the
+ * preferred entry points on performance-sensitive paths. Hostnames
+ * that contain a null byte, hostnames that contain non-ASCII
+ * characters and hostnames longer than 255 bytes return 0.
+ *
+ * Examples:
+ *   ("www.google.com", 14)   -> 3             (com)
+ *   ("google.com:443", 10)   -> 3             (com, port not included)
+ *   ("WWW.GOOGLE.CO.UK", 16) -> 5             (co.uk, case insensitive)
+ */
+size_t GetRegistryLengthN(const char* hostname, size_t hostname_len);
+size_t GetRegistryLengthAllowUnknownRegistriesN(const char* hostname,
+                                                size_t hostname_len);
+
+/*
+ * Like GetRegistryLength and GetRegistryLengthN, but also accept
+ * internationalized domain names in UTF-8, so that they do not need
+ * to be converted to punycode first. Hostname-parts that are not
+ * ASCII are converted into a buffer on the stack, and the result is
+ * looked up as GetRegistryLengthN does; ASCII hostnames are looked up
+ * in place. The registry length is in bytes of the given hostname.
+ * The ideographic full stops U+3002, U+FF0E and U+FF61 separate
+ * hostname-parts like '.'. Non-ASCII characters are not mapped as
+ * IDNA does before converting (e.g. uppercase to lowercase), so they
+ * must already be in mapped form, as URL parsers produce. Invalid
+ * UTF-8 returns 0.
+ *
+ * Examples:
+ *   foo.臺灣               -> 6                 (臺灣)
+ *   www.個人.hk            -> 9                 (個人.hk)
+ *   bücher.de            -> 2                 (de)
+ *   www.google.com       -> 3                 (com)
+ */
+size_t GetRegistryLengthUtf8(const char* hostname);
+size_t GetRegistryLengthUtf8N(const char* hostname, size_t hostname_len);
+
+/*
+ * Computes GetRegistryLengthN for each of the num_hostnames hostnames
+ * and stores the results in registry_lens, which must have room for
+ * num_hostnames entries. hostname_lens holds the length of each
+ * hostname; if hostname_lens is NULL, the hostnames must be
+ * null-terminated. NULL hostnames have a registry length of 0.
+ *
+ * The results are identical to those of calling GetRegistryLengthN
+ * in a loop, but lookups are advanced in groups, one hostname-part at
+ * a time, so that the memory accesses of independent lookups
+ * overlap. Prefer this function when classifying many hostnames at
+ * once.
+ */
+void GetRegistryLengthBatch(const char* const* hostnames,
+                            const size_t* hostname_lens,
+                            size_t num_hostnames,
+                            size_t* registry_lens);
+
+/*
+ * Finds, in a single search, the registry length of the hostname
+ * under the rules of the ICANN section of the public suffix list
+ * alone, and under all of its rules including those of the PRIVATE
+ * section. The latter is the value GetRegistryLength returns, so it
+ * is never less than the former. The ICANN registry suits decisions
+ * that depend on the registrar, such as which domains may set
+ * cookies, and the full one suits grouping hostnames by site. Either
+ * length is 0 if no rule matches. The result cache is not used.
+ *
+ * Examples:
+ *   www.google.com       -> 3, 3              (com, com)
+ *   foo.blogspot.com     -> 3, 12             (com, blogspot.com)
+ *   blogspot.com         -> 3, 12             (com, blogspot.com)
+ *   a.b.co.uk            -> 5, 5              (co.uk, co.uk)
+ */
+void GetRegistryLengths(const char* hostname,
+                        size_t* icann_registry_len,
+                        size_t* private_registry_len);
+void GetRegistryLengthsN(const char* hostname,
+                         size_t hostname_len,
+                         size_t* icann_registry_len,
+                         size_t* private_registry_len);
+
+/*
+ * The parts of a hostname found by GetRegistryInfo. Offsets are in
+ * bytes from the start of the hostname. Like the registry length
+ * GetRegistryLength returns, lengths include a single trailing dot.
+ */
+struct RegistryInfo {
+  /*
+   * The host: the whole hostname, or for GetRegistryInfoForUrl, the
+   * host of the URL.
+   */
+  size_t host_offset;
+  size_t host_len;
+
+  /*
+   * The registry, e.g. "co.uk" in "www.google.co.uk". registry_len
+   * is the value GetRegistryLength returns.
+   */
+  size_t registry_offset;
+  size_t registry_len;
+
+  /*
+   * The registry and the hostname-part before it, i.e. the domain
+   * that can be registered, e.g. "google.co.uk" in
+   * "www.google.co.uk". The length is 0 if there is no such
+   * hostname-part, e.g. if the hostname is a registry.
+   */
+  size_t registrable_domain_offset;
+  size_t registrable_domain_len;
+
+  /*
+   * The number of hostname-parts, e.g. 4 for "www.google.co.uk".
+   * Leading dots and a single trailing dot do not separate
+   * hostname-parts.
+   */
+  size_t num_labels;
+
+  /*
+   * Whether the rule that matched the registry is a wildcard rule
+   * (e.g. "*.ck") or an exception rule (e.g. "!www.ck").
+   */
+  int is_wildcard_rule;
+  int is_exception_rule;
+};
+
+/*
+ * Like GetRegistryLength, but also finds the registrable domain and
+ * the number of hostname-parts of the hostname, in the same search,
+ * and stores them in *info. Returns non-zero if the hostname has a
+ * registry. Otherwise returns 0, leaving only the host and num_labels
+ * set if the hostname is valid. The result cache is not used.
+ *
+ * Examples:
+ *                        registry  registrable domain  labels
+ *   www.google.co.uk  -> 11, 5     4, 12               4
+ *   google.com.       -> 7, 4      0, 11               2
+ *   co.uk             -> 0, 5      0, 0                2
+ *   foo.bar           -> 0, 0      0, 0                2 (returns 0)
+ */
+int GetRegistryInfo(const char* hostname, struct RegistryInfo* info);
+int GetRegistryInfoN(const char* hostname,
+                     size_t hostname_len,
+                     struct RegistryInfo* info);
+
+/*
+ * Like GetRegistryInfoN, but takes a URL of url_len bytes, such as
+ * "https://user@www.google.co.uk:443/path?q", and looks up its host in
+ * place. Every part of the URL but the host is optional, so
+ * "www.google.co.uk" and "google.co.uk:80" work too. Offsets in *info
+ * are from the start of url. A single trailing dot of the host is not
+ * part of it, nor of the registry. Only the bytes up to the end of
+ * the host and port are read, and nothing is allocated or copied
+ * beyond the stack buffers every lookup uses. Returns 0, with all of
+ * *info 0, if the URL has no host or its host is an IPv6 address in
+ * brackets.
+ *
+ * Examples:
+ *                                     host     registry  registrable domain
+ *   https://www.google.co.uk/a     -> 8, 16    19, 5     12, 12
+ *   http://u:p@google.com.:80/     -> 11, 10   18, 3     11, 10
+ *   google.com                     -> 0, 10    7, 3      0, 10
+ *   http://[::1]/                  -> 0, 0     0, 0      0, 0 (returns 0)
+ */
+int GetRegistryInfoForUrl(const char* url,
+                          size_t url_len,
+                          struct RegistryInfo* info);
+
+/*
+ * Add a rule to those that hostnames are looked up with, without
+ * regenerating the tables, e.g. for suffixes under which customers
+ * host their own zones. The rule has the syntax of the public suffix
+ * list: "example.com", the wildcard "*.example.com" or the exception
+ * "!www.example.com", case insensitive. Added rules are kept apart
+ * from the tables, in an overlay that each lookup searches in the same
+ * pass as the tables, so the cost of a lookup only grows with the
+ * hostname-parts the added rules share with the hostname. Where both
+ * match, the longest rule wins, and an exception rule wins over
+ * another rule of the same length. Added rules count as PRIVATE rules
+ * for GetRegistryLengths, and stay when the tables are reloaded.
+ * Until tables are installed, they are the only rules searched.
+ *
+ * Rules may be added and removed while other threads look up
+ * hostnames: lookups already in progress finish with the previous
+ * rules, and later ones use the new rules. Each change rebuilds the
+ * overlay, so it takes time proportional to the number of added
+ * rules, and waits until no lookup uses the previous overlay. Returns
+ * 1 if the rule was added or had been added before, and 0 if the rule
+ * is not valid or memory runs out.
+ */
+int AddRegistryRule(const char* rule);
+
+/*
+ * Remove a rule added with AddRegistryRule, spelled the same way up
+ * to case. Returns 1 if the rule was removed, and 0 if it had not
+ * been added or memory runs out.
+ */
+int RemoveRegistryRule(const char* rule);
+
+/* Remove all rules added with AddRegistryRule. */
+void ClearRegistryRules(void);
+
+/*
+ * A set of registry tables that can be loaded, reloaded and looked up
+ * independently of the others, e.g. to serve several versions of the
+ * rules side by side in one process. The functions above use the
+ * default registry, which is the one InitializeDomainRegistry and
+ * InitializeDomainRegistryFromFile load tables into. All registries
+ * can be used from any thread, and reloading one never blocks lookups
+ * in it or in the others.
+ */
+struct DomainRegistry;
+
+/*
+ * Create a registry with the built-in tables. Does not affect the
+ * default registry, so InitializeDomainRegistry is not needed to use
+ * it. Returns NULL if out of memory.
+ */
+struct DomainRegistry* CreateDomainRegistry(void);
+
+/*
+ * Create a registry with the tables in the binary file at path. See
+ * InitializeDomainRegistryFromFile. Returns NULL if the file cannot be
+ * loaded.
+ */
+struct DomainRegistry* CreateDomainRegistryFromFile(const char* path);
+
+/*
+ * Replace the tables of registry with those in the binary file at
+ * path. Like InitializeDomainRegistryFromFile, which is equivalent to
+ * passing the default registry, this may be called while other
+ * threads look up hostnames in registry. Returns 1 on success, and 0,
+ * leaving the current tables installed, on failure.
+ */
+int ReloadDomainRegistryFromFile(struct DomainRegistry* registry,
+                                 const char* path);
+
+/*
+ * Free registry, its tables and its added rules. No lookup in registry
+ * may be in progress or start once this is called. registry may be
+ * NULL, but must not be the default registry.
+ */
+void DestroyDomainRegistry(struct DomainRegistry* registry);
+
+/* The registry used by the functions that do not take one. */
+struct DomainRegistry* GetDefaultDomainRegistry(void);
+
+/*
+ * Like the functions of the same name without the DomainRegistry
+ * prefix, but look hostnames up in registry, which must not be NULL.
+ */
+size_t DomainRegistryGetRegistryLength(const struct DomainRegistry* registry,
+                                       const char* hostname);
+size_t DomainRegistryGetRegistryLengthAllowUnknownRegistries(
+    const struct DomainRegistry* registry,
+    const char* hostname);
+size_t DomainRegistryGetRegistryLengthN(
+    const struct DomainRegistry* registry,
+    const char* hostname,
+    size_t hostname_len);
+size_t DomainRegistryGetRegistryLengthAllowUnknownRegistriesN(
+    const struct DomainRegistry* registry,
+    const char* hostname,
+    size_t hostname_len);
+size_t DomainRegistryGetRegistryLengthUtf8(
+    const struct DomainRegistry* registry,
+    const char* hostname);
+size_t DomainRegistryGetRegistryLengthUtf8N(
+    const struct DomainRegistry* registry,
+    const char* hostname,
+    size_t hostname_len);
+void DomainRegistryGetRegistryLengthBatch(
+    const struct DomainRegistry* registry,
+    const char* const* hostnames,
+    const size_t* hostname_lens,
+    size_t num_hostnames,
+    size_t* registry_lens);
+void DomainRegistryGetRegistryLengths(const struct DomainRegistry* registry,
+                                      const char* hostname,
+                                      size_t* icann_registry_len,
+                                      size_t* private_registry_len);
+void DomainRegistryGetRegistryLengthsN(
+    const struct DomainRegistry* registry,
+    const char* hostname,
+    size_t hostname_len,
+    size_t* icann_registry_len,
+    size_t* private_registry_len);
+int DomainRegistryGetRegistryInfo(const struct DomainRegistry* registry,
+                                  const char* hostname,
+                                  struct RegistryInfo* info);
+int DomainRegistryGetRegistryInfoN(const struct DomainRegistry* registry,
+                                   const char* hostname,
+                                   size_t hostname_len,
+                                   struct RegistryInfo* info);
+int DomainRegistryGetRegistryInfoForUrl(
+    const struct DomainRegistry* registry,
+    const char* url,
+    size_t url_len,
+    struct RegistryInfo* info);
+int DomainRegistryAddRegistryRule(struct DomainRegistry* registry,
+                                  const char* rule);
+int DomainRegistryRemoveRegistryRule(struct DomainRegistry* registry,
+                                     const char* rule);
+void DomainRegistryClearRegistryRules(struct DomainRegistry* registry);
+
+/*
+ * Stores the number of GetRegistryLength lookups made by the calling
+ * thread that were answered from its result cache in *hits, and the
+ * number that were not in *misses. The cache is only built when
+ * domain_registry_result_cache_size is set in domain_registry.gyp;
+ * otherwise both counts are 0. GetRegistryLengthBatch does not use
+ * the cache.
+ */
+void GetRegistryResultCacheStats(size_t* hits, size_t* misses);
+
+/*
+ * Counts of the events on the lookup path, summed over all threads.
+ */
+struct RegistryStats {
+  /* Lookups, by entry point. */
+  size_t length_lookups;    /* GetRegistryLength and its variants. */
+  size_t lengths_lookups;   /* GetRegistryLengths. */
+  size_t info_lookups;      /* GetRegistryInfo and GetRegistryInfoForUrl. */
+  size_t batch_lookups;     /* Hostnames passed to GetRegistryLengthBatch. */
+
+  /* Hostname-parts looked up, in the tables or the runtime rules. */
+  size_t labels_visited;
+
+  /*
+   * Probes made while searching the trie, i.e. steps of a binary
+   * search, scans of the fingerprints and lookups in the root hash,
+   * and the hostname-part string comparisons made meanwhile.
+   */
+  size_t search_probes;
+  size_t string_compares;
+
+  /* Searches of the trie that fell back to a wildcard rule. */
+  size_t wildcard_fallbacks;
+
+  /* Searches of the trie among siblings that include exception rules. */
+  size_t exception_probes;
+
+  /* Hostname-parts found in the leaf node table. */
+  size_t leaf_table_hits;
+
+  /*
+   * Hostnames rejected before or during the search, by reason: longer
+   * than 255 bytes, containing non-ASCII characters or null bytes, or
+   * containing an empty, wildcard or exception hostname-part.
+   */
+  size_t rejected_too_long;
+  size_t rejected_non_ascii;
+  size_t rejected_invalid_component;
+};
+
+/*
+ * Stores the counts of the events on the lookup path, summed over all
+ * threads, including those that have exited, in *stats. Lookups on a
+ * thread are only counted once the thread has looked up a hostname
+ * with the public API. Counting is only built when
+ * domain_registry_stats is set in domain_registry.gyp; otherwise all
+ * counts are 0.
+ */
+void GetRegistryStats(struct RegistryStats* stats);
+
 /*
  * Override the assertion handler by providing a custom assert handler
  * implementation. The assertion handler will be invoked when an
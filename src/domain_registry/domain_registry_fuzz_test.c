@@ -0,0 +1,682 @@
+// Copyright 2011 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Differential fuzz test, which checks that every lookup engine agrees
+// with a straightforward reference matcher. The reference reads the
+// rules from the public suffix list file the tables are generated
+// from, keeps them and their suffixes in sorted arrays, and looks up
+// each suffix of the hostname in them.
+//
+// Hostnames are generated from the rules, then mutated: hostname-parts
+// are added, dropped or replaced by unknown ones, characters are
+// uppercased, dots are added at the start, at the end and in between,
+// wildcard and exception hostname-parts are inserted, bytes are
+// replaced by arbitrary ones and hostnames are made too long. Each
+// hostname is looked up with GetRegistryLength,
+// GetRegistryLengthAllowUnknownRegistries and their N variants, with
+// every engine, and the results are compared with the reference.
+//
+// Usage: domain_registry_fuzz_test [--json] [--rules=FILE]
+//            [--engine=NAME] [--runs=N] [--seed=N]
+//
+// --rules is the public suffix list file the tables were generated
+// from, third_party/effective_tld_names/effective_tld_names.dat by
+// default, relative to the working directory. --engine runs only the
+// named engine. --runs sets the number of hostnames checked with each
+// engine, and --seed the seed they are generated from. For each engine
+// the test reports the number of executions (hostnames checked), the
+// number of mismatches and the executions per second, or with --json,
+// one JSON object per engine, one per line. The first mismatches are
+// printed. Returns non-zero if there are any.
+//
+// Built with -DDOMAIN_REGISTRY_LIBFUZZER and -fsanitize=fuzzer (see
+// domain_registry_libfuzzer in domain_registry.gyp), this is a
+// libFuzzer target instead. Each input is checked as a hostname as it
+// is, and is also used in place of the random numbers to generate and
+// mutate a hostname as above. Mismatches abort, so that libFuzzer
+// saves the input. --rules is read the same way (libFuzzer warns
+// about, then ignores, flags that start with "--"), and libFuzzer
+// reports the executions per second itself.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "domain_registry/domain_registry.h"
+#include "domain_registry/private/hostname_scanner.h"
+#include "domain_registry/private/punycode.h"
+#include "domain_registry/testing/lookup_engine.h"
+
+static const char kDefaultRulesFile[] =
+    "third_party/effective_tld_names/effective_tld_names.dat";
+
+// The number of mismatches that are printed.
+static const size_t kMaxPrintedMismatches = 10;
+
+// Large enough for hostnames somewhat longer than MAX_HOSTNAME_LEN,
+// which must be rejected.
+#define MAX_GENERATED_LEN (MAX_HOSTNAME_LEN + 64)
+
+// The rules of the public suffix list, in IDNA form, sorted with
+// strcmp, and the suffixes of the rules that start at one of their
+// dots (e.g. "kobe.jp" and "jp" for "*.kobe.jp"), sorted the same way.
+static char** g_rules = NULL;
+static size_t g_num_rules = 0;
+static char** g_rule_suffixes = NULL;
+static size_t g_num_rule_suffixes = 0;
+
+static int CompareStrings(const void* a, const void* b) {
+  return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+static int HasString(char** strings, size_t num_strings, const char* s) {
+  return bsearch(&s, strings, num_strings, sizeof(strings[0]),
+                 CompareStrings) != NULL;
+}
+
+static char* StrDup(const char* s, size_t len) {
+  char* copy = malloc(len + 1);
+  if (copy != NULL) {
+    memcpy(copy, s, len);
+    copy[len] = 0;
+  }
+  return copy;
+}
+
+// Appends s to the array *strings of *num_strings entries, growing it
+// as needed. Returns 0 if out of memory.
+static int AppendString(char*** strings, size_t* num_strings,
+                        size_t* capacity, char* s) {
+  if (s == NULL) {
+    return 0;
+  }
+  if (*num_strings == *capacity) {
+    const size_t new_capacity = *capacity ? 2 * *capacity : 1024;
+    char** grown = realloc(*strings, new_capacity * sizeof(grown[0]));
+    if (grown == NULL) {
+      free(s);
+      return 0;
+    }
+    *strings = grown;
+    *capacity = new_capacity;
+  }
+  (*strings)[(*num_strings)++] = s;
+  return 1;
+}
+
+// Reads the rules from the public suffix list file at path. Each line
+// that is not empty or a comment holds a rule, which is converted to
+// its IDNA form, as registry_tables_generator.py does. Returns 0 if
+// the file cannot be read or holds no rules.
+static int LoadReferenceRules(const char* path) {
+  FILE* file = fopen(path, "r");
+  char line[1024];
+  size_t rules_capacity = 0;
+  size_t suffixes_capacity = 0;
+
+  if (file == NULL) {
+    fprintf(stderr, "Failed to open %s.\n", path);
+    return 0;
+  }
+  while (fgets(line, sizeof(line), file) != NULL) {
+    char rule[MAX_HOSTNAME_LEN + 1];
+    size_t line_len = strlen(line);
+    size_t rule_len;
+    const char* dot;
+
+    while (line_len > 0 && strchr(" \t\r\n", line[line_len - 1]) != NULL) {
+      --line_len;
+    }
+    if (line_len == 0 || strncmp(line, "//", 2) == 0) {
+      continue;
+    }
+    rule_len = ConvertHostnameToAscii(line, line_len, rule, sizeof(rule));
+    if (rule_len == 0) {
+      fprintf(stderr, "Failed to convert rule %.*s.\n", (int) line_len, line);
+      fclose(file);
+      return 0;
+    }
+    rule[rule_len] = 0;
+    if (!AppendString(&g_rules, &g_num_rules, &rules_capacity,
+                      StrDup(rule, rule_len))) {
+      fclose(file);
+      return 0;
+    }
+    for (dot = strchr(rule, '.'); dot != NULL; dot = strchr(dot + 1, '.')) {
+      if (!AppendString(&g_rule_suffixes, &g_num_rule_suffixes,
+                        &suffixes_capacity,
+                        StrDup(dot + 1, rule + rule_len - (dot + 1)))) {
+        fclose(file);
+        return 0;
+      }
+    }
+  }
+  fclose(file);
+  qsort(g_rules, g_num_rules, sizeof(g_rules[0]), CompareStrings);
+  qsort(g_rule_suffixes, g_num_rule_suffixes, sizeof(g_rule_suffixes[0]),
+        CompareStrings);
+  return g_num_rules > 0;
+}
+
+static void FreeReferenceRules(void) {
+  size_t i;
+  for (i = 0; i < g_num_rules; ++i) {
+    free(g_rules[i]);
+  }
+  for (i = 0; i < g_num_rule_suffixes; ++i) {
+    free(g_rule_suffixes[i]);
+  }
+  free(g_rules);
+  free(g_rule_suffixes);
+  g_rules = NULL;
+  g_rule_suffixes = NULL;
+  g_num_rules = 0;
+  g_num_rule_suffixes = 0;
+}
+
+// Returns whether the string made of prefix followed by the len bytes
+// at suffix is one of the num_strings sorted strings.
+static int HasJoinedString(char** strings, size_t num_strings,
+                           const char* prefix, const char* suffix,
+                           size_t len) {
+  char joined[MAX_HOSTNAME_LEN + 3];
+  const size_t prefix_len = strlen(prefix);
+  memcpy(joined, prefix, prefix_len);
+  memcpy(joined + prefix_len, suffix, len);
+  joined[prefix_len + len] = 0;
+  return HasString(strings, num_strings, joined);
+}
+
+// Returns whether prefix followed by the len bytes at suffix is a
+// rule.
+static int HasRule(const char* prefix, const char* suffix, size_t len) {
+  return HasJoinedString(g_rules, g_num_rules, prefix, suffix, len);
+}
+
+// Like HasRule, but also returns non-zero for a suffix of a rule.
+static int HasRuleOrSuffix(const char* prefix, const char* suffix,
+                           size_t len) {
+  return HasRule(prefix, suffix, len) ||
+      HasJoinedString(g_rule_suffixes, g_num_rule_suffixes, prefix, suffix,
+                      len);
+}
+
+// The reference for GetRegistryLengthN and
+// GetRegistryLengthAllowUnknownRegistriesN, implemented from the
+// documentation of domain_registry.h and the algorithm of the public
+// suffix list (http://publicsuffix.org/list/), without regard to how
+// the engines search.
+//
+// The registry is the longest suffix of the hostname that a rule
+// matches, where a wildcard rule "*.foo" matches "bar.foo" if "bar.foo"
+// is not a suffix of another rule, and an exception rule "!bar.foo"
+// makes the registry "foo". Unlike the public suffix list algorithm,
+// if a longer suffix of the hostname is a suffix of a rule, but no
+// rule matches it (e.g. "kobe.jp" of the rule "*.kobe.jp"), there is
+// no registry, rather than a shorter one ("jp"). The list works
+// around this with rules added by scripts/synthesize_entries.py.
+static size_t ReferenceRegistryLength(const char* hostname,
+                                      size_t hostname_len,
+                                      int allow_unknown_registries) {
+  char lowercase[MAX_HOSTNAME_LEN];
+  // The offsets of the hostname-parts that can be part of a registry,
+  // from the rootmost, and the offset of the end of each.
+  size_t part_offsets[MAX_HOSTNAME_LEN];
+  size_t part_ends[MAX_HOSTNAME_LEN];
+  size_t num_parts = 0;
+  // The suffix of a rule matched so far, e.g. "*.kobe.jp" for
+  // "foo.kobe.jp".
+  char matched[MAX_HOSTNAME_LEN + 3];
+  size_t matched_len = 0;
+  size_t start = 0;
+  size_t end = hostname_len;
+  size_t registry_offset = hostname_len;
+  size_t i;
+
+  if (hostname_len > MAX_HOSTNAME_LEN) {
+    return 0;
+  }
+  for (i = 0; i < hostname_len; ++i) {
+    const unsigned char c = (unsigned char) hostname[i];
+    if (c == 0 || c >= 0x80) {
+      return 0;
+    }
+    lowercase[i] = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+  }
+
+  // Leading dots are ignored, as is a single trailing dot, which is
+  // part of the registry.
+  while (start < end && lowercase[start] == '.') {
+    ++start;
+  }
+  if (end > start && lowercase[end - 1] == '.') {
+    --end;
+  }
+
+  // Split the hostname into hostname-parts, from the rootmost, up to
+  // the first one that is empty or is a wildcard or exception, which
+  // no rule can match.
+  while (end > start) {
+    size_t part_start = end;
+    while (part_start > start && lowercase[part_start - 1] != '.') {
+      --part_start;
+    }
+    if (part_start == end || lowercase[part_start] == '*' ||
+        lowercase[part_start] == '!') {
+      break;
+    }
+    part_offsets[num_parts] = part_start;
+    part_ends[num_parts++] = end;
+    if (part_start == start) {
+      break;
+    }
+    end = part_start - 1;
+  }
+
+  for (i = 0; i < num_parts; ++i) {
+    const char* part = lowercase + part_offsets[i];
+    const size_t part_len = part_ends[i] - part_offsets[i];
+    char suffix[MAX_HOSTNAME_LEN + 3];
+    size_t suffix_len = part_len;
+
+    // The hostname-part followed by the suffix matched so far.
+    memcpy(suffix, part, part_len);
+    if (i > 0) {
+      suffix[suffix_len++] = '.';
+      memcpy(suffix + suffix_len, matched, matched_len);
+      suffix_len += matched_len;
+    }
+    if (HasRuleOrSuffix("", suffix, suffix_len)) {
+      memcpy(matched, suffix, suffix_len);
+      matched_len = suffix_len;
+    } else if (i > 0 && HasRule("!", suffix, suffix_len)) {
+      // An exception rule only applies under a wildcard rule.
+      if (HasRuleOrSuffix("*.", matched, matched_len)) {
+        registry_offset = part_offsets[i - 1];
+      }
+      break;
+    } else if (i > 0 && HasRuleOrSuffix("*.", matched, matched_len)) {
+      memmove(matched + 2, matched, matched_len);
+      memcpy(matched, "*.", 2);
+      matched_len += 2;
+    } else {
+      if (i == 0 && allow_unknown_registries) {
+        // No rule has the rootmost hostname-part, so it is the
+        // registry.
+        registry_offset = part_offsets[0];
+      }
+      break;
+    }
+    if (HasRule("", matched, matched_len)) {
+      registry_offset = part_offsets[i];
+    } else {
+      registry_offset = hostname_len;
+    }
+  }
+  return hostname_len - registry_offset;
+}
+
+// The source of the random choices made to generate hostnames: either
+// a deterministic pseudo-random number generator (xorshift64*), or,
+// for libFuzzer, the bytes of its input, followed by zeros.
+struct Random {
+  unsigned long long state;
+  const unsigned char* data;
+  size_t data_len;
+};
+
+static unsigned NextRandom(struct Random* random) {
+  if (random->data != NULL) {
+    unsigned value = 0;
+    int i;
+    for (i = 0; i < 2 && random->data_len > 0; ++i) {
+      value = (value << 8) | *random->data++;
+      --random->data_len;
+    }
+    return value;
+  }
+  random->state ^= random->state >> 12;
+  random->state ^= random->state << 25;
+  random->state ^= random->state >> 27;
+  return (unsigned) ((random->state * 0x2545f4914f6cdd1dULL) >> 32);
+}
+
+// Returns non-zero with a probability of 1 in n.
+static int OneIn(struct Random* random, unsigned n) {
+  return NextRandom(random) % n == 0;
+}
+
+// A hostname being generated, of len bytes at buf.
+struct Hostname {
+  char buf[MAX_GENERATED_LEN];
+  size_t len;
+};
+
+static void InsertBytes(struct Hostname* hostname, size_t offset,
+                        const char* s, size_t len) {
+  if (hostname->len + len > sizeof(hostname->buf)) {
+    return;
+  }
+  memmove(hostname->buf + offset + len, hostname->buf + offset,
+          hostname->len - offset);
+  memcpy(hostname->buf + offset, s, len);
+  hostname->len += len;
+}
+
+static void InsertString(struct Hostname* hostname, size_t offset,
+                         const char* s) {
+  InsertBytes(hostname, offset, s, strlen(s));
+}
+
+// Returns the offset of the start of a random hostname-part.
+static size_t GetRandomPartOffset(struct Random* random,
+                                  const struct Hostname* hostname) {
+  size_t offsets[MAX_GENERATED_LEN + 1];
+  size_t num_offsets = 1;
+  size_t i;
+  offsets[0] = 0;
+  for (i = 0; i < hostname->len; ++i) {
+    if (hostname->buf[i] == '.') {
+      offsets[num_offsets++] = i + 1;
+    }
+  }
+  return offsets[NextRandom(random) % num_offsets];
+}
+
+// Hostname-parts added to the generated hostnames. Some of them are
+// the names of rules too.
+static const char* const kLabels[] = {
+  "www", "a", "foo", "example", "xn--p1ai", "0", "a-b", "com", "uk",
+  "co", "city", "blogspot", "s3", "zz", "ck",
+};
+#define NUM_LABELS (sizeof(kLabels) / sizeof(kLabels[0]))
+
+static const char* GetRandomLabel(struct Random* random) {
+  return kLabels[NextRandom(random) % NUM_LABELS];
+}
+
+// Generates a hostname under a random rule, then mutates it.
+static void GenerateHostname(struct Random* random,
+                             struct Hostname* hostname) {
+  const char* rule = g_rules[NextRandom(random) % g_num_rules];
+  size_t num_prefix_parts = NextRandom(random) % 4;
+  size_t i;
+
+  hostname->len = 0;
+  if (rule[0] == '!') {
+    // An exception rule is matched by the hostname-part itself.
+    ++rule;
+  }
+  if (rule[0] == '*') {
+    // The wildcard matches any hostname-part.
+    InsertString(hostname, 0, GetRandomLabel(random));
+    ++rule;
+  }
+  InsertString(hostname, hostname->len, rule);
+  for (i = 0; i < num_prefix_parts; ++i) {
+    InsertString(hostname, 0, ".");
+    InsertString(hostname, 0, GetRandomLabel(random));
+  }
+
+  if (OneIn(random, 8) && hostname->len > 0) {
+    // Drop the first hostname-part.
+    const char* dot = memchr(hostname->buf, '.', hostname->len);
+    if (dot != NULL) {
+      const size_t len = dot + 1 - hostname->buf;
+      memmove(hostname->buf, hostname->buf + len, hostname->len - len);
+      hostname->len -= len;
+    }
+  }
+  if (OneIn(random, 8)) {
+    // Replace the rootmost hostname-part with one that may not be in
+    // the list.
+    while (hostname->len > 0 && hostname->buf[hostname->len - 1] != '.') {
+      --hostname->len;
+    }
+    InsertString(hostname, hostname->len,
+                 OneIn(random, 2) ? "unknowntld" : GetRandomLabel(random));
+  }
+  if (OneIn(random, 8)) {
+    // Insert a wildcard or exception hostname-part.
+    const size_t offset = GetRandomPartOffset(random, hostname);
+    InsertString(hostname, offset, OneIn(random, 2) ? "*." : "!www.");
+  }
+  if (OneIn(random, 4)) {
+    for (i = 0; i < hostname->len; ++i) {
+      char c = hostname->buf[i];
+      if (c >= 'a' && c <= 'z' && OneIn(random, 2)) {
+        hostname->buf[i] = c - 'a' + 'A';
+      }
+    }
+  }
+  if (OneIn(random, 8)) {
+    InsertString(hostname, 0, OneIn(random, 2) ? "." : "..");
+  }
+  if (OneIn(random, 4)) {
+    InsertString(hostname, hostname->len, OneIn(random, 4) ? ".." : ".");
+  }
+  if (OneIn(random, 8)) {
+    // Double a dot, or add one at the start of a hostname-part.
+    InsertString(hostname, GetRandomPartOffset(random, hostname), ".");
+  }
+  if (OneIn(random, 16) && hostname->len > 0) {
+    // Replace a byte with an arbitrary one, which may be a null byte
+    // or not ASCII.
+    hostname->buf[NextRandom(random) % hostname->len] =
+        (char) NextRandom(random);
+  }
+  if (OneIn(random, 32)) {
+    // Make the hostname about as long as the maximum, or longer.
+    size_t target_len = MAX_HOSTNAME_LEN - 8 + NextRandom(random) % 16;
+    while (hostname->len + 8 <= target_len) {
+      InsertString(hostname, 0, "abcdefg.");
+    }
+  }
+}
+
+static size_t g_num_mismatches = 0;
+
+static void PrintMismatch(const char* engine, const char* function,
+                          const char* hostname, size_t hostname_len,
+                          size_t expected, size_t actual) {
+  size_t i;
+  ++g_num_mismatches;
+  if (g_num_mismatches > kMaxPrintedMismatches) {
+    return;
+  }
+  fprintf(stderr, "%s: %s(\"", engine, function);
+  for (i = 0; i < hostname_len; ++i) {
+    const unsigned char c = (unsigned char) hostname[i];
+    if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\') {
+      fputc(c, stderr);
+    } else {
+      fprintf(stderr, "\\x%02x", c);
+    }
+  }
+  fprintf(stderr, "\", %d) = %d, expected %d\n",
+          (int) hostname_len, (int) actual, (int) expected);
+}
+
+// Checks the lookups of the hostname_len bytes at hostname with the
+// installed engine against the reference. Returns 0 on a mismatch.
+static int CheckHostname(const char* engine, const char* hostname,
+                         size_t hostname_len) {
+  const size_t expected = ReferenceRegistryLength(hostname, hostname_len, 0);
+  const size_t expected_unknown =
+      ReferenceRegistryLength(hostname, hostname_len, 1);
+  const size_t mismatches = g_num_mismatches;
+  size_t actual;
+
+  actual = GetRegistryLengthN(hostname, hostname_len);
+  if (actual != expected) {
+    PrintMismatch(engine, "GetRegistryLengthN", hostname, hostname_len,
+                  expected, actual);
+  }
+  actual = GetRegistryLengthAllowUnknownRegistriesN(hostname, hostname_len);
+  if (actual != expected_unknown) {
+    PrintMismatch(engine, "GetRegistryLengthAllowUnknownRegistriesN",
+                  hostname, hostname_len, expected_unknown, actual);
+  }
+  // The null-terminated variants, if the hostname has no null byte.
+  if (hostname_len < MAX_GENERATED_LEN &&
+      memchr(hostname, 0, hostname_len) == NULL) {
+    char terminated[MAX_GENERATED_LEN + 1];
+    memcpy(terminated, hostname, hostname_len);
+    terminated[hostname_len] = 0;
+    actual = GetRegistryLength(terminated);
+    if (actual != expected) {
+      PrintMismatch(engine, "GetRegistryLength", hostname, hostname_len,
+                    expected, actual);
+    }
+    actual = GetRegistryLengthAllowUnknownRegistries(terminated);
+    if (actual != expected_unknown) {
+      PrintMismatch(engine, "GetRegistryLengthAllowUnknownRegistries",
+                    hostname, hostname_len, expected_unknown, actual);
+    }
+  }
+  return g_num_mismatches == mismatches;
+}
+
+#if defined(DOMAIN_REGISTRY_LIBFUZZER)
+
+int LLVMFuzzerInitialize(int* argc, char*** argv) {
+  const char* rules_file = kDefaultRulesFile;
+  int i;
+  for (i = 1; i < *argc; ++i) {
+    const char* value = GetFlagValue((*argv)[i], "--rules");
+    if (value != NULL) {
+      rules_file = value;
+    }
+  }
+  if (!LoadReferenceRules(rules_file)) {
+    exit(EXIT_FAILURE);
+  }
+  atexit(FreeReferenceRules);
+  InitializeDomainRegistry();
+  return 0;
+}
+
+int LLVMFuzzerTestOneInput(const unsigned char* data, size_t size) {
+  struct Random random;
+  struct Hostname hostname;
+  size_t e;
+  int ok = 1;
+
+  random.state = 0;
+  random.data = data;
+  random.data_len = size;
+  GenerateHostname(&random, &hostname);
+  for (e = 0; e < NUM_LOOKUP_ENGINES; ++e) {
+    InstallEngine(kLookupEngines[e]);
+    ok &= CheckHostname(kLookupEngines[e], (const char*) data, size);
+    ok &= CheckHostname(kLookupEngines[e], hostname.buf, hostname.len);
+  }
+  if (!ok) {
+    abort();
+  }
+  return 0;
+}
+
+#else  // DOMAIN_REGISTRY_LIBFUZZER
+
+static const size_t kDefaultNumRuns = 1 << 18;
+
+static double GetNanos(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char** argv) {
+  const char* rules_file = kDefaultRulesFile;
+  const char* engine_filter = NULL;
+  size_t num_runs = kDefaultNumRuns;
+  unsigned long long seed = 1;
+  int json = 0;
+  size_t e;
+  int i;
+
+  for (i = 1; i < argc; ++i) {
+    const char* value;
+    if (strcmp(argv[i], "--json") == 0) {
+      json = 1;
+    } else if ((value = GetFlagValue(argv[i], "--rules")) != NULL) {
+      rules_file = value;
+    } else if ((value = GetFlagValue(argv[i], "--engine")) != NULL) {
+      engine_filter = value;
+    } else if ((value = GetFlagValue(argv[i], "--runs")) != NULL &&
+               atol(value) > 0) {
+      num_runs = (size_t) atol(value);
+    } else if ((value = GetFlagValue(argv[i], "--seed")) != NULL) {
+      seed = strtoull(value, NULL, 10);
+    } else {
+      fprintf(stderr, "Usage: %s [--json] [--rules=FILE] [--engine=NAME] "
+              "[--runs=N] [--seed=N]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!LoadReferenceRules(rules_file)) {
+    return EXIT_FAILURE;
+  }
+  InitializeDomainRegistry();
+  if (engine_filter != NULL && !InstallEngine(engine_filter)) {
+    fprintf(stderr, "Unknown engine %s.\n", engine_filter);
+    return EXIT_FAILURE;
+  }
+
+  if (!json) {
+    printf("%-11s %10s %10s %10s\n",
+           "engine", "execs", "mismatches", "execs/s");
+  }
+  for (e = 0; e < NUM_LOOKUP_ENGINES; ++e) {
+    struct Random random;
+    struct Hostname hostname;
+    const size_t mismatches = g_num_mismatches;
+    double start_nanos, execs_per_sec;
+    size_t run;
+
+    if (engine_filter != NULL &&
+        strcmp(engine_filter, kLookupEngines[e]) != 0) {
+      continue;
+    }
+    InstallEngine(kLookupEngines[e]);
+    // Every engine checks the same hostnames.
+    random.state = seed * 0x9e3779b97f4a7c15ULL | 1;
+    random.data = NULL;
+    random.data_len = 0;
+    start_nanos = GetNanos();
+    for (run = 0; run < num_runs; ++run) {
+      GenerateHostname(&random, &hostname);
+      CheckHostname(kLookupEngines[e], hostname.buf, hostname.len);
+    }
+    execs_per_sec = num_runs * 1e9 / (GetNanos() - start_nanos);
+    if (json) {
+      printf("{\"engine\": \"%s\", \"execs\": %lu, \"mismatches\": %lu, "
+             "\"execs_per_sec\": %.0f}\n",
+             kLookupEngines[e], (unsigned long) num_runs,
+             (unsigned long) (g_num_mismatches - mismatches), execs_per_sec);
+    } else {
+      printf("%-11s %10lu %10lu %10.0f\n", kLookupEngines[e],
+             (unsigned long) num_runs,
+             (unsigned long) (g_num_mismatches - mismatches), execs_per_sec);
+    }
+  }
+
+  FreeReferenceRules();
+  return g_num_mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif  // DOMAIN_REGISTRY_LIBFUZZER
@@ -14,38 +14,692 @@
 //
 // Performance test, which can be used for A/B testing to measure the
 // performance impact of a change. Run the test before making the change,
-// then after making the change. Look at the difference in runtimes
-// before and after to determine the performance impact.
+// then after making the change, and compare the results.
+//
+// Each lookup engine is run over a set of workloads, which are built
+// from the generated test table:
+//
+//   zipf       hostnames of Zipf-distributed popularity, most of them
+//              under the most common registries
+//   test-table every hostname of the test table, in order
+//   cold       the same, with the CPU caches flushed before each pass
+//   long       hostnames of many hostname-parts, close to the maximum
+//              length
+//   unknown    hostnames under top-level domains that have no rules
+//   invalid    empty hostnames, empty hostname-parts and hostnames
+//              over the maximum length
+//   uppercase  hostnames of the test table in uppercase
+//   wildcard   hostnames that match wildcard and exception rules
+//
+// For each engine and workload, the test reports the throughput of
+// GetRegistryLengthN and of GetRegistryLengthBatch, the 50th, 99th and
+// 99.9th percentile latency of single GetRegistryLengthN calls, and the
+// number of allocations per call. Results are checked against the
+// test table, or, where it has no answer, against the first engine.
+//
+// Usage: domain_registry_perf_test [--json] [--engine=NAME]
+//            [--workload=NAME] [--calls=N]
+//
+// --json prints one JSON object per engine and workload, one per
+// line, for comparing runs with a script. --engine and --workload run
+// only the named engine or workload. --calls sets the number of calls
+// the throughput of each engine and workload is measured over.
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "domain_registry/domain_registry.h"
+#include "domain_registry/private/hostname_scanner.h"
+#include "domain_registry/private/init_registry_tables.h"
+#include "domain_registry/testing/lookup_engine.h"
 #include "domain_registry/testing/test_entry.h"
 
 // Include the generated file that contains the actual registry tables.
 #include "registry_tables_genfiles/test_registry_tables.h"
 
 static const size_t kTestTableLen = sizeof(kTestTable) / sizeof(kTestTable[0]);
-static const size_t kNumIters = 10000;
+
+// Number of hostnames of the zipf workload, and the number of calls
+// whose latency is measured for each engine and workload.
+static const size_t kNumZipfHostnames = 1 << 15;
+static const size_t kNumLatencyCalls = 1 << 18;
+static const size_t kDefaultNumCalls = 1 << 21;
+
+// Size of the buffer read before each pass of the cold workload to
+// evict the registry tables from cache.
+#define EVICTION_BUFFER_SIZE (16 * 1024 * 1024)
+static const size_t kCacheLineSize = 64;
+static unsigned char* g_eviction_buffer = NULL;
+static volatile unsigned g_eviction_sink = 0;
+
+static void EvictCache(void) {
+  unsigned sum = 0;
+  size_t i;
+  for (i = 0; i < EVICTION_BUFFER_SIZE; i += kCacheLineSize) {
+    sum += g_eviction_buffer[i]++;
+  }
+  g_eviction_sink = sum;
+}
+
+// Count allocations by replacing the allocator functions, which glibc
+// supports. Elsewhere, and under AddressSanitizer, which replaces them
+// itself, allocations are not counted.
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define __SANITIZE_ADDRESS__ 1
+#endif
+#endif
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define COUNT_ALLOCATIONS 1
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t num, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static size_t g_num_allocations = 0;
+
+void* malloc(size_t size) {
+  ++g_num_allocations;
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t num, size_t size) {
+  ++g_num_allocations;
+  return __libc_calloc(num, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  ++g_num_allocations;
+  return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+  __libc_free(ptr);
+}
+#else
+#define COUNT_ALLOCATIONS 0
+static size_t g_num_allocations = 0;
+#endif
+
+static double GetNanos(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// A deterministic pseudo-random number generator (xorshift64*), so
+// that runs build the same workloads.
+static unsigned long long g_random_state = 0x9e3779b97f4a7c15ULL;
+
+static unsigned long long NextRandom(void) {
+  g_random_state ^= g_random_state >> 12;
+  g_random_state ^= g_random_state << 25;
+  g_random_state ^= g_random_state >> 27;
+  return g_random_state * 0x2545f4914f6cdd1dULL;
+}
+
+static double NextRandomDouble(void) {
+  return (double) (NextRandom() >> 11) / (double) (1ULL << 53);
+}
+
+// The hostnames of a workload, and the registry length each should
+// have. expected_lens is NULL until the first engine has run, if the
+// test table does not give the answers.
+struct Workload {
+  const char* name;
+  const char** hostnames;
+  size_t* hostname_lens;
+  size_t* expected_lens;
+  size_t num_hostnames;
+  int evict_cache;
+};
+
+static void* AllocOrDie(size_t size) {
+  void* p = malloc(size);
+  if (p == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+static char* CopyString(const char* s, size_t len) {
+  char* copy = AllocOrDie(len + 1);
+  memcpy(copy, s, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+static void InitWorkload(struct Workload* workload,
+                         const char* name,
+                         size_t num_hostnames,
+                         int has_expected_lens) {
+  workload->name = name;
+  workload->hostnames = AllocOrDie(num_hostnames * sizeof(char*));
+  workload->hostname_lens = AllocOrDie(num_hostnames * sizeof(size_t));
+  workload->expected_lens = has_expected_lens ?
+      AllocOrDie(num_hostnames * sizeof(size_t)) : NULL;
+  workload->num_hostnames = 0;
+  workload->evict_cache = 0;
+}
+
+// Adds a copy of hostname, of length hostname_len.
+static void AddHostname(struct Workload* workload,
+                        const char* hostname,
+                        size_t hostname_len,
+                        size_t expected_len) {
+  const size_t i = workload->num_hostnames++;
+  workload->hostnames[i] = CopyString(hostname, hostname_len);
+  workload->hostname_lens[i] = hostname_len;
+  if (workload->expected_lens != NULL) {
+    workload->expected_lens[i] = expected_len;
+  }
+}
+
+// Registries that real-world hostnames are most often under, most
+// popular first. Hostnames under them take the top ranks of the zipf
+// workload.
+static const char* const kPopularRegistries[] = {
+  "com", "net", "org", "de", "co.uk", "cn", "ru", "jp", "info", "nl",
+  "fr", "com.br", "it", "io", "pl", "in", "au", "com.au", "blogspot.com",
+  "github.io", "ca", "es", "co.jp", "eu", "edu", "gov", "us", "ch",
+};
+
+// Subdomains the hostnames of the zipf workload have.
+static const char* const kSubdomains[] = {
+  "www.", "mail.", "cdn.static.", "api.", "m.", "img1.cdn.",
+};
+
+static int IsUnderRegistry(const struct TestEntry* entry,
+                           const char* registry) {
+  const size_t len = strlen(registry);
+  const size_t hostname_len = strlen(entry->hostname);
+  return !entry->is_exception_rule && entry->registry_len == len &&
+      strcmp(entry->hostname + hostname_len - len, registry) == 0;
+}
+
+static void BuildZipfWorkload(struct Workload* workload) {
+  const size_t num_popular =
+      sizeof(kPopularRegistries) / sizeof(kPopularRegistries[0]);
+  const size_t num_subdomains = sizeof(kSubdomains) / sizeof(kSubdomains[0]);
+  size_t* ranks = AllocOrDie(kTestTableLen * sizeof(size_t));
+  double* cumulative = AllocOrDie(kTestTableLen * sizeof(double));
+  size_t num_ranked = 0;
+  size_t i, j;
+  double sum = 0;
+
+  // Rank the popular registries first, then the rest of the test
+  // table in a random order.
+  for (i = 0; i < num_popular; ++i) {
+    for (j = 0; j < kTestTableLen; ++j) {
+      if (IsUnderRegistry(&kTestTable[j], kPopularRegistries[i])) {
+        ranks[num_ranked++] = j;
+        break;
+      }
+    }
+  }
+  for (j = 0; j < kTestTableLen; ++j) {
+    size_t k;
+    for (k = 0; k < num_ranked && ranks[k] != j; ++k) {
+    }
+    if (k == num_ranked) {
+      ranks[num_ranked++] = j;
+    }
+  }
+  for (i = num_ranked - 1; i > num_popular; --i) {
+    const size_t k = num_popular + NextRandom() % (i - num_popular + 1);
+    const size_t rank = ranks[i];
+    ranks[i] = ranks[k];
+    ranks[k] = rank;
+  }
+
+  // Zipf's law with exponent 1: the hostname of rank r is picked with
+  // probability proportional to 1 / r.
+  for (i = 0; i < num_ranked; ++i) {
+    sum += 1.0 / (i + 1);
+    cumulative[i] = sum;
+  }
+  InitWorkload(workload, "zipf", kNumZipfHostnames, 1);
+  for (i = 0; i < kNumZipfHostnames; ++i) {
+    const double r = NextRandomDouble() * sum;
+    const struct TestEntry* entry;
+    const char* subdomain = kSubdomains[NextRandom() % num_subdomains];
+    size_t low = 0;
+    size_t high = num_ranked - 1;
+    char buf[MAX_HOSTNAME_LEN + 32];
+    while (low < high) {
+      const size_t middle = low + (high - low) / 2;
+      if (cumulative[middle] < r) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    entry = &kTestTable[ranks[low]];
+    // Replace the "www." all test hostnames start with, unless it is
+    // what an exception rule matches.
+    if (entry->is_exception_rule) {
+      subdomain = "www.";
+    }
+    snprintf(buf, sizeof(buf), "%s%s", subdomain, entry->hostname + 4);
+    AddHostname(workload, buf, strlen(buf), entry->registry_len);
+  }
+  free(ranks);
+  free(cumulative);
+}
+
+static void BuildTestTableWorkload(struct Workload* workload,
+                                   const char* name) {
+  size_t i;
+  InitWorkload(workload, name, kTestTableLen, 1);
+  for (i = 0; i < kTestTableLen; ++i) {
+    AddHostname(workload, kTestTable[i].hostname,
+                strlen(kTestTable[i].hostname), kTestTable[i].registry_len);
+  }
+}
+
+static void BuildLongWorkload(struct Workload* workload) {
+  static const char* const kLabels[] = {
+    "a.", "bb.", "static.", "img.", "x1.", "eu-west-1.", "c.",
+  };
+  const size_t num_labels = sizeof(kLabels) / sizeof(kLabels[0]);
+  size_t i;
+  InitWorkload(workload, "long", kTestTableLen, 1);
+  for (i = 0; i < kTestTableLen; ++i) {
+    const char* hostname = kTestTable[i].hostname;
+    const size_t hostname_len = strlen(hostname);
+    char buf[MAX_HOSTNAME_LEN + 1];
+    size_t len = 0;
+    // Prepend hostname-parts while the hostname stays valid.
+    for (;;) {
+      const char* label = kLabels[NextRandom() % num_labels];
+      const size_t label_len = strlen(label);
+      if (len + label_len + hostname_len > MAX_HOSTNAME_LEN) {
+        break;
+      }
+      memcpy(buf + len, label, label_len);
+      len += label_len;
+    }
+    memcpy(buf + len, hostname, hostname_len);
+    len += hostname_len;
+    AddHostname(workload, buf, len, kTestTable[i].registry_len);
+  }
+}
+
+static void BuildUnknownWorkload(struct Workload* workload) {
+  size_t i;
+  InitWorkload(workload, "unknown", kTestTableLen, 0);
+  for (i = 0; i < kTestTableLen; ++i) {
+    char buf[64];
+    // Top-level domains of 2 to 12 letters, starting with "zz" so that
+    // none of them has rules.
+    const size_t tld_len = 2 + NextRandom() % 11;
+    size_t len = (size_t) snprintf(buf, sizeof(buf), "www.example%d.zz",
+                                   (int) (i % 1000));
+    size_t j;
+    for (j = 2; j < tld_len; ++j) {
+      buf[len++] = 'a' + NextRandom() % 26;
+    }
+    AddHostname(workload, buf, len, 0);
+  }
+}
+
+static void BuildInvalidWorkload(struct Workload* workload) {
+  size_t i;
+  InitWorkload(workload, "invalid", kTestTableLen, 0);
+  for (i = 0; i < kTestTableLen; ++i) {
+    const char* hostname = kTestTable[i].hostname;
+    const size_t hostname_len = strlen(hostname);
+    char buf[MAX_HOSTNAME_LEN + 32];
+    size_t len = 0;
+    switch (i % 4) {
+      case 0:
+        // An empty hostname-part before the registry.
+        len = hostname_len - kTestTable[i].registry_len;
+        memcpy(buf, hostname, len);
+        buf[len++] = '.';
+        memcpy(buf + len, hostname + len - 1, kTestTable[i].registry_len);
+        len += kTestTable[i].registry_len;
+        break;
+      case 1:
+        // Over the maximum length.
+        memset(buf, 'a', MAX_HOSTNAME_LEN + 1 - hostname_len);
+        len = MAX_HOSTNAME_LEN + 1 - hostname_len;
+        buf[len - 1] = '.';
+        memcpy(buf + len, hostname, hostname_len);
+        len += hostname_len;
+        break;
+      case 2:
+        // Empty.
+        break;
+      default:
+        // A leading empty hostname-part.
+        buf[0] = '.';
+        memcpy(buf + 1, hostname + 4, hostname_len - 4);
+        len = hostname_len - 3;
+        break;
+    }
+    AddHostname(workload, buf, len, 0);
+  }
+}
+
+static void BuildUppercaseWorkload(struct Workload* workload) {
+  size_t i;
+  InitWorkload(workload, "uppercase", kTestTableLen, 1);
+  for (i = 0; i < kTestTableLen; ++i) {
+    const char* hostname = kTestTable[i].hostname;
+    const size_t len = strlen(hostname);
+    char buf[MAX_HOSTNAME_LEN + 1];
+    size_t j;
+    for (j = 0; j < len; ++j) {
+      buf[j] = hostname[j];
+      if (buf[j] >= 'a' && buf[j] <= 'z') {
+        buf[j] -= 'a' - 'A';
+      }
+    }
+    AddHostname(workload, buf, len, kTestTable[i].registry_len);
+  }
+}
+
+static void BuildWildcardWorkload(struct Workload* workload) {
+  size_t i;
+  InitWorkload(workload, "wildcard", kTestTableLen, 1);
+  for (i = 0; i < kTestTableLen; ++i) {
+    // See test_table_builder.py for the hostnames of wildcard rules.
+    const char* hostname = kTestTable[i].hostname;
+    if (kTestTable[i].is_exception_rule ||
+        strncmp(hostname, "www.example.wildcard.", 21) == 0 ||
+        strncmp(hostname, "www.example.wc.", 15) == 0) {
+      AddHostname(workload, hostname, strlen(hostname),
+                  kTestTable[i].registry_len);
+    }
+  }
+}
+
+static void FreeWorkload(struct Workload* workload) {
+  size_t i;
+  for (i = 0; i < workload->num_hostnames; ++i) {
+    free((char*) workload->hostnames[i]);
+  }
+  free(workload->hostnames);
+  free(workload->hostname_lens);
+  free(workload->expected_lens);
+}
+
+static int CompareDoubles(const void* a, const void* b) {
+  const double x = *(const double*) a;
+  const double y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+static double GetPercentile(const double* sorted, size_t n, double p) {
+  size_t i = (size_t) (p * n);
+  if (i >= n) {
+    i = n - 1;
+  }
+  return sorted[i];
+}
+
+// The minimum cost of reading the clock twice, subtracted from each
+// measured latency.
+static double g_timer_overhead = 0;
+
+static void MeasureTimerOverhead(void) {
+  size_t i;
+  g_timer_overhead = 1e9;
+  for (i = 0; i < 10000; ++i) {
+    const double start = GetNanos();
+    const double elapsed = GetNanos() - start;
+    if (elapsed < g_timer_overhead) {
+      g_timer_overhead = elapsed;
+    }
+  }
+}
+
+struct Result {
+  double ns_per_call;
+  double batch_ns_per_call;
+  double p50_ns;
+  double p99_ns;
+  double p999_ns;
+  double allocations_per_call;
+};
+
+// Checks registry_lens against the expected lengths of the workload,
+// or makes them the expected lengths if there are none yet. Returns 0
+// on a mismatch.
+static int CheckResults(const char* engine,
+                        struct Workload* workload,
+                        const size_t* registry_lens) {
+  size_t i;
+  if (workload->expected_lens == NULL) {
+    workload->expected_lens =
+        AllocOrDie(workload->num_hostnames * sizeof(size_t));
+    memcpy(workload->expected_lens, registry_lens,
+           workload->num_hostnames * sizeof(size_t));
+    return 1;
+  }
+  for (i = 0; i < workload->num_hostnames; ++i) {
+    if (registry_lens[i] != workload->expected_lens[i]) {
+      fprintf(stderr, "%s: mismatch for %s. Expected %d, actual %d.\n",
+              engine, workload->hostnames[i],
+              (int) workload->expected_lens[i], (int) registry_lens[i]);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Runs the workload with the installed engine. Returns 0 on a
+// mismatch.
+static int RunWorkload(const char* engine,
+                       struct Workload* workload,
+                       size_t num_calls,
+                       struct Result* result) {
+  const size_t n = workload->num_hostnames;
+  const size_t num_passes = (num_calls + n - 1) / n;
+  const size_t num_latency_calls =
+      n * ((kNumLatencyCalls + n - 1) / n);
+  size_t* registry_lens = AllocOrDie(n * sizeof(size_t));
+  double* latencies = AllocOrDie(num_latency_calls * sizeof(double));
+  size_t num_allocations;
+  size_t pass, i;
+  double elapsed = 0;
+  double start;
+
+  // Warm up, which also allocates the per-thread state of the
+  // library, and check the results.
+  for (i = 0; i < n; ++i) {
+    registry_lens[i] = GetRegistryLengthN(workload->hostnames[i],
+                                          workload->hostname_lens[i]);
+  }
+  if (!CheckResults(engine, workload, registry_lens)) {
+    free(registry_lens);
+    free(latencies);
+    return 0;
+  }
+
+  num_allocations = g_num_allocations;
+  for (pass = 0; pass < num_passes; ++pass) {
+    if (workload->evict_cache) {
+      EvictCache();
+    }
+    start = GetNanos();
+    for (i = 0; i < n; ++i) {
+      registry_lens[i] = GetRegistryLengthN(workload->hostnames[i],
+                                            workload->hostname_lens[i]);
+    }
+    elapsed += GetNanos() - start;
+  }
+  result->allocations_per_call =
+      (double) (g_num_allocations - num_allocations) / (num_passes * n);
+  result->ns_per_call = elapsed / (num_passes * n);
+
+  elapsed = 0;
+  for (pass = 0; pass < num_passes; ++pass) {
+    if (workload->evict_cache) {
+      EvictCache();
+    }
+    start = GetNanos();
+    GetRegistryLengthBatch(workload->hostnames, workload->hostname_lens, n,
+                           registry_lens);
+    elapsed += GetNanos() - start;
+  }
+  result->batch_ns_per_call = elapsed / (num_passes * n);
+  if (!CheckResults(engine, workload, registry_lens)) {
+    free(registry_lens);
+    free(latencies);
+    return 0;
+  }
+
+  for (pass = 0; pass < num_latency_calls / n; ++pass) {
+    if (workload->evict_cache) {
+      EvictCache();
+    }
+    for (i = 0; i < n; ++i) {
+      double latency;
+      start = GetNanos();
+      registry_lens[i] = GetRegistryLengthN(workload->hostnames[i],
+                                            workload->hostname_lens[i]);
+      latency = GetNanos() - start - g_timer_overhead;
+      latencies[pass * n + i] = latency > 0 ? latency : 0;
+    }
+  }
+  qsort(latencies, num_latency_calls, sizeof(double), CompareDoubles);
+  result->p50_ns = GetPercentile(latencies, num_latency_calls, 0.5);
+  result->p99_ns = GetPercentile(latencies, num_latency_calls, 0.99);
+  result->p999_ns = GetPercentile(latencies, num_latency_calls, 0.999);
+
+  free(registry_lens);
+  free(latencies);
+  return 1;
+}
+
+static void PrintResult(const char* engine,
+                        const struct Workload* workload,
+                        const struct Result* result,
+                        int json) {
+  if (json) {
+    printf("{\"engine\": \"%s\", \"workload\": \"%s\", "
+           "\"hostnames\": %d, \"ns_per_call\": %.1f, "
+           "\"calls_per_sec\": %.0f, \"batch_ns_per_call\": %.1f, "
+           "\"p50_ns\": %.0f, \"p99_ns\": %.0f, \"p999_ns\": %.0f, ",
+           engine, workload->name, (int) workload->num_hostnames,
+           result->ns_per_call, 1e9 / result->ns_per_call,
+           result->batch_ns_per_call,
+           result->p50_ns, result->p99_ns, result->p999_ns);
+    if (COUNT_ALLOCATIONS) {
+      printf("\"allocations_per_call\": %.3f}\n",
+             result->allocations_per_call);
+    } else {
+      printf("\"allocations_per_call\": null}\n");
+    }
+    return;
+  }
+  printf("%-11s %-10s %8.1f %10.0f %8.1f %7.0f %7.0f %7.0f ",
+         engine, workload->name, result->ns_per_call,
+         1e9 / result->ns_per_call, result->batch_ns_per_call,
+         result->p50_ns, result->p99_ns, result->p999_ns);
+  if (COUNT_ALLOCATIONS) {
+    printf("%9.3f\n", result->allocations_per_call);
+  } else {
+    printf("%9s\n", "n/a");
+  }
+}
 
 int main(int argc, char** argv) {
+  struct Workload workloads[8];
+  const size_t num_workloads = sizeof(workloads) / sizeof(workloads[0]);
+  const char* engine_filter = NULL;
+  const char* workload_filter = NULL;
+  size_t num_calls = kDefaultNumCalls;
+  int json = 0;
+  int ok = 1;
+  size_t e, w;
+  int i;
+
+  for (i = 1; i < argc; ++i) {
+    const char* value;
+    if (strcmp(argv[i], "--json") == 0) {
+      json = 1;
+    } else if ((value = GetFlagValue(argv[i], "--engine")) != NULL) {
+      engine_filter = value;
+    } else if ((value = GetFlagValue(argv[i], "--workload")) != NULL) {
+      workload_filter = value;
+    } else if ((value = GetFlagValue(argv[i], "--calls")) != NULL &&
+               atol(value) > 0) {
+      num_calls = (size_t) atol(value);
+    } else {
+      fprintf(stderr, "Usage: %s [--json] [--engine=NAME] "
+              "[--workload=NAME] [--calls=N]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
   InitializeDomainRegistry();
+  if (engine_filter != NULL && !InstallEngine(engine_filter)) {
+    fprintf(stderr, "Unknown engine %s.\n", engine_filter);
+    return EXIT_FAILURE;
+  }
 
-  size_t num_iters, i;
-  for (num_iters = 0; num_iters < kNumIters; ++num_iters) {
-    for (i = 0; i < kTestTableLen; ++i) {
-      const struct TestEntry* test_entry = kTestTable + i;
-      const char* hostname = test_entry->hostname;
-      size_t expected_registry_len = test_entry->registry_len;
-      size_t actual_registry_len = GetRegistryLength(hostname);
-      if (expected_registry_len != actual_registry_len) {
-        fprintf(stderr, "Mismatch for %s. Expected %d, actual %d.\n",
-                hostname,
-                (int)expected_registry_len,
-                (int)actual_registry_len);
-        return EXIT_FAILURE;
+  g_eviction_buffer = calloc(EVICTION_BUFFER_SIZE, 1);
+  if (g_eviction_buffer == NULL) {
+    return EXIT_FAILURE;
+  }
+
+  BuildZipfWorkload(&workloads[0]);
+  BuildTestTableWorkload(&workloads[1], "test-table");
+  BuildTestTableWorkload(&workloads[2], "cold");
+  workloads[2].evict_cache = 1;
+  BuildLongWorkload(&workloads[3]);
+  BuildUnknownWorkload(&workloads[4]);
+  BuildInvalidWorkload(&workloads[5]);
+  BuildUppercaseWorkload(&workloads[6]);
+  BuildWildcardWorkload(&workloads[7]);
+  MeasureTimerOverhead();
+
+  if (!json) {
+    printf("Table sizes: trie %d bytes, suffix-hash %d bytes (+ strings), "
+           "dafsa %d bytes\n\n",
+           (int)GetTrieTablesSize(),
+           (int)GetSuffixHashTableSize(),
+           (int)GetDafsaSize());
+    printf("%-11s %-10s %8s %10s %8s %7s %7s %7s %9s\n",
+           "engine", "workload", "ns/call", "calls/s", "batch",
+           "p50", "p99", "p99.9", "allocs");
+  }
+
+  // Compare the trie walk with the other engines, regardless of
+  // which one InitializeDomainRegistry() installed.
+  for (e = 0; ok && e < NUM_LOOKUP_ENGINES; ++e) {
+    if (engine_filter != NULL &&
+        strcmp(engine_filter, kLookupEngines[e]) != 0) {
+      continue;
+    }
+    InstallEngine(kLookupEngines[e]);
+    for (w = 0; ok && w < num_workloads; ++w) {
+      struct Result result;
+      if (workload_filter != NULL &&
+          strcmp(workload_filter, workloads[w].name) != 0) {
+        continue;
+      }
+      // The cold workload evicts the cache before each pass, so fewer
+      // passes are enough.
+      ok = RunWorkload(kLookupEngines[e], &workloads[w],
+                       workloads[w].evict_cache ? num_calls / 16 : num_calls,
+                       &result);
+      if (ok) {
+        PrintResult(kLookupEngines[e], &workloads[w], &result, json);
       }
     }
   }
-  return EXIT_SUCCESS;
+
+  for (w = 0; w < num_workloads; ++w) {
+    FreeWorkload(&workloads[w]);
+  }
+  free(g_eviction_buffer);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
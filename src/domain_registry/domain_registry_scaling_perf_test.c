@@ -0,0 +1,362 @@
+// Copyright 2011 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Multi-threaded performance test, which measures how lookups scale
+// across cores. Contention in the library, e.g. on the allocator or on
+// shared writable state, and false sharing show up as a per-thread
+// throughput that drops as threads are added.
+//
+// Runs GetRegistryLengthN on 1, 2, 4, ... threads, up to the number of
+// online CPUs, each thread pinned to its own CPU where the platform
+// supports it. Each thread count is run over two hostname sets:
+//
+//   shared    all threads look up the same hostnames, in the same
+//             memory
+//   disjoint  each thread looks up its own copy of the hostnames,
+//             with a different subdomain and in a different order
+//
+// For each, the test reports the throughput per thread, the total
+// throughput, and the scaling efficiency, which is the throughput per
+// thread relative to that of a single thread. Ideal scaling keeps it
+// at 1.
+//
+// Usage: domain_registry_scaling_perf_test [--json] [--engine=NAME]
+//            [--threads=N] [--calls=N]
+//
+// --json prints one JSON object per thread count and hostname set, one
+// per line. --engine runs the named engine (trie, suffix-hash, dafsa
+// or matcher) instead of the one InitializeDomainRegistry() installs.
+// --threads sets the largest number of threads, which may exceed the
+// number of CPUs. --calls sets the number of calls per thread.
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "domain_registry/domain_registry.h"
+#include "domain_registry/testing/lookup_engine.h"
+#include "domain_registry/testing/test_entry.h"
+
+// Include the generated file that contains the actual registry tables.
+#include "registry_tables_genfiles/test_registry_tables.h"
+
+static const size_t kTestTableLen = sizeof(kTestTable) / sizeof(kTestTable[0]);
+static const size_t kDefaultNumCalls = 1 << 20;
+#define CACHE_LINE_SIZE 64
+
+// The hostnames a thread looks up, and the registry length each
+// should have.
+struct HostnameSet {
+  const char** hostnames;
+  size_t* hostname_lens;
+  size_t* expected_lens;
+  size_t num_hostnames;
+};
+
+// The state of one thread. Aligned to a cache line so that the
+// threads of the test itself do not share one.
+struct ThreadState {
+  const struct HostnameSet* hostname_set;
+  pthread_barrier_t* barrier;
+  int cpu;
+  size_t num_calls;
+  double elapsed_ns;
+  int ok;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+static double GetNanos(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void* AllocOrDie(size_t size) {
+  void* p = malloc(size);
+  if (p == NULL) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+// Builds the hostnames of the test table, prefixed with prefix, in an
+// order that depends on seed. The same seed gives the same order.
+static void BuildHostnameSet(struct HostnameSet* set,
+                             const char* prefix,
+                             unsigned seed) {
+  const size_t prefix_len = strlen(prefix);
+  size_t i;
+  set->hostnames = AllocOrDie(kTestTableLen * sizeof(char*));
+  set->hostname_lens = AllocOrDie(kTestTableLen * sizeof(size_t));
+  set->expected_lens = AllocOrDie(kTestTableLen * sizeof(size_t));
+  set->num_hostnames = kTestTableLen;
+  for (i = 0; i < kTestTableLen; ++i) {
+    const size_t len = strlen(kTestTable[i].hostname);
+    char* hostname = AllocOrDie(prefix_len + len + 1);
+    memcpy(hostname, prefix, prefix_len);
+    memcpy(hostname + prefix_len, kTestTable[i].hostname, len + 1);
+    set->hostnames[i] = hostname;
+    set->hostname_lens[i] = prefix_len + len;
+    set->expected_lens[i] = kTestTable[i].registry_len;
+  }
+  for (i = kTestTableLen - 1; i > 0; --i) {
+    const size_t j = rand_r(&seed) % (i + 1);
+    const char* hostname = set->hostnames[i];
+    const size_t hostname_len = set->hostname_lens[i];
+    const size_t expected_len = set->expected_lens[i];
+    set->hostnames[i] = set->hostnames[j];
+    set->hostname_lens[i] = set->hostname_lens[j];
+    set->expected_lens[i] = set->expected_lens[j];
+    set->hostnames[j] = hostname;
+    set->hostname_lens[j] = hostname_len;
+    set->expected_lens[j] = expected_len;
+  }
+}
+
+static void FreeHostnameSet(struct HostnameSet* set) {
+  size_t i;
+  for (i = 0; i < set->num_hostnames; ++i) {
+    free((char*) set->hostnames[i]);
+  }
+  free(set->hostnames);
+  free(set->hostname_lens);
+  free(set->expected_lens);
+}
+
+static void PinToCpu(int cpu) {
+#if defined(__linux__)
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#else
+  (void) cpu;
+#endif
+}
+
+static void* RunThread(void* arg) {
+  struct ThreadState* state = arg;
+  const struct HostnameSet* set = state->hostname_set;
+  const size_t n = set->num_hostnames;
+  size_t calls = 0;
+  size_t i;
+  double start;
+
+  PinToCpu(state->cpu);
+
+  // Warm up and check the results, then wait for the other threads so
+  // that all of them are timed together.
+  state->ok = 1;
+  for (i = 0; i < n; ++i) {
+    const size_t registry_len =
+        GetRegistryLengthN(set->hostnames[i], set->hostname_lens[i]);
+    if (registry_len != set->expected_lens[i]) {
+      fprintf(stderr, "Mismatch for %s. Expected %d, actual %d.\n",
+              set->hostnames[i], (int) set->expected_lens[i],
+              (int) registry_len);
+      state->ok = 0;
+      break;
+    }
+  }
+  pthread_barrier_wait(state->barrier);
+
+  start = GetNanos();
+  while (calls < state->num_calls) {
+    size_t sum = 0;
+    for (i = 0; i < n && calls < state->num_calls; ++i, ++calls) {
+      sum += GetRegistryLengthN(set->hostnames[i], set->hostname_lens[i]);
+    }
+    // Keep the compiler from dropping the lookups.
+    if (sum == (size_t) -1) {
+      state->ok = 0;
+    }
+  }
+  state->elapsed_ns = GetNanos() - start;
+  return NULL;
+}
+
+struct Result {
+  double calls_per_sec_per_thread;
+  double total_calls_per_sec;
+};
+
+// Runs num_threads threads, each over hostname_sets[thread] or, if
+// shared_set is non-NULL, all over shared_set. Returns 0 on a mismatch.
+static int RunThreads(size_t num_threads,
+                      int num_cpus,
+                      size_t num_calls,
+                      const struct HostnameSet* shared_set,
+                      const struct HostnameSet* hostname_sets,
+                      struct Result* result) {
+  struct ThreadState* states;
+  pthread_t* threads = AllocOrDie(num_threads * sizeof(pthread_t));
+  pthread_barrier_t barrier;
+  double max_elapsed_ns = 0;
+  double sum_calls_per_sec = 0;
+  int ok = 1;
+  size_t i;
+
+  if (posix_memalign((void**) &states, CACHE_LINE_SIZE,
+                     num_threads * sizeof(*states)) != 0) {
+    fprintf(stderr, "Out of memory.\n");
+    exit(EXIT_FAILURE);
+  }
+  pthread_barrier_init(&barrier, NULL, (unsigned) num_threads);
+  for (i = 0; i < num_threads; ++i) {
+    memset(&states[i], 0, sizeof(states[i]));
+    states[i].hostname_set =
+        shared_set != NULL ? shared_set : &hostname_sets[i];
+    states[i].barrier = &barrier;
+    states[i].cpu = (int) (i % num_cpus);
+    states[i].num_calls = num_calls;
+    if (pthread_create(&threads[i], NULL, RunThread, &states[i]) != 0) {
+      fprintf(stderr, "Failed to create thread %d.\n", (int) i);
+      exit(EXIT_FAILURE);
+    }
+  }
+  for (i = 0; i < num_threads; ++i) {
+    pthread_join(threads[i], NULL);
+    ok = ok && states[i].ok;
+    sum_calls_per_sec += states[i].num_calls / (states[i].elapsed_ns / 1e9);
+    if (states[i].elapsed_ns > max_elapsed_ns) {
+      max_elapsed_ns = states[i].elapsed_ns;
+    }
+  }
+  result->calls_per_sec_per_thread = sum_calls_per_sec / num_threads;
+  result->total_calls_per_sec =
+      num_threads * num_calls / (max_elapsed_ns / 1e9);
+
+  pthread_barrier_destroy(&barrier);
+  free(states);
+  free(threads);
+  return ok;
+}
+
+static void PrintResult(const char* engine,
+                        const char* set_name,
+                        size_t num_threads,
+                        const struct Result* result,
+                        double efficiency,
+                        int json) {
+  if (json) {
+    printf("{\"engine\": \"%s\", \"hostnames\": \"%s\", \"threads\": %d, "
+           "\"calls_per_sec_per_thread\": %.0f, "
+           "\"total_calls_per_sec\": %.0f, \"efficiency\": %.3f}\n",
+           engine, set_name, (int) num_threads,
+           result->calls_per_sec_per_thread, result->total_calls_per_sec,
+           efficiency);
+    return;
+  }
+  printf("%-11s %-9s %7d %15.0f %15.0f %10.3f\n",
+         engine, set_name, (int) num_threads,
+         result->calls_per_sec_per_thread, result->total_calls_per_sec,
+         efficiency);
+}
+
+int main(int argc, char** argv) {
+  const long num_online_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  const int num_cpus = num_online_cpus > 0 ? (int) num_online_cpus : 1;
+  size_t max_threads = (size_t) num_cpus;
+  size_t num_calls = kDefaultNumCalls;
+  const char* engine = "default";
+  struct HostnameSet shared_set;
+  struct HostnameSet* hostname_sets;
+  double single_thread_calls_per_sec[2] = { 0, 0 };
+  size_t num_threads;
+  int json = 0;
+  int ok = 1;
+  size_t i;
+
+  for (i = 1; i < (size_t) argc; ++i) {
+    const char* value;
+    if (strcmp(argv[i], "--json") == 0) {
+      json = 1;
+    } else if ((value = GetFlagValue(argv[i], "--engine")) != NULL) {
+      engine = value;
+    } else if ((value = GetFlagValue(argv[i], "--threads")) != NULL &&
+               atol(value) > 0) {
+      max_threads = (size_t) atol(value);
+    } else if ((value = GetFlagValue(argv[i], "--calls")) != NULL &&
+               atol(value) > 0) {
+      num_calls = (size_t) atol(value);
+    } else {
+      fprintf(stderr, "Usage: %s [--json] [--engine=NAME] [--threads=N] "
+              "[--calls=N]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  InitializeDomainRegistry();
+  if (strcmp(engine, "default") != 0 && !InstallEngine(engine)) {
+    fprintf(stderr, "Unknown engine %s.\n", engine);
+    return EXIT_FAILURE;
+  }
+
+  BuildHostnameSet(&shared_set, "", 0);
+  hostname_sets = AllocOrDie(max_threads * sizeof(*hostname_sets));
+  for (i = 0; i < max_threads; ++i) {
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "t%d.", (int) i);
+    BuildHostnameSet(&hostname_sets[i], prefix, (unsigned) i + 1);
+  }
+
+  if (!json) {
+    printf("%d online CPUs, %d calls per thread\n\n",
+           num_cpus, (int) num_calls);
+    printf("%-11s %-9s %7s %15s %15s %10s\n",
+           "engine", "hostnames", "threads", "calls/s/thread",
+           "total calls/s", "efficiency");
+  }
+
+  // 1, 2, 4, ... threads, and max_threads if it is not a power of 2.
+  for (num_threads = 1; ok; num_threads *= 2) {
+    if (num_threads > max_threads) {
+      if (num_threads / 2 == max_threads) {
+        break;
+      }
+      num_threads = max_threads;
+    }
+    for (i = 0; ok && i < 2; ++i) {
+      const char* set_name = i == 0 ? "shared" : "disjoint";
+      struct Result result;
+      ok = RunThreads(num_threads, num_cpus, num_calls,
+                      i == 0 ? &shared_set : NULL, hostname_sets, &result);
+      if (ok) {
+        if (num_threads == 1) {
+          single_thread_calls_per_sec[i] = result.calls_per_sec_per_thread;
+        }
+        PrintResult(engine, set_name, num_threads, &result,
+                    result.calls_per_sec_per_thread /
+                        single_thread_calls_per_sec[i],
+                    json);
+      }
+    }
+    if (num_threads == max_threads) {
+      break;
+    }
+  }
+
+  FreeHostnameSet(&shared_set);
+  for (i = 0; i < max_threads; ++i) {
+    FreeHostnameSet(&hostname_sets[i]);
+  }
+  free(hostname_sets);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -19,6 +19,9 @@ extern "C" {
 #include "domain_registry/private/assert.h"
 }  // extern "C"
 
+#include <string>
+#include <vector>
+
 #include "testing/gtest/include/gtest/gtest.h"
 
 // Include the generated file that contains the actual registry tables.
@@ -83,6 +86,212 @@ TEST_F(DomainRegistryTest, All) {
   }
 }
 
+TEST_F(DomainRegistryTest, LengthDelimited) {
+  for (size_t i = 0; i < kTestTableLen; ++i) {
+    const char* hostname = kTestTable[i].hostname;
+    const size_t hostname_len = strlen(hostname);
+
+    // Copy the hostname into a buffer that is not null-terminated.
+    std::string buf(hostname);
+    buf.append("x.com");
+    EXPECT_EQ(GetRegistryLength(hostname),
+              GetRegistryLengthN(buf.data(), hostname_len)) << hostname;
+    EXPECT_EQ(GetRegistryLengthAllowUnknownRegistries(hostname),
+              GetRegistryLengthAllowUnknownRegistriesN(buf.data(),
+                                                       hostname_len))
+        << hostname;
+  }
+}
+
+TEST_F(DomainRegistryTest, Batch) {
+  std::vector<const char*> hostnames;
+  std::vector<size_t> hostname_lens;
+  for (size_t i = 0; i < kTestTableLen; ++i) {
+    hostnames.push_back(kTestTable[i].hostname);
+    hostname_lens.push_back(strlen(kTestTable[i].hostname));
+  }
+  hostnames.push_back(NULL);
+  hostname_lens.push_back(0);
+  hostnames.push_back("WWW.GOOGLE.CO.UK");
+  hostname_lens.push_back(16);
+  hostnames.push_back("google.com..");
+  hostname_lens.push_back(12);
+  hostnames.push_back("foo.臺灣");
+  hostname_lens.push_back(strlen("foo.臺灣"));
+
+  std::vector<size_t> registry_lens(hostnames.size());
+  GetRegistryLengthBatch(&hostnames[0], &hostname_lens[0],
+                         hostnames.size(), &registry_lens[0]);
+  for (size_t i = 0; i < hostnames.size(); ++i) {
+    EXPECT_EQ(GetRegistryLengthN(hostnames[i], hostname_lens[i]),
+              registry_lens[i]) << i;
+  }
+
+  // Null-terminated hostnames.
+  std::vector<size_t> registry_lens2(hostnames.size());
+  GetRegistryLengthBatch(&hostnames[0], NULL,
+                         hostnames.size(), &registry_lens2[0]);
+  EXPECT_TRUE(registry_lens == registry_lens2);
+
+  // An empty batch is allowed.
+  GetRegistryLengthBatch(NULL, NULL, 0, NULL);
+}
+
+TEST_F(DomainRegistryTest, CreateDomainRegistry) {
+  struct DomainRegistry* registry = CreateDomainRegistry();
+  ASSERT_TRUE(registry != NULL);
+  EXPECT_TRUE(registry != GetDefaultDomainRegistry());
+  for (size_t i = 0; i < kTestTableLen; ++i) {
+    const char* hostname = kTestTable[i].hostname;
+    EXPECT_EQ(GetRegistryLength(hostname),
+              DomainRegistryGetRegistryLength(registry, hostname))
+        << hostname;
+    EXPECT_EQ(GetRegistryLengthAllowUnknownRegistries(hostname),
+              DomainRegistryGetRegistryLengthAllowUnknownRegistries(
+                  registry, hostname))
+        << hostname;
+  }
+  DestroyDomainRegistry(registry);
+
+  // The default registry still has its tables.
+  EXPECT_EQ(3, GetRegistryLength("www.google.com"));
+}
+
+TEST_F(DomainRegistryTest, RegistryLengths) {
+  for (size_t i = 0; i < kTestTableLen; ++i) {
+    const char* hostname = kTestTable[i].hostname;
+    size_t icann_len;
+    size_t private_len;
+    GetRegistryLengths(hostname, &icann_len, &private_len);
+    EXPECT_EQ(GetRegistryLength(hostname), private_len) << hostname;
+    EXPECT_LE(icann_len, private_len) << hostname;
+  }
+
+  size_t icann_len;
+  size_t private_len;
+  GetRegistryLengths("www.google.com", &icann_len, &private_len);
+  EXPECT_EQ(3, icann_len);
+  EXPECT_EQ(3, private_len);
+  GetRegistryLengths("foo.blogspot.com", &icann_len, &private_len);
+  EXPECT_EQ(3, icann_len);
+  EXPECT_EQ(12, private_len);
+  GetRegistryLengths("foo.blogspot.co.il", &icann_len, &private_len);
+  EXPECT_EQ(5, icann_len);
+  EXPECT_EQ(14, private_len);
+  GetRegistryLengths("a.b.co.uk", &icann_len, &private_len);
+  EXPECT_EQ(5, icann_len);
+  EXPECT_EQ(5, private_len);
+}
+
+TEST_F(DomainRegistryTest, RegistryInfo) {
+  for (size_t i = 0; i < kTestTableLen; ++i) {
+    const char* hostname = kTestTable[i].hostname;
+    const size_t hostname_len = strlen(hostname);
+    RegistryInfo info;
+    GetRegistryInfo(hostname, &info);
+    EXPECT_EQ(GetRegistryLength(hostname), info.registry_len) << hostname;
+    if (info.registry_len > 0) {
+      EXPECT_EQ(hostname_len, info.registry_offset + info.registry_len)
+          << hostname;
+    }
+    if (info.registrable_domain_len > 0) {
+      EXPECT_EQ(hostname_len,
+                info.registrable_domain_offset + info.registrable_domain_len)
+          << hostname;
+      EXPECT_GT(info.registrable_domain_len, info.registry_len + 1)
+          << hostname;
+    }
+  }
+
+  RegistryInfo info;
+  ASSERT_EQ(1, GetRegistryInfo("www.google.co.uk", &info));
+  EXPECT_EQ(11, info.registry_offset);
+  EXPECT_EQ(5, info.registry_len);
+  EXPECT_EQ(4, info.registrable_domain_offset);
+  EXPECT_EQ(12, info.registrable_domain_len);
+  EXPECT_EQ(4, info.num_labels);
+  EXPECT_EQ(0, info.is_wildcard_rule);
+  EXPECT_EQ(0, info.is_exception_rule);
+
+  // *.compute.amazonaws.com
+  ASSERT_EQ(1, GetRegistryInfo("foo.ap-northeast-1.compute.amazonaws.com",
+                               &info));
+  EXPECT_EQ(36, info.registry_len);
+  EXPECT_EQ(40, info.registrable_domain_len);
+  EXPECT_EQ(1, info.is_wildcard_rule);
+
+  // !city.kawasaki.jp
+  ASSERT_EQ(1, GetRegistryInfo("www.city.kawasaki.jp", &info));
+  EXPECT_EQ(11, info.registry_len);
+  EXPECT_EQ(16, info.registrable_domain_len);
+  EXPECT_EQ(1, info.is_exception_rule);
+}
+
+TEST_F(DomainRegistryTest, Utf8) {
+  for (size_t i = 0; i < kTestTableLen; ++i) {
+    const char* hostname = kTestTable[i].hostname;
+    EXPECT_EQ(GetRegistryLength(hostname), GetRegistryLengthUtf8(hostname))
+        << hostname;
+  }
+
+  // foo.臺灣 and its punycode form.
+  EXPECT_EQ(6, GetRegistryLengthUtf8("foo.\xe8\x87\xba\xe7\x81\xa3"));
+  EXPECT_EQ(11, GetRegistryLengthUtf8("foo.xn--nnx388a"));
+  EXPECT_EQ(7, GetRegistryLengthUtf8("foo.\xe8\x87\xba\xe7\x81\xa3."));
+  EXPECT_EQ(6,
+            GetRegistryLengthUtf8("foo\xe3\x80\x82\xe8\x87\xba\xe7\x81\xa3"));
+
+  // www.個人.hk
+  EXPECT_EQ(9, GetRegistryLengthUtf8("www.\xe5\x80\x8b\xe4\xba\xba.hk"));
+
+  // bücher.de, whose non-ASCII hostname-part is not in the registry.
+  EXPECT_EQ(2, GetRegistryLengthUtf8("b\xc3\xbc" "cher.de"));
+  EXPECT_EQ(2, GetRegistryLengthUtf8N("b\xc3\xbc" "cher.deXYZ", 10));
+
+  // Invalid UTF-8, and unknown registries.
+  EXPECT_EQ(0, GetRegistryLengthUtf8("foo.\xe8\x87"));
+  EXPECT_EQ(0, GetRegistryLengthUtf8("b\xc3\xbc" "cher.invalid"));
+  EXPECT_EQ(0, GetRegistryLengthUtf8(NULL));
+}
+
+TEST_F(DomainRegistryTest, RegistryInfoForUrl) {
+  for (size_t i = 0; i < kTestTableLen; ++i) {
+    const char* hostname = kTestTable[i].hostname;
+    if (hostname == NULL || strchr(hostname, '.') == NULL) {
+      continue;
+    }
+    std::string url = std::string("http://") + hostname + "/index.html";
+    RegistryInfo hostname_info;
+    RegistryInfo url_info;
+    EXPECT_EQ(GetRegistryInfo(hostname, &hostname_info),
+              GetRegistryInfoForUrl(url.data(), url.size(), &url_info))
+        << url;
+    EXPECT_EQ(hostname_info.registry_len, url_info.registry_len) << url;
+    EXPECT_EQ(hostname_info.registrable_domain_len,
+              url_info.registrable_domain_len) << url;
+  }
+
+  RegistryInfo info;
+  const char kUrl[] = "https://www.google.co.uk/x";
+  ASSERT_EQ(1, GetRegistryInfoForUrl(kUrl, strlen(kUrl), &info));
+  EXPECT_EQ(8, info.host_offset);
+  EXPECT_EQ(16, info.host_len);
+  EXPECT_EQ(19, info.registry_offset);
+  EXPECT_EQ(5, info.registry_len);
+  EXPECT_EQ(12, info.registrable_domain_offset);
+  EXPECT_EQ(12, info.registrable_domain_len);
+
+  const char kUserinfoUrl[] = "http://u:p@google.com.:80/";
+  ASSERT_EQ(1, GetRegistryInfoForUrl(kUserinfoUrl, strlen(kUserinfoUrl),
+                                     &info));
+  EXPECT_EQ(11, info.host_offset);
+  EXPECT_EQ(10, info.host_len);
+  EXPECT_EQ(18, info.registry_offset);
+  EXPECT_EQ(3, info.registry_len);
+  EXPECT_EQ(11, info.registrable_domain_offset);
+  EXPECT_EQ(10, info.registrable_domain_len);
+}
+
 TEST_F(DomainRegistryTest, Basic) {
   EXPECT_EQ(0, GetRegistryLength(NULL));
   EXPECT_EQ(0, GetRegistryLength(""));
@@ -0,0 +1,207 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "domain_registry/private/dafsa_search.h"
+
+#include <stdlib.h>
+
+#include "domain_registry/domain_registry.h"
+#include "domain_registry/private/assert.h"
+#include "domain_registry/private/registry_tables.h"
+#include "domain_registry/private/string_util.h"
+
+/* The byte encoding. Must match dafsa_builder.py. */
+#define DAFSA_VALUE_RULE 0
+#define DAFSA_VALUE_EXCEPTION_RULE 1
+#define DAFSA_LAST_LABEL_BYTE 0x80
+#define DAFSA_LAST_OFFSET 0x80
+#define DAFSA_OFFSET_SIZE_MASK 0x60
+#define DAFSA_TWO_BYTE_OFFSET 0x40
+#define DAFSA_THREE_BYTE_OFFSET 0x60
+
+/* Value bytes are 0x80 through 0x9f. Label bytes are never in this range. */
+#define IS_DAFSA_VALUE(b) (((b) & 0xe0) == 0x80)
+
+/*
+ * Reads the offset list entry at p into *offset, and whether it is
+ * the last entry of its list into *is_last. Returns the position of
+ * the next entry.
+ */
+static __inline__ const unsigned char* ReadDafsaOffset(
+    const unsigned char* p, size_t* offset, int* is_last) {
+  const unsigned char b = *p;
+  *is_last = (b & DAFSA_LAST_OFFSET) != 0;
+  switch (b & DAFSA_OFFSET_SIZE_MASK) {
+    case DAFSA_THREE_BYTE_OFFSET:
+      *offset = ((size_t) (b & 0x1f) << 16) | ((size_t) p[1] << 8) | p[2];
+      return p + 3;
+    case DAFSA_TWO_BYTE_OFFSET:
+      *offset = ((size_t) (b & 0x1f) << 8) | p[1];
+      return p + 2;
+    default:
+      *offset = b & 0x3f;
+      return p + 1;
+  }
+}
+
+/*
+ * Consumes the label byte at p, which must match the next character,
+ * and moves the node past it.
+ */
+static __inline__ void ConsumeDafsaLabelByte(const unsigned char* p,
+                                             struct DafsaNode* node) {
+  node->at_offset_list = (*p & DAFSA_LAST_LABEL_BYTE) != 0;
+  node->pos = p + 1;
+}
+
+/*
+ * Moves the node past the character c. Returns 0 if no edge from the
+ * node's position is labelled c.
+ */
+static int StepDafsa(struct DafsaNode* node, char c) {
+  const unsigned char* p = node->pos;
+  if (node->at_offset_list) {
+    const unsigned char* child = p;
+    size_t offset;
+    int is_last;
+    do {
+      p = ReadDafsaOffset(p, &offset, &is_last);
+      child += offset;
+      if (!IS_DAFSA_VALUE(*child) && (*child & 0x7f) == (unsigned char) c) {
+        ConsumeDafsaLabelByte(child, node);
+        return 1;
+      }
+    } while (!is_last);
+    return 0;
+  }
+  if (IS_DAFSA_VALUE(*p) || (*p & 0x7f) != (unsigned char) c) {
+    return 0;
+  }
+  ConsumeDafsaLabelByte(p, node);
+  return 1;
+}
+
+/*
+ * Sets the flags of a node whose position is just after a
+ * hostname-part: it is terminal if a word ends here, and has children
+ * if a separator follows. Returns 0 if neither is true, in which case
+ * the position is within a longer hostname-part.
+ */
+static int ReadDafsaNodeFlags(struct DafsaNode* node) {
+  const unsigned char* p = node->pos;
+  int value = -1;
+  int has_children = 0;
+  if (node->at_offset_list) {
+    const unsigned char* child = p;
+    size_t offset;
+    int is_last;
+    do {
+      p = ReadDafsaOffset(p, &offset, &is_last);
+      child += offset;
+      if (IS_DAFSA_VALUE(*child)) {
+        value = *child & 0x1f;
+      } else if ((*child & 0x7f) == '.') {
+        has_children = 1;
+      }
+    } while (!is_last);
+  } else if (IS_DAFSA_VALUE(*p)) {
+    value = *p & 0x1f;
+  } else if ((*p & 0x7f) == '.') {
+    has_children = 1;
+  }
+  node->is_terminal = (value != -1);
+  node->is_exception = (value == DAFSA_VALUE_EXCEPTION_RULE);
+  node->has_children = has_children;
+  return node->is_terminal || node->has_children;
+}
+
+/*
+ * Finds the hostname-part component under the position of start.
+ * Hostname-parts are stored reversed, so the component is matched
+ * from its last character to its first.
+ */
+static int FindDafsaChildN(const char* component,
+                           size_t component_len,
+                           const struct DafsaNode* start,
+                           struct DafsaNode* node) {
+  *node = *start;
+  while (component_len > 0) {
+    if (!StepDafsa(node, component[--component_len])) {
+      return 0;
+    }
+  }
+  return ReadDafsaNodeFlags(node);
+}
+
+int FindDafsaNodeN(const struct RegistryTables* tables,
+                   const char* component,
+                   size_t component_len,
+                   const struct DafsaNode* parent,
+                   struct DafsaNode* node) {
+  struct DafsaNode start;
+  struct DafsaNode wildcard;
+
+  DCHECK(tables->dafsa != NULL);
+  DCHECK(component != NULL);
+  if (IsInvalidComponent(component, component_len)) {
+    return 0;
+  }
+  if (parent == NULL) {
+    if (tables->dafsa_len == 0) {
+      return 0;
+    }
+    start.pos = tables->dafsa;
+    start.at_offset_list = 1;
+  } else {
+    if (parent->has_children == 0) {
+      return 0;
+    }
+    start = *parent;
+    if (!StepDafsa(&start, '.')) {
+      return 0;
+    }
+  }
+
+  /*
+   * Search for an exact match, or an exception rule for component,
+   * falling back to the wildcard. See FindRegistryNodeN for details.
+   */
+  if (FindDafsaChildN(component, component_len, &start, node)) {
+    if (node->is_exception && !FindDafsaChildN("*", 1, &start, &wildcard)) {
+      /* An exception rule only applies if there is a wildcard. */
+      return 0;
+    }
+    node->is_wildcard = 0;
+    return 1;
+  }
+  if (!FindDafsaChildN("*", 1, &start, node)) {
+    return 0;
+  }
+  node->is_wildcard = 1;
+  return 1;
+}
+
+int HasDafsa(const struct RegistryTables* tables) {
+  return tables->dafsa != NULL;
+}
+
+void SetDafsa(const unsigned char* dafsa, size_t dafsa_len) {
+  struct RegistryTables tables;
+  GetRegistryTables(GetDefaultDomainRegistry(), &tables);
+  tables.dafsa = dafsa;
+  tables.dafsa_len = dafsa_len;
+  InstallRegistryTables(GetDefaultDomainRegistry(), &tables);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * Functions to search the DAFSA encoding of the registry rules. See
+ * registry_tables_generator/dafsa_builder.py for a description of the
+ * format. These should not need to be invoked directly.
+ */
+
+#ifndef DOMAIN_REGISTRY_PRIVATE_DAFSA_SEARCH_H_
+#define DOMAIN_REGISTRY_PRIVATE_DAFSA_SEARCH_H_
+
+#include <stdlib.h>
+
+#include "domain_registry/private/registry_tables.h"
+
+/*
+ * A hostname-part found in the DAFSA. Its flags match those of the
+ * corresponding TrieNode.
+ */
+struct DafsaNode {
+  /*
+   * The position in the DAFSA just after the hostname-part, either
+   * within a label or at the start of an offset list.
+   */
+  const unsigned char* pos;
+  int at_offset_list;
+
+  int is_terminal;
+  int is_exception;
+  int has_children;
+
+  /* Whether the node is the wildcard "*". */
+  int is_wildcard;
+};
+
+/*
+ * Find the hostname-part component, of length component_len, under
+ * the given parent node, and store it in *node. If parent is NULL
+ * then component is looked up as a top-level hostname-part. Applies
+ * wildcard and exception rules the same way FindRegistryNodeN
+ * does. Returns 0 if there is no matching node. component must be
+ * lowercase and need not be null-terminated. Does not allocate.
+ */
+int FindDafsaNodeN(const struct RegistryTables* tables,
+                   const char* component,
+                   size_t component_len,
+                   const struct DafsaNode* parent,
+                   struct DafsaNode* node);
+
+/* Do the given tables include a DAFSA? */
+int HasDafsa(const struct RegistryTables* tables);
+
+/*
+ * Install the DAFSA, of dafsa_len bytes. Lookups use the DAFSA
+ * instead of the trie or the suffix hash table while one is
+ * installed. Pass NULL to remove the DAFSA. SetRegistryTables
+ * removes any previously installed DAFSA, so this must be called
+ * after it.
+ */
+void SetDafsa(const unsigned char* dafsa, size_t dafsa_len);
+
+#endif  /* DOMAIN_REGISTRY_PRIVATE_DAFSA_SEARCH_H_ */
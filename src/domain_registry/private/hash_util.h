@@ -0,0 +1,80 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Hash functions shared by the lookup engines. These must match the
+ * functions of the same names in
+ * registry_tables_generator/root_hash_builder.py exactly, since the
+ * generator uses them to lay out the hashed tables.
+ */
+
+#ifndef DOMAIN_REGISTRY_PRIVATE_HASH_UTIL_H_
+#define DOMAIN_REGISTRY_PRIVATE_HASH_UTIL_H_
+
+#include <stdlib.h>
+
+#include "domain_registry/private/registry_types.h"
+
+#if _WINDOWS
+#define __inline__ __inline
+#endif
+
+#define FNV_OFFSET_BASIS 0x811c9dc5u
+
+/*
+ * Continues the 32 bit FNV-1a hash h over the len bytes at s. Each
+ * step is a bijection of h, so two different hashes never continue
+ * to the same value over the same bytes.
+ */
+static __inline__ REGISTRY_U32 ContinueHash(REGISTRY_U32 h,
+                                            const char* s,
+                                            size_t len) {
+  const char* const end = s + len;
+  for (; s < end; ++s) {
+    h ^= (unsigned char) *s;
+    h *= 0x01000193u;
+  }
+  return h;
+}
+
+/* Returns the 32 bit FNV-1a hash of the len bytes at s. */
+static __inline__ REGISTRY_U32 HashHostnamePart(const char* s, size_t len) {
+  return ContinueHash(FNV_OFFSET_BASIS, s, len);
+}
+
+/* Returns h with its bits mixed (the MurmurHash3 finalizer). */
+static __inline__ REGISTRY_U32 MixHash(REGISTRY_U32 h) {
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+/* Maps the 32 bit value h onto the range [0, n) without a division. */
+static __inline__ size_t ReduceHash(REGISTRY_U32 h, size_t n) {
+  return (size_t) (((REGISTRY_U64) h * n) >> 32);
+}
+
+/*
+ * Returns the 8 bit fingerprint of the hostname-part of length len at
+ * s, used to skip sibling nodes without comparing strings.
+ */
+static __inline__ unsigned char GetHostnamePartFingerprint(const char* s,
+                                                           size_t len) {
+  return (unsigned char) (MixHash(HashHostnamePart(s, len)) >> 24);
+}
+
+#endif  /* DOMAIN_REGISTRY_PRIVATE_HASH_UTIL_H_ */
@@ -0,0 +1,260 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "domain_registry/private/hostname_scanner.h"
+
+#include "domain_registry/private/string_util.h"
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#endif
+
+/*
+ * The vectorized scanners are built with per-function target
+ * attributes and selected at runtime, so the library does not need
+ * to be compiled with -msse2 or -mavx2.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define HOSTNAME_SCANNER_X86 1
+#include <immintrin.h>
+#endif
+
+typedef int (*HostnameScannerFn)(const char*, size_t, char*,
+                                 unsigned char*, size_t*);
+
+/*
+ * Scans the bytes between begin and end one at a time. pos is the
+ * offset of begin from the start of the hostname. Returns 0 if a null
+ * byte or non-ASCII character is found.
+ */
+static int ScanBytes(const char* hostname,
+                     size_t pos,
+                     size_t end,
+                     char* lowercase_out,
+                     unsigned char* separators_out,
+                     size_t* num_separators) {
+  size_t n = *num_separators;
+  for (; pos < end; ++pos) {
+    const unsigned char c = hostname[pos];
+    if (c == 0 || c > 0x7f) {
+      return 0;
+    }
+    if (c == '.') {
+      separators_out[n++] = (unsigned char) pos;
+    }
+    lowercase_out[pos] = ToLowerASCIIChar(c);
+  }
+  *num_separators = n;
+  return 1;
+}
+
+/*
+ * Would normally be declared static, but is made visible for testing
+ * so the vectorized scanners can be checked against it.
+ */
+int ScanHostnameScalar(const char* hostname,
+                       size_t hostname_len,
+                       char* lowercase_out,
+                       unsigned char* separators_out,
+                       size_t* num_separators) {
+  *num_separators = 0;
+  if (hostname_len > MAX_HOSTNAME_LEN) {
+    return 0;
+  }
+  return ScanBytes(hostname, 0, hostname_len,
+                   lowercase_out, separators_out, num_separators);
+}
+
+#ifdef HOSTNAME_SCANNER_X86
+
+/* Appends the offset of each bit set in mask, plus base. */
+static __inline__ size_t AppendSeparators(unsigned int mask,
+                                          size_t base,
+                                          unsigned char* separators_out,
+                                          size_t n) {
+  while (mask != 0) {
+    separators_out[n++] = (unsigned char) (base + __builtin_ctz(mask));
+    mask &= mask - 1;
+  }
+  return n;
+}
+
+/*
+ * Scans the 16 bytes at hostname + pos. Returns 0 if a null byte or
+ * non-ASCII character is found.
+ */
+__attribute__((target("sse2")))
+static __inline__ int ScanBlock16(const char* hostname,
+                                  size_t pos,
+                                  char* lowercase_out,
+                                  unsigned char* separators_out,
+                                  size_t* num_separators) {
+  const __m128i chars = _mm_loadu_si128((const __m128i*) (hostname + pos));
+  __m128i upper;
+
+  /*
+   * The sign bit is set for non-ASCII characters. Once those are
+   * ruled out, signed comparisons can be used for the range check.
+   */
+  if ((_mm_movemask_epi8(chars) |
+       _mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_setzero_si128()))) != 0) {
+    return 0;
+  }
+  upper = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1)),
+                        _mm_cmplt_epi8(chars, _mm_set1_epi8('Z' + 1)));
+  _mm_storeu_si128(
+      (__m128i*) (lowercase_out + pos),
+      _mm_or_si128(chars, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+  *num_separators = AppendSeparators(
+      (unsigned int) _mm_movemask_epi8(
+          _mm_cmpeq_epi8(chars, _mm_set1_epi8('.'))),
+      pos, separators_out, *num_separators);
+  return 1;
+}
+
+__attribute__((target("sse2")))
+static int ScanHostnameSSE2(const char* hostname,
+                            size_t hostname_len,
+                            char* lowercase_out,
+                            unsigned char* separators_out,
+                            size_t* num_separators) {
+  size_t pos = 0;
+
+  *num_separators = 0;
+  if (hostname_len > MAX_HOSTNAME_LEN) {
+    return 0;
+  }
+  for (; pos + 16 <= hostname_len; pos += 16) {
+    if (ScanBlock16(hostname, pos,
+                    lowercase_out, separators_out, num_separators) == 0) {
+      return 0;
+    }
+  }
+  return ScanBytes(hostname, pos, hostname_len,
+                   lowercase_out, separators_out, num_separators);
+}
+
+__attribute__((target("avx2")))
+static int ScanHostnameAVX2(const char* hostname,
+                            size_t hostname_len,
+                            char* lowercase_out,
+                            unsigned char* separators_out,
+                            size_t* num_separators) {
+  const __m256i before_upper = _mm256_set1_epi8('A' - 1);
+  const __m256i after_upper = _mm256_set1_epi8('Z' + 1);
+  size_t n = 0;
+  size_t pos = 0;
+
+  *num_separators = 0;
+  if (hostname_len > MAX_HOSTNAME_LEN) {
+    return 0;
+  }
+  for (; pos + 32 <= hostname_len; pos += 32) {
+    const __m256i chars =
+        _mm256_loadu_si256((const __m256i*) (hostname + pos));
+    __m256i upper;
+
+    if ((_mm256_movemask_epi8(chars) |
+         _mm256_movemask_epi8(
+             _mm256_cmpeq_epi8(chars, _mm256_setzero_si256()))) != 0) {
+      return 0;
+    }
+    upper = _mm256_and_si256(_mm256_cmpgt_epi8(chars, before_upper),
+                             _mm256_cmpgt_epi8(after_upper, chars));
+    _mm256_storeu_si256(
+        (__m256i*) (lowercase_out + pos),
+        _mm256_or_si256(chars,
+                        _mm256_and_si256(upper, _mm256_set1_epi8(0x20))));
+    n = AppendSeparators(
+        (unsigned int) _mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('.'))),
+        pos, separators_out, n);
+  }
+  *num_separators = n;
+
+  /* Most hostnames are short, so take a 16-byte step if possible. */
+  if (pos + 16 <= hostname_len) {
+    if (ScanBlock16(hostname, pos,
+                    lowercase_out, separators_out, num_separators) == 0) {
+      return 0;
+    }
+    pos += 16;
+  }
+  return ScanBytes(hostname, pos, hostname_len,
+                   lowercase_out, separators_out, num_separators);
+}
+
+#endif  /* HOSTNAME_SCANNER_X86 */
+
+static int ResolveScanHostname(const char*, size_t, char*,
+                               unsigned char*, size_t*);
+
+/*
+ * The scanner to use on this processor. Starts out pointing at
+ * ResolveScanHostname, which replaces itself with the best scanner
+ * the first time it is called. Racing threads all store the same
+ * value, so relaxed atomic loads and stores are enough.
+ */
+static HostnameScannerFn volatile g_scan_hostname = ResolveScanHostname;
+
+#if defined(_MSC_VER)
+static HostnameScannerFn LoadScanner(void) {
+  return (HostnameScannerFn) InterlockedCompareExchangePointer(
+      (PVOID volatile*) &g_scan_hostname, NULL, NULL);
+}
+
+static void StoreScanner(HostnameScannerFn scanner) {
+  InterlockedExchangePointer((PVOID volatile*) &g_scan_hostname,
+                             (PVOID) scanner);
+}
+#else
+static HostnameScannerFn LoadScanner(void) {
+  return __atomic_load_n(&g_scan_hostname, __ATOMIC_RELAXED);
+}
+
+static void StoreScanner(HostnameScannerFn scanner) {
+  __atomic_store_n(&g_scan_hostname, scanner, __ATOMIC_RELAXED);
+}
+#endif
+
+static int ResolveScanHostname(const char* hostname,
+                               size_t hostname_len,
+                               char* lowercase_out,
+                               unsigned char* separators_out,
+                               size_t* num_separators) {
+  HostnameScannerFn scanner = ScanHostnameScalar;
+#ifdef HOSTNAME_SCANNER_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    scanner = ScanHostnameAVX2;
+  } else if (__builtin_cpu_supports("sse2")) {
+    scanner = ScanHostnameSSE2;
+  }
+#endif
+  StoreScanner(scanner);
+  return scanner(hostname, hostname_len,
+                 lowercase_out, separators_out, num_separators);
+}
+
+int ScanHostname(const char* hostname,
+                 size_t hostname_len,
+                 char* lowercase_out,
+                 unsigned char* separators_out,
+                 size_t* num_separators) {
+  return LoadScanner()(hostname, hostname_len,
+                       lowercase_out, separators_out, num_separators);
+}
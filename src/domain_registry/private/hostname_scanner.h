@@ -0,0 +1,65 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Single-pass hostname preprocessing. These should not need to be
+ * invoked directly.
+ */
+
+#ifndef DOMAIN_REGISTRY_PRIVATE_HOSTNAME_SCANNER_H_
+#define DOMAIN_REGISTRY_PRIVATE_HOSTNAME_SCANNER_H_
+
+#include <stdlib.h>
+
+/*
+ * http://www.ietf.org/rfc/rfc1035.txt (DNS) and
+ * http://tools.ietf.org/html/rfc1123 (Internet host requirements)
+ * specify a maximum hostname length of 255 characters. To make sure
+ * string comparisons, etc are bounded elsewhere in the codebase, we
+ * enforce the 255 character limit in ScanHostname. There are various
+ * other hostname constraints specified in the RFCs (63 bytes per
+ * hostname-part, etc) but we do not enforce those here since doing
+ * so would not change correctness of the overall implementation,
+ * and it's possible that hostnames used in other contexts
+ * (e.g. outside of DNS) would not be subject to the 63-byte
+ * hostname-part limit. So we let the DNS layer enforce its policy,
+ * and enforce only the maximum hostname length here.
+ */
+#define MAX_HOSTNAME_LEN 255
+
+/*
+ * Validates, lowercases and splits the hostname_len bytes at hostname
+ * in a single pass. Returns 0 if the hostname is longer than
+ * MAX_HOSTNAME_LEN bytes or contains a null byte or a non-ASCII
+ * character: hostnames that are not ASCII (e.g. an IDN that hasn't
+ * been converted to ASCII via punycode) are rejected outright.
+ * Otherwise, writes the hostname with all ASCII characters
+ * converted to lowercase to lowercase_out, writes the offset of each
+ * '.' in the hostname to separators_out in ascending order, stores
+ * the number of separators in num_separators and returns 1.
+ *
+ * lowercase_out and separators_out must each have room for
+ * hostname_len entries. Since hostname_len is at most
+ * MAX_HOSTNAME_LEN, every separator offset fits in an unsigned char.
+ *
+ * Uses AVX2 or SSE2 when the processor supports them, and a scalar
+ * loop otherwise.
+ */
+int ScanHostname(const char* hostname,
+                 size_t hostname_len,
+                 char* lowercase_out,
+                 unsigned char* separators_out,
+                 size_t* num_separators);
+
+#endif  /* DOMAIN_REGISTRY_PRIVATE_HOSTNAME_SCANNER_H_ */
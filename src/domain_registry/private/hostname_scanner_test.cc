@@ -0,0 +1,125 @@
+// Copyright 2011 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+
+#include <string>
+
+extern "C" {
+#include "domain_registry/private/hostname_scanner.h"
+
+// Defined in hostname_scanner.c, exposed only for testing.
+int ScanHostnameScalar(const char* hostname,
+                       size_t hostname_len,
+                       char* lowercase_out,
+                       unsigned char* separators_out,
+                       size_t* num_separators);
+}  // extern "C"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+class HostnameScannerTest : public ::testing::Test {
+ protected:
+  // Scans hostname with both ScanHostname and ScanHostnameScalar,
+  // verifies that they agree, and returns the result.
+  int Scan(const std::string& hostname) {
+    char scalar_lowercase[MAX_HOSTNAME_LEN];
+    unsigned char scalar_separators[MAX_HOSTNAME_LEN];
+    size_t scalar_num_separators = 0;
+    const int scalar_result = ScanHostnameScalar(
+        hostname.data(), hostname.size(),
+        scalar_lowercase, scalar_separators, &scalar_num_separators);
+
+    num_separators_ = 0;
+    const int result = ScanHostname(
+        hostname.data(), hostname.size(),
+        lowercase_, separators_, &num_separators_);
+    EXPECT_EQ(scalar_result, result) << hostname;
+    if (result != 0 && scalar_result != 0) {
+      EXPECT_EQ(0, memcmp(scalar_lowercase, lowercase_, hostname.size()))
+          << hostname;
+      EXPECT_EQ(scalar_num_separators, num_separators_) << hostname;
+      EXPECT_EQ(0, memcmp(scalar_separators, separators_,
+                          num_separators_)) << hostname;
+    }
+    return result;
+  }
+
+  std::string Lowercase(size_t len) {
+    return std::string(lowercase_, len);
+  }
+
+  char lowercase_[MAX_HOSTNAME_LEN];
+  unsigned char separators_[MAX_HOSTNAME_LEN];
+  size_t num_separators_;
+};
+
+TEST_F(HostnameScannerTest, Basic) {
+  ASSERT_EQ(1, Scan("WWW.Example.COM"));
+  EXPECT_EQ("www.example.com", Lowercase(15));
+  ASSERT_EQ(2u, num_separators_);
+  EXPECT_EQ(3, separators_[0]);
+  EXPECT_EQ(11, separators_[1]);
+
+  ASSERT_EQ(1, Scan(""));
+  EXPECT_EQ(0u, num_separators_);
+
+  ASSERT_EQ(1, Scan("..a.."));
+  ASSERT_EQ(4u, num_separators_);
+  EXPECT_EQ(4, separators_[3]);
+
+  // Characters adjacent to the uppercase range are left unchanged.
+  ASSERT_EQ(1, Scan("@AZ[`az{"));
+  EXPECT_EQ("@az[`az{", Lowercase(8));
+}
+
+TEST_F(HostnameScannerTest, Invalid) {
+  EXPECT_EQ(0, Scan(std::string("foo\0bar.com", 11)));
+  EXPECT_EQ(0, Scan("f\xc3\xb6o.com"));
+  EXPECT_EQ(0, Scan(std::string(MAX_HOSTNAME_LEN + 1, 'a')));
+  EXPECT_EQ(1, Scan(std::string(MAX_HOSTNAME_LEN, 'a')));
+}
+
+TEST_F(HostnameScannerTest, AllLengthsAndPositions) {
+  // Exercise every length, so that each part of the vectorized
+  // scanners (32-byte blocks, 16-byte blocks and the byte-at-a-time
+  // remainder) sees separators, uppercase and invalid characters.
+  for (size_t len = 1; len <= MAX_HOSTNAME_LEN; ++len) {
+    std::string hostname;
+    for (size_t i = 0; i < len; ++i) {
+      hostname += "aZ.-9Q"[i % 6];
+    }
+    ASSERT_EQ(1, Scan(hostname));
+    for (size_t pos = 0; pos < len; pos += 7) {
+      std::string invalid = hostname;
+      invalid[pos] = '\0';
+      EXPECT_EQ(0, Scan(invalid));
+      invalid[pos] = '\x80';
+      EXPECT_EQ(0, Scan(invalid));
+    }
+  }
+}
+
+TEST_F(HostnameScannerTest, AllCharacters) {
+  for (int c = 1; c < 0x80; ++c) {
+    std::string hostname(40, static_cast<char>(c));
+    ASSERT_EQ(1, Scan(hostname)) << c;
+    const char expected = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+    EXPECT_EQ(std::string(40, expected), Lowercase(40)) << c;
+  }
+}
+
+}  // namespace
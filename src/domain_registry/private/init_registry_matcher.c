@@ -0,0 +1,36 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "domain_registry/private/init_registry_tables.h"
+#include "domain_registry/private/matcher_search.h"
+#include "domain_registry/private/registry_tables.h"
+#include "domain_registry/private/registry_types.h"
+#include "domain_registry/private/trie_node.h"
+
+/* Include the generated file that contains the matcher functions. */
+#define INCLUDE_REGISTRY_MATCHER
+#include "registry_tables_genfiles/registry_tables.h"
+
+void AddRegistryMatcher(struct RegistryTables* tables) {
+  tables->matcher = MatchRegistryRule;
+}
+
+void InitializeRegistryMatcher(void) {
+  SetRegistryMatcher(MatchRegistryRule);
+}
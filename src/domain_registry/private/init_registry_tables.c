@@ -17,7 +17,10 @@
 #include "domain_registry/domain_registry.h"
 
 #include <stdlib.h>
+#include <string.h>
 
+#include "domain_registry/private/init_registry_tables.h"
+#include "domain_registry/private/registry_tables.h"
 #include "domain_registry/private/registry_types.h"
 #include "domain_registry/private/trie_node.h"
 #include "domain_registry/private/trie_search.h"
@@ -25,10 +28,70 @@
 /* Include the generated file that contains the actual registry tables. */
 #include "registry_tables_genfiles/registry_tables.h"
 
+/*
+ * The search must match the layout the tables were generated with.
+ * See domain_registry_eytzinger_layout in domain_registry.gyp.
+ */
+#ifdef DOMAIN_REGISTRY_EYTZINGER_LAYOUT
+#if !REGISTRY_TABLES_EYTZINGER_LAYOUT
+#error "Registry tables must be generated with --eytzinger_layout."
+#endif
+#elif REGISTRY_TABLES_EYTZINGER_LAYOUT
+#error "Registry tables were generated with --eytzinger_layout."
+#endif
+
+/* Install the built-in tables in registry. */
+static void InstallBuiltInTables(struct DomainRegistry* registry) {
+  /*
+   * Install all of the tables at once, so that lookups on other
+   * threads never see only some of them.
+   */
+  struct RegistryTables tables;
+  memset(&tables, 0, sizeof(tables));
+  tables.string_table = kStringTable;
+  tables.node_table = kNodeTable;
+  tables.num_root_children = kNumRootChildren;
+  tables.leaf_node_table = kLeafNodeTable;
+  tables.leaf_node_table_offset = kLeafChildOffset;
+  tables.root_hash_displacements = kRootHashDisplacements;
+  tables.num_root_hash_buckets = kNumRootHashBuckets;
+  tables.root_hash_table = kRootHashTable;
+  tables.node_fingerprints = kNodeFingerprintTable;
+  tables.leaf_fingerprints = kLeafFingerprintTable;
+  tables.node_sections = kNodeSectionTable;
+  tables.leaf_sections = kLeafSectionTable;
+#ifdef DOMAIN_REGISTRY_SUFFIX_HASH
+  AddSuffixHashTable(&tables);
+#endif
+#ifdef DOMAIN_REGISTRY_DAFSA
+  AddDafsa(&tables);
+#endif
+#ifdef DOMAIN_REGISTRY_MATCHER
+  AddRegistryMatcher(&tables);
+#endif
+  InstallRegistryTables(registry, &tables);
+}
+
 void InitializeDomainRegistry(void) {
-  SetRegistryTables(kStringTable,
-                    kNodeTable,
-                    kNumRootChildren,
-                    kLeafNodeTable,
-                    kLeafChildOffset);
+  InstallBuiltInTables(GetDefaultDomainRegistry());
+}
+
+struct DomainRegistry* CreateDomainRegistry(void) {
+  struct DomainRegistry* registry = NewDomainRegistry();
+  if (registry != NULL) {
+    InstallBuiltInTables(registry);
+  }
+  return registry;
+}
+
+size_t GetTrieTablesSize(void) {
+  return sizeof(kStringTable) +
+      sizeof(kNodeTable) +
+      sizeof(kLeafNodeTable) +
+      sizeof(kRootHashDisplacements) +
+      sizeof(kRootHashTable) +
+      sizeof(kNodeFingerprintTable) +
+      sizeof(kLeafFingerprintTable) +
+      sizeof(kNodeSectionTable) +
+      sizeof(kLeafSectionTable);
 }
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Functions to install the generated registry tables. These should
+ * not need to be invoked directly.
+ */
+
+#ifndef DOMAIN_REGISTRY_PRIVATE_INIT_REGISTRY_TABLES_H_
+#define DOMAIN_REGISTRY_PRIVATE_INIT_REGISTRY_TABLES_H_
+
+#include <stdlib.h>
+
+struct RegistryTables;
+
+/*
+ * Install the generated suffix hash table, so that lookups use the
+ * suffix-hash engine instead of walking the trie. Must be called
+ * after InitializeDomainRegistry(). Defined in
+ * init_suffix_hash_table.c (init_suffix_hash_table_lib), which is
+ * only linked into builds that use the suffix-hash engine.
+ */
+void InitializeSuffixHashTable(void);
+
+/*
+ * Add the generated suffix hash table to tables. Used by
+ * InitializeDomainRegistry() when built with
+ * DOMAIN_REGISTRY_SUFFIX_HASH.
+ */
+void AddSuffixHashTable(struct RegistryTables* tables);
+
+/*
+ * Install the generated DAFSA, so that lookups use the DAFSA engine
+ * instead of walking the trie. Must be called after
+ * InitializeDomainRegistry(). Defined in init_dafsa.c
+ * (init_dafsa_lib), which is only linked into builds that use the
+ * DAFSA engine.
+ */
+void InitializeDafsa(void);
+
+/*
+ * Add the generated DAFSA to tables. Used by
+ * InitializeDomainRegistry() when built with DOMAIN_REGISTRY_DAFSA.
+ */
+void AddDafsa(struct RegistryTables* tables);
+
+/*
+ * Install the generated matcher, so that lookups use the matcher
+ * engine instead of walking the trie. Must be called after
+ * InitializeDomainRegistry(). Defined in init_registry_matcher.c
+ * (init_registry_matcher_lib), which is only linked into builds that
+ * use the matcher engine.
+ */
+void InitializeRegistryMatcher(void);
+
+/*
+ * Add the generated matcher to tables. Used by
+ * InitializeDomainRegistry() when built with DOMAIN_REGISTRY_MATCHER.
+ */
+void AddRegistryMatcher(struct RegistryTables* tables);
+
+/*
+ * Sizes in bytes of the generated tables each engine searches. The
+ * trie tables include the root hash, and are also used by the
+ * suffix-hash engine for its strings. The DAFSA is self-contained.
+ * Each is defined next to the function that installs the tables.
+ */
+size_t GetTrieTablesSize(void);
+size_t GetSuffixHashTableSize(void);
+size_t GetDafsaSize(void);
+
+#endif  /* DOMAIN_REGISTRY_PRIVATE_INIT_REGISTRY_TABLES_H_ */
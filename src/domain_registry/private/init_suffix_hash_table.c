@@ -0,0 +1,47 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include "domain_registry/private/init_registry_tables.h"
+#include "domain_registry/private/registry_tables.h"
+#include "domain_registry/private/registry_types.h"
+#include "domain_registry/private/suffix_hash_search.h"
+#include "domain_registry/private/trie_node.h"
+
+/*
+ * Include the generated file that contains the actual registry
+ * tables, with the suffix hash table. The trie tables it also holds
+ * are not referenced here, so they are not compiled into this file.
+ */
+#define INCLUDE_SUFFIX_HASH_TABLE
+#include "registry_tables_genfiles/registry_tables.h"
+
+void AddSuffixHashTable(struct RegistryTables* tables) {
+  tables->suffix_hash_table = kSuffixHashTable;
+  tables->suffix_hash_table_size = kSuffixHashTableSize;
+  tables->suffix_hash_seed = kSuffixHashSeed;
+}
+
+void InitializeSuffixHashTable(void) {
+  SetSuffixHashTable(kSuffixHashTable,
+                     kSuffixHashTableSize,
+                     kSuffixHashSeed);
+}
+
+size_t GetSuffixHashTableSize(void) {
+  return sizeof(kSuffixHashTable);
+}
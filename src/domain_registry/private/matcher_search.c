@@ -0,0 +1,68 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "domain_registry/private/matcher_search.h"
+
+#include <stdlib.h>
+
+#include "domain_registry/domain_registry.h"
+#include "domain_registry/private/assert.h"
+#include "domain_registry/private/registry_tables.h"
+#include "domain_registry/private/string_util.h"
+
+int FindMatcherNodeN(const struct RegistryTables* tables,
+                     const char* component,
+                     size_t component_len,
+                     const struct MatcherNode* parent,
+                     struct MatcherNode* node) {
+  REGISTRY_U32 result;
+
+  DCHECK(tables->matcher != NULL);
+  DCHECK(component != NULL);
+  if (IsInvalidComponent(component, component_len)) {
+    return 0;
+  }
+  if (parent != NULL && parent->has_children == 0) {
+    return 0;
+  }
+
+  /*
+   * The generated code already falls back to the wildcard, and leaves
+   * out exception rules without one. See FindRegistryNodeN.
+   */
+  result = tables->matcher(parent != NULL ? parent->id : 0,
+                           component, component_len);
+  if (result == 0) {
+    return 0;
+  }
+  node->id = result >> REGISTRY_MATCH_NODE_SHIFT;
+  node->is_terminal = (result & REGISTRY_MATCH_TERMINAL) != 0;
+  node->is_exception = (result & REGISTRY_MATCH_EXCEPTION) != 0;
+  node->is_wildcard = (result & REGISTRY_MATCH_WILDCARD) != 0;
+  node->has_children = (node->id != 0);
+  return 1;
+}
+
+int HasRegistryMatcher(const struct RegistryTables* tables) {
+  return tables->matcher != NULL;
+}
+
+void SetRegistryMatcher(RegistryMatcher matcher) {
+  struct RegistryTables tables;
+  GetRegistryTables(GetDefaultDomainRegistry(), &tables);
+  tables.matcher = matcher;
+  InstallRegistryTables(GetDefaultDomainRegistry(), &tables);
+}
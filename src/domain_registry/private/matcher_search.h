@@ -0,0 +1,83 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * Functions to search the registry rules with a matcher generated as
+ * C code. See registry_tables_generator/matcher_builder.py for a
+ * description of the generated code. These should not need to be
+ * invoked directly.
+ */
+
+#ifndef DOMAIN_REGISTRY_PRIVATE_MATCHER_SEARCH_H_
+#define DOMAIN_REGISTRY_PRIVATE_MATCHER_SEARCH_H_
+
+#include <stdlib.h>
+
+#include "domain_registry/private/registry_tables.h"
+#include "domain_registry/private/registry_types.h"
+
+/*
+ * The value a RegistryMatcher returns holds the flags of the node that
+ * matched in its low bits, and the number of the node in the rest, or
+ * 0 if the node has no children. 0 means that nothing matched. Must
+ * match matcher_builder.py.
+ */
+#define REGISTRY_MATCH_TERMINAL 0x1
+#define REGISTRY_MATCH_EXCEPTION 0x2
+#define REGISTRY_MATCH_WILDCARD 0x4
+#define REGISTRY_MATCH_NODE_SHIFT 3
+
+/*
+ * A hostname-part found by the matcher. Its flags match those of the
+ * corresponding TrieNode.
+ */
+struct MatcherNode {
+  /* The number of the node, which the matcher takes as parent. */
+  REGISTRY_U32 id;
+
+  int is_terminal;
+  int is_exception;
+  int has_children;
+
+  /* Whether the node is the wildcard "*". */
+  int is_wildcard;
+};
+
+/*
+ * Find the hostname-part component, of length component_len, under
+ * the given parent node, and store it in *node. If parent is NULL
+ * then component is looked up as a top-level hostname-part. Applies
+ * wildcard and exception rules the same way FindRegistryNodeN
+ * does. Returns 0 if there is no matching node. component must be
+ * lowercase and need not be null-terminated. Does not allocate.
+ */
+int FindMatcherNodeN(const struct RegistryTables* tables,
+                     const char* component,
+                     size_t component_len,
+                     const struct MatcherNode* parent,
+                     struct MatcherNode* node);
+
+/* Do the given tables include a matcher? */
+int HasRegistryMatcher(const struct RegistryTables* tables);
+
+/*
+ * Install the matcher. Lookups use the matcher instead of the trie,
+ * the suffix hash table or the DAFSA while one is installed. Pass NULL
+ * to remove the matcher. SetRegistryTables removes any previously
+ * installed matcher, so this must be called after it.
+ */
+void SetRegistryMatcher(RegistryMatcher matcher);
+
+#endif  /* DOMAIN_REGISTRY_PRIVATE_MATCHER_SEARCH_H_ */
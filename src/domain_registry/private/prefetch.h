@@ -0,0 +1,35 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Prefetch hint used by the lookup engines.
+ */
+
+#ifndef DOMAIN_REGISTRY_PRIVATE_PREFETCH_H_
+#define DOMAIN_REGISTRY_PRIVATE_PREFETCH_H_
+
+/*
+ * Hint to the processor that the cache line containing addr will be
+ * read soon. Does not fault if addr is not mapped.
+ */
+#if defined(__GNUC__)
+#define PREFETCH(addr) __builtin_prefetch(addr)
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <xmmintrin.h>
+#define PREFETCH(addr) _mm_prefetch((const char*) (addr), _MM_HINT_T0)
+#else
+#define PREFETCH(addr)
+#endif
+
+#endif  /* DOMAIN_REGISTRY_PRIVATE_PREFETCH_H_ */
@@ -0,0 +1,289 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "domain_registry/private/punycode.h"
+
+#include <string.h>
+
+#include "domain_registry/private/registry_types.h"
+
+/*
+ * The most characters in a hostname-part, per RFC 1035. Bounding the
+ * characters of the hostname-parts that are encoded also bounds the
+ * deltas computed while encoding them well below 2^32.
+ */
+#define MAX_HOSTNAME_PART_CHARS 63
+
+/* Punycode parameters for IDNA. See RFC 3492, section 5. */
+static const REGISTRY_U32 kBase = 36;
+static const REGISTRY_U32 kTMin = 1;
+static const REGISTRY_U32 kTMax = 26;
+static const REGISTRY_U32 kSkew = 38;
+static const REGISTRY_U32 kDamp = 700;
+static const REGISTRY_U32 kInitialBias = 72;
+static const REGISTRY_U32 kInitialN = 0x80;
+
+static const char kAcePrefix[] = "xn--";
+
+/*
+ * Returns the length of the hostname-part separator that starts the
+ * len bytes at s, or 0 if they do not start with one.
+ */
+static size_t GetSeparatorLength(const unsigned char* s, size_t len) {
+  if (s[0] == '.') {
+    return 1;
+  }
+  /* U+3002, U+FF0E and U+FF61. */
+  if (len >= 3 &&
+      ((s[0] == 0xe3 && s[1] == 0x80 && s[2] == 0x82) ||
+       (s[0] == 0xef && s[1] == 0xbc && s[2] == 0x8e) ||
+       (s[0] == 0xef && s[1] == 0xbd && s[2] == 0xa1))) {
+    return 3;
+  }
+  return 0;
+}
+
+/*
+ * Decodes the character that starts the len bytes at s into *c, and
+ * returns the number of bytes it takes. Returns 0 if they do not start
+ * with a valid UTF-8 sequence: overlong sequences and surrogates are
+ * not valid.
+ */
+static size_t DecodeUtf8Char(const unsigned char* s,
+                             size_t len,
+                             REGISTRY_U32* c) {
+  REGISTRY_U32 min;
+  size_t n;
+  size_t i;
+
+  if (s[0] < 0x80) {
+    *c = s[0];
+    return 1;
+  } else if ((s[0] & 0xe0) == 0xc0) {
+    *c = s[0] & 0x1f;
+    min = 0x80;
+    n = 2;
+  } else if ((s[0] & 0xf0) == 0xe0) {
+    *c = s[0] & 0x0f;
+    min = 0x800;
+    n = 3;
+  } else if ((s[0] & 0xf8) == 0xf0) {
+    *c = s[0] & 0x07;
+    min = 0x10000;
+    n = 4;
+  } else {
+    return 0;
+  }
+  if (len < n) {
+    return 0;
+  }
+  for (i = 1; i < n; ++i) {
+    if ((s[i] & 0xc0) != 0x80) {
+      return 0;
+    }
+    *c = (*c << 6) | (s[i] & 0x3f);
+  }
+  if (*c < min || *c > 0x10ffff || (*c >= 0xd800 && *c <= 0xdfff)) {
+    return 0;
+  }
+  return n;
+}
+
+static char EncodeDigit(REGISTRY_U32 d) {
+  return (char) (d < 26 ? 'a' + d : '0' + d - 26);
+}
+
+/* See RFC 3492, section 6.1. */
+static REGISTRY_U32 AdaptBias(REGISTRY_U32 delta,
+                              REGISTRY_U32 num_points,
+                              int is_first) {
+  REGISTRY_U32 k = 0;
+  delta = is_first ? delta / kDamp : delta / 2;
+  delta += delta / num_points;
+  while (delta > ((kBase - kTMin) * kTMax) / 2) {
+    delta /= kBase - kTMin;
+    k += kBase;
+  }
+  return k + (kBase - kTMin + 1) * delta / (delta + kSkew);
+}
+
+/*
+ * Writes the ACE form of the num_chars characters at chars, which are
+ * not all ASCII, to out, and returns the number of bytes written, or
+ * 0 if more than out_size bytes are needed. See RFC 3492, section
+ * 6.3.
+ */
+static size_t EncodeHostnamePart(const REGISTRY_U32* chars,
+                                 size_t num_chars,
+                                 char* out,
+                                 size_t out_size) {
+  const size_t prefix_len = sizeof(kAcePrefix) - 1;
+  REGISTRY_U32 n = kInitialN;
+  REGISTRY_U32 delta = 0;
+  REGISTRY_U32 bias = kInitialBias;
+  size_t num_basic = 0;
+  size_t num_handled;
+  size_t out_len;
+  size_t i;
+
+  if (out_size < prefix_len) {
+    return 0;
+  }
+  memcpy(out, kAcePrefix, prefix_len);
+  out_len = prefix_len;
+
+  /* The ASCII characters are copied first, followed by a '-'. */
+  for (i = 0; i < num_chars; ++i) {
+    if (chars[i] < 0x80) {
+      if (out_len == out_size) {
+        return 0;
+      }
+      out[out_len++] = (char) chars[i];
+      ++num_basic;
+    }
+  }
+  if (num_basic > 0) {
+    if (out_len == out_size) {
+      return 0;
+    }
+    out[out_len++] = '-';
+  }
+
+  /*
+   * Then each of the others, in increasing order, as a delta that
+   * encodes both the character and where it is inserted.
+   */
+  for (num_handled = num_basic; num_handled < num_chars; ++n, ++delta) {
+    REGISTRY_U32 m = 0x10ffff;
+    for (i = 0; i < num_chars; ++i) {
+      if (chars[i] >= n && chars[i] < m) {
+        m = chars[i];
+      }
+    }
+    delta += (m - n) * (REGISTRY_U32) (num_handled + 1);
+    n = m;
+    for (i = 0; i < num_chars; ++i) {
+      if (chars[i] < n) {
+        ++delta;
+      } else if (chars[i] == n) {
+        REGISTRY_U32 q = delta;
+        REGISTRY_U32 k;
+        for (k = kBase; ; k += kBase) {
+          REGISTRY_U32 t = k <= bias ? kTMin :
+              (k >= bias + kTMax ? kTMax : k - bias);
+          if (q < t) {
+            break;
+          }
+          if (out_len == out_size) {
+            return 0;
+          }
+          out[out_len++] = EncodeDigit(t + (q - t) % (kBase - t));
+          q = (q - t) / (kBase - t);
+        }
+        if (out_len == out_size) {
+          return 0;
+        }
+        out[out_len++] = EncodeDigit(q);
+        bias = AdaptBias(delta, (REGISTRY_U32) (num_handled + 1),
+                         num_handled == num_basic);
+        delta = 0;
+        ++num_handled;
+      }
+    }
+  }
+  return out_len;
+}
+
+size_t ConvertHostnameToAscii(const char* hostname,
+                              size_t hostname_len,
+                              char* out,
+                              size_t out_size) {
+  const unsigned char* s = (const unsigned char*) hostname;
+  REGISTRY_U32 chars[MAX_HOSTNAME_PART_CHARS];
+  size_t out_len = 0;
+  size_t i = 0;
+
+  for (;;) {
+    const size_t part_start = i;
+    size_t separator_len = 0;
+    int is_ascii = 1;
+
+    while (i < hostname_len &&
+           (separator_len = GetSeparatorLength(s + i, hostname_len - i)) ==
+           0) {
+      if (s[i] >= 0x80) {
+        is_ascii = 0;
+      }
+      ++i;
+    }
+
+    if (is_ascii) {
+      if (i - part_start > out_size - out_len) {
+        return 0;
+      }
+      memcpy(out + out_len, hostname + part_start, i - part_start);
+      out_len += i - part_start;
+    } else {
+      size_t num_chars = 0;
+      size_t j = part_start;
+      size_t part_len;
+      while (j < i) {
+        size_t char_len;
+        if (num_chars == MAX_HOSTNAME_PART_CHARS) {
+          return 0;
+        }
+        char_len = DecodeUtf8Char(s + j, i - j, &chars[num_chars]);
+        if (char_len == 0) {
+          return 0;
+        }
+        j += char_len;
+        ++num_chars;
+      }
+      part_len = EncodeHostnamePart(
+          chars, num_chars, out + out_len, out_size - out_len);
+      if (part_len == 0) {
+        return 0;
+      }
+      out_len += part_len;
+    }
+
+    if (i == hostname_len) {
+      return out_len;
+    }
+    if (out_len == out_size) {
+      return 0;
+    }
+    out[out_len++] = '.';
+    i += separator_len;
+  }
+}
+
+size_t FindHostnamePartOffset(const char* hostname,
+                              size_t hostname_len,
+                              size_t num_separators) {
+  const unsigned char* s = (const unsigned char*) hostname;
+  size_t i = 0;
+  while (num_separators > 0 && i < hostname_len) {
+    size_t separator_len = GetSeparatorLength(s + i, hostname_len - i);
+    if (separator_len > 0) {
+      i += separator_len;
+      --num_separators;
+    } else {
+      ++i;
+    }
+  }
+  return i;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * Conversion of UTF-8 hostnames to ASCII, for lookups. These should
+ * not need to be invoked directly.
+ */
+
+#ifndef DOMAIN_REGISTRY_PRIVATE_PUNYCODE_H_
+#define DOMAIN_REGISTRY_PRIVATE_PUNYCODE_H_
+
+#include <stdlib.h>
+
+/*
+ * Converts the UTF-8 hostname of hostname_len bytes at hostname to
+ * ASCII, writing at most out_size bytes to out, and returns the
+ * number of bytes written. Hostname-parts that are ASCII are copied
+ * as they are. Others are encoded with punycode (RFC 3492) and
+ * prefixed with "xn--", as IDNA ToASCII does. The ideographic full
+ * stops U+3002, U+FF0E and U+FF61 separate hostname-parts like '.',
+ * and are written as '.'.
+ *
+ * This implements only what lookups need: non-ASCII characters are
+ * encoded as given, without the IDNA mapping step (e.g. of uppercase
+ * to lowercase), so they must already be in mapped form, as URL
+ * parsers produce. ASCII characters are not lowercased.
+ *
+ * Returns 0 if the hostname is not valid UTF-8, if a hostname-part
+ * has more than 63 characters and is not ASCII, or if the result does
+ * not fit in out_size bytes.
+ */
+size_t ConvertHostnameToAscii(const char* hostname,
+                              size_t hostname_len,
+                              char* out,
+                              size_t out_size);
+
+/*
+ * Returns the offset in the UTF-8 hostname of hostname_len bytes at
+ * hostname just past its num_separators'th hostname-part separator,
+ * i.e. of the start of the hostname-part that starts at the
+ * num_separators'th '.' of the result of ConvertHostnameToAscii.
+ * Returns hostname_len if there are fewer separators.
+ */
+size_t FindHostnamePartOffset(const char* hostname,
+                              size_t hostname_len,
+                              size_t num_separators);
+
+#endif  /* DOMAIN_REGISTRY_PRIVATE_PUNYCODE_H_ */
@@ -0,0 +1,112 @@
+// Copyright 2011 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+
+#include <string>
+
+extern "C" {
+#include "domain_registry/private/punycode.h"
+}  // extern "C"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace {
+
+// Returns hostname converted with ConvertHostnameToAscii, or "(none)"
+// if it cannot be converted.
+std::string ToAscii(const std::string& hostname) {
+  char out[256];
+  size_t out_len =
+      ConvertHostnameToAscii(hostname.data(), hostname.size(), out,
+                             sizeof(out));
+  if (out_len == 0) {
+    return "(none)";
+  }
+  return std::string(out, out_len);
+}
+
+TEST(PunycodeTest, AsciiUnchanged) {
+  EXPECT_EQ("www.google.com", ToAscii("www.google.com"));
+  EXPECT_EQ("WWW.Google.com.", ToAscii("WWW.Google.com."));
+  EXPECT_EQ("..a", ToAscii("..a"));
+  EXPECT_EQ("xn--nnx388a", ToAscii("xn--nnx388a"));
+}
+
+TEST(PunycodeTest, Encode) {
+  EXPECT_EQ("foo.xn--nnx388a", ToAscii("foo.\xe8\x87\xba\xe7\x81\xa3"));
+  EXPECT_EQ("xn--bcher-kva.de", ToAscii("b\xc3\xbc" "cher.de"));
+  EXPECT_EQ("xn--tda", ToAscii("\xc3\xbc"));
+  EXPECT_EQ("xn--mnchen-3ya.de.", ToAscii("m\xc3\xbc" "nchen.de."));
+
+  // Samples from RFC 3492, section 7.1: (B) Chinese and (L) Russian.
+  EXPECT_EQ("xn--ihqwcrb4cv8a8dqg056pqjye",
+            ToAscii("\xe4\xbb\x96\xe4\xbb\xac\xe4\xb8\xba\xe4\xbb\x80"
+                    "\xe4\xb9\x88\xe4\xb8\x8d\xe8\xaf\xb4\xe4\xb8\xad"
+                    "\xe6\x96\x87"));
+  EXPECT_EQ("xn--b1abfaaepdrnnbgefbadotcwatmq2g4l",
+            ToAscii("\xd0\xbf\xd0\xbe\xd1\x87\xd0\xb5\xd0\xbc\xd1\x83"
+                    "\xd0\xb6\xd0\xb5\xd0\xbe\xd0\xbd\xd0\xb8\xd0\xbd"
+                    "\xd0\xb5\xd0\xb3\xd0\xbe\xd0\xb2\xd0\xbe\xd1\x80"
+                    "\xd1\x8f\xd1\x82\xd0\xbf\xd0\xbe\xd1\x80\xd1\x83"
+                    "\xd1\x81\xd1\x81\xd0\xba\xd0\xb8"));
+
+  // A character outside the Basic Multilingual Plane (U+1F600).
+  EXPECT_EQ("xn--e28h", ToAscii("\xf0\x9f\x98\x80"));
+}
+
+TEST(PunycodeTest, IdeographicFullStops) {
+  // U+3002, U+FF0E and U+FF61 separate hostname-parts.
+  EXPECT_EQ("a.b.c.d", ToAscii("a\xe3\x80\x82" "b\xef\xbc\x8e"
+                               "c\xef\xbd\xa1" "d"));
+  EXPECT_EQ("foo.xn--nnx388a",
+            ToAscii("foo\xe3\x80\x82\xe8\x87\xba\xe7\x81\xa3"));
+}
+
+TEST(PunycodeTest, Invalid) {
+  // Truncated, overlong, surrogate and stray continuation bytes.
+  EXPECT_EQ("(none)", ToAscii("a.\xc3"));
+  EXPECT_EQ("(none)", ToAscii("a.\xc0\xae"));
+  EXPECT_EQ("(none)", ToAscii("a.\xed\xa0\x80"));
+  EXPECT_EQ("(none)", ToAscii("a.\x80"));
+  EXPECT_EQ("(none)", ToAscii("a.\xf4\x90\x80\x80"));
+
+  // A non-ASCII hostname-part of more than 63 characters.
+  std::string long_part;
+  for (int i = 0; i < 64; ++i) {
+    long_part += "\xc3\xbc";
+  }
+  EXPECT_EQ("(none)", ToAscii(long_part));
+  EXPECT_NE("(none)", ToAscii(long_part.substr(2)));
+}
+
+TEST(PunycodeTest, OutputTooSmall) {
+  char out[12];
+  EXPECT_EQ(12, ConvertHostnameToAscii("\xc3\xbc.abcd", 7, out, 12));
+  EXPECT_EQ(0, ConvertHostnameToAscii("\xc3\xbc.abcde", 8, out, 12));
+  EXPECT_EQ(0, ConvertHostnameToAscii("abcd.\xc3\xbc", 7, out, 10));
+  EXPECT_EQ(0, ConvertHostnameToAscii("\xc3\xbc", 2, out, 3));
+}
+
+TEST(PunycodeTest, FindHostnamePartOffset) {
+  const char kHostname[] = "a\xe3\x80\x82\xe8\x87\xba.b";
+  const size_t hostname_len = strlen(kHostname);
+  EXPECT_EQ(0, FindHostnamePartOffset(kHostname, hostname_len, 0));
+  EXPECT_EQ(4, FindHostnamePartOffset(kHostname, hostname_len, 1));
+  EXPECT_EQ(8, FindHostnamePartOffset(kHostname, hostname_len, 2));
+  EXPECT_EQ(hostname_len,
+            FindHostnamePartOffset(kHostname, hostname_len, 3));
+}
+
+}  // namespace
@@ -0,0 +1,408 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "domain_registry/private/registry_blob.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "domain_registry/domain_registry.h"
+#include "domain_registry/private/registry_tables.h"
+#include "domain_registry/private/trie_node.h"
+
+/* Blob sizes are stored in 32 bits. */
+#define REGISTRY_BLOB_MAX_SIZE 0xffffffffU
+
+REGISTRY_U32 ComputeRegistryBlobChecksum(const void* data, size_t len) {
+  const unsigned char* p = (const unsigned char*) data;
+  const unsigned char* end = p + len;
+  REGISTRY_U32 table[256];
+  REGISTRY_U32 crc;
+  int i;
+  int j;
+
+  for (i = 0; i < 256; ++i) {
+    crc = (REGISTRY_U32) i;
+    for (j = 0; j < 8; ++j) {
+      crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320U : 0);
+    }
+    table[i] = crc;
+  }
+  crc = 0xffffffffU;
+  for (; p < end; ++p) {
+    crc = (crc >> 8) ^ table[(crc ^ *p) & 0xff];
+  }
+  return crc ^ 0xffffffffU;
+}
+
+/*
+ * Get the start of the given section, and its number of entries of
+ * entry_size bytes. Returns 0 if the section is not within the blob,
+ * is misaligned, or is not a whole number of entries.
+ */
+static int GetRegistryBlobSection(const unsigned char* blob,
+                                  const struct RegistryBlobHeader* header,
+                                  enum RegistryBlobSectionIndex index,
+                                  size_t entry_size,
+                                  const void** section,
+                                  size_t* num_entries) {
+  const struct RegistryBlobSection* s = header->sections + index;
+  if (s->offset < sizeof(*header) ||
+      s->offset % REGISTRY_BLOB_ALIGNMENT != 0 ||
+      s->offset > header->size ||
+      s->size > header->size - s->offset ||
+      s->size % entry_size != 0) {
+    return 0;
+  }
+  *section = blob + s->offset;
+  *num_entries = s->size / entry_size;
+  return 1;
+}
+
+/*
+ * Do all offsets in the node tables stay within the tables? Checked
+ * once at load time, so that the search never has to.
+ */
+static int AreRegistryBlobNodesValid(const struct TrieNode* nodes,
+                                     size_t num_nodes,
+                                     const TrieLeafNode* leaf_nodes,
+                                     size_t num_leaf_nodes,
+                                     size_t string_table_len) {
+  size_t i;
+  for (i = 0; i < num_nodes; ++i) {
+    const struct TrieNode* node = nodes + i;
+    const size_t first_child = GetTrieNodeFirstChildOffset(node);
+    const size_t num_children = GetTrieNodeNumChildren(node);
+    const size_t end_child = first_child + num_children;
+    if (GetTrieNodeStringTableOffset(node) >= string_table_len) {
+      return 0;
+    }
+    if (num_children == 0) {
+      continue;
+    }
+    /* All children are in one of the two tables. */
+    if (first_child < num_nodes) {
+      if (end_child > num_nodes) return 0;
+    } else if (end_child > num_nodes + num_leaf_nodes) {
+      return 0;
+    }
+  }
+  for (i = 0; i < num_leaf_nodes; ++i) {
+    if (leaf_nodes[i] >= string_table_len) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*
+ * Validate the blob and install its tables in registry, along with the
+ * given release function. See SetRegistryTablesFromBlob.
+ */
+static int InstallRegistryBlob(struct DomainRegistry* registry,
+                               const void* blob,
+                               size_t blob_len,
+                               void (*release)(void* release_context),
+                               void* release_context) {
+  const unsigned char* data = (const unsigned char*) blob;
+  const struct RegistryBlobHeader* header =
+      (const struct RegistryBlobHeader*) blob;
+  const void* string_table;
+  const void* node_table;
+  const void* leaf_node_table;
+  const void* root_hash_displacements;
+  const void* root_hash_table;
+  const void* node_fingerprints;
+  const void* leaf_fingerprints;
+  const void* node_sections;
+  const void* leaf_sections;
+  size_t string_table_len;
+  size_t num_nodes;
+  size_t num_leaf_nodes;
+  size_t num_root_hash_buckets;
+  size_t num_root_hash_entries;
+  size_t num_node_fingerprints;
+  size_t num_leaf_fingerprints;
+  size_t num_node_section_bytes;
+  size_t num_leaf_section_bytes;
+  size_t i;
+  struct RegistryTables tables;
+#ifdef DOMAIN_REGISTRY_EYTZINGER_LAYOUT
+  const REGISTRY_U32 expected_flags = REGISTRY_BLOB_FLAG_EYTZINGER_LAYOUT;
+#else
+  const REGISTRY_U32 expected_flags = 0;
+#endif
+
+  if (blob == NULL ||
+      (size_t) data % REGISTRY_BLOB_ALIGNMENT != 0 ||
+      blob_len < sizeof(*header) ||
+      header->magic != REGISTRY_BLOB_MAGIC ||
+      header->version != REGISTRY_BLOB_VERSION ||
+      header->size != blob_len ||
+      header->checksum != ComputeRegistryBlobChecksum(
+          data + REGISTRY_BLOB_CHECKSUM_START,
+          blob_len - REGISTRY_BLOB_CHECKSUM_START)) {
+    return 0;
+  }
+  /*
+   * The search must match the layout the tables were generated with.
+   * See domain_registry_eytzinger_layout in domain_registry.gyp. Nodes
+   * are used in place, so they must also have been written with the
+   * node encoding this library was built with.
+   */
+  if (header->flags != expected_flags ||
+      header->node_layout != TRIE_NODE_LAYOUT) {
+    return 0;
+  }
+
+  if (!GetRegistryBlobSection(data, header, REGISTRY_BLOB_STRING_TABLE, 1,
+                              &string_table, &string_table_len) ||
+      !GetRegistryBlobSection(data, header, REGISTRY_BLOB_NODE_TABLE,
+                              sizeof(struct TrieNode),
+                              &node_table, &num_nodes) ||
+      !GetRegistryBlobSection(data, header, REGISTRY_BLOB_LEAF_NODE_TABLE,
+                              sizeof(TrieLeafNode),
+                              &leaf_node_table, &num_leaf_nodes) ||
+      !GetRegistryBlobSection(data, header,
+                              REGISTRY_BLOB_ROOT_HASH_DISPLACEMENTS,
+                              sizeof(REGISTRY_U16),
+                              &root_hash_displacements,
+                              &num_root_hash_buckets) ||
+      !GetRegistryBlobSection(data, header, REGISTRY_BLOB_ROOT_HASH_TABLE,
+                              sizeof(struct RootHashEntry),
+                              &root_hash_table, &num_root_hash_entries) ||
+      !GetRegistryBlobSection(data, header, REGISTRY_BLOB_NODE_FINGERPRINTS,
+                              1, &node_fingerprints, &num_node_fingerprints) ||
+      !GetRegistryBlobSection(data, header, REGISTRY_BLOB_LEAF_FINGERPRINTS,
+                              1, &leaf_fingerprints, &num_leaf_fingerprints) ||
+      !GetRegistryBlobSection(data, header, REGISTRY_BLOB_NODE_SECTIONS,
+                              1, &node_sections, &num_node_section_bytes) ||
+      !GetRegistryBlobSection(data, header, REGISTRY_BLOB_LEAF_SECTIONS,
+                              1, &leaf_sections, &num_leaf_section_bytes)) {
+    return 0;
+  }
+
+  /* Hostname-parts are null-terminated. */
+  if (string_table_len == 0 ||
+      ((const char*) string_table)[string_table_len - 1] != '\0') {
+    return 0;
+  }
+  if (header->num_root_children == 0 ||
+      header->num_root_children > num_nodes ||
+      header->leaf_node_table_offset != num_nodes ||
+      !AreRegistryBlobNodesValid((const struct TrieNode*) node_table,
+                                 num_nodes,
+                                 (const TrieLeafNode*) leaf_node_table,
+                                 num_leaf_nodes,
+                                 string_table_len)) {
+    return 0;
+  }
+  /* The root hash and the fingerprints are optional. */
+  if (header->num_root_hash_buckets != num_root_hash_buckets) {
+    return 0;
+  }
+  if (num_root_hash_buckets > 0) {
+    const struct RootHashEntry* entries =
+        (const struct RootHashEntry*) root_hash_table;
+    if (num_root_hash_entries != header->num_root_children) {
+      return 0;
+    }
+    for (i = 0; i < num_root_hash_entries; ++i) {
+      if (entries[i].node_index >= header->num_root_children) {
+        return 0;
+      }
+    }
+  } else if (num_root_hash_entries > 0) {
+    return 0;
+  }
+  if ((num_node_fingerprints > 0 || num_leaf_fingerprints > 0) &&
+      (num_node_fingerprints != num_nodes ||
+       num_leaf_fingerprints != num_leaf_nodes)) {
+    return 0;
+  }
+  /* Sections are packed four to a byte. */
+  if ((num_node_section_bytes > 0 || num_leaf_section_bytes > 0) &&
+      (num_node_section_bytes != (num_nodes + 3) / 4 ||
+       num_leaf_section_bytes != (num_leaf_nodes + 3) / 4)) {
+    return 0;
+  }
+
+  memset(&tables, 0, sizeof(tables));
+  tables.string_table = (const char*) string_table;
+  tables.node_table = (const struct TrieNode*) node_table;
+  tables.num_root_children = header->num_root_children;
+  tables.leaf_node_table = (const TrieLeafNode*) leaf_node_table;
+  tables.leaf_node_table_offset = header->leaf_node_table_offset;
+  if (num_root_hash_buckets > 0) {
+    tables.root_hash_displacements =
+        (const REGISTRY_U16*) root_hash_displacements;
+    tables.num_root_hash_buckets = num_root_hash_buckets;
+    tables.root_hash_table = (const struct RootHashEntry*) root_hash_table;
+  }
+  if (num_node_fingerprints > 0) {
+    tables.node_fingerprints = (const unsigned char*) node_fingerprints;
+    tables.leaf_fingerprints = (const unsigned char*) leaf_fingerprints;
+  }
+  if (num_node_section_bytes > 0) {
+    tables.node_sections = (const unsigned char*) node_sections;
+    tables.leaf_sections = (const unsigned char*) leaf_sections;
+  }
+  tables.release = release;
+  tables.release_context = release_context;
+  InstallRegistryTables(registry, &tables);
+  return 1;
+}
+
+int SetRegistryTablesFromBlob(const void* blob, size_t blob_len) {
+  return InstallRegistryBlob(GetDefaultDomainRegistry(), blob, blob_len,
+                             NULL, NULL);
+}
+
+/*
+ * Map the file at path into memory read-only, and store its size in
+ * *len. Returns NULL on failure.
+ */
+static const void* MapFileReadOnly(const char* path, size_t* len) {
+#if defined(_WIN32)
+  HANDLE file;
+  HANDLE mapping;
+  LARGE_INTEGER size;
+  void* data;
+
+  file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                     OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return NULL;
+  }
+  if (!GetFileSizeEx(file, &size) ||
+      size.QuadPart <= 0 ||
+      size.QuadPart > REGISTRY_BLOB_MAX_SIZE) {
+    CloseHandle(file);
+    return NULL;
+  }
+  mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (mapping == NULL) {
+    return NULL;
+  }
+  /* The view keeps the mapping alive. */
+  data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (data == NULL) {
+    return NULL;
+  }
+  *len = (size_t) size.QuadPart;
+  return data;
+#else
+  struct stat st;
+  void* data;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  if (fstat(fd, &st) != 0 ||
+      st.st_size <= 0 ||
+      (REGISTRY_U64) st.st_size > REGISTRY_BLOB_MAX_SIZE) {
+    close(fd);
+    return NULL;
+  }
+  /* The mapping stays valid after the descriptor is closed. */
+  data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return NULL;
+  }
+  *len = (size_t) st.st_size;
+  return data;
+#endif
+}
+
+/* A file mapped by MapFileReadOnly. */
+struct MappedFile {
+  const void* data;
+  size_t len;
+};
+
+static void UnmapFile(const void* data, size_t len) {
+#if defined(_WIN32)
+  (void) len;
+  UnmapViewOfFile(data);
+#else
+  munmap((void*) data, len);
+#endif
+}
+
+/*
+ * Release function of tables loaded from a file. Called once the
+ * tables are replaced and no lookup uses them.
+ */
+static void ReleaseMappedFile(void* release_context) {
+  struct MappedFile* file = (struct MappedFile*) release_context;
+  UnmapFile(file->data, file->len);
+  free(file);
+}
+
+int ReloadDomainRegistryFromFile(struct DomainRegistry* registry,
+                                 const char* path) {
+  struct MappedFile* file;
+
+  if (registry == NULL || path == NULL) {
+    return 0;
+  }
+  file = (struct MappedFile*) malloc(sizeof(*file));
+  if (file == NULL) {
+    return 0;
+  }
+  file->data = MapFileReadOnly(path, &file->len);
+  if (file->data == NULL) {
+    free(file);
+    return 0;
+  }
+  /* The file stays mapped until its tables are replaced. */
+  if (!InstallRegistryBlob(registry, file->data, file->len,
+                           ReleaseMappedFile, file)) {
+    ReleaseMappedFile(file);
+    return 0;
+  }
+  return 1;
+}
+
+int InitializeDomainRegistryFromFile(const char* path) {
+  return ReloadDomainRegistryFromFile(GetDefaultDomainRegistry(), path);
+}
+
+struct DomainRegistry* CreateDomainRegistryFromFile(const char* path) {
+  struct DomainRegistry* registry = NewDomainRegistry();
+  if (registry == NULL) {
+    return NULL;
+  }
+  if (!ReloadDomainRegistryFromFile(registry, path)) {
+    DestroyDomainRegistry(registry);
+    return NULL;
+  }
+  return registry;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * Functions to install registry tables from the binary blob written
+ * by registry_tables_generator.py. See table_serializer.py for a
+ * description of the format. These should not need to be invoked
+ * directly.
+ */
+
+#ifndef DOMAIN_REGISTRY_PRIVATE_REGISTRY_BLOB_H_
+#define DOMAIN_REGISTRY_PRIVATE_REGISTRY_BLOB_H_
+
+#include <stdlib.h>
+
+#include "domain_registry/private/registry_types.h"
+
+/* The blob format. Must match table_serializer.py. */
+#define REGISTRY_BLOB_MAGIC 0x42545244  /* "DRTB" */
+#define REGISTRY_BLOB_VERSION 3
+#define REGISTRY_BLOB_FLAG_EYTZINGER_LAYOUT 1
+#define REGISTRY_BLOB_ALIGNMENT 8
+
+/* The offset of the first byte covered by the checksum. */
+#define REGISTRY_BLOB_CHECKSUM_START 16
+
+/* Indices of the sections in RegistryBlobHeader. */
+enum RegistryBlobSectionIndex {
+  REGISTRY_BLOB_STRING_TABLE,
+  REGISTRY_BLOB_NODE_TABLE,
+  REGISTRY_BLOB_LEAF_NODE_TABLE,
+  REGISTRY_BLOB_ROOT_HASH_DISPLACEMENTS,
+  REGISTRY_BLOB_ROOT_HASH_TABLE,
+  REGISTRY_BLOB_NODE_FINGERPRINTS,
+  REGISTRY_BLOB_LEAF_FINGERPRINTS,
+  REGISTRY_BLOB_NODE_SECTIONS,
+  REGISTRY_BLOB_LEAF_SECTIONS,
+  REGISTRY_BLOB_NUM_SECTIONS
+};
+
+/* The position of a table in the blob, in bytes from its start. */
+struct RegistryBlobSection {
+  REGISTRY_U32 offset;
+  REGISTRY_U32 size;
+};
+
+/*
+ * The start of the blob. All fields are little-endian, so blobs are
+ * rejected by big-endian hosts.
+ */
+struct RegistryBlobHeader {
+  REGISTRY_U32 magic;
+  REGISTRY_U32 version;
+
+  /* The size of the whole blob. */
+  REGISTRY_U32 size;
+
+  /* CRC-32 of the blob from REGISTRY_BLOB_CHECKSUM_START onwards. */
+  REGISTRY_U32 checksum;
+
+  REGISTRY_U32 flags;
+  REGISTRY_U32 num_root_children;
+
+  /*
+   * The number of entries in the node table. Child offsets at or
+   * above this refer to the leaf node table.
+   */
+  REGISTRY_U32 leaf_node_table_offset;
+
+  REGISTRY_U32 num_root_hash_buckets;
+
+  /* The TRIE_NODE_LAYOUT of the node tables. See trie_node.h. */
+  REGISTRY_U32 node_layout;
+
+  struct RegistryBlobSection sections[REGISTRY_BLOB_NUM_SECTIONS];
+};
+
+/*
+ * Compute the CRC-32 of the len bytes at data, as used for the blob
+ * checksum. This is the same CRC-32 as zlib's.
+ */
+REGISTRY_U32 ComputeRegistryBlobChecksum(const void* data, size_t len);
+
+/*
+ * Validate the blob of blob_len bytes and install its tables, which
+ * are used in place. The blob must be aligned to
+ * REGISTRY_BLOB_ALIGNMENT bytes, and must outlive all lookups that use
+ * its tables. The root hash, fingerprint and node section sections may
+ * be empty, in which case the searches they speed up are used without
+ * them, and all rules are treated as ICANN rules.
+ * Returns 0, leaving the current tables installed, if the blob is
+ * invalid.
+ */
+int SetRegistryTablesFromBlob(const void* blob, size_t blob_len);
+
+#endif  /* DOMAIN_REGISTRY_PRIVATE_REGISTRY_BLOB_H_ */
@@ -0,0 +1,295 @@
+// Copyright 2011 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "domain_registry/domain_registry.h"
+#include "domain_registry/private/registry_blob.h"
+#include "domain_registry/private/trie_search.h"
+}  // extern "C"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+// Include the simple test tables inline.
+#include "domain_registry/testing/simple_node_table.c"
+
+namespace {
+
+class RegistryBlobTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    SetRegistryTables(NULL, NULL, 0, NULL, 0);
+    memset(&header_, 0, sizeof(header_));
+    header_.magic = REGISTRY_BLOB_MAGIC;
+    header_.version = REGISTRY_BLOB_VERSION;
+#ifdef DOMAIN_REGISTRY_EYTZINGER_LAYOUT
+    header_.flags = REGISTRY_BLOB_FLAG_EYTZINGER_LAYOUT;
+#endif
+    header_.num_root_children = kSimpleNumRootChildren;
+    header_.leaf_node_table_offset = kSimpleLeafNodeTableOffset;
+    header_.num_root_hash_buckets = kSimpleNumRootHashBuckets;
+    header_.node_layout = TRIE_NODE_LAYOUT;
+    SetSection(REGISTRY_BLOB_STRING_TABLE,
+               kSimpleStringTable, sizeof(kSimpleStringTable));
+    SetSection(REGISTRY_BLOB_NODE_TABLE,
+               kSimpleNodeTable, sizeof(kSimpleNodeTable));
+    SetSection(REGISTRY_BLOB_LEAF_NODE_TABLE,
+               kSimpleLeafNodeTable, sizeof(kSimpleLeafNodeTable));
+    SetSection(REGISTRY_BLOB_ROOT_HASH_DISPLACEMENTS,
+               kSimpleRootHashDisplacements,
+               sizeof(kSimpleRootHashDisplacements));
+    SetSection(REGISTRY_BLOB_ROOT_HASH_TABLE,
+               kSimpleRootHashTable, sizeof(kSimpleRootHashTable));
+    SetSection(REGISTRY_BLOB_NODE_FINGERPRINTS,
+               kSimpleNodeFingerprintTable,
+               sizeof(kSimpleNodeFingerprintTable));
+    SetSection(REGISTRY_BLOB_LEAF_FINGERPRINTS,
+               kSimpleLeafFingerprintTable,
+               sizeof(kSimpleLeafFingerprintTable));
+    SetSection(REGISTRY_BLOB_NODE_SECTIONS,
+               kSimpleNodeSectionTable, sizeof(kSimpleNodeSectionTable));
+    SetSection(REGISTRY_BLOB_LEAF_SECTIONS,
+               kSimpleLeafSectionTable, sizeof(kSimpleLeafSectionTable));
+  }
+
+  virtual void TearDown() {
+    SetRegistryTables(NULL, NULL, 0, NULL, 0);
+  }
+
+  void SetSection(RegistryBlobSectionIndex index,
+                  const void* data,
+                  size_t size) {
+    sections_[index].assign(static_cast<const char*>(data), size);
+  }
+
+  // Lay out the header and sections, and fill in the size and
+  // checksum.
+  void BuildBlob() {
+    std::string body;
+    for (int i = 0; i < REGISTRY_BLOB_NUM_SECTIONS; ++i) {
+      body.resize(body.size() + (0 - (sizeof(header_) + body.size())) %
+                  REGISTRY_BLOB_ALIGNMENT);
+      header_.sections[i].offset = sizeof(header_) + body.size();
+      header_.sections[i].size = sections_[i].size();
+      body += sections_[i];
+    }
+    header_.size = sizeof(header_) + body.size();
+    blob_.assign(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    blob_ += body;
+    UpdateChecksum();
+  }
+
+  void UpdateChecksum() {
+    const REGISTRY_U32 checksum = ComputeRegistryBlobChecksum(
+        blob_.data() + REGISTRY_BLOB_CHECKSUM_START,
+        blob_.size() - REGISTRY_BLOB_CHECKSUM_START);
+    memcpy(&blob_[offsetof(RegistryBlobHeader, checksum)],
+           &checksum, sizeof(checksum));
+  }
+
+  // Install blob_, copied to suitably aligned memory.
+  int SetRegistryTablesFromTestBlob() {
+    aligned_.assign(blob_.size() / sizeof(REGISTRY_U64) + 1, 0);
+    memcpy(&aligned_[0], blob_.data(), blob_.size());
+    return SetRegistryTablesFromBlob(&aligned_[0], blob_.size());
+  }
+
+  void ExpectSimpleTablesInstalled() {
+    EXPECT_EQ(7, GetRegistryLength("a.foo.com"));
+    EXPECT_EQ(11, GetRegistryLength("www.zzz.bar.foo"));
+    EXPECT_EQ(0, GetRegistryLength("bar.com"));
+  }
+
+  RegistryBlobHeader header_;
+  std::string sections_[REGISTRY_BLOB_NUM_SECTIONS];
+  std::string blob_;
+  std::vector<REGISTRY_U64> aligned_;
+};
+
+// Expect GetRegistryLengths to find the given ICANN and private
+// registry lengths for bar.foo, a PRIVATE rule in the simple tables.
+void ExpectBarDotFooRegistryLengths(size_t expected_icann_len,
+                                    size_t expected_private_len) {
+  size_t icann_len;
+  size_t private_len;
+  GetRegistryLengths("bar.foo", &icann_len, &private_len);
+  EXPECT_EQ(expected_icann_len, icann_len);
+  EXPECT_EQ(expected_private_len, private_len);
+}
+
+TEST_F(RegistryBlobTest, Checksum) {
+  // The standard CRC-32 check value.
+  EXPECT_EQ(0xcbf43926U, ComputeRegistryBlobChecksum("123456789", 9));
+  EXPECT_EQ(0U, ComputeRegistryBlobChecksum("", 0));
+}
+
+TEST_F(RegistryBlobTest, Basic) {
+  BuildBlob();
+  ASSERT_EQ(1, SetRegistryTablesFromTestBlob());
+  ExpectSimpleTablesInstalled();
+  ExpectBarDotFooRegistryLengths(0, 7);
+}
+
+TEST_F(RegistryBlobTest, OptionalSections) {
+  header_.num_root_hash_buckets = 0;
+  SetSection(REGISTRY_BLOB_ROOT_HASH_DISPLACEMENTS, "", 0);
+  SetSection(REGISTRY_BLOB_ROOT_HASH_TABLE, "", 0);
+  SetSection(REGISTRY_BLOB_NODE_FINGERPRINTS, "", 0);
+  SetSection(REGISTRY_BLOB_LEAF_FINGERPRINTS, "", 0);
+  SetSection(REGISTRY_BLOB_NODE_SECTIONS, "", 0);
+  SetSection(REGISTRY_BLOB_LEAF_SECTIONS, "", 0);
+  BuildBlob();
+  ASSERT_EQ(1, SetRegistryTablesFromTestBlob());
+  ExpectSimpleTablesInstalled();
+
+  // Without sections, all rules are ICANN rules.
+  ExpectBarDotFooRegistryLengths(7, 7);
+}
+
+TEST_F(RegistryBlobTest, SectionsSizeMismatch) {
+  // Sections must cover all nodes of both tables, or neither.
+  SetSection(REGISTRY_BLOB_LEAF_SECTIONS, "", 0);
+  BuildBlob();
+  EXPECT_EQ(0, SetRegistryTablesFromTestBlob());
+
+  SetUp();
+  SetSection(REGISTRY_BLOB_NODE_SECTIONS, kSimpleNodeSectionTable, 1);
+  BuildBlob();
+  EXPECT_EQ(0, SetRegistryTablesFromTestBlob());
+}
+
+TEST_F(RegistryBlobTest, InvalidHeader) {
+  header_.magic = 0;
+  BuildBlob();
+  EXPECT_EQ(0, SetRegistryTablesFromTestBlob());
+
+  SetUp();
+  header_.version = REGISTRY_BLOB_VERSION + 1;
+  BuildBlob();
+  EXPECT_EQ(0, SetRegistryTablesFromTestBlob());
+
+  SetUp();
+  header_.flags ^= REGISTRY_BLOB_FLAG_EYTZINGER_LAYOUT;
+  BuildBlob();
+  EXPECT_EQ(0, SetRegistryTablesFromTestBlob());
+
+  // Nodes written with another encoding.
+  SetUp();
+  header_.node_layout = TRIE_NODE_LAYOUT + 1;
+  BuildBlob();
+  EXPECT_EQ(0, SetRegistryTablesFromTestBlob());
+
+  SetUp();
+  BuildBlob();
+  EXPECT_EQ(0, SetRegistryTablesFromBlob(NULL, 0));
+  EXPECT_EQ(0, SetRegistryTablesFromBlob(blob_.data(), 4));
+}
+
+TEST_F(RegistryBlobTest, Corrupt) {
+  BuildBlob();
+  blob_[blob_.size() - 1] ^= 1;
+  EXPECT_EQ(0, SetRegistryTablesFromTestBlob());
+}
+
+TEST_F(RegistryBlobTest, Truncated) {
+  BuildBlob();
+  blob_.resize(blob_.size() - 1);
+  UpdateChecksum();
+  EXPECT_EQ(0, SetRegistryTablesFromTestBlob());
+}
+
+TEST_F(RegistryBlobTest, SectionOutOfBounds) {
+  BuildBlob();
+  RegistryBlobHeader* header =
+      reinterpret_cast<RegistryBlobHeader*>(&blob_[0]);
+  header->sections[REGISTRY_BLOB_LEAF_FINGERPRINTS].size += 8;
+  UpdateChecksum();
+  EXPECT_EQ(0, SetRegistryTablesFromTestBlob());
+}
+
+TEST_F(RegistryBlobTest, StringTableNotTerminated) {
+  // Drop both the null byte of the last hostname-part and the one that
+  // ends the string literal.
+  SetSection(REGISTRY_BLOB_STRING_TABLE,
+             kSimpleStringTable, sizeof(kSimpleStringTable) - 2);
+  BuildBlob();
+  EXPECT_EQ(0, SetRegistryTablesFromTestBlob());
+}
+
+TEST_F(RegistryBlobTest, NodeOutOfRange) {
+  struct TrieNode nodes[
+      sizeof(kSimpleNodeTable) / sizeof(kSimpleNodeTable[0])];
+  memcpy(nodes, kSimpleNodeTable, sizeof(nodes));
+  const struct TrieNode kManyChildren = TRIE_NODE(0, 7, 100, 0, 0, 0);
+  nodes[0] = kManyChildren;
+  SetSection(REGISTRY_BLOB_NODE_TABLE, nodes, sizeof(nodes));
+  BuildBlob();
+  EXPECT_EQ(0, SetRegistryTablesFromTestBlob());
+
+  SetUp();
+  TrieLeafNode leaf_nodes[
+      sizeof(kSimpleLeafNodeTable) / sizeof(kSimpleLeafNodeTable[0])];
+  memcpy(leaf_nodes, kSimpleLeafNodeTable, sizeof(leaf_nodes));
+  leaf_nodes[0] = sizeof(kSimpleStringTable);
+  SetSection(REGISTRY_BLOB_LEAF_NODE_TABLE, leaf_nodes, sizeof(leaf_nodes));
+  BuildBlob();
+  EXPECT_EQ(0, SetRegistryTablesFromTestBlob());
+}
+
+TEST_F(RegistryBlobTest, FailureKeepsCurrentTables) {
+  BuildBlob();
+  ASSERT_EQ(1, SetRegistryTablesFromTestBlob());
+  std::vector<REGISTRY_U64> installed(aligned_);
+  ASSERT_EQ(1, SetRegistryTablesFromBlob(&installed[0], blob_.size()));
+
+  blob_[blob_.size() - 1] ^= 1;
+  EXPECT_EQ(0, SetRegistryTablesFromTestBlob());
+  ExpectSimpleTablesInstalled();
+}
+
+TEST_F(RegistryBlobTest, FromFile) {
+  EXPECT_EQ(0, InitializeDomainRegistryFromFile(NULL));
+  EXPECT_EQ(0, InitializeDomainRegistryFromFile("/nonexistent/registry.bin"));
+
+  char path[] = "/tmp/registry_blob_test_XXXXXX";
+  const int fd = mkstemp(path);
+  ASSERT_LE(0, fd);
+  FILE* file = fdopen(fd, "wb");
+  ASSERT_TRUE(file != NULL);
+  BuildBlob();
+  ASSERT_EQ(blob_.size(), fwrite(blob_.data(), 1, blob_.size(), file));
+  fclose(file);
+
+  EXPECT_EQ(1, InitializeDomainRegistryFromFile(path));
+  struct DomainRegistry* registry = CreateDomainRegistryFromFile(path);
+  ASSERT_TRUE(registry != NULL);
+  // The tables stay mapped after the file is removed.
+  remove(path);
+  ExpectSimpleTablesInstalled();
+  EXPECT_EQ(11, DomainRegistryGetRegistryLength(registry, "www.zzz.bar.foo"));
+  EXPECT_EQ(0, ReloadDomainRegistryFromFile(registry, path));
+  EXPECT_EQ(11, DomainRegistryGetRegistryLength(registry, "www.zzz.bar.foo"));
+  DestroyDomainRegistry(registry);
+
+  EXPECT_TRUE(CreateDomainRegistryFromFile(path) == NULL);
+  EXPECT_EQ(0, ReloadDomainRegistryFromFile(NULL, path));
+}
+
+}  // namespace
@@ -0,0 +1,436 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "domain_registry/private/registry_overlay.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "domain_registry/domain_registry.h"
+#include "domain_registry/private/assert.h"
+#include "domain_registry/private/hostname_scanner.h"
+#include "domain_registry/private/registry_tables.h"
+#include "domain_registry/private/string_util.h"
+
+/*
+ * Separates the hostname-parts of a rule key. Sorts before every
+ * character a rule may contain, so that rules sharing their rootmost
+ * hostname-parts sort next to each other.
+ */
+static const char kKeySeparator = '\1';
+
+/*
+ * A rule being added to an overlay, with its hostname-parts in the
+ * order the trie visits them, e.g. "com\1example" for "*.example.com"
+ * or "!www.example.com" would be "com\1example\1www".
+ */
+struct OverlayRuleKey {
+  char* key;
+  int is_exception;
+};
+
+int NormalizeRegistryRule(const char* rule, char* out) {
+  const char* name;
+  size_t name_len;
+  size_t label_start = 0;
+  size_t i;
+
+  if (rule == NULL) {
+    return 0;
+  }
+  name = rule;
+  if (IsExceptionComponent(name)) {
+    ++name;
+  }
+  for (name_len = 0; name_len <= MAX_HOSTNAME_LEN; ++name_len) {
+    if (name[name_len] == '\0') break;
+  }
+  if (name_len == 0 || name_len > MAX_HOSTNAME_LEN) {
+    return 0;
+  }
+  for (i = 0; i <= name_len; ++i) {
+    const unsigned char c = (i < name_len) ? name[i] : '.';
+    if (c == '.') {
+      const size_t label_len = i - label_start;
+      if (label_len == 0 ||
+          (label_len > 1 &&
+           memchr(name + label_start, '*', label_len) != NULL)) {
+        return 0;
+      }
+      label_start = i + 1;
+    } else if (c <= ' ' || c > 0x7f || c == '!') {
+      return 0;
+    }
+  }
+  /* There are no exceptions to a wildcard. */
+  if (name != rule && IsWildcardComponent(name)) {
+    return 0;
+  }
+
+  if (name != rule) {
+    *out++ = '!';
+  }
+  for (i = 0; i < name_len; ++i) {
+    out[i] = ToLowerASCIIChar(name[i]);
+  }
+  out[name_len] = '\0';
+  return 1;
+}
+
+/* Write the key of the normalized rule to key. */
+static void GetOverlayRuleKey(const char* rule, struct OverlayRuleKey* key) {
+  const char* name = rule;
+  const char* end;
+  char* out = key->key;
+
+  key->is_exception = IsExceptionComponent(name);
+  if (key->is_exception) {
+    ++name;
+  }
+  end = name + strlen(name);
+  while (end > name) {
+    const char* label = end;
+    while (label > name && label[-1] != '.') {
+      --label;
+    }
+    if (out != key->key) {
+      *out++ = kKeySeparator;
+    }
+    memcpy(out, label, end - label);
+    out += end - label;
+    end = (label > name) ? label - 1 : name;
+  }
+  *out = '\0';
+}
+
+static int CompareOverlayRuleKeys(const void* a, const void* b) {
+  const struct OverlayRuleKey* key_a = (const struct OverlayRuleKey*) a;
+  const struct OverlayRuleKey* key_b = (const struct OverlayRuleKey*) b;
+  const int result = strcmp(key_a->key, key_b->key);
+  if (result != 0) {
+    return result;
+  }
+  return key_a->is_exception - key_b->is_exception;
+}
+
+/*
+ * Lay out the trie of the sorted keys in nodes, breadth first, so
+ * that the children of each node are adjacent. Returns the number of
+ * nodes. For each node, ranges holds the keys that pass through it
+ * and positions the offset in those keys of its children's
+ * hostname-parts; both must have room for one entry per node.
+ */
+static size_t BuildOverlayNodes(const struct OverlayRuleKey* keys,
+                                size_t num_keys,
+                                struct RegistryOverlayNode* nodes,
+                                char* labels,
+                                size_t (*ranges)[2],
+                                size_t* positions) {
+  size_t num_nodes = 1;
+  size_t labels_len = 1;
+  size_t i;
+
+  /* The root has the empty hostname-part. */
+  memset(nodes, 0, sizeof(*nodes));
+  labels[0] = '\0';
+  ranges[0][0] = 0;
+  ranges[0][1] = num_keys;
+  positions[0] = 0;
+  for (i = 0; i < num_nodes; ++i) {
+    const size_t pos = positions[i];
+    const size_t end = ranges[i][1];
+    size_t j = ranges[i][0];
+
+    /* Keys that end at this node sort before those that continue. */
+    while (i > 0 && j < end && keys[j].key[pos - 1] == '\0') {
+      if (keys[j].is_exception) {
+        nodes[i].is_exception = 1;
+      } else {
+        nodes[i].is_terminal = 1;
+      }
+      ++j;
+    }
+    nodes[i].first_child = (REGISTRY_U32) num_nodes;
+    while (j < end) {
+      const char* label = keys[j].key + pos;
+      const size_t label_len = strcspn(label, "\1");
+      struct RegistryOverlayNode* child = nodes + num_nodes;
+      size_t k = j + 1;
+      while (k < end &&
+             strncmp(keys[k].key + pos, label, label_len) == 0 &&
+             (keys[k].key[pos + label_len] == kKeySeparator ||
+              keys[k].key[pos + label_len] == '\0')) {
+        ++k;
+      }
+      memset(child, 0, sizeof(*child));
+      child->label_offset = (REGISTRY_U32) labels_len;
+      memcpy(labels + labels_len, label, label_len);
+      labels[labels_len + label_len] = '\0';
+      labels_len += label_len + 1;
+      ranges[num_nodes][0] = j;
+      ranges[num_nodes][1] = k;
+      positions[num_nodes] = pos + label_len + 1;
+      ++num_nodes;
+      j = k;
+    }
+    nodes[i].num_children =
+        (REGISTRY_U32) (num_nodes - nodes[i].first_child);
+  }
+  return num_nodes;
+}
+
+const struct RegistryOverlay* BuildRegistryOverlay(const char* const* rules,
+                                                   size_t num_rules) {
+  struct OverlayRuleKey* keys;
+  char* key_buffer;
+  char* key_chars;
+  size_t (*ranges)[2];
+  size_t* positions;
+  struct RegistryOverlay* overlay;
+  const char** overlay_rules;
+  struct RegistryOverlayNode* nodes;
+  char* chars;
+  size_t max_nodes = 1;
+  size_t num_chars = 0;
+  size_t size;
+  size_t i;
+
+  /*
+   * Each hostname-part of each rule adds at most one node, and each
+   * node's hostname-part is one of a rule's, so the nodes and their
+   * hostname-parts need at most as much room as the rules.
+   */
+  for (i = 0; i < num_rules; ++i) {
+    const char* c;
+    DCHECK(i == 0 || strcmp(rules[i - 1], rules[i]) < 0);
+    ++max_nodes;
+    for (c = rules[i]; *c != '\0'; ++c) {
+      if (*c == '.') ++max_nodes;
+    }
+    num_chars += c - rules[i] + 1;
+  }
+
+  keys = (struct OverlayRuleKey*) malloc(num_rules * sizeof(*keys) + 1);
+  key_buffer = (char*) malloc(num_chars + 1);
+  ranges = (size_t (*)[2]) malloc(max_nodes * sizeof(*ranges));
+  positions = (size_t*) malloc(max_nodes * sizeof(*positions));
+  size = sizeof(*overlay) +
+      num_rules * sizeof(*overlay_rules) +
+      max_nodes * sizeof(*nodes) +
+      2 * num_chars + 1;
+  overlay = (struct RegistryOverlay*) malloc(size);
+  if (keys == NULL || key_buffer == NULL || ranges == NULL ||
+      positions == NULL || overlay == NULL) {
+    free(keys);
+    free(key_buffer);
+    free(ranges);
+    free(positions);
+    free(overlay);
+    return NULL;
+  }
+  overlay_rules = (const char**) (overlay + 1);
+  nodes = (struct RegistryOverlayNode*) (overlay_rules + num_rules);
+  chars = (char*) (nodes + max_nodes);
+
+  /* Keep a copy of the rules. */
+  for (i = 0; i < num_rules; ++i) {
+    const size_t len = strlen(rules[i]) + 1;
+    memcpy(chars, rules[i], len);
+    overlay_rules[i] = chars;
+    chars += len;
+  }
+  overlay->rules = overlay_rules;
+  overlay->num_rules = num_rules;
+
+  key_chars = key_buffer;
+  for (i = 0; i < num_rules; ++i) {
+    keys[i].key = key_chars;
+    GetOverlayRuleKey(rules[i], keys + i);
+    key_chars += strlen(key_chars) + 1;
+  }
+  qsort(keys, num_rules, sizeof(*keys), CompareOverlayRuleKeys);
+
+  overlay->nodes = nodes;
+  overlay->labels = chars;
+  overlay->num_nodes = BuildOverlayNodes(
+      keys, num_rules, nodes, chars, ranges, positions);
+  DCHECK(overlay->num_nodes <= max_nodes);
+
+  free(keys);
+  free(key_buffer);
+  free(ranges);
+  free(positions);
+  return overlay;
+}
+
+void FreeRegistryOverlay(const struct RegistryOverlay* overlay) {
+  free((void*) overlay);
+}
+
+const struct RegistryOverlayNode* FindRegistryOverlayNodeN(
+    const struct RegistryOverlay* overlay,
+    const struct RegistryOverlayNode* parent,
+    const char* component,
+    size_t component_len) {
+  const struct RegistryOverlayNode* children =
+      overlay->nodes + parent->first_child;
+  size_t low = 0;
+  size_t high = parent->num_children;
+
+  while (low < high) {
+    const size_t middle = low + (high - low) / 2;
+    const int result = HostnamePartCmpN(
+        component, component_len,
+        overlay->labels + children[middle].label_offset);
+    if (result == 0) {
+      return children + middle;
+    }
+    if (result < 0) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+  return NULL;
+}
+
+/* A change to the rules of an overlay. See UpdateOverlayRules. */
+struct OverlayRuleUpdate {
+  /* The normalized rule to add or remove, or NULL to remove all. */
+  const char* rule;
+  int add;
+
+  /* Set to the value the public function returns. */
+  int result;
+};
+
+/*
+ * Return an overlay with the rules of overlay (which may be NULL),
+ * changed as the OverlayRuleUpdate at context describes. Returns
+ * overlay itself if the rules do not change or the new overlay cannot
+ * be built. Called with installers serialized, so overlay is not
+ * replaced meanwhile.
+ */
+static const struct RegistryOverlay* UpdateOverlayRules(
+    const struct RegistryOverlay* overlay,
+    void* context) {
+  /* memcpy needs a valid pointer even when it copies nothing. */
+  static const char* const kNoRules[1] = { NULL };
+  struct OverlayRuleUpdate* update = (struct OverlayRuleUpdate*) context;
+  const char* const* rules = (overlay != NULL) ? overlay->rules : kNoRules;
+  const size_t num_rules = (overlay != NULL) ? overlay->num_rules : 0;
+  const char** new_rules;
+  const struct RegistryOverlay* new_overlay;
+  size_t low = 0;
+  size_t high = num_rules;
+  int found;
+
+  if (update->rule == NULL) {
+    update->result = 1;
+    return NULL;
+  }
+  while (low < high) {
+    const size_t middle = low + (high - low) / 2;
+    if (strcmp(rules[middle], update->rule) < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  found = low < num_rules && strcmp(rules[low], update->rule) == 0;
+  if (found == update->add) {
+    /* Adding a rule that is present, or removing one that is not. */
+    update->result = found;
+    return overlay;
+  }
+  if (!update->add && num_rules == 1) {
+    update->result = 1;
+    return NULL;
+  }
+
+  new_rules = (const char**) malloc((num_rules + 1) * sizeof(*new_rules));
+  if (new_rules == NULL) {
+    update->result = 0;
+    return overlay;
+  }
+  memcpy(new_rules, rules, low * sizeof(*new_rules));
+  if (update->add) {
+    new_rules[low] = update->rule;
+    memcpy(new_rules + low + 1, rules + low,
+           (num_rules - low) * sizeof(*new_rules));
+    new_overlay = BuildRegistryOverlay(new_rules, num_rules + 1);
+  } else {
+    memcpy(new_rules + low, rules + low + 1,
+           (num_rules - low - 1) * sizeof(*new_rules));
+    new_overlay = BuildRegistryOverlay(new_rules, num_rules - 1);
+  }
+  free(new_rules);
+  if (new_overlay == NULL) {
+    update->result = 0;
+    return overlay;
+  }
+  update->result = 1;
+  return new_overlay;
+}
+
+static int UpdateRegistryRules(struct DomainRegistry* registry,
+                               const char* rule,
+                               int add) {
+  char normalized[MAX_HOSTNAME_LEN + 2];
+  struct OverlayRuleUpdate update;
+
+  DCHECK(registry != NULL);
+  if (NormalizeRegistryRule(rule, normalized) == 0) {
+    return 0;
+  }
+  update.rule = normalized;
+  update.add = add;
+  update.result = 0;
+  UpdateRegistryOverlay(registry, UpdateOverlayRules, &update);
+  return update.result;
+}
+
+int DomainRegistryAddRegistryRule(struct DomainRegistry* registry,
+                                  const char* rule) {
+  return UpdateRegistryRules(registry, rule, 1);
+}
+
+int DomainRegistryRemoveRegistryRule(struct DomainRegistry* registry,
+                                     const char* rule) {
+  return UpdateRegistryRules(registry, rule, 0);
+}
+
+void DomainRegistryClearRegistryRules(struct DomainRegistry* registry) {
+  struct OverlayRuleUpdate update;
+
+  DCHECK(registry != NULL);
+  update.rule = NULL;
+  update.add = 0;
+  update.result = 0;
+  UpdateRegistryOverlay(registry, UpdateOverlayRules, &update);
+}
+
+int AddRegistryRule(const char* rule) {
+  return DomainRegistryAddRegistryRule(GetDefaultDomainRegistry(), rule);
+}
+
+int RemoveRegistryRule(const char* rule) {
+  return DomainRegistryRemoveRegistryRule(GetDefaultDomainRegistry(), rule);
+}
+
+void ClearRegistryRules(void) {
+  DomainRegistryClearRegistryRules(GetDefaultDomainRegistry());
+}
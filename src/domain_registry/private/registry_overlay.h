@@ -0,0 +1,105 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * Rules added at runtime (see AddRegistryRule in domain_registry.h),
+ * searched alongside the installed tables. These should not need to be
+ * invoked directly.
+ *
+ * An overlay is an immutable trie of hostname-parts like the one in
+ * the tables, built from scratch each time a rule is added or removed,
+ * in a single allocation. Lookups reach it through the installed
+ * tables, so replacing it is safe while other threads look up
+ * hostnames. See UpdateRegistryOverlay in registry_tables.h.
+ */
+
+#ifndef DOMAIN_REGISTRY_PRIVATE_REGISTRY_OVERLAY_H_
+#define DOMAIN_REGISTRY_PRIVATE_REGISTRY_OVERLAY_H_
+
+#include <stdlib.h>
+
+#include "domain_registry/private/registry_types.h"
+
+/* A node of the overlay trie. */
+struct RegistryOverlayNode {
+  /*
+   * Offset of the null-terminated hostname-part of this node in the
+   * labels of the overlay. Wildcard rules have the hostname-part "*".
+   * Exception rules are stored without their leading "!".
+   */
+  REGISTRY_U32 label_offset;
+
+  /*
+   * Index of the first child of this node in the nodes of the
+   * overlay. Children are adjacent, and sorted by hostname-part.
+   */
+  REGISTRY_U32 first_child;
+  REGISTRY_U32 num_children;
+
+  /* Whether a rule ends at this node. */
+  unsigned char is_terminal;
+
+  /* Whether an exception rule ends at this node. */
+  unsigned char is_exception;
+};
+
+struct RegistryOverlay {
+  /*
+   * The rules the overlay was built from, lowercased, in strcmp
+   * order, for building the next overlay.
+   */
+  const char* const* rules;
+  size_t num_rules;
+
+  /* The trie. nodes[0] is its root, which has no hostname-part. */
+  const struct RegistryOverlayNode* nodes;
+  size_t num_nodes;
+  const char* labels;
+};
+
+/*
+ * Check the rule, in the syntax of the public suffix list (e.g.
+ * "example.com", "*.example.com" or "!www.example.com"), and write it
+ * to out, lowercased and null-terminated. out must have room for
+ * MAX_HOSTNAME_LEN + 2 bytes. Returns 0 if the rule is not valid: each
+ * hostname-part must be non-empty and may only contain '*' if it is
+ * the wildcard "*", only the rule as a whole may start with '!', and
+ * the hostname-parts are subject to the same limits as hostnames.
+ */
+int NormalizeRegistryRule(const char* rule, char* out);
+
+/*
+ * Build an overlay of the num_rules normalized rules, which must be
+ * in strcmp order and distinct. The overlay keeps its own copy of the
+ * rules. Returns NULL if out of memory.
+ */
+const struct RegistryOverlay* BuildRegistryOverlay(const char* const* rules,
+                                                   size_t num_rules);
+
+/* Free an overlay returned by BuildRegistryOverlay. overlay may be NULL. */
+void FreeRegistryOverlay(const struct RegistryOverlay* overlay);
+
+/*
+ * Find the child of parent whose hostname-part is the component_len
+ * bytes at component, which need not be null-terminated. Returns NULL
+ * if there is none.
+ */
+const struct RegistryOverlayNode* FindRegistryOverlayNodeN(
+    const struct RegistryOverlay* overlay,
+    const struct RegistryOverlayNode* parent,
+    const char* component,
+    size_t component_len);
+
+#endif  /* DOMAIN_REGISTRY_PRIVATE_REGISTRY_OVERLAY_H_ */
@@ -0,0 +1,418 @@
+// Copyright 2011 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+#include <string>
+
+extern "C" {
+#include "domain_registry/domain_registry.h"
+#include "domain_registry/private/dafsa_search.h"
+#include "domain_registry/private/hostname_scanner.h"
+#include "domain_registry/private/matcher_search.h"
+#include "domain_registry/private/registry_overlay.h"
+#include "domain_registry/private/registry_tables.h"
+#include "domain_registry/private/suffix_hash_search.h"
+#include "domain_registry/private/trie_search.h"
+}  // extern "C"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+// Include the simple test tables inline.
+#include "domain_registry/testing/simple_node_table.c"
+
+namespace {
+
+std::string Normalize(const char* rule) {
+  char out[MAX_HOSTNAME_LEN + 2];
+  if (NormalizeRegistryRule(rule, out) == 0) {
+    return "(invalid)";
+  }
+  return out;
+}
+
+TEST(RegistryOverlayTest, NormalizeRegistryRule) {
+  EXPECT_EQ("example.com", Normalize("example.com"));
+  EXPECT_EQ("example.com", Normalize("EXAMPLE.Com"));
+  EXPECT_EQ("*.example.com", Normalize("*.example.com"));
+  EXPECT_EQ("!www.example.com", Normalize("!WWW.example.com"));
+  EXPECT_EQ("foo.*.example", Normalize("foo.*.example"));
+  EXPECT_EQ("com", Normalize("com"));
+
+  EXPECT_EQ("(invalid)", Normalize(NULL));
+  EXPECT_EQ("(invalid)", Normalize(""));
+  EXPECT_EQ("(invalid)", Normalize("!"));
+  EXPECT_EQ("(invalid)", Normalize(".example.com"));
+  EXPECT_EQ("(invalid)", Normalize("example.com."));
+  EXPECT_EQ("(invalid)", Normalize("example..com"));
+  EXPECT_EQ("(invalid)", Normalize("a*.example.com"));
+  EXPECT_EQ("(invalid)", Normalize("!*.example.com"));
+  EXPECT_EQ("(invalid)", Normalize("www.!example.com"));
+  EXPECT_EQ("(invalid)", Normalize("!!example.com"));
+  EXPECT_EQ("(invalid)", Normalize("exa mple.com"));
+  EXPECT_EQ("(invalid)", Normalize("b\xc3\xbc" "cher.de"));
+
+  std::string longest(MAX_HOSTNAME_LEN, 'a');
+  EXPECT_EQ(longest, Normalize(longest.c_str()));
+  EXPECT_EQ("!" + longest, Normalize(("!" + longest).c_str()));
+  EXPECT_EQ("(invalid)", Normalize((longest + "a").c_str()));
+}
+
+// Find the node for the hostname-parts of hostname, e.g. "b.a" for
+// the child "b" of the root node "a".
+const struct RegistryOverlayNode* FindNode(
+    const struct RegistryOverlay* overlay,
+    const std::string& hostname) {
+  const struct RegistryOverlayNode* node = overlay->nodes;
+  size_t end = hostname.size();
+  while (node != NULL && end > 0) {
+    size_t start = hostname.rfind('.', end - 1);
+    start = (start == std::string::npos) ? 0 : start + 1;
+    node = FindRegistryOverlayNodeN(overlay, node, hostname.data() + start,
+                                    end - start);
+    end = (start > 0) ? start - 1 : 0;
+  }
+  return node;
+}
+
+TEST(RegistryOverlayTest, BuildRegistryOverlay) {
+  const char* rules[] = {
+    "!www.example.com",
+    "*.example.com",
+    "example.net",
+    "foo.example.com",
+    "net",
+  };
+  const size_t num_rules = sizeof(rules) / sizeof(rules[0]);
+  const struct RegistryOverlay* overlay =
+      BuildRegistryOverlay(rules, num_rules);
+  ASSERT_TRUE(overlay != NULL);
+
+  ASSERT_EQ(num_rules, overlay->num_rules);
+  for (size_t i = 0; i < num_rules; ++i) {
+    EXPECT_STREQ(rules[i], overlay->rules[i]);
+    EXPECT_NE(rules[i], overlay->rules[i]);
+  }
+
+  // The root, com, net, example.com, example.net and the three
+  // children of example.com.
+  EXPECT_EQ(8, overlay->num_nodes);
+  EXPECT_EQ(2, overlay->nodes[0].num_children);
+
+  const struct RegistryOverlayNode* node = FindNode(overlay, "com");
+  ASSERT_TRUE(node != NULL);
+  EXPECT_STREQ("com", overlay->labels + node->label_offset);
+  EXPECT_FALSE(node->is_terminal);
+  EXPECT_EQ(1, node->num_children);
+
+  node = FindNode(overlay, "example.com");
+  ASSERT_TRUE(node != NULL);
+  EXPECT_FALSE(node->is_terminal);
+  EXPECT_EQ(3, node->num_children);
+
+  // Children are sorted by hostname-part.
+  const struct RegistryOverlayNode* children =
+      overlay->nodes + node->first_child;
+  EXPECT_STREQ("*", overlay->labels + children[0].label_offset);
+  EXPECT_STREQ("foo", overlay->labels + children[1].label_offset);
+  EXPECT_STREQ("www", overlay->labels + children[2].label_offset);
+
+  node = FindNode(overlay, "*.example.com");
+  ASSERT_TRUE(node != NULL);
+  EXPECT_TRUE(node->is_terminal);
+  EXPECT_FALSE(node->is_exception);
+
+  node = FindNode(overlay, "www.example.com");
+  ASSERT_TRUE(node != NULL);
+  EXPECT_FALSE(node->is_terminal);
+  EXPECT_TRUE(node->is_exception);
+  EXPECT_EQ(0, node->num_children);
+
+  node = FindNode(overlay, "net");
+  ASSERT_TRUE(node != NULL);
+  EXPECT_TRUE(node->is_terminal);
+  EXPECT_EQ(1, node->num_children);
+  EXPECT_TRUE(FindNode(overlay, "example.net")->is_terminal);
+
+  EXPECT_TRUE(FindNode(overlay, "org") == NULL);
+  EXPECT_TRUE(FindNode(overlay, "bar.example.com") == NULL);
+  EXPECT_TRUE(FindNode(overlay, "ex.com") == NULL);
+  EXPECT_TRUE(FindNode(overlay, "example.co") == NULL);
+  FreeRegistryOverlay(overlay);
+
+  overlay = BuildRegistryOverlay(NULL, 0);
+  ASSERT_TRUE(overlay != NULL);
+  EXPECT_EQ(1, overlay->num_nodes);
+  EXPECT_EQ(0, overlay->nodes[0].num_children);
+  FreeRegistryOverlay(overlay);
+  FreeRegistryOverlay(NULL);
+}
+
+// The lookup engines each test runs with. Added rules are searched in
+// the same pass as the tables of each.
+enum Engine {
+  kTrie,
+  kSuffixHash,
+  kDafsa,
+  kMatcher,
+};
+
+class RegistryRulesTest : public ::testing::TestWithParam<Engine> {
+ protected:
+  virtual void SetUp() {
+    SetRegistryTables(kSimpleStringTable,
+                      kSimpleNodeTable,
+                      kSimpleNumRootChildren,
+                      kSimpleLeafNodeTable,
+                      kSimpleLeafNodeTableOffset);
+    if (GetParam() == kSuffixHash) {
+      SetSuffixHashTable(kSimpleSuffixHashTable,
+                         kSimpleSuffixHashTableSize,
+                         kSimpleSuffixHashSeed);
+    } else if (GetParam() == kDafsa) {
+      SetDafsa(kSimpleDafsa, sizeof(kSimpleDafsa));
+    } else if (GetParam() == kMatcher) {
+      SetRegistryMatcher(SimpleMatchRegistryRule);
+    }
+  }
+
+  virtual void TearDown() {
+    ClearRegistryRules();
+    SetRegistryTables(NULL, NULL, 0, NULL, 0);
+  }
+};
+
+TEST_P(RegistryRulesTest, AddAndRemove) {
+  EXPECT_EQ(0, GetRegistryLength("www.zzz.com"));
+  EXPECT_EQ(1, AddRegistryRule("zzz.com"));
+  EXPECT_EQ(7, GetRegistryLength("www.zzz.com"));
+  EXPECT_EQ(7, GetRegistryLength("zzz.com"));
+  EXPECT_EQ(0, GetRegistryLength("com"));
+
+  // Adding a rule again changes nothing.
+  EXPECT_EQ(1, AddRegistryRule("ZZZ.com"));
+  EXPECT_EQ(7, GetRegistryLength("www.zzz.com"));
+
+  EXPECT_EQ(1, RemoveRegistryRule("zzz.COM"));
+  EXPECT_EQ(0, GetRegistryLength("www.zzz.com"));
+  EXPECT_EQ(0, RemoveRegistryRule("zzz.com"));
+  EXPECT_EQ(0, RemoveRegistryRule("*.zzz.com"));
+
+  EXPECT_EQ(0, AddRegistryRule(""));
+  EXPECT_EQ(0, AddRegistryRule("zzz..com"));
+  EXPECT_EQ(0, RemoveRegistryRule(NULL));
+
+  // The rules of the tables cannot be removed.
+  EXPECT_EQ(0, RemoveRegistryRule("foo.com"));
+  EXPECT_EQ(7, GetRegistryLength("a.foo.com"));
+}
+
+TEST_P(RegistryRulesTest, LongestRuleWins) {
+  // Rules longer than those of the tables.
+  EXPECT_EQ(1, AddRegistryRule("x.foo.com"));
+  EXPECT_EQ(9, GetRegistryLength("a.x.foo.com"));
+  EXPECT_EQ(9, GetRegistryLength("x.foo.com"));
+  EXPECT_EQ(7, GetRegistryLength("a.y.foo.com"));
+  EXPECT_EQ(1, AddRegistryRule("*.y.foo.com"));
+  EXPECT_EQ(11, GetRegistryLength("a.b.y.foo.com"));
+  EXPECT_EQ(7, GetRegistryLength("y.foo.com"));
+
+  // Rules shorter than those of the tables.
+  EXPECT_EQ(1, AddRegistryRule("com"));
+  EXPECT_EQ(7, GetRegistryLength("a.foo.com"));
+  EXPECT_EQ(3, GetRegistryLength("a.bar.com"));
+  EXPECT_EQ(1, AddRegistryRule("foo"));
+  EXPECT_EQ(11, GetRegistryLength("www.zzz.bar.foo"));
+  EXPECT_EQ(7, GetRegistryLength("zzz.foo"));
+  EXPECT_EQ(3, GetRegistryLength("foo"));
+
+  // Rules under roots the tables do not have.
+  EXPECT_EQ(0, GetRegistryLength("a.b.example"));
+  EXPECT_EQ(1, AddRegistryRule("*.example"));
+  EXPECT_EQ(9, GetRegistryLength("a.b.example"));
+  EXPECT_EQ(9, GetRegistryLength("b.example"));
+  EXPECT_EQ(0, GetRegistryLength("example"));
+  EXPECT_EQ(9, GetRegistryLengthAllowUnknownRegistries("a.b.example"));
+  EXPECT_EQ(8, GetRegistryLengthAllowUnknownRegistries("a.example2"));
+
+  // The wildcard matches where a longer rule does not end.
+  EXPECT_EQ(1, AddRegistryRule("a.c.example"));
+  EXPECT_EQ(9, GetRegistryLength("x.c.example"));
+  EXPECT_EQ(11, GetRegistryLength("x.a.c.example"));
+}
+
+TEST_P(RegistryRulesTest, ExceptionRules) {
+  EXPECT_EQ(1, AddRegistryRule("*.example"));
+  EXPECT_EQ(1, AddRegistryRule("!www.example"));
+  EXPECT_EQ(7, GetRegistryLength("www.example"));
+  EXPECT_EQ(7, GetRegistryLength("a.www.example"));
+  EXPECT_EQ(11, GetRegistryLength("a.wwx.example"));
+
+  // An exception rule wins over a wildcard rule of the tables of the
+  // same length.
+  EXPECT_EQ(7, GetRegistryLength("qux.foo"));
+  EXPECT_EQ(1, AddRegistryRule("!qux.foo"));
+  EXPECT_EQ(3, GetRegistryLength("qux.foo"));
+  EXPECT_EQ(7, GetRegistryLength("quy.foo"));
+
+  struct RegistryInfo info;
+  EXPECT_EQ(1, GetRegistryInfo("qux.foo", &info));
+  EXPECT_EQ(4, info.registry_offset);
+  EXPECT_EQ(3, info.registry_len);
+  EXPECT_EQ(0, info.registrable_domain_offset);
+
+  // But not over a longer rule of the tables.
+  EXPECT_EQ(11, GetRegistryLength("www.qux.foo"));
+  EXPECT_FALSE(info.is_wildcard_rule);
+  EXPECT_TRUE(info.is_exception_rule);
+
+  EXPECT_EQ(1, GetRegistryInfo("www.b.example", &info));
+  EXPECT_EQ(4, info.registry_offset);
+  EXPECT_TRUE(info.is_wildcard_rule);
+  EXPECT_FALSE(info.is_exception_rule);
+}
+
+TEST_P(RegistryRulesTest, OtherLookups) {
+  EXPECT_EQ(1, AddRegistryRule("x.foo.com"));
+  const char* hostnames[] = { "a.x.foo.com", "a.foo.com", "a.x.bar.com" };
+  size_t registry_lens[3];
+  GetRegistryLengthBatch(hostnames, NULL, 3, registry_lens);
+  EXPECT_EQ(9, registry_lens[0]);
+  EXPECT_EQ(7, registry_lens[1]);
+  EXPECT_EQ(0, registry_lens[2]);
+
+  // Added rules are PRIVATE rules.
+  SetNodeSectionTables(kSimpleNodeSectionTable, kSimpleLeafSectionTable);
+  size_t icann_len;
+  size_t private_len;
+  GetRegistryLengths("a.x.foo.com", &icann_len, &private_len);
+  EXPECT_EQ(7, icann_len);
+  EXPECT_EQ(9, private_len);
+
+  EXPECT_EQ(9, GetRegistryLengthUtf8("\xc3\xbc.x.foo.com"));
+
+  struct RegistryInfo info;
+  const char kUrl[] = "https://a.x.foo.com/";
+  EXPECT_EQ(1, GetRegistryInfoForUrl(kUrl, sizeof(kUrl) - 1, &info));
+  EXPECT_EQ(10, info.registry_offset);
+  EXPECT_EQ(9, info.registry_len);
+}
+
+TEST_P(RegistryRulesTest, KeptWhenTablesChange) {
+  EXPECT_EQ(1, AddRegistryRule("x.foo.com"));
+  SetNodeFingerprintTables(kSimpleNodeFingerprintTable,
+                           kSimpleLeafFingerprintTable);
+  EXPECT_EQ(9, GetRegistryLength("a.x.foo.com"));
+
+  SetRegistryTables(NULL, NULL, 0, NULL, 0);
+  EXPECT_EQ(9, GetRegistryLength("a.x.foo.com"));
+  EXPECT_EQ(0, GetRegistryLength("a.foo.com"));
+
+  ClearRegistryRules();
+  EXPECT_EQ(0, GetRegistryLength("a.x.foo.com"));
+  ClearRegistryRules();
+}
+
+TEST_P(RegistryRulesTest, Registries) {
+  struct DomainRegistry* registry = NewDomainRegistry();
+  ASSERT_TRUE(registry != NULL);
+  EXPECT_EQ(1, DomainRegistryAddRegistryRule(registry, "example"));
+  EXPECT_EQ(1, DomainRegistryAddRegistryRule(registry, "*.example.com"));
+  EXPECT_EQ(7, DomainRegistryGetRegistryLength(registry, "a.example"));
+  EXPECT_EQ(0, DomainRegistryGetRegistryLength(registry, "a.foo.com"));
+  EXPECT_EQ(0, GetRegistryLength("a.example"));
+
+  EXPECT_EQ(1, DomainRegistryRemoveRegistryRule(registry, "example"));
+  EXPECT_EQ(0, DomainRegistryGetRegistryLength(registry, "a.example"));
+  EXPECT_EQ(13, DomainRegistryGetRegistryLength(registry, "a.b.example.com"));
+  DomainRegistryClearRegistryRules(registry);
+  EXPECT_EQ(0, DomainRegistryGetRegistryLength(registry, "a.b.example.com"));
+
+  // The added rules are freed with the registry.
+  EXPECT_EQ(1, DomainRegistryAddRegistryRule(registry, "example"));
+  DestroyDomainRegistry(registry);
+}
+
+TEST_P(RegistryRulesTest, Generation) {
+  const unsigned generation = AcquireRegistryTables(
+      GetDefaultDomainRegistry())->generation;
+  ReleaseRegistryTables();
+
+  // Results cached before the rules change are not used after.
+  EXPECT_EQ(7, GetRegistryLength("a.x.foo.com"));
+  EXPECT_EQ(1, AddRegistryRule("x.foo.com"));
+  EXPECT_NE(generation, AcquireRegistryTables(
+      GetDefaultDomainRegistry())->generation);
+  ReleaseRegistryTables();
+  EXPECT_EQ(9, GetRegistryLength("a.x.foo.com"));
+}
+
+INSTANTIATE_TEST_CASE_P(Engines, RegistryRulesTest,
+                        ::testing::Values(kTrie, kSuffixHash, kDafsa,
+                                          kMatcher));
+
+#if !defined(_WIN32)
+
+const int kNumLookupThreads = 4;
+const int kNumUpdates = 2000;
+
+volatile int g_stop = 0;
+
+void* LookupThread(void* arg) {
+  int* num_errors = static_cast<int*>(arg);
+  while (!__sync_fetch_and_add(&g_stop, 0)) {
+    if (GetRegistryLength("a.foo.com") != 7) ++*num_errors;
+    size_t len = GetRegistryLength("a.x.foo.com");
+    if (len != 9 && len != 7) ++*num_errors;
+    len = GetRegistryLength("a.zzz.example");
+    if (len != 11 && len != 0) ++*num_errors;
+  }
+  return NULL;
+}
+
+TEST(RegistryRulesThreadTest, UpdateDuringLookups) {
+  SetRegistryTables(kSimpleStringTable,
+                    kSimpleNodeTable,
+                    kSimpleNumRootChildren,
+                    kSimpleLeafNodeTable,
+                    kSimpleLeafNodeTableOffset);
+  g_stop = 0;
+  pthread_t threads[kNumLookupThreads];
+  int num_errors[kNumLookupThreads] = { 0 };
+  for (int i = 0; i < kNumLookupThreads; ++i) {
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, LookupThread,
+                                &num_errors[i]));
+  }
+  for (int i = 0; i < kNumUpdates; ++i) {
+    if (i % 2 == 0) {
+      EXPECT_EQ(1, AddRegistryRule("x.foo.com"));
+      EXPECT_EQ(1, AddRegistryRule("*.example"));
+    } else {
+      EXPECT_EQ(1, RemoveRegistryRule("x.foo.com"));
+      ClearRegistryRules();
+    }
+  }
+  __sync_fetch_and_add(&g_stop, 1);
+  for (int i = 0; i < kNumLookupThreads; ++i) {
+    pthread_join(threads[i], NULL);
+    EXPECT_EQ(0, num_errors[i]);
+  }
+  SetRegistryTables(NULL, NULL, 0, NULL, 0);
+}
+
+#endif  // !defined(_WIN32)
+
+}  // namespace
@@ -19,23 +19,27 @@
 #include <string.h>
 
 #include "domain_registry/private/assert.h"
+#include "domain_registry/private/dafsa_search.h"
+#include "domain_registry/private/hostname_scanner.h"
+#include "domain_registry/private/matcher_search.h"
+#include "domain_registry/private/punycode.h"
+#include "domain_registry/private/registry_overlay.h"
+#include "domain_registry/private/registry_stats.h"
+#include "domain_registry/private/registry_tables.h"
+#include "domain_registry/private/result_cache.h"
 #include "domain_registry/private/string_util.h"
+#include "domain_registry/private/suffix_hash_search.h"
 #include "domain_registry/private/trie_search.h"
+#include "domain_registry/private/url_host.h"
 
-/* RFCs 1035 and 1123 specify a max hostname length of 255 bytes. */
-static const size_t kMaxHostnameLen = 255;
+static const size_t kMaxHostnameLen = MAX_HOSTNAME_LEN;
 
-/* strdup() is not part of ANSI C89 so we define our own. */
-static char* StrDup(const char* s) {
-  const size_t len = strlen(s);
-  char* s2 = malloc(len + 1);
-  if (s2 == NULL) {
-    return NULL;
-  }
-  memcpy(s2, s, len);
-  s2[len] = 0;
-  return s2;
-}
+/*
+ * Number of lookups GetRegistryLengthBatch advances in lock-step. Large
+ * enough to keep many independent cache misses in flight, small enough
+ * that the lookup state stays in L1.
+ */
+#define BATCH_WINDOW_SIZE 16
 
 /* strnlen() is not part of ANSI C89 so we define our own. */
 static size_t StrnLen(const char* s, size_t max) {
@@ -47,205 +51,603 @@ static size_t StrnLen(const char* s, size_t max) {
   return i - s;
 }
 
-static int IsStringASCII(const char* s) {
-  const char* it = s;
-  for (; *it != 0; ++it) {
-    unsigned const char unsigned_char = *it;
-    if (unsigned_char > 0x7f) {
-      return 0;
-    }
+/*
+ * Iterates the hostname-parts of a scanned hostname in reverse
+ * order. For instance if the hostname is "foo.bar.com", we will return
+ * a pointer to "com", then "bar", then "foo". Rather than scanning the
+ * hostname for separators again, uses the separator offsets found by
+ * ScanHostname.
+ */
+struct HostnamePartIterator {
+  const char* hostname;
+  const unsigned char* separators;
+
+  /* Offset of the first character after any leading separators. */
+  size_t start;
+
+  /* Offset one past the end of the next hostname-part. */
+  size_t end;
+
+  /*
+   * Number of separators not yet visited. Separators before start
+   * are never visited.
+   */
+  size_t num_separators;
+  size_t num_leading_separators;
+};
+
+static void StartHostnamePartIterator(struct HostnamePartIterator* it,
+                                      const char* hostname,
+                                      size_t hostname_len,
+                                      const unsigned char* separators,
+                                      size_t num_separators) {
+  size_t num_leading = 0;
+
+  /* Skip over leading separators. */
+  while (num_leading < num_separators &&
+         separators[num_leading] == num_leading) {
+    ++num_leading;
   }
-  return 1;
-}
+  it->hostname = hostname;
+  it->separators = separators;
+  it->start = num_leading;
+  it->end = hostname_len;
+  it->num_separators = num_separators;
+  it->num_leading_separators = num_leading;
 
-static int IsValidHostname(const char* hostname) {
   /*
-   * http://www.ietf.org/rfc/rfc1035.txt (DNS) and
-   * http://tools.ietf.org/html/rfc1123 (Internet host requirements)
-   * specify a maximum hostname length of 255 characters. To make sure
-   * string comparisons, etc are bounded elsewhere in the codebase, we
-   * enforce the 255 character limit here. There are various other
-   * hostname constraints specified in the RFCs (63 bytes per
-   * hostname-part, etc) but we do not enforce those here since doing
-   * so would not change correctness of the overall implementation,
-   * and it's possible that hostnames used in other contexts
-   * (e.g. outside of DNS) would not be subject to the 63-byte
-   * hostname-part limit. So we let the DNS layer enforce its policy,
-   * and enforce only the maximum hostname length here.
+   * Special case: a single trailing dot indicates a fully-qualified
+   * domain name. Skip over it.
    */
-  if (StrnLen(hostname, kMaxHostnameLen + 1) > kMaxHostnameLen) {
+  if (num_separators > num_leading &&
+      separators[num_separators - 1] == hostname_len - 1) {
+    it->end = hostname_len - 1;
+    it->num_separators = num_separators - 1;
+  }
+}
+
+/*
+ * Returns the number of hostname-parts an iterator started with the
+ * same arguments would visit, if all of them are valid.
+ */
+static size_t CountHostnameParts(const char* hostname,
+                                 size_t hostname_len,
+                                 const unsigned char* separators,
+                                 size_t num_separators) {
+  struct HostnamePartIterator it;
+  StartHostnamePartIterator(
+      &it, hostname, hostname_len, separators, num_separators);
+  if (it.end <= it.start) {
     return 0;
   }
+  return it.num_separators - it.num_leading_separators + 1;
+}
+
+/*
+ * Returns the next hostname-part and stores its length in part_len,
+ * or returns NULL if there are no more valid hostname-parts.
+ */
+static const char* GetNextHostnamePart(struct HostnamePartIterator* it,
+                                       size_t* part_len) {
+  const char* hostname_part;
+  if (it->num_separators > it->num_leading_separators) {
+    const size_t sep = it->separators[--it->num_separators];
+    hostname_part = it->hostname + sep + 1;
+    *part_len = it->end - (sep + 1);
+    it->end = sep;
+  } else if (it->end > it->start) {
+    /* Visit the first hostname-part. */
+    hostname_part = it->hostname + it->start;
+    *part_len = it->end - it->start;
+    it->end = it->start;
+  } else {
+    return NULL;
+  }
+  if (IsInvalidComponent(hostname_part, *part_len)) {
+    COUNT_REGISTRY_STAT(rejected_invalid_component);
+    return NULL;
+  }
+  return hostname_part;
+}
+
+/* The tables a registry lookup searches. */
+enum RegistryEngine {
+  REGISTRY_ENGINE_TRIE,
+  REGISTRY_ENGINE_SUFFIX_HASH,
+  REGISTRY_ENGINE_DAFSA,
+  REGISTRY_ENGINE_MATCHER
+};
+
+/*
+ * State of a single registry lookup. A lookup visits one
+ * hostname-part per call to StepRegistryLookup, which lets
+ * GetRegistryLengthBatch advance many lookups in lock-step.
+ */
+struct RegistryLookup {
+  /* The tables to search. */
+  const struct RegistryTables* tables;
+
+  /* The hostname, without leading separators. */
+  const char* value;
+  const char* value_end;
+
+  struct HostnamePartIterator parts;
+
+  /* The hostname-part to search for in the next step. */
+  const char* component;
+  size_t component_len;
 
   /*
-   * All hostnames must contain only ASCII characters. If a hostname
-   * is passed in that contains non-ASCII (e.g. an IDN that hasn't been
-   * converted to ASCII via punycode) we want to reject it outright.
+   * The node that matched in the previous step, or NULL if the next
+   * step searches the root.
    */
-  if (IsStringASCII(hostname) == 0) {
-    return 0;
+  const struct TrieNode* current;
+
+  enum RegistryEngine engine;
+
+  /*
+   * The suffix hash entry that matched in the previous step, or NULL
+   * if the next step searches the root.
+   */
+  const struct SuffixHashEntry* current_entry;
+
+  /*
+   * The DAFSA node that matched in the previous step, if
+   * has_dafsa_node is set.
+   */
+  struct DafsaNode dafsa_node;
+  int has_dafsa_node;
+
+  /*
+   * The matcher node that matched in the previous step, if
+   * has_matcher_node is set.
+   */
+  struct MatcherNode matcher_node;
+  int has_matcher_node;
+
+  /*
+   * The start of the longest matching registry found so far, and
+   * whether the rule that matched it is a wildcard or an exception
+   * rule. last_valid_rule is the start of the hostname-part the rule
+   * ended at, which for an exception rule is before the registry.
+   */
+  const char* last_valid;
+  const char* last_valid_rule;
+  int last_valid_is_wildcard;
+  int last_valid_is_exception;
+
+  /* Whether the tables cannot match a longer rule. */
+  int tables_done;
+
+  /*
+   * The overlay node that matched in the previous step, starting at
+   * the root of the overlay, or NULL once the overlay cannot match a
+   * longer rule. The longest rule the overlay matched so far is kept
+   * apart from that of the tables until the lookup is done, like
+   * last_valid.
+   */
+  const struct RegistryOverlayNode* overlay_node;
+  const char* overlay_last_valid;
+  const char* overlay_last_valid_rule;
+  int overlay_last_valid_is_wildcard;
+  int overlay_last_valid_is_exception;
+
+  /*
+   * The rootmost hostname-part, if it is not in the table. Used to
+   * support unknown registries.
+   */
+  const char* unknown_registry;
+
+  /*
+   * If find_icann is set, icann_last_valid is the start of the longest
+   * registry found so far under the ICANN rules alone, and icann_done
+   * is set once no longer one can be found. Only supported by the trie
+   * engine.
+   */
+  int find_icann;
+  int icann_done;
+  const char* icann_last_valid;
+
+  int done;
+};
+
+/*
+ * Iterate over all hostname-parts of the scanned hostname, which must
+ * already be lowercase. Visits the hostname components one at a time,
+ * e.g. if hostname is foo.com, we will first visit component com, then
+ * component foo.
+ */
+static void StartRegistryLookup(struct RegistryLookup* lookup,
+                                const struct RegistryTables* tables,
+                                const char* hostname,
+                                size_t hostname_len,
+                                const unsigned char* separators,
+                                size_t num_separators) {
+  StartHostnamePartIterator(
+      &lookup->parts, hostname, hostname_len, separators, num_separators);
+  lookup->tables = tables;
+  lookup->value = hostname + lookup->parts.start;
+  lookup->value_end = hostname + hostname_len;
+  lookup->current = NULL;
+  if (HasRegistryMatcher(tables)) {
+    lookup->engine = REGISTRY_ENGINE_MATCHER;
+  } else if (HasDafsa(tables)) {
+    lookup->engine = REGISTRY_ENGINE_DAFSA;
+  } else if (HasSuffixHashTable(tables)) {
+    lookup->engine = REGISTRY_ENGINE_SUFFIX_HASH;
+  } else {
+    lookup->engine = REGISTRY_ENGINE_TRIE;
   }
+  lookup->current_entry = NULL;
+  lookup->has_dafsa_node = 0;
+  lookup->has_matcher_node = 0;
+  lookup->last_valid = NULL;
+  lookup->last_valid_rule = NULL;
+  lookup->last_valid_is_wildcard = 0;
+  lookup->last_valid_is_exception = 0;
+  /*
+   * Without tables installed, only the rules added at runtime are
+   * searched.
+   */
+  lookup->tables_done = (lookup->engine == REGISTRY_ENGINE_TRIE &&
+                         tables->node_table == NULL);
+  lookup->overlay_node =
+      (tables->overlay != NULL) ? tables->overlay->nodes : NULL;
+  lookup->overlay_last_valid = NULL;
+  lookup->overlay_last_valid_rule = NULL;
+  lookup->overlay_last_valid_is_wildcard = 0;
+  lookup->overlay_last_valid_is_exception = 0;
+  lookup->unknown_registry = NULL;
+  lookup->find_icann = 0;
+  lookup->icann_done = 0;
+  lookup->icann_last_valid = NULL;
+  lookup->component =
+      GetNextHostnamePart(&lookup->parts, &lookup->component_len);
+  lookup->done = (lookup->component == NULL);
+}
 
-  return 1;
+/*
+ * Record that a rule ends at the node that matched lookup->component.
+ * The registry starts at the component, or, for an exception rule, at
+ * the hostname-part after it.
+ */
+static void SetMatchingRule(struct RegistryLookup* lookup,
+                            int is_wildcard,
+                            int is_exception) {
+  if (is_exception) {
+    lookup->last_valid = lookup->component + lookup->component_len + 1;
+  } else {
+    lookup->last_valid = lookup->component;
+  }
+  lookup->last_valid_rule = lookup->component;
+  lookup->last_valid_is_wildcard = is_wildcard;
+  lookup->last_valid_is_exception = is_exception;
 }
 
 /*
- * Get a pointer to the beginning of the valid registry. If rule_part
- * is an exception component, this will seek past the
- * rule_part. Otherwise this will simply return the component itself.
+ * Like StepTrieLookup, but finds each suffix of the hostname with a
+ * single probe of the suffix hash table instead of searching the
+ * children of the previous node.
  */
-static const char* GetDomainRegistryStr(const char* rule_part,
-                                        const char* component) {
-  if (IsExceptionComponent(rule_part)) {
-    return component + strlen(component) + 1;
+static void StepSuffixHashLookup(struct RegistryLookup* lookup) {
+  const struct SuffixHashEntry* parent = lookup->current_entry;
+  const struct SuffixHashEntry* entry = FindSuffixHashEntryN(
+      lookup->tables, lookup->component, lookup->component_len, parent);
+  if (entry == NULL) {
+    if (parent == NULL) {
+      lookup->unknown_registry = lookup->component;
+    }
+    lookup->tables_done = 1;
+    return;
+  }
+  if (entry->is_terminal == 1) {
+    SetMatchingRule(
+        lookup,
+        IsWildcardComponent(
+            GetHostnamePart(lookup->tables, entry->string_table_offset)),
+        entry->is_exception);
   } else {
-    return component;
+    lookup->last_valid = NULL;
+  }
+  lookup->current_entry = entry;
+  if (entry->has_children == 0) {
+    lookup->tables_done = 1;
   }
 }
 
 /*
- * Iterates the hostname-parts between start and end in reverse order,
- * separated by the character specified by sep. For instance if the
- * string between start and end is "foo\0bar\0com" and sep is the null
- * character, we will return a pointer to "com", then "bar", then
- * "foo".
+ * Like StepSuffixHashLookup, but matches each hostname-part against
+ * the DAFSA, character by character.
  */
-static const char* GetNextHostnamePartImpl(const char* start,
-                                           const char* end,
-                                           char sep,
-                                           void** ctx) {
-  const char* last;
-  const char* i;
+static void StepDafsaLookup(struct RegistryLookup* lookup) {
+  const struct DafsaNode* parent =
+      lookup->has_dafsa_node ? &lookup->dafsa_node : NULL;
+  struct DafsaNode node;
+  if (FindDafsaNodeN(lookup->tables, lookup->component,
+                     lookup->component_len, parent, &node) == 0) {
+    if (parent == NULL) {
+      lookup->unknown_registry = lookup->component;
+    }
+    lookup->tables_done = 1;
+    return;
+  }
+  if (node.is_terminal) {
+    SetMatchingRule(lookup, node.is_wildcard, node.is_exception);
+  } else {
+    lookup->last_valid = NULL;
+  }
+  lookup->dafsa_node = node;
+  lookup->has_dafsa_node = 1;
+  if (node.has_children == 0) {
+    lookup->tables_done = 1;
+  }
+}
 
-  if (*ctx == NULL) {
-    *ctx = (void*) end;
+/*
+ * Like StepDafsaLookup, but matches each hostname-part with the
+ * generated matcher.
+ */
+static void StepMatcherLookup(struct RegistryLookup* lookup) {
+  const struct MatcherNode* parent =
+      lookup->has_matcher_node ? &lookup->matcher_node : NULL;
+  struct MatcherNode node;
+  if (FindMatcherNodeN(lookup->tables, lookup->component,
+                       lookup->component_len, parent, &node) == 0) {
+    if (parent == NULL) {
+      lookup->unknown_registry = lookup->component;
+    }
+    lookup->tables_done = 1;
+    return;
+  }
+  if (node.is_terminal) {
+    SetMatchingRule(lookup, node.is_wildcard, node.is_exception);
+  } else {
+    lookup->last_valid = NULL;
+  }
+  lookup->matcher_node = node;
+  lookup->has_matcher_node = 1;
+  if (node.has_children == 0) {
+    lookup->tables_done = 1;
+  }
+}
+
+/*
+ * Update the registry found under the ICANN rules alone, once the trie
+ * search has matched lookup->component to a node in the given section
+ * and updated lookup->last_valid. The search of the ICANN rules
+ * follows the same nodes until it reaches one that only PRIVATE rules
+ * pass through, after which it would have stopped.
+ */
+static void UpdateIcannRegistry(struct RegistryLookup* lookup,
+                                enum NodeSection section) {
+  if (lookup->icann_done) {
+    return;
+  }
+  switch (section) {
+    case NODE_SECTION_ICANN:
+      lookup->icann_last_valid = lookup->last_valid;
+      break;
+    case NODE_SECTION_ICANN_NOT_TERMINAL:
+      lookup->icann_last_valid = NULL;
+      break;
+    case NODE_SECTION_PRIVATE_ICANN_WILDCARD:
+      /* The ICANN wildcard matches the hostname-part, and is a leaf. */
+      lookup->icann_last_valid = lookup->component;
+      lookup->icann_done = 1;
+      break;
+    default:
+      lookup->icann_done = 1;
+      break;
+  }
+}
 
+static void StepTrieLookup(struct RegistryLookup* lookup) {
+  const struct RegistryTables* tables = lookup->tables;
+  const struct TrieNode* parent = lookup->current;
+
+  if (parent != NULL && HasLeafChildren(tables, parent)) {
     /*
-     * Special case: a single trailing dot indicates a fully-qualified
-     * domain name. Skip over it.
+     * The child nodes are in the leaf node table, so perform a
+     * search in that table. Leaf nodes have no children, so this is
+     * the last step.
      */
-    if (end > start && *(end - 1) == sep) {
-      *ctx = (void*) (end - 1);
+    const TrieLeafNode* leaf_node = FindRegistryLeafNodeEntryN(
+        tables, lookup->component, lookup->component_len, parent);
+    if (leaf_node != NULL) {
+      const char* rule_part = GetHostnamePart(tables, *leaf_node);
+      COUNT_REGISTRY_STAT(leaf_table_hits);
+      SetMatchingRule(lookup, IsWildcardComponent(rule_part),
+                      IsExceptionComponent(rule_part));
+      if (lookup->find_icann) {
+        UpdateIcannRegistry(lookup, GetLeafNodeSection(tables, leaf_node));
+      }
     }
+    lookup->tables_done = 1;
+    return;
   }
-  last = *ctx;
-  if (start > last) return NULL;
-  for (i = last - 1; i >= start; --i) {
-    if (*i == sep) {
-      *ctx = (void*) i;
-      return i + 1;
+
+  lookup->current = FindRegistryNodeN(
+      tables, lookup->component, lookup->component_len, parent);
+  if (lookup->current == NULL) {
+    if (parent == NULL) {
+      lookup->unknown_registry = lookup->component;
     }
+    lookup->tables_done = 1;
+    return;
   }
-  if (last != start && *start != 0) {
-    /*
-     * Special case: If we didn't find a match, but the context
-     * indicates that we haven't visited the first component yet, and
-     * there is a non-NULL first component, then visit the first
-     * component.
-     */
-    *ctx = (void*) start;
-    return start;
+  if (IsTrieNodeTerminal(lookup->current)) {
+    const char* rule_part = GetHostnamePart(
+        tables, GetTrieNodeStringTableOffset(lookup->current));
+    SetMatchingRule(lookup, IsWildcardComponent(rule_part),
+                    IsExceptionComponent(rule_part));
+  } else {
+    lookup->last_valid = NULL;
+  }
+  if (lookup->find_icann) {
+    UpdateIcannRegistry(lookup, GetNodeSection(tables, lookup->current));
   }
-  return NULL;
 }
 
-static const char* GetNextHostnamePart(const char* start,
-                                       const char* end,
-                                       char sep,
-                                       void** ctx) {
-  const char* hostname_part = GetNextHostnamePartImpl(start, end, sep, ctx);
-  if (IsInvalidComponent(hostname_part)) {
-    return NULL;
+/* Like SetMatchingRule, for a rule of the overlay. */
+static void SetOverlayMatchingRule(struct RegistryLookup* lookup,
+                                   int is_wildcard,
+                                   int is_exception) {
+  if (is_exception) {
+    lookup->overlay_last_valid =
+        lookup->component + lookup->component_len + 1;
+  } else {
+    lookup->overlay_last_valid = lookup->component;
   }
-  return hostname_part;
+  lookup->overlay_last_valid_rule = lookup->component;
+  lookup->overlay_last_valid_is_wildcard = is_wildcard;
+  lookup->overlay_last_valid_is_exception = is_exception;
 }
 
 /*
- * Iterate over all hostname-parts between value and value_end, where
- * the hostname-parts are separated by character sep.
+ * Match lookup->component against the children of the overlay node
+ * that matched in the previous step. Unlike the tables, the overlay
+ * keeps the longest rule found so far when it reaches a node no rule
+ * ends at, and a wildcard sibling of the node that matched also
+ * matches the hostname-part.
  */
-static const char* GetRegistryForHostname(const char* value,
-                                          const char* value_end,
-                                          const char sep) {
-  void *ctx = NULL;
-  const struct TrieNode* current = NULL;
-  const char* component = NULL;
-  const char* last_valid = NULL;
-
-  /*
-   * Iterate over the hostname components one at a time, e.g. if value
-   * is foo.com, we will first visit component com, then component foo.
-   */
-  while ((component =
-          GetNextHostnamePart(value, value_end, sep, &ctx)) != NULL) {
-    const char* leaf_node;
+static void StepOverlayLookup(struct RegistryLookup* lookup) {
+  const struct RegistryOverlay* overlay = lookup->tables->overlay;
+  const struct RegistryOverlayNode* parent = lookup->overlay_node;
+  const struct RegistryOverlayNode* wildcard =
+      FindRegistryOverlayNodeN(overlay, parent, "*", 1);
+  const struct RegistryOverlayNode* node = FindRegistryOverlayNodeN(
+      overlay, parent, lookup->component, lookup->component_len);
 
-    current = FindRegistryNode(component, current);
-    if (current == NULL) {
-      break;
-    }
-    if (current->is_terminal == 1) {
-      last_valid = GetDomainRegistryStr(
-          GetHostnamePart(current->string_table_offset), component);
-    } else {
-      last_valid = NULL;
+  if (wildcard != NULL && wildcard->is_terminal) {
+    SetOverlayMatchingRule(lookup, 1, 0);
+  }
+  if (node == NULL) {
+    node = wildcard;
+  }
+  if (node != NULL && node != wildcard) {
+    if (node->is_exception) {
+      SetOverlayMatchingRule(lookup, 0, 1);
+    } else if (node->is_terminal) {
+      SetOverlayMatchingRule(lookup, 0, 0);
     }
-    if (HasLeafChildren(current)) {
-      /*
-       * The child nodes are in the leaf node table, so perform a
-       * search in that table.
-       */
-      component = GetNextHostnamePart(value, value_end, sep, &ctx);
-      if (component == NULL) {
+  }
+  lookup->overlay_node =
+      (node != NULL && node->num_children > 0) ? node : NULL;
+}
+
+/*
+ * Use the rule the overlay matched if it is longer than the one the
+ * tables matched. Of two rules of the same length, the exception rule
+ * wins; otherwise both give the same registry.
+ */
+static void FinishOverlayLookup(struct RegistryLookup* lookup) {
+  if (lookup->overlay_last_valid_rule == NULL) {
+    return;
+  }
+  if (lookup->last_valid == NULL ||
+      lookup->overlay_last_valid_rule < lookup->last_valid_rule ||
+      (lookup->overlay_last_valid_rule == lookup->last_valid_rule &&
+       lookup->overlay_last_valid_is_exception)) {
+    lookup->last_valid = lookup->overlay_last_valid;
+    lookup->last_valid_rule = lookup->overlay_last_valid_rule;
+    lookup->last_valid_is_wildcard = lookup->overlay_last_valid_is_wildcard;
+    lookup->last_valid_is_exception =
+        lookup->overlay_last_valid_is_exception;
+  }
+}
+
+/*
+ * Match lookup->component against the tables and the overlay, then
+ * move on to the next hostname-part, until neither can match a longer
+ * rule.
+ */
+static void StepRegistryLookup(struct RegistryLookup* lookup) {
+  DCHECK(lookup->done == 0);
+  COUNT_REGISTRY_STAT(labels_visited);
+  if (lookup->tables_done == 0) {
+    switch (lookup->engine) {
+      case REGISTRY_ENGINE_SUFFIX_HASH:
+        StepSuffixHashLookup(lookup);
         break;
-      }
-      leaf_node = FindRegistryLeafNode(component, current);
-      if (leaf_node == NULL) {
+      case REGISTRY_ENGINE_DAFSA:
+        StepDafsaLookup(lookup);
+        break;
+      case REGISTRY_ENGINE_MATCHER:
+        StepMatcherLookup(lookup);
+        break;
+      default:
+        StepTrieLookup(lookup);
         break;
-      }
-      return GetDomainRegistryStr(leaf_node, component);
     }
   }
+  if (lookup->overlay_node != NULL) {
+    StepOverlayLookup(lookup);
+  }
+  if (lookup->tables_done == 0 || lookup->overlay_node != NULL) {
+    lookup->component =
+        GetNextHostnamePart(&lookup->parts, &lookup->component_len);
+  }
+  if ((lookup->tables_done != 0 && lookup->overlay_node == NULL) ||
+      lookup->component == NULL) {
+    lookup->done = 1;
+    FinishOverlayLookup(lookup);
+  }
+}
 
-  return last_valid;
+/*
+ * Prefetch the table entries the next step of lookup will visit
+ * first.
+ */
+static void PrefetchRegistryLookup(const struct RegistryLookup* lookup) {
+  if (lookup->tables_done != 0) {
+    return;
+  }
+  switch (lookup->engine) {
+    case REGISTRY_ENGINE_SUFFIX_HASH:
+      PrefetchSuffixHashEntry(lookup->tables,
+                              lookup->component,
+                              lookup->component_len,
+                              lookup->current_entry);
+      break;
+    case REGISTRY_ENGINE_DAFSA:
+      /*
+       * The next step continues from where the previous one left
+       * off, which is already in cache.
+       */
+      break;
+    case REGISTRY_ENGINE_MATCHER:
+      /* The matcher is code, and loads no tables. */
+      break;
+    default:
+      PrefetchRegistryNodeChildren(lookup->tables, lookup->current);
+      break;
+  }
+}
+
+/*
+ * Prefetch the strings the next step of lookup will compare against
+ * first. Must be called after PrefetchRegistryLookup.
+ */
+static void PrefetchRegistryLookupStrings(
+    const struct RegistryLookup* lookup) {
+  if (lookup->engine == REGISTRY_ENGINE_TRIE && lookup->tables_done == 0) {
+    PrefetchRegistryNodeChildStrings(lookup->tables, lookup->current);
+  }
 }
 
-static size_t GetRegistryLengthImpl(
-    const char* value,
-    const char* value_end,
-    const char sep,
-    int allow_unknown_registries) {
-  const char* registry;
+/*
+ * Returns the length of the registry that starts at registry, within
+ * the hostname of the finished lookup, or 0 if registry is NULL.
+ */
+static size_t GetRegistryMatchLength(const struct RegistryLookup* lookup,
+                                     const char* registry) {
+  const char* const value = lookup->value;
+  const char* const value_end = lookup->value_end;
   size_t match_len;
 
-  while (*value == sep && value < value_end) {
-    /* Skip over leading separators. */
-    ++value;
-  }
-  registry = GetRegistryForHostname(value, value_end, sep);
+  DCHECK(lookup->done != 0);
   if (registry == NULL) {
-    /*
-     * Didn't find a match. If unknown registries are allowed, see if
-     * the root hostname part is not in the table. If so, consider it to be a
-     * valid registry, and return its length.
-     */
-    if (allow_unknown_registries != 0) {
-      void* ctx = NULL;
-      const char* root_hostname_part =
-          GetNextHostnamePart(value, value_end, sep, &ctx);
-      /*
-       * See if the root hostname-part is in the table. If it's not in
-       * the table, then consider the unknown registry to be a valid
-       * registry.
-       */
-      if (root_hostname_part != NULL &&
-          FindRegistryNode(root_hostname_part, NULL) == NULL) {
-        registry = root_hostname_part;
-      }
-    }
-    if (registry == NULL) {
-      return 0;
-    }
+    return 0;
   }
   if (registry < value || registry >= value_end) {
     /* Error cases. */
@@ -257,68 +659,511 @@ static size_t GetRegistryLengthImpl(
   return match_len;
 }
 
-size_t GetRegistryLength(const char* hostname) {
-  const char* buf_end;
-  char* buf;
-  size_t registry_length;
+static size_t FinishRegistryLookup(const struct RegistryLookup* lookup,
+                                   int allow_unknown_registries) {
+  const char* registry = lookup->last_valid;
+
+  if (registry == NULL && allow_unknown_registries != 0) {
+    /*
+     * Didn't find a match. If unknown registries are allowed, and
+     * the root hostname-part is not in the table, consider it to be
+     * a valid registry, and return its length.
+     */
+    registry = lookup->unknown_registry;
+  }
+  return GetRegistryMatchLength(lookup, registry);
+}
+
+/*
+ * Count a hostname of length hostname_len that ScanHostname rejected,
+ * by the reason it was rejected for.
+ */
+static void CountRejectedHostname(size_t hostname_len) {
+  if (hostname_len > MAX_HOSTNAME_LEN) {
+    COUNT_REGISTRY_STAT(rejected_too_long);
+  } else {
+    COUNT_REGISTRY_STAT(rejected_non_ascii);
+  }
+}
 
+static size_t GetRegistryLengthImpl(const struct DomainRegistry* registry,
+                                    const char* hostname,
+                                    size_t hostname_len,
+                                    int allow_unknown_registries) {
+  /*
+   * Validate, lowercase and find the separators of the hostname in a
+   * single pass, into buffers on the stack. The search below then
+   * works on the lowercase copy, and the registry length is the same
+   * in the copy as in the original.
+   */
+  char lowercase[MAX_HOSTNAME_LEN];
+  unsigned char separators[MAX_HOSTNAME_LEN];
+  size_t num_separators;
+  const struct RegistryTables* tables;
+  struct RegistryLookup lookup;
+  size_t registry_len;
+
+  DCHECK(registry != NULL);
   if (hostname == NULL) {
     return 0;
   }
-  if (IsValidHostname(hostname) == 0) {
+  COUNT_REGISTRY_STAT(length_lookups);
+  /*
+   * The whole lookup, including the cache check, uses the tables that
+   * are installed now, even if others are installed meanwhile.
+   */
+  tables = AcquireRegistryTables(registry);
+  if (LookupResultCache(tables->generation, hostname, hostname_len,
+                        allow_unknown_registries, &registry_len)) {
+    ReleaseRegistryTables();
+    return registry_len;
+  }
+  if (ScanHostname(hostname, hostname_len,
+                   lowercase, separators, &num_separators) == 0) {
+    CountRejectedHostname(hostname_len);
+    ReleaseRegistryTables();
     return 0;
   }
+  StartRegistryLookup(
+      &lookup, tables, lowercase, hostname_len, separators, num_separators);
+  while (lookup.done == 0) {
+    StepRegistryLookup(&lookup);
+  }
+  registry_len = FinishRegistryLookup(&lookup, allow_unknown_registries);
+  InsertResultCache(tables->generation, hostname, hostname_len,
+                    allow_unknown_registries, registry_len);
+  ReleaseRegistryTables();
+  return registry_len;
+}
+
+size_t DomainRegistryGetRegistryLengthN(
+    const struct DomainRegistry* registry,
+    const char* hostname,
+    size_t hostname_len) {
+  return GetRegistryLengthImpl(registry, hostname, hostname_len, 0);
+}
+
+size_t DomainRegistryGetRegistryLengthAllowUnknownRegistriesN(
+    const struct DomainRegistry* registry,
+    const char* hostname,
+    size_t hostname_len) {
+  return GetRegistryLengthImpl(registry, hostname, hostname_len, 1);
+}
 
+size_t DomainRegistryGetRegistryLength(const struct DomainRegistry* registry,
+                                       const char* hostname) {
+  if (hostname == NULL) {
+    return 0;
+  }
   /*
-   * Replace dots between hostname parts with the null byte. This
-   * allows us to index directly into the string and refer to each
-   * hostname-part as if it were its own null-terminated string.
+   * Hostnames longer than kMaxHostnameLen are rejected, so there is
+   * no need to scan past that point.
    */
-  buf = StrDup(hostname);
-  if (buf == NULL) {
+  return DomainRegistryGetRegistryLengthN(
+      registry, hostname, StrnLen(hostname, kMaxHostnameLen + 1));
+}
+
+size_t DomainRegistryGetRegistryLengthAllowUnknownRegistries(
+    const struct DomainRegistry* registry,
+    const char* hostname) {
+  if (hostname == NULL) {
     return 0;
   }
-  ReplaceChar(buf, '.', '\0');
+  return DomainRegistryGetRegistryLengthAllowUnknownRegistriesN(
+      registry, hostname, StrnLen(hostname, kMaxHostnameLen + 1));
+}
 
-  buf_end = buf + strlen(hostname);
-  DCHECK(*buf_end == 0);
+size_t GetRegistryLengthN(const char* hostname, size_t hostname_len) {
+  return DomainRegistryGetRegistryLengthN(
+      GetDefaultDomainRegistry(), hostname, hostname_len);
+}
+
+size_t GetRegistryLengthAllowUnknownRegistriesN(const char* hostname,
+                                                size_t hostname_len) {
+  return DomainRegistryGetRegistryLengthAllowUnknownRegistriesN(
+      GetDefaultDomainRegistry(), hostname, hostname_len);
+}
 
-  /* Normalize the input by converting all characters to lowercase. */
-  ToLowerASCII(buf, buf_end);
-  registry_length = GetRegistryLengthImpl(buf, buf_end, '\0', 0);
-  free(buf);
-  return registry_length;
+size_t GetRegistryLength(const char* hostname) {
+  return DomainRegistryGetRegistryLength(GetDefaultDomainRegistry(),
+                                         hostname);
 }
 
 size_t GetRegistryLengthAllowUnknownRegistries(const char* hostname) {
-  const char* buf_end;
-  char* buf;
-  size_t registry_length;
+  return DomainRegistryGetRegistryLengthAllowUnknownRegistries(
+      GetDefaultDomainRegistry(), hostname);
+}
+
+/*
+ * Each character of a hostname takes at most 4 bytes in UTF-8, and
+ * at least 1 byte once converted to ASCII, so no longer UTF-8
+ * hostname converts to a valid one.
+ */
+static const size_t kMaxUtf8HostnameLen = 4 * MAX_HOSTNAME_LEN;
+
+size_t DomainRegistryGetRegistryLengthUtf8N(
+    const struct DomainRegistry* registry,
+    const char* hostname,
+    size_t hostname_len) {
+  char ascii[MAX_HOSTNAME_LEN];
+  size_t ascii_len;
+  size_t registry_len;
+  size_t num_separators;
+  size_t i;
 
   if (hostname == NULL) {
     return 0;
   }
-  if (IsValidHostname(hostname) == 0) {
+  for (i = 0; i < hostname_len; ++i) {
+    if ((unsigned char) hostname[i] >= 0x80) {
+      break;
+    }
+  }
+  if (i == hostname_len) {
+    return DomainRegistryGetRegistryLengthN(registry, hostname, hostname_len);
+  }
+
+  ascii_len = ConvertHostnameToAscii(
+      hostname, hostname_len, ascii, sizeof(ascii));
+  if (ascii_len == 0) {
+    return 0;
+  }
+  registry_len = DomainRegistryGetRegistryLengthN(registry, ascii, ascii_len);
+  if (registry_len == 0) {
     return 0;
   }
 
   /*
-   * Replace dots between hostname parts with the null byte. This
-   * allows us to index directly into the string and refer to each
-   * hostname-part as if it were its own null-terminated string.
+   * The registry is the last hostname-parts of the converted hostname.
+   * Find the same hostname-parts in the original one.
    */
-  buf = StrDup(hostname);
-  if (buf == NULL) {
+  num_separators = 0;
+  for (i = 0; i < ascii_len - registry_len; ++i) {
+    if (ascii[i] == '.') {
+      ++num_separators;
+    }
+  }
+  return hostname_len -
+      FindHostnamePartOffset(hostname, hostname_len, num_separators);
+}
+
+size_t DomainRegistryGetRegistryLengthUtf8(
+    const struct DomainRegistry* registry,
+    const char* hostname) {
+  return DomainRegistryGetRegistryLengthUtf8N(
+      registry, hostname,
+      hostname != NULL ? StrnLen(hostname, kMaxUtf8HostnameLen + 1) : 0);
+}
+
+size_t GetRegistryLengthUtf8N(const char* hostname, size_t hostname_len) {
+  return DomainRegistryGetRegistryLengthUtf8N(
+      GetDefaultDomainRegistry(), hostname, hostname_len);
+}
+
+size_t GetRegistryLengthUtf8(const char* hostname) {
+  return DomainRegistryGetRegistryLengthUtf8(
+      GetDefaultDomainRegistry(), hostname);
+}
+
+void DomainRegistryGetRegistryLengthsN(
+    const struct DomainRegistry* registry,
+    const char* hostname,
+    size_t hostname_len,
+    size_t* icann_registry_len,
+    size_t* private_registry_len) {
+  char lowercase[MAX_HOSTNAME_LEN];
+  unsigned char separators[MAX_HOSTNAME_LEN];
+  size_t num_separators;
+  const struct RegistryTables* tables;
+  struct RegistryLookup lookup;
+
+  DCHECK(registry != NULL);
+  DCHECK(icann_registry_len != NULL);
+  DCHECK(private_registry_len != NULL);
+  *icann_registry_len = 0;
+  *private_registry_len = 0;
+  if (hostname == NULL) {
+    return;
+  }
+  COUNT_REGISTRY_STAT(lengths_lookups);
+  tables = AcquireRegistryTables(registry);
+  if (ScanHostname(hostname, hostname_len,
+                   lowercase, separators, &num_separators) == 0) {
+    CountRejectedHostname(hostname_len);
+    ReleaseRegistryTables();
+    return;
+  }
+  /*
+   * Only the trie has the sections of the rules, so use it even if
+   * another engine is installed. The result cache only holds a single
+   * length per hostname, so it is not used either.
+   */
+  StartRegistryLookup(
+      &lookup, tables, lowercase, hostname_len, separators, num_separators);
+  lookup.engine = REGISTRY_ENGINE_TRIE;
+  lookup.find_icann = 1;
+  while (lookup.done == 0) {
+    StepRegistryLookup(&lookup);
+  }
+  *icann_registry_len =
+      GetRegistryMatchLength(&lookup, lookup.icann_last_valid);
+  *private_registry_len = GetRegistryMatchLength(&lookup, lookup.last_valid);
+  ReleaseRegistryTables();
+}
+
+void DomainRegistryGetRegistryLengths(const struct DomainRegistry* registry,
+                                      const char* hostname,
+                                      size_t* icann_registry_len,
+                                      size_t* private_registry_len) {
+  DomainRegistryGetRegistryLengthsN(
+      registry, hostname,
+      hostname != NULL ? StrnLen(hostname, kMaxHostnameLen + 1) : 0,
+      icann_registry_len, private_registry_len);
+}
+
+void GetRegistryLengthsN(const char* hostname,
+                         size_t hostname_len,
+                         size_t* icann_registry_len,
+                         size_t* private_registry_len) {
+  DomainRegistryGetRegistryLengthsN(GetDefaultDomainRegistry(),
+                                    hostname,
+                                    hostname_len,
+                                    icann_registry_len,
+                                    private_registry_len);
+}
+
+void GetRegistryLengths(const char* hostname,
+                        size_t* icann_registry_len,
+                        size_t* private_registry_len) {
+  DomainRegistryGetRegistryLengths(GetDefaultDomainRegistry(),
+                                   hostname,
+                                   icann_registry_len,
+                                   private_registry_len);
+}
+
+int DomainRegistryGetRegistryInfoN(const struct DomainRegistry* registry,
+                                   const char* hostname,
+                                   size_t hostname_len,
+                                   struct RegistryInfo* info) {
+  char lowercase[MAX_HOSTNAME_LEN];
+  unsigned char separators[MAX_HOSTNAME_LEN];
+  size_t num_separators;
+  const struct RegistryTables* tables;
+  struct RegistryLookup lookup;
+  const char* registry_start;
+  const char* domain_start;
+
+  DCHECK(registry != NULL);
+  DCHECK(info != NULL);
+  memset(info, 0, sizeof(*info));
+  if (hostname == NULL) {
     return 0;
   }
-  ReplaceChar(buf, '.', '\0');
+  COUNT_REGISTRY_STAT(info_lookups);
+  tables = AcquireRegistryTables(registry);
+  if (ScanHostname(hostname, hostname_len,
+                   lowercase, separators, &num_separators) == 0) {
+    CountRejectedHostname(hostname_len);
+    ReleaseRegistryTables();
+    return 0;
+  }
+  StartRegistryLookup(
+      &lookup, tables, lowercase, hostname_len, separators, num_separators);
+  info->host_len = hostname_len;
+  info->num_labels = CountHostnameParts(
+      lowercase, hostname_len, separators, num_separators);
+  while (lookup.done == 0) {
+    StepRegistryLookup(&lookup);
+  }
+  ReleaseRegistryTables();
+
+  info->registry_len = GetRegistryMatchLength(&lookup, lookup.last_valid);
+  if (info->registry_len == 0) {
+    return 0;
+  }
+  info->registry_offset = hostname_len - info->registry_len;
+  info->is_wildcard_rule = lookup.last_valid_is_wildcard;
+  info->is_exception_rule = lookup.last_valid_is_exception;
+
+  /*
+   * The registrable domain adds the hostname-part before the
+   * registry, which is preceded by a separator unless the registry
+   * starts the hostname.
+   */
+  registry_start = lowercase + info->registry_offset;
+  if (registry_start > lookup.value) {
+    domain_start = registry_start - 1;
+    while (domain_start > lookup.value && domain_start[-1] != '.') {
+      --domain_start;
+    }
+    if (domain_start < registry_start - 1) {
+      info->registrable_domain_offset = domain_start - lowercase;
+      info->registrable_domain_len =
+          hostname_len - info->registrable_domain_offset;
+    }
+  }
+  return 1;
+}
+
+int DomainRegistryGetRegistryInfo(const struct DomainRegistry* registry,
+                                  const char* hostname,
+                                  struct RegistryInfo* info) {
+  return DomainRegistryGetRegistryInfoN(
+      registry, hostname,
+      hostname != NULL ? StrnLen(hostname, kMaxHostnameLen + 1) : 0,
+      info);
+}
 
-  buf_end = buf + strlen(hostname);
-  DCHECK(*buf_end == 0);
+int DomainRegistryGetRegistryInfoForUrl(
+    const struct DomainRegistry* registry,
+    const char* url,
+    size_t url_len,
+    struct RegistryInfo* info) {
+  size_t host_offset;
+  size_t host_len;
+  int found;
 
-  /* Normalize the input by converting all characters to lowercase. */
-  ToLowerASCII(buf, buf_end);
-  registry_length = GetRegistryLengthImpl(buf, buf_end, '\0', 1);
-  free(buf);
-  return registry_length;
+  DCHECK(info != NULL);
+  if (url == NULL || FindUrlHost(url, url_len, &host_offset, &host_len) == 0) {
+    memset(info, 0, sizeof(*info));
+    return 0;
+  }
+  found = DomainRegistryGetRegistryInfoN(
+      registry, url + host_offset, host_len, info);
+  if (info->host_len == 0) {
+    /* The host is not a valid hostname. */
+    return 0;
+  }
+
+  /* Make the offsets relative to the start of the URL. */
+  info->host_offset += host_offset;
+  if (info->registry_len > 0) {
+    info->registry_offset += host_offset;
+  }
+  if (info->registrable_domain_len > 0) {
+    info->registrable_domain_offset += host_offset;
+  }
+  return found;
+}
+
+int GetRegistryInfoForUrl(const char* url,
+                          size_t url_len,
+                          struct RegistryInfo* info) {
+  return DomainRegistryGetRegistryInfoForUrl(
+      GetDefaultDomainRegistry(), url, url_len, info);
+}
+
+int GetRegistryInfoN(const char* hostname,
+                     size_t hostname_len,
+                     struct RegistryInfo* info) {
+  return DomainRegistryGetRegistryInfoN(
+      GetDefaultDomainRegistry(), hostname, hostname_len, info);
+}
+
+int GetRegistryInfo(const char* hostname, struct RegistryInfo* info) {
+  return DomainRegistryGetRegistryInfo(
+      GetDefaultDomainRegistry(), hostname, info);
+}
+
+void GetRegistryLengthBatch(const char* const* hostnames,
+                            const size_t* hostname_lens,
+                            size_t num_hostnames,
+                            size_t* registry_lens) {
+  DomainRegistryGetRegistryLengthBatch(GetDefaultDomainRegistry(),
+                                       hostnames,
+                                       hostname_lens,
+                                       num_hostnames,
+                                       registry_lens);
+}
+
+void DomainRegistryGetRegistryLengthBatch(
+    const struct DomainRegistry* registry,
+    const char* const* hostnames,
+    const size_t* hostname_lens,
+    size_t num_hostnames,
+    size_t* registry_lens) {
+  struct RegistryLookup lookups[BATCH_WINDOW_SIZE];
+  char lowercase[BATCH_WINDOW_SIZE][MAX_HOSTNAME_LEN];
+  unsigned char separators[BATCH_WINDOW_SIZE][MAX_HOSTNAME_LEN];
+  size_t window_start;
+
+  DCHECK(registry != NULL);
+  for (window_start = 0;
+       window_start < num_hostnames;
+       window_start += BATCH_WINDOW_SIZE) {
+    size_t window_size = num_hostnames - window_start;
+    size_t num_active = 0;
+    size_t i;
+    /*
+     * Acquired once per window rather than per batch, so that a large
+     * batch does not hold up the installation of new tables.
+     */
+    const struct RegistryTables* tables = AcquireRegistryTables(registry);
+
+    if (window_size > BATCH_WINDOW_SIZE) {
+      window_size = BATCH_WINDOW_SIZE;
+    }
+    for (i = 0; i < window_size; ++i) {
+      const char* hostname = hostnames[window_start + i];
+      size_t hostname_len = 0;
+      size_t num_separators = 0;
+      COUNT_REGISTRY_STAT(batch_lookups);
+      if (hostname != NULL) {
+        hostname_len = (hostname_lens != NULL) ?
+            hostname_lens[window_start + i] :
+            StrnLen(hostname, kMaxHostnameLen + 1);
+      }
+      if (hostname == NULL ||
+          ScanHostname(hostname, hostname_len, lowercase[i],
+                       separators[i], &num_separators) == 0) {
+        /* An empty lookup is done immediately and has no registry. */
+        if (hostname != NULL) {
+          CountRejectedHostname(hostname_len);
+        }
+        hostname_len = 0;
+        num_separators = 0;
+      }
+      StartRegistryLookup(&lookups[i], tables, lowercase[i], hostname_len,
+                          separators[i], num_separators);
+      if (lookups[i].done == 0) {
+        ++num_active;
+      }
+    }
+
+    /*
+     * Advance all lookups in the window by one hostname-part per
+     * pass. Before each pass, prefetch the first nodes and strings
+     * each lookup's search will visit, so that the cache misses of
+     * the lookups in the window overlap instead of being taken one
+     * after another. The string table entries can only be prefetched
+     * once the nodes that refer to them have been loaded, so they
+     * are prefetched in a second loop.
+     */
+    while (num_active > 0) {
+      for (i = 0; i < window_size; ++i) {
+        if (lookups[i].done == 0) {
+          PrefetchRegistryLookup(&lookups[i]);
+        }
+      }
+      for (i = 0; i < window_size; ++i) {
+        if (lookups[i].done == 0) {
+          PrefetchRegistryLookupStrings(&lookups[i]);
+        }
+      }
+      num_active = 0;
+      for (i = 0; i < window_size; ++i) {
+        if (lookups[i].done == 0) {
+          StepRegistryLookup(&lookups[i]);
+          if (lookups[i].done == 0) {
+            ++num_active;
+          }
+        }
+      }
+    }
+
+    for (i = 0; i < window_size; ++i) {
+      registry_lens[window_start + i] = FinishRegistryLookup(&lookups[i], 0);
+    }
+    ReleaseRegistryTables();
+  }
 }
@@ -14,6 +14,9 @@
 
 extern "C" {
 #include "domain_registry/domain_registry.h"
+#include "domain_registry/private/dafsa_search.h"
+#include "domain_registry/private/matcher_search.h"
+#include "domain_registry/private/suffix_hash_search.h"
 #include "domain_registry/private/trie_search.h"
 }  // extern "C"
 
@@ -41,30 +44,47 @@ const char* kTooLongHostname =
     "123456789012345678901234567890123456789012345678901234567890"
     "12345678.foo.com";
 
-class RegistrySearchTest : public ::testing::Test {
+// The lookup engines each test runs with.
+enum Engine {
+  kTrie,
+  kSuffixHash,
+  kDafsa,
+  kMatcher,
+};
+
+class RegistrySearchTest : public ::testing::TestWithParam<Engine> {
  protected:
-  static void SetUpTestCase() {
+  virtual void SetUp() {
     // For these tests we use the test tables from simple_node_table.c.
     SetRegistryTables(kSimpleStringTable,
                       kSimpleNodeTable,
                       kSimpleNumRootChildren,
                       kSimpleLeafNodeTable,
                       kSimpleLeafNodeTableOffset);
+    if (GetParam() == kSuffixHash) {
+      SetSuffixHashTable(kSimpleSuffixHashTable,
+                         kSimpleSuffixHashTableSize,
+                         kSimpleSuffixHashSeed);
+    } else if (GetParam() == kDafsa) {
+      SetDafsa(kSimpleDafsa, sizeof(kSimpleDafsa));
+    } else if (GetParam() == kMatcher) {
+      SetRegistryMatcher(SimpleMatchRegistryRule);
+    }
   }
 
-  static void TearDownTestCase() {
+  virtual void TearDown() {
     SetRegistryTables(NULL, NULL, 0, NULL, 0);
   }
 };
 
-TEST_F(RegistrySearchTest, Basic) {
+TEST_P(RegistrySearchTest, Basic) {
   EXPECT_EQ(0, GetRegistryLength(""));
   EXPECT_EQ(0, GetRegistryLength("zzz"));
   EXPECT_EQ(0, GetRegistryLength("."));
   EXPECT_EQ(0, GetRegistryLength(".."));
 }
 
-TEST_F(RegistrySearchTest, FooDotCom) {
+TEST_P(RegistrySearchTest, FooDotCom) {
   EXPECT_EQ(0, GetRegistryLength("com"));
   EXPECT_EQ(0, GetRegistryLength("bar.com"));
   EXPECT_EQ(0, GetRegistryLength("www.bar.com"));
@@ -75,19 +95,19 @@ TEST_F(RegistrySearchTest, FooDotCom) {
   EXPECT_EQ(7, GetRegistryLength("www.zzz.foo.com"));
 }
 
-TEST_F(RegistrySearchTest, DotFoo) {
+TEST_P(RegistrySearchTest, DotFoo) {
   EXPECT_EQ(0, GetRegistryLength("foo"));
   EXPECT_EQ(0, GetRegistryLength(".foo"));
   EXPECT_EQ(7, GetRegistryLength("zzz.foo"));
 }
 
-TEST_F(RegistrySearchTest, BazDotFoo) {
+TEST_P(RegistrySearchTest, BazDotFoo) {
   EXPECT_EQ(3, GetRegistryLength("baz.foo"));
   EXPECT_EQ(3, GetRegistryLength("a.baz.foo"));
   EXPECT_EQ(3, GetRegistryLength("b.baz.foo"));
 }
 
-TEST_F(RegistrySearchTest, BarDotFoo) {
+TEST_P(RegistrySearchTest, BarDotFoo) {
   EXPECT_EQ(7, GetRegistryLength("bar.foo"));
   EXPECT_EQ(7, GetRegistryLength(".bar.foo"));
 
@@ -110,7 +130,7 @@ TEST_F(RegistrySearchTest, BarDotFoo) {
   EXPECT_EQ(9, GetRegistryLength(".a.bar.foo"));
 }
 
-TEST_F(RegistrySearchTest, StarDotFoo) {
+TEST_P(RegistrySearchTest, StarDotFoo) {
   // Tests for children of *.foo (!baz.*.foo, foo.*.foo, *.*.foo).
 
   // !baz.*.foo:
@@ -138,7 +158,7 @@ TEST_F(RegistrySearchTest, StarDotFoo) {
   EXPECT_EQ(11, GetRegistryLength("www.zzz.zzz.foo"));
 }
 
-TEST_F(RegistrySearchTest, UnknownRegistries) {
+TEST_P(RegistrySearchTest, UnknownRegistries) {
   EXPECT_EQ(0, GetRegistryLength("foo.bar"));
   EXPECT_EQ(3, GetRegistryLengthAllowUnknownRegistries("foo.bar"));
   EXPECT_EQ(3, GetRegistryLengthAllowUnknownRegistries(".foo.bar"));
@@ -150,7 +170,7 @@ TEST_F(RegistrySearchTest, UnknownRegistries) {
   EXPECT_EQ(0, GetRegistryLengthAllowUnknownRegistries("a.foo.com.."));
 }
 
-TEST_F(RegistrySearchTest, MultipleDots) {
+TEST_P(RegistrySearchTest, MultipleDots) {
   // First, we know that *.foo.com should match.
   EXPECT_EQ(7, GetRegistryLength("a.foo.com"));
 
@@ -173,7 +193,7 @@ TEST_F(RegistrySearchTest, MultipleDots) {
   EXPECT_EQ(7, GetRegistryLength(".a...foo.com"));
 }
 
-TEST_F(RegistrySearchTest, HostnameMaxLength) {
+TEST_P(RegistrySearchTest, HostnameMaxLength) {
   ASSERT_EQ(255, strlen(kLongestAllowedHostname));
   ASSERT_EQ(256, strlen(kTooLongHostname));
 
@@ -185,4 +205,318 @@ TEST_F(RegistrySearchTest, HostnameMaxLength) {
   EXPECT_EQ(0, GetRegistryLengthAllowUnknownRegistries(kTooLongHostname));
 }
 
+TEST_P(RegistrySearchTest, LengthDelimited) {
+  // The hostname does not need to be null-terminated.
+  const char kHostnames[] = "www.zzz.foo.comXYZ";
+  EXPECT_EQ(7, GetRegistryLengthN(kHostnames, 15));
+  EXPECT_EQ(7, GetRegistryLengthAllowUnknownRegistriesN(kHostnames, 15));
+  EXPECT_EQ(0, GetRegistryLengthN(kHostnames, 14));
+  EXPECT_EQ(2, GetRegistryLengthAllowUnknownRegistriesN(kHostnames, 14));
+  EXPECT_EQ(0, GetRegistryLengthN(kHostnames, 0));
+  EXPECT_EQ(0, GetRegistryLengthN(NULL, 0));
+  EXPECT_EQ(0, GetRegistryLengthAllowUnknownRegistriesN(NULL, 0));
+
+  // Embedded null bytes are not allowed.
+  const char kEmbeddedNull[] = "a.foo\0.com";
+  EXPECT_EQ(0, GetRegistryLengthN(kEmbeddedNull, sizeof(kEmbeddedNull) - 1));
+}
+
+TEST_P(RegistrySearchTest, CaseInsensitive) {
+  EXPECT_EQ(7, GetRegistryLength("A.FOO.COM"));
+  EXPECT_EQ(7, GetRegistryLength("a.FoO.cOm"));
+  EXPECT_EQ(3, GetRegistryLength("a.BAZ.foo"));
+  EXPECT_EQ(5, GetRegistryLength("BAZ.A.FOO"));
+  EXPECT_EQ(11, GetRegistryLength("WWW.ZZZ.BAR.FOO"));
+  EXPECT_EQ(3, GetRegistryLengthAllowUnknownRegistries("FOO.BAR"));
+}
+
+TEST_P(RegistrySearchTest, Batch) {
+  const char* const kHostnames[] = {
+    "a.foo.com", "com", "baz.zzz.foo", "www.foo.zzz.foo", "a.foo..com",
+    "BAZ.A.FOO", "", NULL, "www.asdf.bar.foo", "foo.bar", kTooLongHostname,
+    "foo.a.foo", "zzz.zzz.foo", ".a...foo.com", "a.foo.com.", "a.foo.com..",
+    "z.a.bar.foo", "bar.foo",
+  };
+  const size_t kNumHostnames = sizeof(kHostnames) / sizeof(kHostnames[0]);
+  size_t registry_lens[kNumHostnames];
+  GetRegistryLengthBatch(kHostnames, NULL, kNumHostnames, registry_lens);
+  for (size_t i = 0; i < kNumHostnames; ++i) {
+    EXPECT_EQ(GetRegistryLength(kHostnames[i]), registry_lens[i]) << i;
+  }
+}
+
+TEST_P(RegistrySearchTest, HostnameMaxLengthN) {
+  EXPECT_EQ(7, GetRegistryLengthN(kLongestAllowedHostname, 255));
+  EXPECT_EQ(0, GetRegistryLengthN(kTooLongHostname, 256));
+  EXPECT_EQ(0, GetRegistryLengthAllowUnknownRegistriesN(kTooLongHostname, 256));
+}
+
+// Expect GetRegistryLengths to find the given ICANN and private
+// registry lengths for hostname.
+void ExpectRegistryLengths(size_t expected_icann_len,
+                           size_t expected_private_len,
+                           const char* hostname) {
+  size_t icann_len = 42;
+  size_t private_len = 42;
+  GetRegistryLengths(hostname, &icann_len, &private_len);
+  EXPECT_EQ(expected_icann_len, icann_len) << hostname;
+  EXPECT_EQ(expected_private_len, private_len) << hostname;
+}
+
+TEST_P(RegistrySearchTest, RegistryLengthsWithoutSections) {
+  // Without section tables, all rules are ICANN rules.
+  ExpectRegistryLengths(7, 7, "a.foo.com");
+  ExpectRegistryLengths(7, 7, "bar.foo");
+  ExpectRegistryLengths(11, 11, "www.foo.bar.foo");
+  ExpectRegistryLengths(0, 0, "foo.bar");
+  ExpectRegistryLengths(0, 0, NULL);
+}
+
+TEST_P(RegistrySearchTest, RegistryLengths) {
+  SetNodeSectionTables(kSimpleNodeSectionTable, kSimpleLeafSectionTable);
+
+  // Rules that are only in the ICANN section.
+  ExpectRegistryLengths(7, 7, "a.foo.com");
+  ExpectRegistryLengths(7, 7, "zzz.foo");
+  ExpectRegistryLengths(3, 3, "a.baz.foo");
+  ExpectRegistryLengths(5, 5, "baz.a.foo");
+  ExpectRegistryLengths(11, 11, "www.zzz.bar.foo");
+  ExpectRegistryLengths(0, 0, "com");
+
+  // bar.foo is a PRIVATE rule, which the ICANN rule *.bar.foo passes
+  // through.
+  ExpectRegistryLengths(0, 7, "bar.foo");
+  ExpectRegistryLengths(0, 8, "bar.foo.");
+
+  // foo.bar.foo is a PRIVATE rule, and the ICANN rule *.bar.foo
+  // matches in its place.
+  ExpectRegistryLengths(11, 11, "www.foo.bar.foo");
+  ExpectRegistryLengths(11, 11, "FOO.BAR.FOO");
+
+  // Invalid hostnames have no registry.
+  ExpectRegistryLengths(0, 0, "a.bar..foo");
+  ExpectRegistryLengths(0, 0, kTooLongHostname);
+
+  // The private registry length is the one GetRegistryLength finds.
+  size_t icann_len;
+  size_t private_len;
+  GetRegistryLengthsN("a.bar.fooXYZ", 9, &icann_len, &private_len);
+  EXPECT_EQ(9, icann_len);
+  EXPECT_EQ(GetRegistryLengthN("a.bar.fooXYZ", 9), private_len);
+}
+
+// Expect GetRegistryInfo to find the given parts of hostname.
+void ExpectRegistryInfo(const char* hostname,
+                        size_t registry_offset,
+                        size_t registry_len,
+                        size_t registrable_domain_offset,
+                        size_t registrable_domain_len,
+                        size_t num_labels,
+                        int is_wildcard_rule,
+                        int is_exception_rule) {
+  RegistryInfo info;
+  EXPECT_EQ(registry_len != 0, GetRegistryInfo(hostname, &info)) << hostname;
+  EXPECT_EQ(registry_offset, info.registry_offset) << hostname;
+  EXPECT_EQ(registry_len, info.registry_len) << hostname;
+  EXPECT_EQ(registrable_domain_offset, info.registrable_domain_offset)
+      << hostname;
+  EXPECT_EQ(registrable_domain_len, info.registrable_domain_len) << hostname;
+  EXPECT_EQ(num_labels, info.num_labels) << hostname;
+  EXPECT_EQ(is_wildcard_rule, info.is_wildcard_rule) << hostname;
+  EXPECT_EQ(is_exception_rule, info.is_exception_rule) << hostname;
+}
+
+TEST_P(RegistrySearchTest, RegistryInfo) {
+  ExpectRegistryInfo("www.zzz.foo.com", 8, 7, 4, 11, 4, 0, 0);
+  ExpectRegistryInfo("foo.com", 0, 7, 0, 0, 2, 0, 0);
+  ExpectRegistryInfo("a.foo.com.", 2, 8, 0, 10, 3, 0, 0);
+  ExpectRegistryInfo("..a.foo.com", 4, 7, 2, 9, 3, 0, 0);
+  ExpectRegistryInfo("A.FOO.COM", 2, 7, 0, 9, 3, 0, 0);
+
+  // Wildcard rules: *.*.foo and *.bar.foo.
+  ExpectRegistryInfo("www.zzz.zzz.foo", 4, 11, 0, 15, 4, 1, 0);
+  ExpectRegistryInfo("www.zzz.bar.foo", 4, 11, 0, 15, 4, 1, 0);
+
+  // Exception rules: !baz.foo and !baz.*.foo.
+  ExpectRegistryInfo("a.baz.foo", 6, 3, 2, 7, 3, 0, 1);
+  ExpectRegistryInfo("baz.foo", 4, 3, 0, 7, 2, 0, 1);
+  ExpectRegistryInfo("baz.a.foo", 4, 5, 0, 9, 3, 0, 1);
+
+  // An empty hostname-part is not a registrable domain.
+  ExpectRegistryInfo("a..foo.com", 3, 7, 0, 0, 4, 0, 0);
+
+  // Hostnames without a registry.
+  ExpectRegistryInfo("foo.bar", 0, 0, 0, 0, 2, 0, 0);
+  ExpectRegistryInfo("com", 0, 0, 0, 0, 1, 0, 0);
+  ExpectRegistryInfo("", 0, 0, 0, 0, 0, 0, 0);
+  ExpectRegistryInfo("..", 0, 0, 0, 0, 0, 0, 0);
+  ExpectRegistryInfo(NULL, 0, 0, 0, 0, 0, 0, 0);
+  ExpectRegistryInfo(kTooLongHostname, 0, 0, 0, 0, 0, 0, 0);
+
+  RegistryInfo info;
+  EXPECT_EQ(1, GetRegistryInfoN("www.zzz.foo.comXYZ", 15, &info));
+  EXPECT_EQ(GetRegistryLengthN("www.zzz.foo.comXYZ", 15), info.registry_len);
+  EXPECT_EQ(4, info.registrable_domain_offset);
+  EXPECT_EQ(0, info.host_offset);
+  EXPECT_EQ(15, info.host_len);
+}
+
+// Expect GetRegistryInfoForUrl to find the given parts of url.
+void ExpectRegistryInfoForUrl(const char* url,
+                              size_t host_offset,
+                              size_t host_len,
+                              size_t registry_offset,
+                              size_t registry_len,
+                              size_t registrable_domain_offset,
+                              size_t registrable_domain_len) {
+  RegistryInfo info;
+  EXPECT_EQ(registry_len != 0,
+            GetRegistryInfoForUrl(url, strlen(url), &info)) << url;
+  EXPECT_EQ(host_offset, info.host_offset) << url;
+  EXPECT_EQ(host_len, info.host_len) << url;
+  EXPECT_EQ(registry_offset, info.registry_offset) << url;
+  EXPECT_EQ(registry_len, info.registry_len) << url;
+  EXPECT_EQ(registrable_domain_offset, info.registrable_domain_offset)
+      << url;
+  EXPECT_EQ(registrable_domain_len, info.registrable_domain_len) << url;
+}
+
+TEST_P(RegistrySearchTest, RegistryInfoForUrl) {
+  ExpectRegistryInfoForUrl("http://www.zzz.foo.com/", 7, 15, 15, 7, 11, 11);
+  ExpectRegistryInfoForUrl(
+      "http://user@www.zzz.foo.com.:80/path", 12, 15, 20, 7, 16, 11);
+  ExpectRegistryInfoForUrl("//a.baz.foo?q", 2, 9, 8, 3, 4, 7);
+  ExpectRegistryInfoForUrl("foo.com:8080", 0, 7, 0, 7, 0, 0);
+  ExpectRegistryInfoForUrl("www.zzz.zzz.foo", 0, 15, 4, 11, 0, 15);
+
+  // URLs whose host has no registry.
+  ExpectRegistryInfoForUrl("http://foo.bar/", 7, 7, 0, 0, 0, 0);
+  ExpectRegistryInfoForUrl("http://a..foo.com/", 7, 10, 10, 7, 0, 0);
+
+  // URLs without a host.
+  ExpectRegistryInfoForUrl("http://[::1]/", 0, 0, 0, 0, 0, 0);
+  ExpectRegistryInfoForUrl("mailto:a@foo.com", 0, 0, 0, 0, 0, 0);
+  ExpectRegistryInfoForUrl("file:///etc/hosts", 0, 0, 0, 0, 0, 0);
+  ExpectRegistryInfoForUrl("", 0, 0, 0, 0, 0, 0);
+
+  RegistryInfo info;
+  EXPECT_EQ(1, GetRegistryInfoForUrl("http://a.foo.comXYZ", 16, &info));
+  EXPECT_EQ(9, info.registry_offset);
+  EXPECT_EQ(7, info.registry_len);
+  EXPECT_EQ(0, GetRegistryInfoForUrl(NULL, 0, &info));
+  EXPECT_EQ(0, info.host_len);
+}
+
+INSTANTIATE_TEST_CASE_P(Engines, RegistrySearchTest,
+                        ::testing::Values(kTrie, kSuffixHash, kDafsa,
+                                          kMatcher));
+
+class ResultCacheTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    SetRegistryTables(kSimpleStringTable,
+                      kSimpleNodeTable,
+                      kSimpleNumRootChildren,
+                      kSimpleLeafNodeTable,
+                      kSimpleLeafNodeTableOffset);
+    GetRegistryResultCacheStats(&hits_, &misses_);
+  }
+
+  virtual void TearDown() {
+    SetRegistryTables(NULL, NULL, 0, NULL, 0);
+  }
+
+  // Expect the given number of hits and misses since the last call.
+  void ExpectStats(size_t hits, size_t misses) {
+    size_t total_hits;
+    size_t total_misses;
+    GetRegistryResultCacheStats(&total_hits, &total_misses);
+    EXPECT_EQ(hits, total_hits - hits_);
+    EXPECT_EQ(misses, total_misses - misses_);
+    hits_ = total_hits;
+    misses_ = total_misses;
+  }
+
+  size_t hits_;
+  size_t misses_;
+};
+
+#if defined(DOMAIN_REGISTRY_RESULT_CACHE_SIZE) && \
+    DOMAIN_REGISTRY_RESULT_CACHE_SIZE > 0
+
+TEST_F(ResultCacheTest, HitsAndMisses) {
+  EXPECT_EQ(7, GetRegistryLength("a.foo.com"));
+  ExpectStats(0, 1);
+  EXPECT_EQ(7, GetRegistryLength("a.foo.com"));
+  ExpectStats(1, 0);
+
+  // The same bytes with a different length are a different hostname.
+  EXPECT_EQ(7, GetRegistryLengthN("a.foo.com.", 9));
+  ExpectStats(1, 0);
+  EXPECT_EQ(0, GetRegistryLength("a.foo.com.."));
+  ExpectStats(0, 1);
+
+  // The cache is keyed by the raw bytes, so case matters.
+  EXPECT_EQ(7, GetRegistryLength("A.FOO.COM"));
+  ExpectStats(0, 1);
+
+  // Results with and without unknown registries are cached separately.
+  EXPECT_EQ(0, GetRegistryLength("foo.bar"));
+  ExpectStats(0, 1);
+  EXPECT_EQ(3, GetRegistryLengthAllowUnknownRegistries("foo.bar"));
+  ExpectStats(0, 1);
+  EXPECT_EQ(3, GetRegistryLengthAllowUnknownRegistries("foo.bar"));
+  ExpectStats(1, 0);
+}
+
+TEST_F(ResultCacheTest, LongHostnamesAreNotCached) {
+  EXPECT_EQ(7, GetRegistryLength(kLongestAllowedHostname));
+  EXPECT_EQ(7, GetRegistryLength(kLongestAllowedHostname));
+  ExpectStats(0, 2);
+}
+
+TEST_F(ResultCacheTest, BatchDoesNotUseCache) {
+  const char* const kHostnames[] = { "a.foo.com", "a.foo.com" };
+  size_t registry_lens[2];
+  GetRegistryLengthBatch(kHostnames, NULL, 2, registry_lens);
+  EXPECT_EQ(7, registry_lens[0]);
+  EXPECT_EQ(7, registry_lens[1]);
+  ExpectStats(0, 0);
+}
+
+TEST_F(ResultCacheTest, RegistryLengthsDoNotUseCache) {
+  size_t icann_len;
+  size_t private_len;
+  EXPECT_EQ(7, GetRegistryLength("a.foo.com"));
+  ExpectStats(0, 1);
+  GetRegistryLengths("a.foo.com", &icann_len, &private_len);
+  EXPECT_EQ(7, private_len);
+  ExpectStats(0, 0);
+}
+
+TEST_F(ResultCacheTest, SetRegistryTablesInvalidates) {
+  EXPECT_EQ(7, GetRegistryLength("a.foo.com"));
+  EXPECT_EQ(7, GetRegistryLength("a.foo.com"));
+  ExpectStats(1, 1);
+
+  // Install tables with no rules at all.
+  SetRegistryTables(kSimpleStringTable,
+                    kSimpleNodeTable,
+                    0,
+                    kSimpleLeafNodeTable,
+                    kSimpleLeafNodeTableOffset);
+  EXPECT_EQ(0, GetRegistryLength("a.foo.com"));
+  ExpectStats(0, 1);
+}
+
+#else
+
+TEST_F(ResultCacheTest, Disabled) {
+  EXPECT_EQ(7, GetRegistryLength("a.foo.com"));
+  EXPECT_EQ(7, GetRegistryLength("a.foo.com"));
+  ExpectStats(0, 0);
+}
+
+#endif
+
 }  // namespace
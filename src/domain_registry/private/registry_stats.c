@@ -0,0 +1,60 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "domain_registry/private/registry_stats.h"
+
+#include <stdlib.h>
+
+#include "domain_registry/domain_registry.h"
+
+#if defined(DOMAIN_REGISTRY_STATS)
+
+#if defined(_MSC_VER)
+__declspec(thread) struct RegistryStats g_registry_stats;
+#else
+__thread struct RegistryStats g_registry_stats;
+#endif
+
+struct RegistryStats* GetThreadRegistryStats(void) {
+  return &g_registry_stats;
+}
+
+#else  /* DOMAIN_REGISTRY_STATS */
+
+struct RegistryStats* GetThreadRegistryStats(void) {
+  return NULL;
+}
+
+#endif  /* DOMAIN_REGISTRY_STATS */
+
+static size_t LoadCount(const size_t* count) {
+#if defined(_MSC_VER)
+  return *(const volatile size_t*) count;
+#else
+  return __atomic_load_n(count, __ATOMIC_RELAXED);
+#endif
+}
+
+void AddRegistryStats(struct RegistryStats* total,
+                      const struct RegistryStats* stats) {
+  /* RegistryStats holds only size_t counts. */
+  size_t* total_counts = (size_t*) total;
+  const size_t* counts = (const size_t*) stats;
+  size_t i;
+  for (i = 0; i < sizeof(*stats) / sizeof(size_t); ++i) {
+    total_counts[i] += LoadCount(&counts[i]);
+  }
+}
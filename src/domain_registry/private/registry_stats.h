@@ -0,0 +1,74 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * Counters of the events on the lookup path. Each thread counts into
+ * its own RegistryStats, without locks or shared cache lines, and
+ * GetRegistryStats sums those of all threads. The counters are only
+ * compiled in when DOMAIN_REGISTRY_STATS is defined (see
+ * domain_registry_stats in domain_registry.gyp). Otherwise
+ * COUNT_REGISTRY_STAT does nothing. These should not need to be
+ * invoked directly.
+ */
+
+#ifndef DOMAIN_REGISTRY_PRIVATE_REGISTRY_STATS_H_
+#define DOMAIN_REGISTRY_PRIVATE_REGISTRY_STATS_H_
+
+#include <stdlib.h>
+
+#include "domain_registry/domain_registry.h"
+
+#if defined(DOMAIN_REGISTRY_STATS)
+
+#if defined(_MSC_VER)
+extern __declspec(thread) struct RegistryStats g_registry_stats;
+
+#define COUNT_REGISTRY_STAT(name) \
+  ((void) ++*(volatile size_t*) &g_registry_stats.name)
+#else
+extern __thread struct RegistryStats g_registry_stats;
+
+/*
+ * Other threads read the counters while they are counted, so they are
+ * loaded and stored atomically. No ordering is needed, and only the
+ * counting thread stores, so this compiles to a plain increment.
+ */
+#define COUNT_REGISTRY_STAT(name) \
+  __atomic_store_n(&g_registry_stats.name, \
+                   __atomic_load_n(&g_registry_stats.name, \
+                                   __ATOMIC_RELAXED) + 1, \
+                   __ATOMIC_RELAXED)
+#endif
+
+#else  /* DOMAIN_REGISTRY_STATS */
+
+#define COUNT_REGISTRY_STAT(name) ((void) 0)
+
+#endif  /* DOMAIN_REGISTRY_STATS */
+
+/*
+ * Returns the counters of the calling thread, which stay valid until
+ * it exits, or NULL if counting is not compiled in.
+ */
+struct RegistryStats* GetThreadRegistryStats(void);
+
+/*
+ * Add the counts of *stats to *total. *stats may be counted into by
+ * its thread meanwhile.
+ */
+void AddRegistryStats(struct RegistryStats* total,
+                      const struct RegistryStats* stats);
+
+#endif  /* DOMAIN_REGISTRY_PRIVATE_REGISTRY_STATS_H_ */
@@ -0,0 +1,171 @@
+// Copyright 2011 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#endif
+
+#include <string.h>
+
+#include <string>
+
+extern "C" {
+#include "domain_registry/domain_registry.h"
+#include "domain_registry/private/hostname_scanner.h"
+#include "domain_registry/private/registry_stats.h"
+#include "domain_registry/private/registry_tables.h"
+#include "domain_registry/private/trie_search.h"
+}  // extern "C"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+// Include the simple test tables inline.
+#include "domain_registry/testing/simple_node_table.c"
+
+namespace {
+
+// Counts the events since the test started. Other tests may have
+// counted before.
+class RegistryStatsTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    SetRegistryTables(kSimpleStringTable,
+                      kSimpleNodeTable,
+                      kSimpleNumRootChildren,
+                      kSimpleLeafNodeTable,
+                      kSimpleLeafNodeTableOffset);
+    GetRegistryStats(&start_);
+  }
+
+  virtual void TearDown() {
+    SetRegistryTables(NULL, NULL, 0, NULL, 0);
+  }
+
+  struct RegistryStats GetStatsSinceStart() {
+    struct RegistryStats stats;
+    GetRegistryStats(&stats);
+    const size_t* start_counts = reinterpret_cast<const size_t*>(&start_);
+    size_t* counts = reinterpret_cast<size_t*>(&stats);
+    for (size_t i = 0; i < sizeof(stats) / sizeof(size_t); ++i) {
+      counts[i] -= start_counts[i];
+    }
+    return stats;
+  }
+
+  struct RegistryStats start_;
+};
+
+#if defined(DOMAIN_REGISTRY_STATS)
+
+TEST_F(RegistryStatsTest, CountsTrieSearch) {
+  // foo, then the wildcard under foo, then the wildcard in the leaf
+  // node table under *.foo.
+  EXPECT_EQ(7, GetRegistryLength("b.a.x.foo"));
+  struct RegistryStats stats = GetStatsSinceStart();
+  EXPECT_EQ(1, stats.length_lookups);
+  EXPECT_EQ(3, stats.labels_visited);
+  EXPECT_EQ(2, stats.wildcard_fallbacks);
+  EXPECT_EQ(2, stats.exception_probes);
+  EXPECT_EQ(1, stats.leaf_table_hits);
+  EXPECT_LT(0, stats.search_probes);
+  EXPECT_LE(stats.search_probes, stats.string_compares);
+
+  // Found in the leaf node table without the wildcard.
+  EXPECT_EQ(11, GetRegistryLength("a.foo.bar.foo"));
+  stats = GetStatsSinceStart();
+  EXPECT_EQ(2, stats.length_lookups);
+  EXPECT_EQ(6, stats.labels_visited);
+  EXPECT_EQ(2, stats.wildcard_fallbacks);
+  EXPECT_EQ(2, stats.leaf_table_hits);
+}
+
+TEST_F(RegistryStatsTest, CountsEntryPoints) {
+  const char* hostnames[] = { "a.b.foo", "a.com", NULL };
+  size_t registry_lens[3];
+  size_t icann_registry_len;
+  size_t private_registry_len;
+  struct RegistryInfo info;
+
+  GetRegistryLengthN("a.b.foo", 7);
+  GetRegistryLengthAllowUnknownRegistries("a.b.foo");
+  GetRegistryLengths("a.b.foo", &icann_registry_len, &private_registry_len);
+  GetRegistryInfo("a.b.foo", &info);
+  GetRegistryInfoForUrl("http://a.b.foo/", 15, &info);
+  GetRegistryLengthBatch(hostnames, NULL, 3, registry_lens);
+
+  struct RegistryStats stats = GetStatsSinceStart();
+  EXPECT_EQ(2, stats.length_lookups);
+  EXPECT_EQ(1, stats.lengths_lookups);
+  EXPECT_EQ(2, stats.info_lookups);
+  EXPECT_EQ(3, stats.batch_lookups);
+}
+
+TEST_F(RegistryStatsTest, CountsRejects) {
+  std::string too_long(MAX_HOSTNAME_LEN, 'a');
+  too_long += ".foo";
+  EXPECT_EQ(0, GetRegistryLength(too_long.c_str()));
+  EXPECT_EQ(0, GetRegistryLength("b\xc3\xbc" "cher.foo"));
+  EXPECT_EQ(0, GetRegistryLengthN("a\0b.foo", 7));
+  EXPECT_EQ(0, GetRegistryLength("a.b..foo"));
+  EXPECT_EQ(0, GetRegistryLength("a.*.foo"));
+
+  struct RegistryStats stats = GetStatsSinceStart();
+  EXPECT_EQ(1, stats.rejected_too_long);
+  // Null bytes are rejected like non-ASCII characters.
+  EXPECT_EQ(2, stats.rejected_non_ascii);
+  EXPECT_EQ(2, stats.rejected_invalid_component);
+}
+
+#if !defined(_WIN32)
+
+// Uses GetRegistryLengths, which the result cache does not answer, so
+// that every lookup searches the tables.
+void* LookupThread(void* arg) {
+  (void) arg;
+  for (int i = 0; i < 10; ++i) {
+    size_t icann_registry_len;
+    size_t private_registry_len;
+    GetRegistryLengths("b.a.x.foo", &icann_registry_len,
+                       &private_registry_len);
+  }
+  return NULL;
+}
+
+TEST_F(RegistryStatsTest, CountsExitedThreads) {
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, LookupThread, NULL));
+  pthread_join(thread, NULL);
+  struct RegistryStats stats = GetStatsSinceStart();
+  EXPECT_EQ(10, stats.lengths_lookups);
+  EXPECT_EQ(30, stats.labels_visited);
+}
+
+#endif  // !defined(_WIN32)
+
+#else  // DOMAIN_REGISTRY_STATS
+
+TEST_F(RegistryStatsTest, CompiledOut) {
+  struct RegistryStats zero;
+  struct RegistryStats stats;
+  memset(&zero, 0, sizeof(zero));
+  EXPECT_EQ(7, GetRegistryLength("b.a.x.foo"));
+  EXPECT_EQ(0, GetRegistryLength("a.b..foo"));
+  GetRegistryStats(&stats);
+  EXPECT_EQ(0, memcmp(&zero, &stats, sizeof(stats)));
+  EXPECT_TRUE(GetThreadRegistryStats() == NULL);
+}
+
+#endif  // DOMAIN_REGISTRY_STATS
+
+}  // namespace
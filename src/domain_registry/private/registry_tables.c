@@ -0,0 +1,442 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "domain_registry/private/registry_tables.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "domain_registry/domain_registry.h"
+#include "domain_registry/private/assert.h"
+#include "domain_registry/private/registry_overlay.h"
+#include "domain_registry/private/registry_stats.h"
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#if defined(_WIN32)
+#define THREAD_EXIT_CALLBACK NTAPI
+#else
+#define THREAD_EXIT_CALLBACK
+#endif
+
+/*
+ * A thread that has looked up hostnames. Readers are linked into a
+ * list that installers walk, and are removed when their thread exits.
+ */
+struct RegistryTablesReader {
+  /*
+   * The epoch in which the thread acquired the tables it is using, or
+   * 0 if it is not using any. The only member other threads read.
+   */
+  volatile REGISTRY_U32 epoch;
+
+  /* The number of nested AcquireRegistryTables calls. */
+  unsigned depth;
+
+  /* The registry passed to the outermost call, and its tables. */
+  const struct DomainRegistry* registry;
+  const struct RegistryTables* tables;
+
+  /*
+   * The thread's lookup counters, or NULL if they are not compiled
+   * in. Summed by GetRegistryStats.
+   */
+  const struct RegistryStats* stats;
+
+  struct RegistryTablesReader* next;
+};
+
+/* Returned by AcquireRegistryTables until tables are installed. */
+static const struct RegistryTables kNoRegistryTables;
+
+/* The registry used by the functions that do not take one. */
+static struct DomainRegistry g_default_registry = {
+  &kNoRegistryTables,
+  { { 0 }, { 0 } }
+};
+
+/* Incremented each time tables are installed. Never 0. */
+static volatile REGISTRY_U32 g_epoch = 1;
+
+/*
+ * Serializes installers, and guards the list of readers. Never taken
+ * by lookups, except by those on threads that could not allocate a
+ * reader.
+ */
+static volatile REGISTRY_U32 g_lock = 0;
+static struct RegistryTablesReader* g_readers = NULL;
+
+/* The lookup counters of the threads that have exited. */
+static struct RegistryStats g_exited_stats;
+
+static THREAD_LOCAL struct RegistryTablesReader* g_reader = NULL;
+
+/*
+ * The number of nested AcquireRegistryTables calls holding g_lock, on
+ * a thread without a reader.
+ */
+static THREAD_LOCAL unsigned g_locked_depth = 0;
+
+#if defined(_WIN32)
+static INIT_ONCE g_reader_key_once = INIT_ONCE_STATIC_INIT;
+static DWORD g_reader_key = FLS_OUT_OF_INDEXES;
+#else
+static pthread_once_t g_reader_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_reader_key;
+static int g_reader_key_created = 0;
+#endif
+
+/*
+ * Sequentially consistent atomic operations. Lookups use the cheaper
+ * release store to leave their epoch.
+ */
+#if defined(_MSC_VER)
+static REGISTRY_U32 AtomicLoad(volatile REGISTRY_U32* p) {
+  return (REGISTRY_U32) InterlockedCompareExchange((volatile LONG*) p, 0, 0);
+}
+
+static void AtomicStore(volatile REGISTRY_U32* p, REGISTRY_U32 value) {
+  InterlockedExchange((volatile LONG*) p, (LONG) value);
+}
+
+static void AtomicStoreRelease(volatile REGISTRY_U32* p, REGISTRY_U32 value) {
+  InterlockedExchange((volatile LONG*) p, (LONG) value);
+}
+
+static REGISTRY_U32 AtomicExchange(volatile REGISTRY_U32* p,
+                                   REGISTRY_U32 value) {
+  return (REGISTRY_U32) InterlockedExchange((volatile LONG*) p, (LONG) value);
+}
+
+static const struct RegistryTables* LoadTables(
+    const struct DomainRegistry* registry) {
+  return (const struct RegistryTables*) InterlockedCompareExchangePointer(
+      (PVOID volatile*) &registry->tables, NULL, NULL);
+}
+
+static void StoreTables(struct DomainRegistry* registry,
+                        const struct RegistryTables* tables) {
+  InterlockedExchangePointer((PVOID volatile*) &registry->tables,
+                             (PVOID) tables);
+}
+#else
+static REGISTRY_U32 AtomicLoad(volatile REGISTRY_U32* p) {
+  return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+static void AtomicStore(volatile REGISTRY_U32* p, REGISTRY_U32 value) {
+  __atomic_store_n(p, value, __ATOMIC_SEQ_CST);
+}
+
+static void AtomicStoreRelease(volatile REGISTRY_U32* p, REGISTRY_U32 value) {
+  __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+static REGISTRY_U32 AtomicExchange(volatile REGISTRY_U32* p,
+                                   REGISTRY_U32 value) {
+  return __atomic_exchange_n(p, value, __ATOMIC_SEQ_CST);
+}
+
+static const struct RegistryTables* LoadTables(
+    const struct DomainRegistry* registry) {
+  return __atomic_load_n(&registry->tables, __ATOMIC_SEQ_CST);
+}
+
+static void StoreTables(struct DomainRegistry* registry,
+                        const struct RegistryTables* tables) {
+  __atomic_store_n(&registry->tables, tables, __ATOMIC_SEQ_CST);
+}
+#endif
+
+static void YieldThread(void) {
+#if defined(_WIN32)
+  SwitchToThread();
+#else
+  sched_yield();
+#endif
+}
+
+static void LockRegistryTables(void) {
+  while (AtomicExchange(&g_lock, 1) != 0) {
+    YieldThread();
+  }
+}
+
+static void UnlockRegistryTables(void) {
+  AtomicStore(&g_lock, 0);
+}
+
+/* Called when a thread with a reader exits. */
+static void THREAD_EXIT_CALLBACK UnregisterReader(void* data) {
+  struct RegistryTablesReader* reader = (struct RegistryTablesReader*) data;
+  struct RegistryTablesReader** link;
+
+  if (reader == NULL) {
+    return;
+  }
+  LockRegistryTables();
+  for (link = &g_readers; *link != NULL; link = &(*link)->next) {
+    if (*link == reader) {
+      *link = reader->next;
+      break;
+    }
+  }
+  if (reader->stats != NULL) {
+    AddRegistryStats(&g_exited_stats, reader->stats);
+  }
+  UnlockRegistryTables();
+  free(reader);
+  g_reader = NULL;
+}
+
+#if defined(_WIN32)
+static BOOL CALLBACK CreateReaderKey(PINIT_ONCE once,
+                                     PVOID parameter,
+                                     PVOID* context) {
+  g_reader_key = FlsAlloc(UnregisterReader);
+  return TRUE;
+}
+#else
+static void CreateReaderKey(void) {
+  g_reader_key_created =
+      pthread_key_create(&g_reader_key, UnregisterReader) == 0;
+}
+#endif
+
+/*
+ * Have UnregisterReader called with reader when the calling thread
+ * exits. Returns 0 on failure.
+ */
+static int SetReaderKey(struct RegistryTablesReader* reader) {
+#if defined(_WIN32)
+  InitOnceExecuteOnce(&g_reader_key_once, CreateReaderKey, NULL, NULL);
+  return g_reader_key != FLS_OUT_OF_INDEXES &&
+      FlsSetValue(g_reader_key, reader);
+#else
+  pthread_once(&g_reader_key_once, CreateReaderKey);
+  return g_reader_key_created &&
+      pthread_setspecific(g_reader_key, reader) == 0;
+#endif
+}
+
+/*
+ * Create the calling thread's reader. Returns NULL if it could not be
+ * created, in which case lookups on the thread take g_lock instead.
+ */
+static struct RegistryTablesReader* RegisterReader(void) {
+  struct RegistryTablesReader* reader =
+      (struct RegistryTablesReader*) calloc(1, sizeof(*reader));
+  if (reader == NULL) {
+    return NULL;
+  }
+  /*
+   * A reader that is never unregistered would be freed with its
+   * thread while still on the list.
+   */
+  if (!SetReaderKey(reader)) {
+    free(reader);
+    return NULL;
+  }
+  reader->stats = GetThreadRegistryStats();
+  LockRegistryTables();
+  reader->next = g_readers;
+  g_readers = reader;
+  UnlockRegistryTables();
+  g_reader = reader;
+  return reader;
+}
+
+struct DomainRegistry* NewDomainRegistry(void) {
+  struct DomainRegistry* registry =
+      (struct DomainRegistry*) calloc(1, sizeof(*registry));
+  if (registry != NULL) {
+    registry->tables = &kNoRegistryTables;
+  }
+  return registry;
+}
+
+void DestroyDomainRegistry(struct DomainRegistry* registry) {
+  struct RegistryTables tables;
+  if (registry == NULL) {
+    return;
+  }
+  DCHECK(registry != &g_default_registry);
+  /* Release the installed tables. */
+  memset(&tables, 0, sizeof(tables));
+  InstallRegistryTables(registry, &tables);
+  FreeRegistryOverlay(registry->tables->overlay);
+  free(registry);
+}
+
+struct DomainRegistry* GetDefaultDomainRegistry(void) {
+  return &g_default_registry;
+}
+
+const struct RegistryTables* AcquireRegistryTables(
+    const struct DomainRegistry* registry) {
+  struct RegistryTablesReader* reader = g_reader;
+
+  if (g_locked_depth > 0 ||
+      (reader == NULL && (reader = RegisterReader()) == NULL)) {
+    if (g_locked_depth++ == 0) {
+      LockRegistryTables();
+    }
+    return LoadTables(registry);
+  }
+  if (reader->depth++ == 0) {
+    /*
+     * Publish the epoch before loading the tables. An installer that
+     * swaps the tables after the load sees the epoch, and waits.
+     */
+    AtomicStore(&reader->epoch, AtomicLoad(&g_epoch));
+    reader->registry = registry;
+    reader->tables = LoadTables(registry);
+  } else if (registry != reader->registry) {
+    /*
+     * The epoch published by the outermost call also keeps these
+     * tables from being released.
+     */
+    return LoadTables(registry);
+  }
+  return reader->tables;
+}
+
+void ReleaseRegistryTables(void) {
+  struct RegistryTablesReader* reader = g_reader;
+
+  if (g_locked_depth > 0) {
+    if (--g_locked_depth == 0) {
+      UnlockRegistryTables();
+    }
+    return;
+  }
+  DCHECK(reader != NULL && reader->depth > 0);
+  if (--reader->depth == 0) {
+    AtomicStoreRelease(&reader->epoch, 0);
+  }
+}
+
+void GetRegistryStats(struct RegistryStats* stats) {
+  const struct RegistryTablesReader* reader;
+
+  DCHECK(g_locked_depth == 0);
+  memset(stats, 0, sizeof(*stats));
+  LockRegistryTables();
+  AddRegistryStats(stats, &g_exited_stats);
+  for (reader = g_readers; reader != NULL; reader = reader->next) {
+    if (reader->stats != NULL) {
+      AddRegistryStats(stats, reader->stats);
+    }
+  }
+  UnlockRegistryTables();
+}
+
+void GetRegistryTables(const struct DomainRegistry* registry,
+                       struct RegistryTables* tables) {
+  LockRegistryTables();
+  *tables = *LoadTables(registry);
+  UnlockRegistryTables();
+}
+
+/*
+ * Install a copy of *tables in registry, and wait until no lookup
+ * uses the previous tables, which are returned. They stay valid until
+ * the next call. Called with g_lock held, and not between
+ * AcquireRegistryTables and ReleaseRegistryTables, since it would
+ * wait for the calling thread.
+ */
+static const struct RegistryTables* SwapRegistryTables(
+    struct DomainRegistry* registry,
+    const struct RegistryTables* tables) {
+  const struct RegistryTables* previous;
+  struct RegistryTables* installed;
+  struct RegistryTablesReader* reader;
+  REGISTRY_U32 epoch;
+
+  previous = LoadTables(registry);
+  installed = registry->installed_tables +
+      (previous == registry->installed_tables ? 1 : 0);
+  epoch = AtomicLoad(&g_epoch) + 1;
+  if (epoch == 0) {
+    epoch = 1;
+  }
+  *installed = *tables;
+  installed->generation = epoch;
+  StoreTables(registry, installed);
+  AtomicStore(&g_epoch, epoch);
+
+  /*
+   * Wait for the lookups that acquired the tables in an earlier epoch,
+   * and so may be using the previous tables. Lookups that start now
+   * get the new ones.
+   */
+  for (reader = g_readers; reader != NULL; reader = reader->next) {
+    REGISTRY_U32 reader_epoch;
+    while ((reader_epoch = AtomicLoad(&reader->epoch)) != 0 &&
+           reader_epoch != epoch) {
+      YieldThread();
+    }
+  }
+  return previous;
+}
+
+void InstallRegistryTables(struct DomainRegistry* registry,
+                           const struct RegistryTables* tables) {
+  struct RegistryTables copy = *tables;
+  const struct RegistryTables* previous;
+  const struct RegistryTables* installed;
+
+  DCHECK(g_locked_depth == 0 && (g_reader == NULL || g_reader->depth == 0));
+  LockRegistryTables();
+  copy.overlay = LoadTables(registry)->overlay;
+  previous = SwapRegistryTables(registry, &copy);
+  installed = LoadTables(registry);
+  if (previous->release != NULL &&
+      (previous->release != installed->release ||
+       previous->release_context != installed->release_context)) {
+    previous->release(previous->release_context);
+  }
+  UnlockRegistryTables();
+}
+
+void UpdateRegistryOverlay(struct DomainRegistry* registry,
+                           RegistryOverlayUpdate update,
+                           void* context) {
+  struct RegistryTables tables;
+  const struct RegistryOverlay* previous;
+
+  DCHECK(g_locked_depth == 0 && (g_reader == NULL || g_reader->depth == 0));
+  LockRegistryTables();
+  tables = *LoadTables(registry);
+  previous = tables.overlay;
+  tables.overlay = update(previous, context);
+  if (tables.overlay != previous) {
+    SwapRegistryTables(registry, &tables);
+    FreeRegistryOverlay(previous);
+  }
+  UnlockRegistryTables();
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * The set of tables lookups search, and the functions to replace it
+ * while other threads are looking up hostnames. These should not need
+ * to be invoked directly.
+ *
+ * Each DomainRegistry has its own set of installed tables. Installed
+ * tables are immutable. Lookups reach them through a single atomic
+ * pointer per registry, between AcquireRegistryTables and
+ * ReleaseRegistryTables, and never take a lock. Installing new tables
+ * swaps the pointer, then waits for the lookups that may still be
+ * using the previous tables before releasing them: each thread
+ * publishes the epoch it acquired the tables in, and the installer
+ * waits until no thread is in an epoch from before the swap. Epochs
+ * are shared by all registries. Rules added at runtime are installed
+ * the same way, as part of the tables.
+ */
+
+#ifndef DOMAIN_REGISTRY_PRIVATE_REGISTRY_TABLES_H_
+#define DOMAIN_REGISTRY_PRIVATE_REGISTRY_TABLES_H_
+
+#include <stdlib.h>
+
+#include "domain_registry/private/registry_types.h"
+#include "domain_registry/private/trie_node.h"
+
+struct RegistryOverlay;
+
+/*
+ * Generated code that matches a hostname-part against the children of
+ * the node numbered parent. See SetRegistryMatcher.
+ */
+typedef REGISTRY_U32 (*RegistryMatcher)(REGISTRY_U32 parent,
+                                        const char* component,
+                                        size_t component_len);
+
+/*
+ * A complete set of tables. Only the trie tables are required; the
+ * others speed up or replace the trie search when present. See the
+ * corresponding Set functions for a description of each.
+ */
+struct RegistryTables {
+  /* See SetRegistryTables. */
+  const char* string_table;
+  const struct TrieNode* node_table;
+  size_t num_root_children;
+  const TrieLeafNode* leaf_node_table;
+  size_t leaf_node_table_offset;
+
+  /* See SetRootHashTable. */
+  const REGISTRY_U16* root_hash_displacements;
+  size_t num_root_hash_buckets;
+  const struct RootHashEntry* root_hash_table;
+
+  /* See SetNodeFingerprintTables. */
+  const unsigned char* node_fingerprints;
+  const unsigned char* leaf_fingerprints;
+
+  /* See SetNodeSectionTables. */
+  const unsigned char* node_sections;
+  const unsigned char* leaf_sections;
+
+  /* See SetSuffixHashTable. */
+  const struct SuffixHashEntry* suffix_hash_table;
+  size_t suffix_hash_table_size;
+  REGISTRY_U32 suffix_hash_seed;
+
+  /* See SetDafsa. */
+  const unsigned char* dafsa;
+  size_t dafsa_len;
+
+  /* See SetRegistryMatcher. */
+  RegistryMatcher matcher;
+
+  /*
+   * Rules added at runtime, searched along with the tables above, or
+   * NULL if there are none. Only replaced by UpdateRegistryOverlay:
+   * InstallRegistryTables keeps the installed overlay.
+   */
+  const struct RegistryOverlay* overlay;
+
+  /*
+   * If not NULL, called with release_context once the tables have
+   * been replaced and no lookup uses them any more, e.g. to unmap the
+   * file they were loaded from. Not called if the replacement has the
+   * same release function and context, i.e. still uses the same
+   * memory.
+   */
+  void (*release)(void* release_context);
+  void* release_context;
+
+  /*
+   * Assigned by InstallRegistryTables. Unique to each installed set,
+   * across all registries.
+   */
+  unsigned generation;
+};
+
+/* See domain_registry.h. */
+struct DomainRegistry {
+  /* The installed tables. Never NULL. */
+  const struct RegistryTables* volatile tables;
+
+  /*
+   * Installed tables are copied into whichever of these is not
+   * current. Since InstallRegistryTables waits until the previous
+   * tables are no longer used, two are enough.
+   */
+  struct RegistryTables installed_tables[2];
+};
+
+/*
+ * Allocate a registry with no tables installed. Returns NULL if out of
+ * memory. Free with DestroyDomainRegistry.
+ */
+struct DomainRegistry* NewDomainRegistry(void);
+
+/*
+ * Get the tables installed in registry, which stay valid until the
+ * matching call to ReleaseRegistryTables on the same thread. Calls may
+ * be nested, in which case inner calls for the same registry return
+ * the same tables as the outermost one. Never returns NULL; before any
+ * tables are installed, returns tables with all members NULL. Does not
+ * lock, and only allocates the first time a thread calls it.
+ */
+const struct RegistryTables* AcquireRegistryTables(
+    const struct DomainRegistry* registry);
+
+/* End the use of the tables returned by AcquireRegistryTables. */
+void ReleaseRegistryTables(void);
+
+/*
+ * Copy the tables installed in registry into *tables, so that some of
+ * them can be replaced with InstallRegistryTables.
+ */
+void GetRegistryTables(const struct DomainRegistry* registry,
+                       struct RegistryTables* tables);
+
+/*
+ * Install a copy of *tables in registry, in place of its installed
+ * tables. Lookups that start after this returns use the new tables.
+ * Blocks until no lookup uses the previous tables, then releases them,
+ * so it must not be called between AcquireRegistryTables and
+ * ReleaseRegistryTables. Lookups on other threads are never blocked.
+ * Calls from different threads are serialized. The overlay of tables
+ * is ignored.
+ */
+void InstallRegistryTables(struct DomainRegistry* registry,
+                           const struct RegistryTables* tables);
+
+/*
+ * Returns the overlay to install in place of overlay, the installed
+ * one (NULL if there is none). Returning overlay itself leaves the
+ * tables unchanged.
+ */
+typedef const struct RegistryOverlay* (*RegistryOverlayUpdate)(
+    const struct RegistryOverlay* overlay,
+    void* context);
+
+/*
+ * Replace the overlay installed in registry with the one update
+ * returns when called with it and context. update is called with
+ * installers serialized, so the overlay it is passed stays installed
+ * until it returns; it must not install tables itself. Like
+ * InstallRegistryTables, blocks until no lookup uses the previous
+ * overlay, then frees it with FreeRegistryOverlay.
+ */
+void UpdateRegistryOverlay(struct DomainRegistry* registry,
+                           RegistryOverlayUpdate update,
+                           void* context);
+
+#endif  /* DOMAIN_REGISTRY_PRIVATE_REGISTRY_TABLES_H_ */
@@ -0,0 +1,303 @@
+// Copyright 2011 Google Inc. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "domain_registry/domain_registry.h"
+#include "domain_registry/private/registry_tables.h"
+#include "domain_registry/private/trie_search.h"
+}  // extern "C"
+
+#include "testing/gtest/include/gtest/gtest.h"
+
+// Include the simple test tables inline.
+#include "domain_registry/testing/simple_node_table.c"
+
+namespace {
+
+// The number of sets of tables released so far.
+volatile int g_num_released = 0;
+
+// A heap copy of the simple test tables, released when it is replaced.
+struct TablesCopy {
+  std::string string_table;
+  std::vector<struct TrieNode> nodes;
+  std::vector<TrieLeafNode> leaf_nodes;
+};
+
+void ReleaseTablesCopy(void* release_context) {
+  TablesCopy* copy = static_cast<TablesCopy*>(release_context);
+  // Overwrite the tables before freeing them, so that a lookup that
+  // still uses them gets the wrong result even without ASan.
+  memset(&copy->string_table[0], 0xff, copy->string_table.size());
+  memset(&copy->nodes[0], 0xff,
+         copy->nodes.size() * sizeof(copy->nodes[0]));
+  memset(&copy->leaf_nodes[0], 0xff,
+         copy->leaf_nodes.size() * sizeof(copy->leaf_nodes[0]));
+  delete copy;
+  __sync_fetch_and_add(&g_num_released, 1);
+}
+
+// Install a copy of the simple tables with the given number of root
+// nodes in registry. With 1, only "com" is a root node.
+void InstallTablesCopy(struct DomainRegistry* registry,
+                       size_t num_root_children) {
+  TablesCopy* copy = new TablesCopy;
+  copy->string_table.assign(kSimpleStringTable, sizeof(kSimpleStringTable));
+  copy->nodes.assign(kSimpleNodeTable,
+                     kSimpleNodeTable + sizeof(kSimpleNodeTable) /
+                         sizeof(kSimpleNodeTable[0]));
+  copy->leaf_nodes.assign(kSimpleLeafNodeTable,
+                          kSimpleLeafNodeTable + sizeof(kSimpleLeafNodeTable) /
+                              sizeof(kSimpleLeafNodeTable[0]));
+
+  struct RegistryTables tables;
+  memset(&tables, 0, sizeof(tables));
+  tables.string_table = copy->string_table.data();
+  tables.node_table = &copy->nodes[0];
+  tables.num_root_children = num_root_children;
+  tables.leaf_node_table = &copy->leaf_nodes[0];
+  tables.leaf_node_table_offset = kSimpleLeafNodeTableOffset;
+  tables.release = ReleaseTablesCopy;
+  tables.release_context = copy;
+  InstallRegistryTables(registry, &tables);
+}
+
+void InstallTablesCopy(size_t num_root_children) {
+  InstallTablesCopy(GetDefaultDomainRegistry(), num_root_children);
+}
+
+const struct RegistryTables* AcquireDefaultTables() {
+  return AcquireRegistryTables(GetDefaultDomainRegistry());
+}
+
+class RegistryTablesTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    SetRegistryTables(NULL, NULL, 0, NULL, 0);
+    g_num_released = 0;
+  }
+
+  virtual void TearDown() {
+    SetRegistryTables(NULL, NULL, 0, NULL, 0);
+  }
+};
+
+TEST_F(RegistryTablesTest, Install) {
+  InstallTablesCopy(kSimpleNumRootChildren);
+  EXPECT_EQ(11, GetRegistryLength("www.zzz.bar.foo"));
+  EXPECT_EQ(7, GetRegistryLength("a.foo.com"));
+  EXPECT_EQ(0, g_num_released);
+
+  InstallTablesCopy(1);
+  EXPECT_EQ(0, GetRegistryLength("www.zzz.bar.foo"));
+  EXPECT_EQ(7, GetRegistryLength("a.foo.com"));
+  EXPECT_EQ(1, g_num_released);
+
+  SetRegistryTables(NULL, NULL, 0, NULL, 0);
+  EXPECT_EQ(2, g_num_released);
+}
+
+TEST_F(RegistryTablesTest, Generation) {
+  const unsigned generation = AcquireDefaultTables()->generation;
+  ReleaseRegistryTables();
+  InstallTablesCopy(kSimpleNumRootChildren);
+  EXPECT_NE(generation, AcquireDefaultTables()->generation);
+  ReleaseRegistryTables();
+}
+
+TEST_F(RegistryTablesTest, SetKeepsRelease) {
+  // Adding tables to the installed ones keeps the installed tables in
+  // use, so they are not released.
+  InstallTablesCopy(kSimpleNumRootChildren);
+  SetNodeFingerprintTables(kSimpleNodeFingerprintTable,
+                           kSimpleLeafFingerprintTable);
+  EXPECT_EQ(0, g_num_released);
+  EXPECT_EQ(11, GetRegistryLength("www.zzz.bar.foo"));
+
+  const struct RegistryTables* tables = AcquireDefaultTables();
+  EXPECT_TRUE(tables->node_fingerprints != NULL);
+  EXPECT_TRUE(tables->release == ReleaseTablesCopy);
+  ReleaseRegistryTables();
+
+  SetRegistryTables(NULL, NULL, 0, NULL, 0);
+  EXPECT_EQ(1, g_num_released);
+}
+
+TEST_F(RegistryTablesTest, NestedAcquire) {
+  InstallTablesCopy(kSimpleNumRootChildren);
+  const struct RegistryTables* tables = AcquireDefaultTables();
+  EXPECT_EQ(tables, AcquireDefaultTables());
+  ReleaseRegistryTables();
+  ReleaseRegistryTables();
+}
+
+TEST_F(RegistryTablesTest, Registries) {
+  struct DomainRegistry* all_rules = NewDomainRegistry();
+  struct DomainRegistry* com_only = NewDomainRegistry();
+  ASSERT_TRUE(all_rules != NULL);
+  ASSERT_TRUE(com_only != NULL);
+
+  InstallTablesCopy(all_rules, kSimpleNumRootChildren);
+  InstallTablesCopy(com_only, 1);
+  EXPECT_EQ(11, DomainRegistryGetRegistryLength(all_rules,
+                                                "www.zzz.bar.foo"));
+  EXPECT_EQ(0, DomainRegistryGetRegistryLength(com_only, "www.zzz.bar.foo"));
+  EXPECT_EQ(7, DomainRegistryGetRegistryLength(com_only, "a.foo.com"));
+  EXPECT_EQ(3, DomainRegistryGetRegistryLengthAllowUnknownRegistriesN(
+      com_only, "www.zzz.bar.foo", 15));
+
+  // The default registry is unaffected.
+  const struct RegistryTables* tables = AcquireDefaultTables();
+  EXPECT_TRUE(tables->node_table == NULL);
+  ReleaseRegistryTables();
+
+  // Each registry has its own generation.
+  const unsigned generation = AcquireRegistryTables(all_rules)->generation;
+  EXPECT_NE(generation, AcquireRegistryTables(com_only)->generation);
+  ReleaseRegistryTables();
+  ReleaseRegistryTables();
+
+  const char* hostnames[] = { "a.foo.com", "www.zzz.bar.foo" };
+  size_t registry_lens[2];
+  DomainRegistryGetRegistryLengthBatch(com_only, hostnames, NULL, 2,
+                                       registry_lens);
+  EXPECT_EQ(7, registry_lens[0]);
+  EXPECT_EQ(0, registry_lens[1]);
+
+  EXPECT_EQ(0, g_num_released);
+  DestroyDomainRegistry(all_rules);
+  EXPECT_EQ(1, g_num_released);
+  DestroyDomainRegistry(com_only);
+  EXPECT_EQ(2, g_num_released);
+  DestroyDomainRegistry(NULL);
+}
+
+TEST_F(RegistryTablesTest, NestedAcquireOfOtherRegistry) {
+  struct DomainRegistry* registry = NewDomainRegistry();
+  ASSERT_TRUE(registry != NULL);
+  InstallTablesCopy(kSimpleNumRootChildren);
+  InstallTablesCopy(registry, 1);
+
+  const struct RegistryTables* tables = AcquireDefaultTables();
+  const struct RegistryTables* other = AcquireRegistryTables(registry);
+  EXPECT_NE(tables, other);
+  EXPECT_EQ(1, other->num_root_children);
+  ReleaseRegistryTables();
+  // Lookups in either registry, nested in the use of the tables, use
+  // the tables of the registry they look up.
+  EXPECT_EQ(11, GetRegistryLength("www.zzz.bar.foo"));
+  EXPECT_EQ(0, DomainRegistryGetRegistryLength(registry, "www.zzz.bar.foo"));
+  EXPECT_EQ(tables, AcquireDefaultTables());
+  ReleaseRegistryTables();
+  ReleaseRegistryTables();
+
+  DestroyDomainRegistry(registry);
+}
+
+#if !defined(_WIN32)
+
+volatile int g_installed = 0;
+
+void* InstallTablesCopyThread(void* arg) {
+  (void) arg;
+  InstallTablesCopy(1);
+  __sync_fetch_and_add(&g_installed, 1);
+  return NULL;
+}
+
+TEST_F(RegistryTablesTest, InstallWaitsForLookups) {
+  InstallTablesCopy(kSimpleNumRootChildren);
+  const struct RegistryTables* tables = AcquireDefaultTables();
+  g_installed = 0;
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, InstallTablesCopyThread, NULL));
+
+  // The tables this thread uses are not released while it uses them,
+  // even though new ones have been installed.
+  usleep(50 * 1000);
+  EXPECT_EQ(0, g_installed);
+  EXPECT_EQ(0, g_num_released);
+  EXPECT_EQ(tables, AcquireDefaultTables());
+  ReleaseRegistryTables();
+  // Lookups nested in the use of the tables also use them.
+  EXPECT_EQ(11, GetRegistryLength("www.zzz.bar.foo"));
+  ReleaseRegistryTables();
+
+  pthread_join(thread, NULL);
+  EXPECT_EQ(1, g_installed);
+  EXPECT_EQ(1, g_num_released);
+  EXPECT_EQ(0, GetRegistryLength("www.zzz.bar.foo"));
+}
+
+// Lookups whose results differ between the two sets of tables the
+// stress test alternates between are checked against both.
+const int kNumLookupThreads = 4;
+const int kNumInstalls = 2000;
+
+volatile int g_stop = 0;
+
+void* LookupThread(void* arg) {
+  int* num_errors = static_cast<int*>(arg);
+  const char* hostnames[] = { "a.foo.com", "www.zzz.bar.foo" };
+  size_t registry_lens[2];
+  while (!__sync_fetch_and_add(&g_stop, 0)) {
+    if (GetRegistryLength("a.foo.com") != 7) ++*num_errors;
+    const size_t len = GetRegistryLength("www.zzz.bar.foo");
+    if (len != 11 && len != 0) ++*num_errors;
+    if (GetRegistryLength("bar.com") != 0) ++*num_errors;
+
+    GetRegistryLengthBatch(hostnames, NULL, 2, registry_lens);
+    if (registry_lens[0] != 7) ++*num_errors;
+    if (registry_lens[1] != 11 && registry_lens[1] != 0) ++*num_errors;
+  }
+  return NULL;
+}
+
+TEST_F(RegistryTablesTest, InstallDuringLookups) {
+  InstallTablesCopy(kSimpleNumRootChildren);
+  g_stop = 0;
+  pthread_t threads[kNumLookupThreads];
+  int num_errors[kNumLookupThreads] = { 0 };
+  for (int i = 0; i < kNumLookupThreads; ++i) {
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, LookupThread,
+                                &num_errors[i]));
+  }
+  for (int i = 0; i < kNumInstalls; ++i) {
+    InstallTablesCopy(i % 2 == 0 ? 1 : kSimpleNumRootChildren);
+  }
+  __sync_fetch_and_add(&g_stop, 1);
+  for (int i = 0; i < kNumLookupThreads; ++i) {
+    pthread_join(threads[i], NULL);
+    EXPECT_EQ(0, num_errors[i]);
+  }
+  EXPECT_EQ(kNumInstalls, g_num_released);
+
+  // The readers of the exited threads are gone.
+  InstallTablesCopy(kSimpleNumRootChildren);
+  EXPECT_EQ(kNumInstalls + 1, g_num_released);
+}
+
+#endif  // !defined(_WIN32)
+
+}  // namespace
@@ -18,5 +18,12 @@
 #define DOMAIN_REGISTRY_PRIVATE_REGISTRY_TYPES_H_
 
 typedef unsigned short REGISTRY_U16;
+typedef unsigned int REGISTRY_U32;
+
+#if defined(_MSC_VER)
+typedef unsigned __int64 REGISTRY_U64;
+#else
+typedef unsigned long long REGISTRY_U64;
+#endif
 
 #endif  /* DOMAIN_REGISTRY_PRIVATE_REGISTRY_TYPES_H_ */
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "domain_registry/private/result_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "domain_registry/domain_registry.h"
+#include "domain_registry/private/hash_util.h"
+
+#if defined(DOMAIN_REGISTRY_RESULT_CACHE_SIZE) && \
+    DOMAIN_REGISTRY_RESULT_CACHE_SIZE > 0
+
+#if (DOMAIN_REGISTRY_RESULT_CACHE_SIZE & \
+     (DOMAIN_REGISTRY_RESULT_CACHE_SIZE - 1)) != 0
+#error "DOMAIN_REGISTRY_RESULT_CACHE_SIZE must be a power of two."
+#endif
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+/* A cached registry length. Fills one 64 byte cache line. */
+struct ResultCacheEntry {
+  /* The generation of the registry tables the entry was computed with. */
+  unsigned generation;
+
+  /* The length of the hostname, or 0 if the entry is empty. */
+  unsigned char hostname_len;
+  unsigned char allow_unknown_registries;
+  unsigned char registry_len;
+  char hostname[MAX_CACHED_HOSTNAME_LEN];
+};
+
+/*
+ * The calling thread's cache. Each hostname maps to a single slot, so
+ * a lookup touches one entry and an insert replaces whatever was
+ * there. Since the cache is per thread, no locks are needed.
+ */
+static THREAD_LOCAL struct ResultCacheEntry
+    g_entries[DOMAIN_REGISTRY_RESULT_CACHE_SIZE];
+
+static THREAD_LOCAL size_t g_hits = 0;
+static THREAD_LOCAL size_t g_misses = 0;
+
+static struct ResultCacheEntry* GetResultCacheEntry(unsigned generation,
+                                                    const char* hostname,
+                                                    size_t hostname_len) {
+  /*
+   * Entries are tagged with their generation rather than the cache
+   * being emptied when it changes, so that lookups in different
+   * registries do not empty each other's entries. Mixing in the
+   * generation also gives the same hostname in different registries
+   * different slots.
+   */
+  return g_entries +
+      (MixHash(HashHostnamePart(hostname, hostname_len) ^ generation) &
+       (DOMAIN_REGISTRY_RESULT_CACHE_SIZE - 1));
+}
+
+int LookupResultCache(unsigned generation,
+                      const char* hostname,
+                      size_t hostname_len,
+                      int allow_unknown_registries,
+                      size_t* registry_len) {
+  const struct ResultCacheEntry* entry;
+  if (hostname_len == 0 || hostname_len > MAX_CACHED_HOSTNAME_LEN) {
+    ++g_misses;
+    return 0;
+  }
+  entry = GetResultCacheEntry(generation, hostname, hostname_len);
+  if (entry->generation != generation ||
+      entry->hostname_len != hostname_len ||
+      entry->allow_unknown_registries != allow_unknown_registries ||
+      memcmp(entry->hostname, hostname, hostname_len) != 0) {
+    ++g_misses;
+    return 0;
+  }
+  ++g_hits;
+  *registry_len = entry->registry_len;
+  return 1;
+}
+
+void InsertResultCache(unsigned generation,
+                       const char* hostname,
+                       size_t hostname_len,
+                       int allow_unknown_registries,
+                       size_t registry_len) {
+  struct ResultCacheEntry* entry;
+  if (hostname_len == 0 || hostname_len > MAX_CACHED_HOSTNAME_LEN) {
+    return;
+  }
+  entry = GetResultCacheEntry(generation, hostname, hostname_len);
+  entry->generation = generation;
+  entry->hostname_len = (unsigned char) hostname_len;
+  entry->allow_unknown_registries = (unsigned char) allow_unknown_registries;
+  entry->registry_len = (unsigned char) registry_len;
+  memcpy(entry->hostname, hostname, hostname_len);
+}
+
+void GetRegistryResultCacheStats(size_t* hits, size_t* misses) {
+  *hits = g_hits;
+  *misses = g_misses;
+}
+
+#else  /* DOMAIN_REGISTRY_RESULT_CACHE_SIZE */
+
+int LookupResultCache(unsigned generation,
+                      const char* hostname,
+                      size_t hostname_len,
+                      int allow_unknown_registries,
+                      size_t* registry_len) {
+  (void) generation;
+  (void) hostname;
+  (void) hostname_len;
+  (void) allow_unknown_registries;
+  (void) registry_len;
+  return 0;
+}
+
+void InsertResultCache(unsigned generation,
+                       const char* hostname,
+                       size_t hostname_len,
+                       int allow_unknown_registries,
+                       size_t registry_len) {
+  (void) generation;
+  (void) hostname;
+  (void) hostname_len;
+  (void) allow_unknown_registries;
+  (void) registry_len;
+}
+
+void GetRegistryResultCacheStats(size_t* hits, size_t* misses) {
+  *hits = 0;
+  *misses = 0;
+}
+
+#endif  /* DOMAIN_REGISTRY_RESULT_CACHE_SIZE */
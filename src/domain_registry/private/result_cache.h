@@ -0,0 +1,62 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * Per-thread cache of registry lengths, keyed by the raw hostname
+ * bytes. The cache is only compiled in when
+ * DOMAIN_REGISTRY_RESULT_CACHE_SIZE is defined to a non-zero power of
+ * two, the number of entries each thread caches (see
+ * domain_registry_result_cache_size in domain_registry.gyp). Otherwise
+ * every lookup misses and nothing is counted. These should not need
+ * to be invoked directly.
+ */
+
+#ifndef DOMAIN_REGISTRY_PRIVATE_RESULT_CACHE_H_
+#define DOMAIN_REGISTRY_PRIVATE_RESULT_CACHE_H_
+
+#include <stdlib.h>
+
+/*
+ * Hostnames longer than this are not cached, so that each entry fits
+ * in a 64 byte cache line.
+ */
+#define MAX_CACHED_HOSTNAME_LEN 57
+
+/*
+ * Look up the registry length of the hostname of length hostname_len
+ * in the calling thread's cache, for the given value of
+ * allow_unknown_registries. generation is that of the registry tables
+ * the lookup uses; entries computed with other tables, e.g. those of
+ * another registry, do not match.
+ * Returns 1 and stores the length in *registry_len on a hit, or
+ * returns 0 on a miss.
+ */
+int LookupResultCache(unsigned generation,
+                      const char* hostname,
+                      size_t hostname_len,
+                      int allow_unknown_registries,
+                      size_t* registry_len);
+
+/*
+ * Store the registry length of a hostname that missed the cache in
+ * the calling thread's cache, replacing the entry in its slot.
+ */
+void InsertResultCache(unsigned generation,
+                       const char* hostname,
+                       size_t hostname_len,
+                       int allow_unknown_registries,
+                       size_t registry_len);
+
+#endif  /* DOMAIN_REGISTRY_PRIVATE_RESULT_CACHE_H_ */
@@ -42,9 +42,10 @@ static __inline__ int IsExceptionComponent(const char* component) {
   return 0;
 }
 
-static __inline__ int IsInvalidComponent(const char* component) {
+static __inline__ int IsInvalidComponent(const char* component,
+                                         size_t component_len) {
   if (component == NULL ||
-      component[0] == 0 ||
+      component_len == 0 ||
       IsExceptionComponent(component) ||
       IsWildcardComponent(component)) {
     return 1;
@@ -59,6 +60,13 @@ static __inline__ void ReplaceChar(char* value, char old, char newval) {
   }
 }
 
+static __inline__ char ToLowerASCIIChar(char c) {
+  if (c >= 'A' && c <= 'Z') {
+    return c - kUpperLowerDistance;
+  }
+  return c;
+}
+
 static __inline__ void ToLowerASCII(char* buf, const char* end) {
   for (; buf < end; ++buf) {
     char c = *buf;
@@ -86,4 +94,25 @@ static __inline__ int HostnamePartCmp(const char *a, const char *b) {
   return ret;
 }
 
+/*
+ * Like HostnamePartCmp, but a is a hostname-part of length a_len that
+ * need not be null-terminated. b must be null-terminated. Both must be
+ * lowercase: hostnames are lowercased by ScanHostname, and all entries
+ * in the string table are lowercase.
+ */
+static __inline__ int HostnamePartCmpN(const char *a, size_t a_len,
+                                       const char *b) {
+  size_t i;
+  for (i = 0; i < a_len; ++i) {
+    const unsigned char a_char = a[i];
+    const unsigned char b_char = b[i];
+    /*
+     * If b is shorter than a, b_char is the null terminator and the
+     * comparison below returns a positive value, as strcmp would.
+     */
+    if (a_char != b_char) return a_char - b_char;
+  }
+  return -(int) (unsigned char) b[a_len];
+}
+
 #endif  /* DOMAIN_REGISTRY_PRIVATE_STRING_UTIL_H_ */
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "domain_registry/private/suffix_hash_search.h"
+
+#include <stdlib.h>
+
+#include "domain_registry/domain_registry.h"
+#include "domain_registry/private/assert.h"
+#include "domain_registry/private/hash_util.h"
+#include "domain_registry/private/prefetch.h"
+#include "domain_registry/private/registry_tables.h"
+#include "domain_registry/private/string_util.h"
+#include "domain_registry/private/trie_search.h"
+
+/*
+ * Returns the hash of the suffix formed by component and the suffix
+ * represented by parent. Must match suffix_hash_builder.py.
+ */
+static __inline__ REGISTRY_U32 HashSuffix(
+    const struct RegistryTables* tables,
+    const char* component,
+    size_t component_len,
+    const struct SuffixHashEntry* parent) {
+  if (parent == NULL) {
+    /* Top-level hostname-parts are hashed from the seeded basis. */
+    return ContinueHash(FNV_OFFSET_BASIS ^ tables->suffix_hash_seed,
+                        component,
+                        component_len);
+  }
+  return ContinueHash(ContinueHash(parent->hash, ".", 1),
+                      component,
+                      component_len);
+}
+
+/*
+ * Probes the table for the entry with hash h and hostname-part
+ * component. Every entry has a distinct hash, so once a slot with
+ * hash h is found, no other slot can match.
+ */
+static const struct SuffixHashEntry* ProbeSuffixHash(
+    const struct RegistryTables* tables,
+    REGISTRY_U32 h,
+    const char* component,
+    size_t component_len) {
+  const size_t mask = tables->suffix_hash_table_size - 1;
+  size_t slot = MixHash(h) & mask;
+  while (1) {
+    const struct SuffixHashEntry* entry = tables->suffix_hash_table + slot;
+    if (entry->hash == h) {
+      /* Exception rules are stored under the part after the "!". */
+      const char* entry_str =
+          GetHostnamePart(tables, entry->string_table_offset) +
+          entry->is_exception;
+      if (HostnamePartCmpN(component, component_len, entry_str) != 0) {
+        return NULL;
+      }
+      return entry;
+    }
+    if (entry->hash == 0) {
+      return NULL;
+    }
+    slot = (slot + 1) & mask;
+  }
+}
+
+const struct SuffixHashEntry* FindSuffixHashEntryN(
+    const struct RegistryTables* tables,
+    const char* component,
+    size_t component_len,
+    const struct SuffixHashEntry* parent) {
+  const struct SuffixHashEntry* entry;
+  int has_wildcard_child;
+
+  DCHECK(tables->suffix_hash_table != NULL);
+  DCHECK(component != NULL);
+  if (IsInvalidComponent(component, component_len)) {
+    return NULL;
+  }
+  if (parent != NULL && parent->has_children == 0) {
+    return NULL;
+  }
+  has_wildcard_child = (parent != NULL && parent->has_wildcard_child);
+
+  /*
+   * Search for an exact match, or an exception rule for component,
+   * falling back to the wildcard. See FindRegistryNodeN for details.
+   */
+  entry = ProbeSuffixHash(tables,
+                          HashSuffix(tables, component, component_len, parent),
+                          component,
+                          component_len);
+  if (entry != NULL) {
+    if (entry->is_exception && !has_wildcard_child) {
+      /* An exception rule only applies if there is a wildcard. */
+      return NULL;
+    }
+    return entry;
+  }
+  if (has_wildcard_child) {
+    return ProbeSuffixHash(tables, HashSuffix(tables, "*", 1, parent), "*", 1);
+  }
+  return NULL;
+}
+
+void PrefetchSuffixHashEntry(const struct RegistryTables* tables,
+                             const char* component,
+                             size_t component_len,
+                             const struct SuffixHashEntry* parent) {
+  PREFETCH(tables->suffix_hash_table +
+           (MixHash(HashSuffix(tables, component, component_len, parent)) &
+            (tables->suffix_hash_table_size - 1)));
+}
+
+int HasSuffixHashTable(const struct RegistryTables* tables) {
+  return tables->suffix_hash_table != NULL;
+}
+
+void SetSuffixHashTable(const struct SuffixHashEntry* table,
+                        size_t table_size,
+                        REGISTRY_U32 seed) {
+  struct RegistryTables tables;
+  DCHECK(table == NULL || (table_size & (table_size - 1)) == 0);
+  GetRegistryTables(GetDefaultDomainRegistry(), &tables);
+  tables.suffix_hash_table = table;
+  tables.suffix_hash_table_size = table_size;
+  tables.suffix_hash_seed = seed;
+  InstallRegistryTables(GetDefaultDomainRegistry(), &tables);
+}
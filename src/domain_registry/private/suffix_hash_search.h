@@ -0,0 +1,67 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * Functions to search the suffix hash table. These should not need to
+ * be invoked directly.
+ */
+
+#ifndef DOMAIN_REGISTRY_PRIVATE_SUFFIX_HASH_SEARCH_H_
+#define DOMAIN_REGISTRY_PRIVATE_SUFFIX_HASH_SEARCH_H_
+
+#include <stdlib.h>
+
+#include "domain_registry/private/registry_tables.h"
+#include "domain_registry/private/registry_types.h"
+#include "domain_registry/private/trie_node.h"
+
+/*
+ * Find the entry for the hostname-part component, of length
+ * component_len, under the given parent entry. If parent is NULL then
+ * component is looked up as a top-level hostname-part. Applies
+ * wildcard and exception rules the same way FindRegistryNodeN
+ * does. component must be lowercase and need not be
+ * null-terminated. Does not allocate.
+ */
+const struct SuffixHashEntry* FindSuffixHashEntryN(
+    const struct RegistryTables* tables,
+    const char* component,
+    size_t component_len,
+    const struct SuffixHashEntry* parent);
+
+/*
+ * Prefetch the slot a search for component under parent will visit
+ * first. Used to overlap the cache misses of independent lookups.
+ */
+void PrefetchSuffixHashEntry(const struct RegistryTables* tables,
+                             const char* component,
+                             size_t component_len,
+                             const struct SuffixHashEntry* parent);
+
+/* Do the given tables include a suffix hash table? */
+int HasSuffixHashTable(const struct RegistryTables* tables);
+
+/*
+ * Install the suffix hash table. table_size must be a power of
+ * two. Entries refer to the string table installed by
+ * SetRegistryTables. Pass NULL to remove the table, in which case
+ * lookups walk the trie. SetRegistryTables removes any previously
+ * installed table, so this must be called after it.
+ */
+void SetSuffixHashTable(const struct SuffixHashEntry* table,
+                        size_t table_size,
+                        REGISTRY_U32 seed);
+
+#endif  /* DOMAIN_REGISTRY_PRIVATE_SUFFIX_HASH_SEARCH_H_ */
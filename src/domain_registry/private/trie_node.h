@@ -17,42 +17,133 @@
 #ifndef DOMAIN_REGISTRY_PRIVATE_TRIE_NODE_H_
 #define DOMAIN_REGISTRY_PRIVATE_TRIE_NODE_H_
 
+#include <stddef.h>
+
+#include "domain_registry/private/registry_types.h"
+
+#if _WINDOWS
+#define __inline__ __inline
+#endif
+
+/*
+ * TrieNode represents a single node in a Trie. Its encoding is chosen
+ * by registry_tables_generator/node_layout_builder.py, which gives each
+ * field the smallest integer word that holds the largest value in the
+ * tables, so the generated trie_node_layout.h defines struct TrieNode,
+ * the TRIE_NODE initializer and the functions that read each field.
+ * TRIE_NODE_LAYOUT identifies the encoding, so that table blobs
+ * written with another one are rejected. Logically, a node has:
+ *
+ * string_table_offset: Index in the string table for the
+ * hostname-part associated with this node.
+ * Read with GetTrieNodeStringTableOffset.
+ *
+ * first_child_offset: Offset of the first child of this node in the
+ * node table. All children are stored adjacent to each other, sorted
+ * lexicographically by their hostname parts, except that the wildcard
+ * "*" (if present) is always first and exception rules (e.g. "!foo")
+ * are sorted as though they had no leading "!".
+ * Read with GetTrieNodeFirstChildOffset.
+ *
+ * num_children: Number of children of this node.
+ * Read with GetTrieNodeNumChildren.
+ *
+ * is_terminal: Whether this node is a "terminal" node. A terminal node
+ * is one that represents the end of a sequence of nodes in the trie.
+ * For instance if the sequences "com.foo.bar" and "com.foo" are added
+ * to the trie, "bar" and "foo" are terminal nodes, since they are both
+ * at the end of their sequences. Read with IsTrieNodeTerminal.
+ *
+ * has_wildcard_child: Whether the first child of this node is the
+ * wildcard "*". Lets the search fall back to the wildcard without a
+ * second lookup. Read with TrieNodeHasWildcardChild.
+ *
+ * has_exception_children: Whether any children of this node are
+ * exception rules. Exception rules are found by the same search as
+ * other children, so the search only has to skip the leading "!" when
+ * this is set. Read with TrieNodeHasExceptionChildren.
+ *
+ * Leaf nodes have no children, so the leaf node table only holds the
+ * string_table_offset of each, as a TrieLeafNode.
+ */
+#include "registry_tables_genfiles/trie_node_layout.h"
+
 #pragma pack(push)
 #pragma pack(1)
 
 /*
- * TrieNode represents a single node in a Trie. It uses 6 bytes of
- * storage.
+ * RootHashEntry is a slot in the minimal perfect hash of the root
+ * nodes. It uses 4 bytes of storage.
  */
-struct TrieNode {
+struct RootHashEntry {
+  /* Index of the root node that maps to this slot. */
+  REGISTRY_U16 node_index;
+
   /*
-   * Index in the string table for the hostname-part associated with
-   * this node.
+   * Fingerprint of the hostname-part of the root node. Lets searches
+   * for unknown hostname-parts fail without reading the string table.
    */
-  unsigned int string_table_offset  : 21;
+  REGISTRY_U16 fingerprint;
+};
+
+#pragma pack(pop)
+
+/*
+ * The section of the public suffix list a node belongs to, as seen by
+ * a search that only considers the ICANN section. Nodes have no spare
+ * bits for it, so it is kept in separate tables of 2-bit entries. Must
+ * match the NODE_SECTION values in
+ * registry_tables_generator/section_table_builder.py.
+ */
+enum NodeSection {
+  /* ICANN rules pass through the node, and end at it if terminal. */
+  NODE_SECTION_ICANN = 0,
+
+  /* ICANN rules pass through the node, but only PRIVATE rules end here. */
+  NODE_SECTION_ICANN_NOT_TERMINAL = 1,
 
   /*
-   * Offset of the first child of this node in the node table. All
-   * children are stored adjacent to each other, sorted
-   * lexicographically by their hostname parts.
+   * Only PRIVATE rules pass through the node, so a search of the ICANN
+   * rules stops at its parent.
    */
-  unsigned int first_child_offset   : 14;
+  NODE_SECTION_PRIVATE = 2,
 
   /*
-   * Number of children of this node.
+   * Like NODE_SECTION_PRIVATE, but the wildcard sibling of the node is
+   * an ICANN rule without children, which a search of the ICANN rules
+   * ends at instead.
    */
-  unsigned int num_children         : 12;
+  NODE_SECTION_PRIVATE_ICANN_WILDCARD = 3
+};
 
+/*
+ * SuffixHashEntry is a slot in the hash table of rule suffixes used by
+ * the suffix-hash lookup engine. It uses 8 bytes of storage.
+ */
+struct SuffixHashEntry {
   /*
-   * Whether this node is a "terminal" node. A terminal node is one
-   * that represents the end of a sequence of nodes in the trie. For
-   * instance if the sequences "com.foo.bar" and "com.foo" are added
-   * to the trie, "bar" and "foo" are terminal nodes, since they are
-   * both at the end of their sequences.
+   * Hash of the right-anchored suffix this entry represents (e.g.
+   * "example.com"), or 0 if the slot is empty.
    */
-  unsigned int is_terminal          :  1;
-};
+  REGISTRY_U32 hash;
 
-#pragma pack(pop)
+  /*
+   * Index in the string table for the leftmost hostname-part of the
+   * suffix, including the leading "!" of exception rules.
+   */
+  unsigned int string_table_offset     : 28;
+
+  /* Whether a rule ends at this suffix. See TrieNode. */
+  unsigned int is_terminal             :  1;
+
+  /* Whether the wildcard "*" is a child of this suffix. */
+  unsigned int has_wildcard_child      :  1;
+
+  /* Whether this entry is an exception rule. */
+  unsigned int is_exception            :  1;
+
+  /* Whether any longer suffixes extend this one. */
+  unsigned int has_children            :  1;
+};
 
 #endif  /* DOMAIN_REGISTRY_PRIVATE_TRIE_NODE_H_ */
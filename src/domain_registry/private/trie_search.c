@@ -14,13 +14,27 @@
  * limitations under the License.
  */
 
+#include "domain_registry/domain_registry.h"
 #include "domain_registry/private/assert.h"
+#include "domain_registry/private/hash_util.h"
+#include "domain_registry/private/prefetch.h"
+#include "domain_registry/private/registry_stats.h"
+#include "domain_registry/private/registry_tables.h"
 #include "domain_registry/private/string_util.h"
 #include "domain_registry/private/trie_search.h"
 
 #include <stdlib.h>
 #include <string.h>
 
+/*
+ * Fingerprints are compared 16 at a time with SSE2, which every x86-64
+ * processor supports.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__SSE2__)
+#define TRIE_SEARCH_SSE2 1
+#include <emmintrin.h>
+#endif
+
 /*
  * Helper macro that chooses the node half-way between the start and
  * end nodes. Used for binary search.
@@ -28,46 +42,48 @@
 #define MIDDLE(start, end) ((start) + ((((end) - (start)) + 1) / 2));
 
 /*
- * Global data structures used to perform the search. Should be
- * populated once at startup by a call to SetRegistryTables.
+ * Sibling groups with at least this many searchable (i.e. non-wildcard)
+ * nodes are stored in Eytzinger order when the tables are generated
+ * with --eytzinger_layout. Must match EYTZINGER_MIN_SIBLINGS in
+ * registry_tables_generator/node_table_builder.py.
  */
-static const char* g_string_table = NULL;
-static const struct TrieNode* g_node_table = NULL;
-static size_t g_num_root_children = 0;
-static const REGISTRY_U16* g_leaf_node_table = NULL;
-static size_t g_leaf_node_table_offset = 0;
+#define EYTZINGER_MIN_SIBLINGS 8
 
 /*
- * Create an "exception" version of the given component. For instance
- * if component is "foo", will return "!foo". The caller is
- * responsible for freeing the returned memory.
+ * A fingerprint search compares the fingerprints of one block of this
+ * many siblings. Larger sibling groups are first narrowed down to one
+ * block with a binary search over the first node of each block, so
+ * that the search scales like a binary search.
  */
-static char* StrDupExceptionComponent(const char* component) {
-  /*
-   * TODO(bmcquade): could use thread-local storage of sufficient size
-   * to avoid this allocation. This should be invoked infrequently
-   * enough that it's probably fine for us to perform the allocation.
-   */
-  const size_t component_len = strlen(component);
-  char* exception_component = malloc(component_len + 2);
-  if (exception_component == NULL) {
-    return NULL;
+#define FINGERPRINT_BLOCK_SIZE 16
+
+/*
+ * Returns the hostname-part that candidate_str represents in the
+ * sort order of its sibling range. Exception rules (e.g. "!foo") are
+ * sorted as though they had no leading "!", so that a single search
+ * finds either the exact hostname-part or its exception.
+ */
+static __inline__ const char* GetSortKey(const char* candidate_str,
+                                         int has_exception_siblings) {
+  if (has_exception_siblings && IsExceptionComponent(candidate_str)) {
+    return candidate_str + 1;
   }
-  memcpy(exception_component + 1, component, component_len);
-  exception_component[0] = '!';
-  exception_component[component_len + 1] = 0;
-  return exception_component;
+  return candidate_str;
 }
 
 /*
- * Performs a binary search looking for value, between the nodes start
- * and end, inclusive. Would normally have static linkage but is made
- * public for testing.
+ * Performs a binary search looking for value, a hostname-part of
+ * length value_len, between the nodes start and end, inclusive. If
+ * has_exception_siblings is non-zero, exception rules in the range
+ * match the hostname-part they are an exception for.
  */
-const struct TrieNode* FindNodeInRange(
+static const struct TrieNode* FindNodeInRangeN(
+    const struct RegistryTables* tables,
     const char* value,
+    size_t value_len,
     const struct TrieNode* start,
-    const struct TrieNode* end) {
+    const struct TrieNode* end,
+    int has_exception_siblings) {
   DCHECK(value != NULL);
   DCHECK(start != NULL);
   DCHECK(end != NULL);
@@ -79,8 +95,12 @@ const struct TrieNode* FindNodeInRange(
 
     DCHECK(start <= end);
     candidate = MIDDLE(start, end);
-    candidate_str = g_string_table + candidate->string_table_offset;
-    result = HostnamePartCmp(value, candidate_str);
+    candidate_str = GetSortKey(
+        tables->string_table + GetTrieNodeStringTableOffset(candidate),
+        has_exception_siblings);
+    COUNT_REGISTRY_STAT(search_probes);
+    COUNT_REGISTRY_STAT(string_compares);
+    result = HostnamePartCmpN(value, value_len, candidate_str);
     if (result == 0) return candidate;
     if (result > 0) {
       if (end == candidate) return NULL;
@@ -93,27 +113,34 @@ const struct TrieNode* FindNodeInRange(
 }
 
 /*
- * Performs a binary search looking for value, between the nodes start
- * and end, inclusive. Would normally have static linkage but is made
- * public for testing.
+ * Performs a binary search looking for value, a hostname-part of
+ * length value_len, between the nodes start and end, inclusive. If
+ * has_exception_siblings is non-zero, exception rules in the range
+ * match the hostname-part they are an exception for.
  */
-const char* FindLeafNodeInRange(
+static const TrieLeafNode* FindLeafNodeInRangeN(
+    const struct RegistryTables* tables,
     const char* value,
-    const REGISTRY_U16* start,
-    const REGISTRY_U16* end) {
+    size_t value_len,
+    const TrieLeafNode* start,
+    const TrieLeafNode* end,
+    int has_exception_siblings) {
   DCHECK(value != NULL);
   DCHECK(start != NULL);
   DCHECK(end != NULL);
   if (start > end) return NULL;
   while (1) {
-    const REGISTRY_U16* candidate;
+    const TrieLeafNode* candidate;
     const char* candidate_str;
     int result;
     DCHECK(start <= end);
     candidate = MIDDLE(start, end);
-    candidate_str = g_string_table + *candidate;
-    result = HostnamePartCmp(value, candidate_str);
-    if (result == 0) return candidate_str;
+    candidate_str = tables->string_table + *candidate;
+    COUNT_REGISTRY_STAT(search_probes);
+    COUNT_REGISTRY_STAT(string_compares);
+    result = HostnamePartCmpN(
+        value, value_len, GetSortKey(candidate_str, has_exception_siblings));
+    if (result == 0) return candidate;
     if (result > 0) {
       if (end == candidate) return NULL;
       start = candidate + 1;
@@ -124,32 +151,445 @@ const char* FindLeafNodeInRange(
   }
 }
 
+/*
+ * Searches for value, a hostname-part of length value_len, among the
+ * num_nodes nodes at nodes, which are stored in Eytzinger order: the
+ * children of the node at index i are at 2i+1 (lesser) and 2i+2
+ * (greater). The next index is computed from the comparison without a
+ * branch, so the only unpredictable branches are inside the string
+ * comparison. If has_exception_siblings is non-zero, exception rules
+ * match the hostname-part they are an exception for.
+ */
+static const struct TrieNode* FindNodeInEytzingerRangeN(
+    const struct RegistryTables* tables,
+    const char* value,
+    size_t value_len,
+    const struct TrieNode* nodes,
+    size_t num_nodes,
+    int has_exception_siblings) {
+  size_t i = 0;
+  DCHECK(value != NULL);
+  DCHECK(nodes != NULL);
+  while (i < num_nodes) {
+    const struct TrieNode* candidate = nodes + i;
+    int result;
+
+    /*
+     * The 8 descendants three levels down are adjacent, so fetch them
+     * while this level's string comparison runs.
+     */
+    if (8 * i + 7 < num_nodes) {
+      PREFETCH(nodes + (8 * i + 7));
+    }
+    COUNT_REGISTRY_STAT(search_probes);
+    COUNT_REGISTRY_STAT(string_compares);
+    result = HostnamePartCmpN(
+        value, value_len,
+        GetSortKey(
+            tables->string_table + GetTrieNodeStringTableOffset(candidate),
+            has_exception_siblings));
+    if (result == 0) return candidate;
+    i = 2 * i + 1 + (result > 0);
+  }
+  return NULL;
+}
+
+/*
+ * Like FindNodeInEytzingerRangeN, but searches the num_leaves leaf
+ * node table entries at leaves. Returns the matching entry.
+ */
+static const TrieLeafNode* FindLeafNodeInEytzingerRangeN(
+    const struct RegistryTables* tables,
+    const char* value,
+    size_t value_len,
+    const TrieLeafNode* leaves,
+    size_t num_leaves,
+    int has_exception_siblings) {
+  size_t i = 0;
+  DCHECK(value != NULL);
+  DCHECK(leaves != NULL);
+  while (i < num_leaves) {
+    const char* candidate_str = tables->string_table + leaves[i];
+    int result;
+
+    /* The 16 descendants four levels down fill 32 bytes. */
+    if (16 * i + 15 < num_leaves) {
+      PREFETCH(leaves + (16 * i + 15));
+    }
+    COUNT_REGISTRY_STAT(search_probes);
+    COUNT_REGISTRY_STAT(string_compares);
+    result = HostnamePartCmpN(
+        value, value_len, GetSortKey(candidate_str, has_exception_siblings));
+    if (result == 0) return leaves + i;
+    i = 2 * i + 1 + (result > 0);
+  }
+  return NULL;
+}
+
+/*
+ * Returns the index of the first of the fingerprints between index i
+ * and num_fingerprints that equals fingerprint, or num_fingerprints if
+ * there is none.
+ */
+static __inline__ size_t FindFingerprint(const unsigned char* fingerprints,
+                                         size_t i,
+                                         size_t num_fingerprints,
+                                         unsigned char fingerprint) {
+#ifdef TRIE_SEARCH_SSE2
+  const __m128i needle = _mm_set1_epi8((char) fingerprint);
+  for (; i + 16 <= num_fingerprints; i += 16) {
+    const __m128i block =
+        _mm_loadu_si128((const __m128i*) (fingerprints + i));
+    const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; i < num_fingerprints; ++i) {
+    if (fingerprints[i] == fingerprint) {
+      break;
+    }
+  }
+  return i;
+}
+
+/*
+ * Returns the number of fingerprint blocks of a sibling group of
+ * num_siblings nodes.
+ */
+static __inline__ size_t GetNumFingerprintBlocks(size_t num_siblings) {
+  return (num_siblings + FINGERPRINT_BLOCK_SIZE - 1) / FINGERPRINT_BLOCK_SIZE;
+}
+
+/*
+ * Returns the index of the first node a fingerprint search of
+ * num_siblings nodes compares the string of before it compares
+ * fingerprints, or num_siblings if it compares fingerprints first.
+ */
+static __inline__ size_t GetFirstFingerprintProbe(size_t num_siblings) {
+  const size_t num_blocks = GetNumFingerprintBlocks(num_siblings);
+  if (num_blocks <= 1) return num_siblings;
+  return (num_blocks / 2) * FINGERPRINT_BLOCK_SIZE;
+}
+
+/*
+ * Searches for value, a hostname-part of length value_len with the
+ * given fingerprint, among the num_nodes nodes at nodes, which are
+ * stored in sorted order. A binary search over the first node of each
+ * block of FINGERPRINT_BLOCK_SIZE nodes finds the only block that can
+ * hold value, and then only the nodes of that block whose fingerprint
+ * matches have their strings compared. If has_exception_siblings is
+ * non-zero, exception rules match the hostname-part they are an
+ * exception for.
+ */
+static const struct TrieNode* FindNodeByFingerprintN(
+    const struct RegistryTables* tables,
+    const char* value,
+    size_t value_len,
+    unsigned char fingerprint,
+    const struct TrieNode* nodes,
+    size_t num_nodes,
+    int has_exception_siblings) {
+  const unsigned char* fingerprints =
+      tables->node_fingerprints + (nodes - tables->node_table);
+  size_t first_block = 0;
+  size_t end_block = GetNumFingerprintBlocks(num_nodes);
+  size_t i, end;
+  while (end_block - first_block > 1) {
+    const size_t middle = first_block + (end_block - first_block) / 2;
+    const struct TrieNode* candidate = nodes + middle * FINGERPRINT_BLOCK_SIZE;
+    int result;
+    COUNT_REGISTRY_STAT(search_probes);
+    COUNT_REGISTRY_STAT(string_compares);
+    result = HostnamePartCmpN(
+        value, value_len,
+        GetSortKey(
+            tables->string_table + GetTrieNodeStringTableOffset(candidate),
+            has_exception_siblings));
+    if (result == 0) return candidate;
+    if (result < 0) {
+      end_block = middle;
+    } else {
+      first_block = middle;
+    }
+  }
+  i = first_block * FINGERPRINT_BLOCK_SIZE;
+  end = i + FINGERPRINT_BLOCK_SIZE < num_nodes ?
+      i + FINGERPRINT_BLOCK_SIZE : num_nodes;
+  COUNT_REGISTRY_STAT(search_probes);
+  while ((i = FindFingerprint(fingerprints, i, end, fingerprint)) < end) {
+    const char* candidate_str = GetSortKey(
+        tables->string_table + GetTrieNodeStringTableOffset(&nodes[i]),
+        has_exception_siblings);
+    COUNT_REGISTRY_STAT(string_compares);
+    if (HostnamePartCmpN(value, value_len, candidate_str) == 0) {
+      return nodes + i;
+    }
+    ++i;
+  }
+  return NULL;
+}
+
+/*
+ * Like FindNodeByFingerprintN, but searches the num_leaves leaf node
+ * table entries at leaves. Returns the matching entry.
+ */
+static const TrieLeafNode* FindLeafNodeByFingerprintN(
+    const struct RegistryTables* tables,
+    const char* value,
+    size_t value_len,
+    unsigned char fingerprint,
+    const TrieLeafNode* leaves,
+    size_t num_leaves,
+    int has_exception_siblings) {
+  const unsigned char* fingerprints =
+      tables->leaf_fingerprints + (leaves - tables->leaf_node_table);
+  size_t first_block = 0;
+  size_t end_block = GetNumFingerprintBlocks(num_leaves);
+  size_t i, end;
+  while (end_block - first_block > 1) {
+    const size_t middle = first_block + (end_block - first_block) / 2;
+    const TrieLeafNode* candidate = leaves + middle * FINGERPRINT_BLOCK_SIZE;
+    int result;
+    COUNT_REGISTRY_STAT(search_probes);
+    COUNT_REGISTRY_STAT(string_compares);
+    result = HostnamePartCmpN(
+        value, value_len,
+        GetSortKey(tables->string_table + *candidate, has_exception_siblings));
+    if (result == 0) return candidate;
+    if (result < 0) {
+      end_block = middle;
+    } else {
+      first_block = middle;
+    }
+  }
+  i = first_block * FINGERPRINT_BLOCK_SIZE;
+  end = i + FINGERPRINT_BLOCK_SIZE < num_leaves ?
+      i + FINGERPRINT_BLOCK_SIZE : num_leaves;
+  COUNT_REGISTRY_STAT(search_probes);
+  while ((i = FindFingerprint(fingerprints, i, end, fingerprint)) < end) {
+    const char* candidate_str = tables->string_table + leaves[i];
+    COUNT_REGISTRY_STAT(string_compares);
+    if (HostnamePartCmpN(
+            value, value_len,
+            GetSortKey(candidate_str, has_exception_siblings)) == 0) {
+      return leaves + i;
+    }
+    ++i;
+  }
+  return NULL;
+}
+
+/*
+ * Returns non-zero if the sibling group of num_siblings searchable
+ * nodes is stored in Eytzinger order.
+ */
+static __inline__ int IsEytzingerRange(size_t num_siblings) {
+#ifdef DOMAIN_REGISTRY_EYTZINGER_LAYOUT
+  return num_siblings >= EYTZINGER_MIN_SIBLINGS;
+#else
+  (void) num_siblings;
+  return 0;
+#endif
+}
+
+/*
+ * Searches the sibling nodes between start and end, inclusive. Ranges
+ * stored in Eytzinger order are always searched in that order, so
+ * that --eytzinger_layout takes effect whether or not fingerprints are
+ * installed. Other ranges are searched by fingerprint if they are
+ * installed, and otherwise with a binary search.
+ */
+static const struct TrieNode* FindNodeInSiblingsN(
+    const struct RegistryTables* tables,
+    const char* value,
+    size_t value_len,
+    const struct TrieNode* start,
+    const struct TrieNode* end,
+    int has_exception_siblings) {
+  if (start > end) return NULL;
+  if (IsEytzingerRange((end - start) + 1)) {
+    return FindNodeInEytzingerRangeN(
+        tables, value, value_len, start, (end - start) + 1,
+        has_exception_siblings);
+  }
+  if (tables->node_fingerprints != NULL) {
+    return FindNodeByFingerprintN(
+        tables, value, value_len, GetHostnamePartFingerprint(value, value_len),
+        start, (end - start) + 1, has_exception_siblings);
+  }
+  return FindNodeInRangeN(tables,
+                          value,
+                          value_len,
+                          start,
+                          end,
+                          has_exception_siblings);
+}
+
+/*
+ * Searches the sibling leaf node table entries between start and end,
+ * inclusive, choosing the search the same way as FindNodeInSiblingsN.
+ */
+static const TrieLeafNode* FindLeafNodeInSiblingsN(
+    const struct RegistryTables* tables,
+    const char* value,
+    size_t value_len,
+    const TrieLeafNode* start,
+    const TrieLeafNode* end,
+    int has_exception_siblings) {
+  if (start > end) return NULL;
+  if (IsEytzingerRange((end - start) + 1)) {
+    return FindLeafNodeInEytzingerRangeN(
+        tables, value, value_len, start, (end - start) + 1,
+        has_exception_siblings);
+  }
+  if (tables->leaf_fingerprints != NULL) {
+    return FindLeafNodeByFingerprintN(
+        tables, value, value_len, GetHostnamePartFingerprint(value, value_len),
+        start, (end - start) + 1, has_exception_siblings);
+  }
+  return FindLeafNodeInRangeN(tables,
+                              value,
+                              value_len,
+                              start,
+                              end,
+                              has_exception_siblings);
+}
+
+/*
+ * Looks up value, a hostname-part of length value_len, in the perfect
+ * hash of the root nodes. The hash maps every hostname-part to some
+ * root node, so the match is confirmed with a fingerprint check and
+ * then a single string comparison.
+ */
+static const struct TrieNode* FindRootNodeInHashN(
+    const struct RegistryTables* tables,
+    const char* value,
+    size_t value_len) {
+  const REGISTRY_U32 h = HashHostnamePart(value, value_len);
+  const REGISTRY_U32 mixed = MixHash(h);
+  const REGISTRY_U32 displacement = tables->root_hash_displacements[
+      ReduceHash(mixed, tables->num_root_hash_buckets)];
+  const struct RootHashEntry* entry = tables->root_hash_table + ReduceHash(
+      MixHash(h ^ (displacement * 0x9e3779b9u)), tables->num_root_children);
+  const struct TrieNode* node;
+
+  COUNT_REGISTRY_STAT(search_probes);
+  if (entry->fingerprint != (mixed & 0xffff)) {
+    return NULL;
+  }
+  node = tables->node_table + entry->node_index;
+  COUNT_REGISTRY_STAT(string_compares);
+  if (HostnamePartCmpN(
+          value, value_len,
+          tables->string_table + GetTrieNodeStringTableOffset(node)) != 0) {
+    return NULL;
+  }
+  return node;
+}
+
+/*
+ * Performs a binary search looking for value, between the nodes start
+ * and end, inclusive. Exception rules in the range match the
+ * hostname-part they are an exception for. Would normally have static
+ * linkage but is made public for testing.
+ */
+const struct TrieNode* FindNodeInRange(
+    const struct RegistryTables* tables,
+    const char* value,
+    const struct TrieNode* start,
+    const struct TrieNode* end) {
+  DCHECK(value != NULL);
+  return FindNodeInRangeN(tables, value, strlen(value), start, end, 1);
+}
+
+/*
+ * Performs a binary search looking for value, between the nodes start
+ * and end, inclusive. Exception rules in the range match the
+ * hostname-part they are an exception for. Would normally have static
+ * linkage but is made public for testing.
+ */
+const char* FindLeafNodeInRange(
+    const struct RegistryTables* tables,
+    const char* value,
+    const TrieLeafNode* start,
+    const TrieLeafNode* end) {
+  const TrieLeafNode* leaf;
+  DCHECK(value != NULL);
+  leaf = FindLeafNodeInRangeN(tables, value, strlen(value), start, end, 1);
+  return leaf != NULL ? tables->string_table + *leaf : NULL;
+}
+
+/*
+ * Searches for value among the num_nodes nodes at nodes, which are
+ * stored in Eytzinger order. Exception rules match the hostname-part
+ * they are an exception for. Would normally have static linkage but
+ * is made public for testing.
+ */
+const struct TrieNode* FindNodeInEytzingerRange(
+    const struct RegistryTables* tables,
+    const char* value,
+    const struct TrieNode* nodes,
+    size_t num_nodes) {
+  DCHECK(value != NULL);
+  return FindNodeInEytzingerRangeN(
+      tables, value, strlen(value), nodes, num_nodes, 1);
+}
+
+/*
+ * Searches for value among the num_leaves leaf node table entries at
+ * leaves, which are stored in Eytzinger order. Exception rules match
+ * the hostname-part they are an exception for. Would normally have
+ * static linkage but is made public for testing.
+ */
+const char* FindLeafNodeInEytzingerRange(
+    const struct RegistryTables* tables,
+    const char* value,
+    const TrieLeafNode* leaves,
+    size_t num_leaves) {
+  const TrieLeafNode* leaf;
+  DCHECK(value != NULL);
+  leaf = FindLeafNodeInEytzingerRangeN(
+      tables, value, strlen(value), leaves, num_leaves, 1);
+  return leaf != NULL ? tables->string_table + *leaf : NULL;
+}
+
 /*
  * Searches to find a registry node with the given component
  * identifier and the given parent node. If parent is null, searches
  * starting from the root node.
  */
-const struct TrieNode* FindRegistryNode(const char* component,
-                                        const struct TrieNode* parent) {
+const struct TrieNode* FindRegistryNodeN(const struct RegistryTables* tables,
+                                         const char* component,
+                                         size_t component_len,
+                                         const struct TrieNode* parent) {
   const struct TrieNode* start;
   const struct TrieNode* end;
   const struct TrieNode* current;
-  const struct TrieNode* exception;
+  const struct TrieNode* wildcard = NULL;
+  int has_exception_children = 0;
 
-  DCHECK(g_string_table != NULL);
-  DCHECK(g_node_table != NULL);
-  DCHECK(g_leaf_node_table != NULL);
+  DCHECK(tables->string_table != NULL);
+  DCHECK(tables->node_table != NULL);
+  DCHECK(tables->leaf_node_table != NULL);
   DCHECK(component != NULL);
 
-  if (IsInvalidComponent(component)) {
+  if (IsInvalidComponent(component, component_len)) {
     return NULL;
   }
   if (parent == NULL) {
-    /* If parent is NULL, start the search at the root node. */
-    start = g_node_table;
-    end = start + (g_num_root_children - 1);
+    /*
+     * If parent is NULL, start the search at the root node. The root
+     * never has wildcard or exception children.
+     */
+    if (tables->root_hash_table != NULL) {
+      return FindRootNodeInHashN(tables, component, component_len);
+    }
+    start = tables->node_table;
+    end = start + (tables->num_root_children - 1);
   } else {
-    if (HasLeafChildren(parent) != 0) {
+    if (HasLeafChildren(tables, parent) != 0) {
       /*
        * If the parent has leaf children, FindRegistryLeafNode should
        * have been called instead.
@@ -159,136 +599,380 @@ const struct TrieNode* FindRegistryNode(const char* component,
     }
 
     /* We'll be searching the specified parent node's children. */
-    start = g_node_table + parent->first_child_offset;
-    end = start + ((int) parent->num_children - 1);
+    start = tables->node_table + GetTrieNodeFirstChildOffset(parent);
+    end = start + ((int) GetTrieNodeNumChildren(parent) - 1);
+    if (TrieNodeHasWildcardChild(parent)) {
+      /*
+       * The wildcard sorts before every other hostname-part, so it is
+       * always the first child. Remember it and exclude it from the
+       * search below.
+       */
+      wildcard = start++;
+    }
+    has_exception_children = TrieNodeHasExceptionChildren(parent);
   }
-  current = FindNodeInRange(component, start, end);
+
+  /*
+   * Search for an exact match. Since exception rules are sorted as
+   * though they had no leading "!", this also finds the exception
+   * rule for component, if there is one. From
+   * http://publicsuffix.org/format/: "An exclamation mark (!) at the
+   * start of a rule marks an exception to a previous wildcard
+   * rule. An exception rule takes priority over any other matching
+   * rule.".
+   */
+  if (has_exception_children) {
+    COUNT_REGISTRY_STAT(exception_probes);
+  }
+  current = FindNodeInSiblingsN(tables, component, component_len, start, end,
+                                has_exception_children);
   if (current != NULL) {
-    /* Found a match. Return it. */
+    if (has_exception_children &&
+        wildcard == NULL &&
+        IsExceptionComponent(
+            tables->string_table + GetTrieNodeStringTableOffset(current))) {
+      /* An exception rule only applies if there is a wildcard. */
+      return NULL;
+    }
     return current;
   }
 
   /*
-   * We didn't find an exact match, so see if there's a wildcard
-   * match. From http://publicsuffix.org/format/: "The wildcard
+   * We didn't find an exact match, so fall back to the wildcard, if
+   * any. From http://publicsuffix.org/format/: "The wildcard
    * character * (asterisk) matches any valid sequence of characters
    * in a hostname part. (Note: the list uses Unicode, not Punycode
    * forms, and is encoded using UTF-8.) Wildcards may only be used to
    * wildcard an entire level. That is, they must be surrounded by
    * dots (or implicit dots, at the beginning of a line)."
    */
-  current = FindNodeInRange("*", start, end);
-  if (current != NULL) {
-    /*
-     * If there was a wildcard match, see if there is a wildcard
-     * exception match, and prefer it if so. From
-     * http://publicsuffix.org/format/: "An exclamation mark (!) at
-     * the start of a rule marks an exception to a previous wildcard
-     * rule. An exception rule takes priority over any other matching
-     * rule.".
-     */
-    char* exception_component = StrDupExceptionComponent(component);
-    if (exception_component == NULL) {
-      return NULL;
-    }
-    exception = FindNodeInRange(exception_component,
-                                start,
-                                end);
-    free(exception_component);
-    if (exception != NULL) {
-      current = exception;
-    }
+  if (wildcard != NULL) {
+    COUNT_REGISTRY_STAT(wildcard_fallbacks);
   }
-  return current;
+  return wildcard;
 }
 
-const char* FindRegistryLeafNode(const char* component,
-                                 const struct TrieNode* parent) {
+const struct TrieNode* FindRegistryNode(const struct RegistryTables* tables,
+                                        const char* component,
+                                        const struct TrieNode* parent) {
+  DCHECK(component != NULL);
+  if (component == NULL) {
+    return NULL;
+  }
+  return FindRegistryNodeN(tables, component, strlen(component), parent);
+}
+
+const TrieLeafNode* FindRegistryLeafNodeEntryN(
+    const struct RegistryTables* tables,
+    const char* component,
+    size_t component_len,
+    const struct TrieNode* parent) {
   size_t offset;
-  const REGISTRY_U16* leaf_start;
-  const REGISTRY_U16* leaf_end;
-  const char* match;
-  const char* exception;
-
-  DCHECK(g_string_table != NULL);
-  DCHECK(g_node_table != NULL);
-  DCHECK(g_leaf_node_table != NULL);
+  const TrieLeafNode* leaf_start;
+  const TrieLeafNode* leaf_end;
+  const TrieLeafNode* match;
+  const TrieLeafNode* wildcard = NULL;
+
+  DCHECK(tables->string_table != NULL);
+  DCHECK(tables->node_table != NULL);
+  DCHECK(tables->leaf_node_table != NULL);
   DCHECK(component != NULL);
   DCHECK(parent != NULL);
-  DCHECK(HasLeafChildren(parent) != 0);
+  DCHECK(HasLeafChildren(tables, parent) != 0);
 
   if (parent == NULL) {
     return NULL;
   }
-  if (HasLeafChildren(parent) == 0) {
+  if (HasLeafChildren(tables, parent) == 0) {
     return NULL;
   }
-  if (IsInvalidComponent(component)) {
+  if (IsInvalidComponent(component, component_len)) {
     return NULL;
   }
 
-  offset = parent->first_child_offset - g_leaf_node_table_offset;
-  leaf_start = g_leaf_node_table + offset;
-  leaf_end = leaf_start + ((int) parent->num_children - 1);
-  match = FindLeafNodeInRange(component,
-                              leaf_start,
-                              leaf_end);
-  if (match != NULL) {
-    return match;
+  offset = GetTrieNodeFirstChildOffset(parent) - tables->leaf_node_table_offset;
+  leaf_start = tables->leaf_node_table + offset;
+  leaf_end = leaf_start + ((int) GetTrieNodeNumChildren(parent) - 1);
+  if (TrieNodeHasWildcardChild(parent)) {
+    /* The wildcard is always the first child. See FindRegistryNodeN. */
+    wildcard = leaf_start++;
   }
 
   /*
-   * We didn't find an exact match, so see if there's a wildcard
-   * match. From http://publicsuffix.org/format/: "The wildcard
-   * character * (asterisk) matches any valid sequence of characters
-   * in a hostname part. (Note: the list uses Unicode, not Punycode
-   * forms, and is encoded using UTF-8.) Wildcards may only be used to
-   * wildcard an entire level. That is, they must be surrounded by
-   * dots (or implicit dots, at the beginning of a line)."
+   * Search for an exact match or an exception rule, falling back to
+   * the wildcard. See FindRegistryNodeN for details.
    */
-  match = FindLeafNodeInRange("*", leaf_start, leaf_end);
+  if (TrieNodeHasExceptionChildren(parent)) {
+    COUNT_REGISTRY_STAT(exception_probes);
+  }
+  match = FindLeafNodeInSiblingsN(tables, component,
+                                  component_len,
+                                  leaf_start,
+                                  leaf_end,
+                                  TrieNodeHasExceptionChildren(parent));
   if (match != NULL) {
+    if (TrieNodeHasExceptionChildren(parent) &&
+        wildcard == NULL &&
+        IsExceptionComponent(tables->string_table + *match)) {
+      /* An exception rule only applies if there is a wildcard. */
+      return NULL;
+    }
+    return match;
+  }
+  if (wildcard != NULL) {
+    COUNT_REGISTRY_STAT(wildcard_fallbacks);
+  }
+  return wildcard;
+}
+
+const char* FindRegistryLeafNodeN(const struct RegistryTables* tables,
+                                  const char* component,
+                                  size_t component_len,
+                                  const struct TrieNode* parent) {
+  const TrieLeafNode* leaf =
+      FindRegistryLeafNodeEntryN(tables, component, component_len, parent);
+  if (leaf == NULL) {
+    return NULL;
+  }
+  return tables->string_table + *leaf;
+}
+
+const char* FindRegistryLeafNode(const struct RegistryTables* tables,
+                                 const char* component,
+                                 const struct TrieNode* parent) {
+  DCHECK(component != NULL);
+  if (component == NULL) {
+    return NULL;
+  }
+  return FindRegistryLeafNodeN(tables, component, strlen(component), parent);
+}
+
+/*
+ * Prefetch the first nodes visited by a search of the nodes between
+ * start and end, inclusive: the first probe, as well as both
+ * candidates for the second probe, which for wide ranges are on
+ * different cache lines. In Eytzinger order, the first levels are at
+ * the start of the range.
+ */
+static void PrefetchNodeRange(const struct RegistryTables* tables,
+                              const struct TrieNode* start,
+                              const struct TrieNode* end) {
+  const struct TrieNode* middle;
+  if (start > end) return;
+  if (IsEytzingerRange((end - start) + 1)) {
+    PREFETCH(start);
+    PREFETCH(start + 7);
+    return;
+  }
+  if (tables->node_fingerprints != NULL) {
+    const size_t num_siblings = (end - start) + 1;
+    const size_t first = GetFirstFingerprintProbe(num_siblings);
+    if (first < num_siblings) {
+      PREFETCH(start + first);
+    } else {
+      /* A search of a single block reads the fingerprints first. */
+      PREFETCH(tables->node_fingerprints + (start - tables->node_table));
+    }
+    return;
+  }
+  middle = MIDDLE(start, end);
+  PREFETCH(middle);
+  PREFETCH(start + ((middle - start) / 2));
+  PREFETCH(middle + ((end - middle) / 2));
+}
+
+/* Prefetch the string of the first node visited by a range search. */
+static void PrefetchNodeRangeString(const struct RegistryTables* tables,
+                                    const struct TrieNode* start,
+                                    const struct TrieNode* end) {
+  const struct TrieNode* first;
+  if (start > end) return;
+  if (IsEytzingerRange((end - start) + 1)) {
+    first = start;
+  } else if (tables->node_fingerprints != NULL) {
     /*
-     * There was a wildcard match, so see if there is a wildcard
-     * exception match, and prefer it if so. From
-     * http://publicsuffix.org/format/: "An exclamation mark (!) at
-     * the start of a rule marks an exception to a previous wildcard
-     * rule. An exception rule takes priority over any other matching
-     * rule.".
+     * The first string a search of a single block reads depends on
+     * the fingerprints, so there is nothing to prefetch.
      */
-    char* exception_component = StrDupExceptionComponent(component);
-    if (exception_component == NULL) {
-      return NULL;
+    const size_t num_siblings = (end - start) + 1;
+    const size_t probe = GetFirstFingerprintProbe(num_siblings);
+    if (probe == num_siblings) return;
+    first = start + probe;
+  } else {
+    first = MIDDLE(start, end);
+  }
+  PREFETCH(tables->string_table + GetTrieNodeStringTableOffset(first));
+}
+
+/*
+ * Returns the first entry visited by a leaf node table range search,
+ * or NULL if the search compares fingerprints first.
+ */
+static const TrieLeafNode* GetFirstLeafProbe(
+    const struct RegistryTables* tables,
+    const TrieLeafNode* start,
+    const TrieLeafNode* end) {
+  const size_t num_siblings = (end - start) + 1;
+  const TrieLeafNode* middle;
+  if (IsEytzingerRange(num_siblings)) return start;
+  if (tables->leaf_fingerprints != NULL) {
+    const size_t first = GetFirstFingerprintProbe(num_siblings);
+    return first < num_siblings ? start + first : NULL;
+  }
+  middle = MIDDLE(start, end);
+  return middle;
+}
+
+void PrefetchRegistryNodeChildren(const struct RegistryTables* tables,
+                                  const struct TrieNode* parent) {
+  if (parent == NULL) {
+    /*
+     * A hashed root search touches one slot that depends on the
+     * hostname-part, so there is nothing to prefetch.
+     */
+    if (tables->num_root_children == 0 || tables->root_hash_table != NULL) {
+      return;
     }
-    exception = FindLeafNodeInRange(exception_component,
-                                    leaf_start,
-                                    leaf_end);
-    free(exception_component);
-    if (exception != NULL) {
-      match = exception;
+    PrefetchNodeRange(tables, tables->node_table,
+                      tables->node_table + (tables->num_root_children - 1));
+  } else if (HasLeafChildren(tables, parent)) {
+    const TrieLeafNode* start = tables->leaf_node_table +
+        (GetTrieNodeFirstChildOffset(parent) - tables->leaf_node_table_offset);
+    const TrieLeafNode* end =
+        start + ((int) GetTrieNodeNumChildren(parent) - 1);
+    const TrieLeafNode* first;
+    start += TrieNodeHasWildcardChild(parent);
+    if (start > end) return;
+    first = GetFirstLeafProbe(tables, start, end);
+    if (first == NULL) {
+      PREFETCH(tables->leaf_fingerprints + (start - tables->leaf_node_table));
+      return;
     }
+    PREFETCH(first);
+  } else {
+    const struct TrieNode* start =
+        tables->node_table + GetTrieNodeFirstChildOffset(parent);
+    const struct TrieNode* end =
+        start + ((int) GetTrieNodeNumChildren(parent) - 1);
+    start += TrieNodeHasWildcardChild(parent);
+    PrefetchNodeRange(tables, start, end);
   }
-  return match;
 }
 
-const char* GetHostnamePart(size_t offset) {
-  DCHECK(g_string_table != NULL);
-  return g_string_table + offset;
+void PrefetchRegistryNodeChildStrings(const struct RegistryTables* tables,
+                                      const struct TrieNode* parent) {
+  if (parent == NULL) {
+    if (tables->num_root_children == 0 || tables->root_hash_table != NULL) {
+      return;
+    }
+    PrefetchNodeRangeString(
+        tables, tables->node_table,
+        tables->node_table + (tables->num_root_children - 1));
+  } else if (HasLeafChildren(tables, parent)) {
+    const TrieLeafNode* start = tables->leaf_node_table +
+        (GetTrieNodeFirstChildOffset(parent) - tables->leaf_node_table_offset);
+    const TrieLeafNode* end =
+        start + ((int) GetTrieNodeNumChildren(parent) - 1);
+    const TrieLeafNode* first;
+    start += TrieNodeHasWildcardChild(parent);
+    if (start > end) return;
+    first = GetFirstLeafProbe(tables, start, end);
+    if (first == NULL) return;
+    PREFETCH(tables->string_table + *first);
+  } else {
+    const struct TrieNode* start =
+        tables->node_table + GetTrieNodeFirstChildOffset(parent);
+    const struct TrieNode* end =
+        start + ((int) GetTrieNodeNumChildren(parent) - 1);
+    start += TrieNodeHasWildcardChild(parent);
+    PrefetchNodeRangeString(tables, start, end);
+  }
 }
 
-int HasLeafChildren(const struct TrieNode* node) {
-  if (node->first_child_offset < g_leaf_node_table_offset) return 0;
+const char* GetHostnamePart(const struct RegistryTables* tables,
+                            size_t offset) {
+  DCHECK(tables->string_table != NULL);
+  return tables->string_table + offset;
+}
+
+int HasLeafChildren(const struct RegistryTables* tables,
+                    const struct TrieNode* node) {
+  if (GetTrieNodeFirstChildOffset(node) < tables->leaf_node_table_offset) {
+    return 0;
+  }
   return 1;
 }
 
+/* Returns the index-th 2-bit entry of the packed sections. */
+static __inline__ enum NodeSection GetPackedSection(
+    const unsigned char* sections, size_t index) {
+  return (enum NodeSection) ((sections[index >> 2] >> ((index & 3) * 2)) & 3);
+}
+
+enum NodeSection GetNodeSection(const struct RegistryTables* tables,
+                                const struct TrieNode* node) {
+  if (tables->node_sections == NULL) {
+    return NODE_SECTION_ICANN;
+  }
+  return GetPackedSection(tables->node_sections, node - tables->node_table);
+}
+
+enum NodeSection GetLeafNodeSection(const struct RegistryTables* tables,
+                                    const TrieLeafNode* leaf) {
+  if (tables->leaf_sections == NULL) {
+    return NODE_SECTION_ICANN;
+  }
+  return GetPackedSection(tables->leaf_sections,
+                          leaf - tables->leaf_node_table);
+}
+
 void SetRegistryTables(const char* string_table,
                        const struct TrieNode* node_table,
                        size_t num_root_children,
-                       const REGISTRY_U16* leaf_node_table,
+                       const TrieLeafNode* leaf_node_table,
                        size_t leaf_node_table_offset) {
-  g_string_table = string_table;
-  g_node_table = node_table;
-  g_num_root_children = num_root_children;
-  g_leaf_node_table = leaf_node_table;
-  g_leaf_node_table_offset = leaf_node_table_offset;
+  /* Replaces all of the installed tables, including the optional ones. */
+  struct RegistryTables tables;
+  memset(&tables, 0, sizeof(tables));
+  tables.string_table = string_table;
+  tables.node_table = node_table;
+  tables.num_root_children = num_root_children;
+  tables.leaf_node_table = leaf_node_table;
+  tables.leaf_node_table_offset = leaf_node_table_offset;
+  InstallRegistryTables(GetDefaultDomainRegistry(), &tables);
+}
+
+void SetRootHashTable(const REGISTRY_U16* displacements,
+                      size_t num_buckets,
+                      const struct RootHashEntry* root_hash_table) {
+  struct RegistryTables tables;
+  GetRegistryTables(GetDefaultDomainRegistry(), &tables);
+  DCHECK(displacements != NULL);
+  DCHECK(num_buckets > 0);
+  DCHECK(root_hash_table != NULL);
+  DCHECK(tables.num_root_children > 0);
+  tables.root_hash_displacements = displacements;
+  tables.num_root_hash_buckets = num_buckets;
+  tables.root_hash_table = root_hash_table;
+  InstallRegistryTables(GetDefaultDomainRegistry(), &tables);
+}
+
+void SetNodeFingerprintTables(const unsigned char* node_fingerprints,
+                              const unsigned char* leaf_fingerprints) {
+  struct RegistryTables tables;
+  DCHECK((node_fingerprints == NULL) == (leaf_fingerprints == NULL));
+  GetRegistryTables(GetDefaultDomainRegistry(), &tables);
+  tables.node_fingerprints = node_fingerprints;
+  tables.leaf_fingerprints = leaf_fingerprints;
+  InstallRegistryTables(GetDefaultDomainRegistry(), &tables);
+}
+
+void SetNodeSectionTables(const unsigned char* node_sections,
+                          const unsigned char* leaf_sections) {
+  struct RegistryTables tables;
+  DCHECK((node_sections == NULL) == (leaf_sections == NULL));
+  GetRegistryTables(GetDefaultDomainRegistry(), &tables);
+  tables.node_sections = node_sections;
+  tables.leaf_sections = leaf_sections;
+  InstallRegistryTables(GetDefaultDomainRegistry(), &tables);
 }
@@ -15,6 +15,9 @@
  *
  * Functions to search the registry tables. These should not
  * need to be invoked directly.
+ *
+ * The search functions take the tables to search, as returned by
+ * AcquireRegistryTables (see registry_tables.h).
  */
 
 #ifndef DOMAIN_REGISTRY_PRIVATE_TRIE_SEARCH_H_
@@ -22,6 +25,7 @@
 
 #include <stdlib.h>
 
+#include "domain_registry/private/registry_tables.h"
 #include "domain_registry/private/registry_types.h"
 #include "domain_registry/private/trie_node.h"
 
@@ -30,9 +34,20 @@
  * name. If parent is NULL then the search is performed at the root
  * TrieNode.
  */
-const struct TrieNode* FindRegistryNode(const char* component,
+const struct TrieNode* FindRegistryNode(const struct RegistryTables* tables,
+                                        const char* component,
                                         const struct TrieNode* parent);
 
+/*
+ * Like FindRegistryNode, but component is a hostname-part of length
+ * component_len that need not be null-terminated. component
+ * must be lowercase. Does not allocate.
+ */
+const struct TrieNode* FindRegistryNodeN(const struct RegistryTables* tables,
+                                         const char* component,
+                                         size_t component_len,
+                                         const struct TrieNode* parent);
+
 /*
  * Find a leaf TrieNode under the given parent node with the specified
  * name. If parent does not have all leaf children (i.e. if
@@ -40,23 +55,112 @@ const struct TrieNode* FindRegistryNode(const char* component,
  * NULL. If parent is NULL then the search is performed at the root
  * TrieNode.
  */
-const char* FindRegistryLeafNode(const char* component,
+const char* FindRegistryLeafNode(const struct RegistryTables* tables,
+                                 const char* component,
                                  const struct TrieNode* parent);
 
+/*
+ * Like FindRegistryLeafNode, but component is a hostname-part of
+ * length component_len that need not be null-terminated. component
+ * must be lowercase. Does not allocate.
+ */
+const char* FindRegistryLeafNodeN(const struct RegistryTables* tables,
+                                  const char* component,
+                                  size_t component_len,
+                                  const struct TrieNode* parent);
+
+/*
+ * Like FindRegistryLeafNodeN, but returns the matching entry of the
+ * leaf node table instead of its hostname-part, e.g. to pass to
+ * GetLeafNodeSection.
+ */
+const TrieLeafNode* FindRegistryLeafNodeEntryN(
+    const struct RegistryTables* tables,
+    const char* component,
+    size_t component_len,
+    const struct TrieNode* parent);
+
+/*
+ * Prefetch the first nodes that a search for a child of parent will
+ * visit. If parent is NULL, prefetches the first nodes visited by a
+ * search of the root. Used to overlap the cache misses of independent
+ * lookups.
+ */
+void PrefetchRegistryNodeChildren(const struct RegistryTables* tables,
+                                  const struct TrieNode* parent);
+
+/*
+ * Prefetch the hostname-part of the first node that a search for a
+ * child of parent will visit. This reads the node, so it should be
+ * called some time after PrefetchRegistryNodeChildren for the same
+ * parent.
+ */
+void PrefetchRegistryNodeChildStrings(const struct RegistryTables* tables,
+                                      const struct TrieNode* parent);
+
 /* Get the hostname part for the given string table offset. */
-const char* GetHostnamePart(size_t offset);
+const char* GetHostnamePart(const struct RegistryTables* tables,
+                            size_t offset);
 
 /* Does the given node have all leaf children? */
-int HasLeafChildren(const struct TrieNode* node);
+int HasLeafChildren(const struct RegistryTables* tables,
+                    const struct TrieNode* node);
 
 /*
- * Initialize the registry tables. Called at system startup by
- * InitializeDomainRegistry().
+ * Get the section of the given node of the node table, or of the
+ * given entry of the leaf node table. See enum NodeSection. Return
+ * NODE_SECTION_ICANN if no section tables are installed.
+ */
+enum NodeSection GetNodeSection(const struct RegistryTables* tables,
+                                const struct TrieNode* node);
+enum NodeSection GetLeafNodeSection(const struct RegistryTables* tables,
+                                    const TrieLeafNode* leaf);
+
+/*
+ * Install the registry tables, replacing all installed tables
+ * including the optional ones set by the functions below. Lookups in
+ * progress on other threads finish with the tables they started
+ * with. Called at system startup by InitializeDomainRegistry().
  */
 void SetRegistryTables(const char* string_table,
                        const struct TrieNode* node_table,
                        size_t num_root_children,
-                       const REGISTRY_U16* leaf_node_table,
+                       const TrieLeafNode* leaf_node_table,
                        size_t leaf_node_table_offset);
 
+/*
+ * Install a minimal perfect hash of the root nodes, used to search the
+ * root instead of a binary search. root_hash_table must have one entry
+ * per root node. SetRegistryTables removes any previously installed
+ * hash, so this must be called after it.
+ */
+void SetRootHashTable(const REGISTRY_U16* displacements,
+                      size_t num_buckets,
+                      const struct RootHashEntry* root_hash_table);
+
+/*
+ * Install the fingerprints of the hostname-parts of the nodes in the
+ * node and leaf node tables, which have one entry per node. Sibling
+ * groups are then searched by comparing the fingerprints of a block of
+ * 16 siblings, found with a binary search over the first sibling of
+ * each block, and only the strings of nodes with a matching fingerprint
+ * are read. Groups stored in Eytzinger order are still searched by
+ * comparing strings. Pass NULL for both to always compare strings.
+ * SetRegistryTables removes any previously installed fingerprints, so
+ * this must be called after it.
+ */
+void SetNodeFingerprintTables(const unsigned char* node_fingerprints,
+                              const unsigned char* leaf_fingerprints);
+
+/*
+ * Install the sections of the nodes in the node and leaf node tables,
+ * packed four 2-bit enum NodeSection values to a byte, starting from
+ * the least significant bits. Searches then also find the registry
+ * under the ICANN rules alone; see GetRegistryLengths. Pass NULL for
+ * both to treat all rules as ICANN rules. SetRegistryTables removes
+ * any previously installed sections, so this must be called after it.
+ */
+void SetNodeSectionTables(const unsigned char* node_sections,
+                          const unsigned char* leaf_sections);
+
 #endif  /* DOMAIN_REGISTRY_PRIVATE_TRIE_SEARCH_H_ */
@@ -12,22 +12,43 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
 extern "C" {
 
+#include "domain_registry/domain_registry.h"
+#include "domain_registry/private/hash_util.h"
 #include "domain_registry/private/trie_search.h"
 
 // These additional methods in trie_search.c are not public, but we
 // want to test them, so we declare their signatures here.
 
 const struct TrieNode* FindNodeInRange(
+    const struct RegistryTables* tables,
     const char* value,
     const struct TrieNode* start,
     const struct TrieNode* end);
 
 const char* FindLeafNodeInRange(
+    const struct RegistryTables* tables,
     const char* value,
-    const REGISTRY_U16* start,
-    const REGISTRY_U16* end);
+    const TrieLeafNode* start,
+    const TrieLeafNode* end);
+
+const struct TrieNode* FindNodeInEytzingerRange(
+    const struct RegistryTables* tables,
+    const char* value,
+    const struct TrieNode* nodes,
+    size_t num_nodes);
+
+const char* FindLeafNodeInEytzingerRange(
+    const struct RegistryTables* tables,
+    const char* value,
+    const TrieLeafNode* leaves,
+    size_t num_leaves);
 
 }  // extern "C"
 
@@ -38,7 +59,22 @@ const char* FindLeafNodeInRange(
 
 namespace {
 
-class TrieSearchTest : public ::testing::Test {
+// Acquires the tables installed by the SetUpTestCase of each test case
+// for the duration of each test.
+class RegistryTablesTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    tables_ = AcquireRegistryTables(GetDefaultDomainRegistry());
+  }
+
+  virtual void TearDown() {
+    ReleaseRegistryTables();
+  }
+
+  const struct RegistryTables* tables_;
+};
+
+class TrieSearchTest : public RegistryTablesTest {
  protected:
   static void SetUpTestCase() {
     // For these tests we use the test tables from simple_node_table.c.
@@ -54,7 +90,96 @@ class TrieSearchTest : public ::testing::Test {
   }
 };
 
-class TrieSearchFindNodeTest : public ::testing::Test {
+class TrieSearchRootHashTest : public TrieSearchTest {
+ protected:
+  static void SetUpTestCase() {
+    TrieSearchTest::SetUpTestCase();
+    SetRootHashTable(kSimpleRootHashDisplacements,
+                     kSimpleNumRootHashBuckets,
+                     kSimpleRootHashTable);
+  }
+};
+
+class TrieSearchFingerprintTest : public TrieSearchTest {
+ protected:
+  static void SetUpTestCase() {
+    TrieSearchTest::SetUpTestCase();
+    SetNodeFingerprintTables(kSimpleNodeFingerprintTable,
+                             kSimpleLeafFingerprintTable);
+  }
+};
+
+// Enough root nodes that they form two fingerprint blocks of 16 nodes,
+// the last of which is compared one at a time.
+const int kNumWideNodes = 30;
+
+// Enough root nodes that a binary search over the fingerprint blocks
+// takes several steps, with a last block that is not full.
+const int kNumLargeGroupNodes = 100;
+
+// The number of nodes a fingerprint search compares at a time. Must
+// match FINGERPRINT_BLOCK_SIZE in trie_search.c.
+const int kFingerprintBlockSize = 16;
+
+class TrieSearchWideFingerprintTest : public RegistryTablesTest {
+ protected:
+  TrieSearchWideFingerprintTest() : num_nodes_(kNumWideNodes) {}
+
+  virtual void SetUp() {
+    std::vector<int> order(num_nodes_);
+#ifdef DOMAIN_REGISTRY_EYTZINGER_LAYOUT
+    // Groups this large are stored in Eytzinger order, and searched in
+    // that order whether or not there are fingerprints.
+    int next = 0;
+    FillEytzingerOrder(0, &next, &order);
+#else
+    for (int i = 0; i < num_nodes_; ++i) {
+      order[i] = i;
+    }
+#endif
+    for (int i = 0; i < num_nodes_; ++i) {
+      char name[8];
+      snprintf(name, sizeof(name), "w%02d", order[i]);
+      struct TrieNode node = TRIE_NODE(string_table_.size(), 0, 0, 1, 0, 0);
+      nodes_.push_back(node);
+      fingerprints_.push_back(GetHostnamePartFingerprint(name, 3));
+      string_table_.append(name, 4);
+    }
+    // No node has leaf children, but the leaf node table must be set.
+    SetRegistryTables(string_table_.c_str(), &nodes_[0], num_nodes_,
+                      kSimpleLeafNodeTable, num_nodes_);
+    SetNodeFingerprintTables(&fingerprints_[0], &fingerprints_[0]);
+    RegistryTablesTest::SetUp();
+  }
+
+  virtual void TearDown() {
+    RegistryTablesTest::TearDown();
+    SetRegistryTables(NULL, NULL, 0, NULL, 0);
+  }
+
+  // Sets the entries of order from index i on to the sorted positions
+  // of the nodes stored at them in Eytzinger order.
+  static void FillEytzingerOrder(int i, int* next, std::vector<int>* order) {
+    if (i >= static_cast<int>(order->size())) return;
+    FillEytzingerOrder(2 * i + 1, next, order);
+    (*order)[i] = (*next)++;
+    FillEytzingerOrder(2 * i + 2, next, order);
+  }
+
+  int num_nodes_;
+  std::string string_table_;
+  std::vector<struct TrieNode> nodes_;
+  std::vector<unsigned char> fingerprints_;
+};
+
+class TrieSearchLargeGroupTest : public TrieSearchWideFingerprintTest {
+ protected:
+  TrieSearchLargeGroupTest() {
+    num_nodes_ = kNumLargeGroupNodes;
+  }
+};
+
+class TrieSearchFindNodeTest : public RegistryTablesTest {
  protected:
   static void SetUpTestCase() {
     // For these tests we need only the string table from simple_node_table.c.
@@ -66,166 +191,399 @@ class TrieSearchFindNodeTest : public ::testing::Test {
   }
 };
 
+// Sibling hostname-parts stored in Eytzinger order. In sorted order
+// they are ac, ad, ae, !ag, ai, al, am, ao, aq, ar.
+const char kEytzingerStringTable[] =
+    "ac\0ad\0ae\0!ag\0ai\0al\0am\0ao\0aq\0ar\0";
+
+const struct TrieNode kEytzingerNodeTable[] = {
+  TRIE_NODE(19, 0, 0, 1, 0, 0),  // am
+  TRIE_NODE( 9, 0, 0, 1, 0, 0),  // !ag
+  TRIE_NODE(25, 0, 0, 1, 0, 0),  // aq
+  TRIE_NODE( 3, 0, 0, 1, 0, 0),  // ad
+  TRIE_NODE(16, 0, 0, 1, 0, 0),  // al
+  TRIE_NODE(22, 0, 0, 1, 0, 0),  // ao
+  TRIE_NODE(28, 0, 0, 1, 0, 0),  // ar
+  TRIE_NODE( 0, 0, 0, 1, 0, 0),  // ac
+  TRIE_NODE( 6, 0, 0, 1, 0, 0),  // ae
+  TRIE_NODE(13, 0, 0, 1, 0, 0),  // ai
+};
+
+const TrieLeafNode kEytzingerLeafNodeTable[] = {
+  19, 9, 25, 3, 16, 22, 28, 0, 6, 13,
+};
+
+const size_t kNumEytzingerNodes =
+    sizeof(kEytzingerLeafNodeTable) / sizeof(kEytzingerLeafNodeTable[0]);
+
+const char* kEytzingerHostnameParts[] = {
+  "ac", "ad", "ae", "ag", "ai", "al", "am", "ao", "aq", "ar",
+};
+
+class TrieSearchEytzingerTest : public RegistryTablesTest {
+ protected:
+  static void SetUpTestCase() {
+    SetRegistryTables(kEytzingerStringTable, NULL, 0, NULL, 0);
+  }
+
+  static void TearDownTestCase() {
+    SetRegistryTables(NULL, NULL, 0, NULL, 0);
+  }
+};
+
+TEST_F(TrieSearchEytzingerTest, FindNodeInEytzingerRange) {
+  for (size_t i = 0; i < kNumEytzingerNodes; ++i) {
+    const char* hostname_part = kEytzingerHostnameParts[i];
+    const struct TrieNode* node = FindNodeInEytzingerRange(
+        tables_, hostname_part, kEytzingerNodeTable, kNumEytzingerNodes);
+    ASSERT_TRUE(node != NULL) << hostname_part;
+    const char* str = kEytzingerStringTable +
+        GetTrieNodeStringTableOffset(node);
+    EXPECT_STREQ(hostname_part, str + (str[0] == '!' ? 1 : 0));
+  }
+  EXPECT_EQ(NULL,
+            FindNodeInEytzingerRange(tables_,
+                                     "",
+                                     kEytzingerNodeTable,
+                                     kNumEytzingerNodes));
+  EXPECT_EQ(NULL,
+            FindNodeInEytzingerRange(tables_,
+                                     "ab",
+                                     kEytzingerNodeTable,
+                                     kNumEytzingerNodes));
+  EXPECT_EQ(NULL,
+            FindNodeInEytzingerRange(tables_,
+                                     "af",
+                                     kEytzingerNodeTable,
+                                     kNumEytzingerNodes));
+  EXPECT_EQ(NULL,
+            FindNodeInEytzingerRange(tables_,
+                                     "as",
+                                     kEytzingerNodeTable,
+                                     kNumEytzingerNodes));
+  EXPECT_EQ(NULL,
+            FindNodeInEytzingerRange(tables_,
+                                     "amx",
+                                     kEytzingerNodeTable,
+                                     kNumEytzingerNodes));
+  EXPECT_EQ(NULL,
+            FindNodeInEytzingerRange(tables_, "am", kEytzingerNodeTable, 0));
+}
+
+TEST_F(TrieSearchEytzingerTest, FindLeafNodeInEytzingerRange) {
+  for (size_t i = 0; i < kNumEytzingerNodes; ++i) {
+    const char* hostname_part = kEytzingerHostnameParts[i];
+    const char* match = FindLeafNodeInEytzingerRange(
+        tables_, hostname_part, kEytzingerLeafNodeTable, kNumEytzingerNodes);
+    ASSERT_TRUE(match != NULL) << hostname_part;
+    EXPECT_STREQ(hostname_part, match + (match[0] == '!' ? 1 : 0));
+  }
+  EXPECT_EQ(&kEytzingerStringTable[9],
+            FindLeafNodeInEytzingerRange(tables_,
+                                         "ag",
+                                         kEytzingerLeafNodeTable,
+                                         kNumEytzingerNodes));
+  EXPECT_EQ(NULL,
+            FindLeafNodeInEytzingerRange(tables_,
+                                         "a",
+                                         kEytzingerLeafNodeTable,
+                                         kNumEytzingerNodes));
+  EXPECT_EQ(NULL,
+            FindLeafNodeInEytzingerRange(tables_,
+                                         "an",
+                                         kEytzingerLeafNodeTable,
+                                         kNumEytzingerNodes));
+  EXPECT_EQ(NULL,
+            FindLeafNodeInEytzingerRange(tables_,
+                                         "zz",
+                                         kEytzingerLeafNodeTable,
+                                         kNumEytzingerNodes));
+}
+
 TEST_F(TrieSearchTest, FindRegistryNode) {
   // Tests for searching root nodes.
-  EXPECT_EQ(NULL, FindRegistryNode("", NULL));
-  EXPECT_EQ(&kSimpleNodeTable[0], FindRegistryNode("com", NULL));
-  EXPECT_EQ(&kSimpleNodeTable[1], FindRegistryNode("foo", NULL));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "", NULL));
+  EXPECT_EQ(&kSimpleNodeTable[0], FindRegistryNode(tables_, "com", NULL));
+  EXPECT_EQ(&kSimpleNodeTable[1], FindRegistryNode(tables_, "foo", NULL));
 
   // Tests for searching non-root nodes.
+  EXPECT_EQ(&kSimpleNodeTable[4],
+            FindRegistryNode(tables_, "baz", &kSimpleNodeTable[1]));
   EXPECT_EQ(&kSimpleNodeTable[2],
-            FindRegistryNode("baz", &kSimpleNodeTable[1]));
-  EXPECT_EQ(&kSimpleNodeTable[3],
-            FindRegistryNode("zzz", &kSimpleNodeTable[1]));
+            FindRegistryNode(tables_, "zzz", &kSimpleNodeTable[1]));
+  EXPECT_EQ(&kSimpleNodeTable[2],
+            FindRegistryNode(tables_, "wildcard", &kSimpleNodeTable[1]));
+  EXPECT_EQ(&kSimpleNodeTable[2],
+            FindRegistryNode(tables_, "wc", &kSimpleNodeTable[1]));
   EXPECT_EQ(&kSimpleNodeTable[3],
-            FindRegistryNode("wildcard", &kSimpleNodeTable[1]));
+            FindRegistryNode(tables_, "bar", &kSimpleNodeTable[1]));
   EXPECT_EQ(&kSimpleNodeTable[3],
-            FindRegistryNode("wc", &kSimpleNodeTable[1]));
-  EXPECT_EQ(&kSimpleNodeTable[4],
-            FindRegistryNode("bar", &kSimpleNodeTable[1]));
-  EXPECT_EQ(&kSimpleNodeTable[4],
-            FindRegistryNode("bar", &kSimpleNodeTable[1]));
+            FindRegistryNodeN(tables_, "barfoo", 3, &kSimpleNodeTable[1]));
 
   // Tests to verify that searches for wildcard and exceptions never match.
-  EXPECT_EQ(NULL, FindRegistryNode("!baz", &kSimpleNodeTable[1]));
-  EXPECT_EQ(NULL, FindRegistryNode("*", &kSimpleNodeTable[1]));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "!baz", &kSimpleNodeTable[1]));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "*", &kSimpleNodeTable[1]));
 
   // Test to verify that a search for the empty string on a wildcard
   // node doesn't match.
-  EXPECT_EQ(NULL, FindRegistryNode("", &kSimpleNodeTable[1]));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "", &kSimpleNodeTable[1]));
+}
+
+TEST_F(TrieSearchRootHashTest, FindRegistryNode) {
+  EXPECT_EQ(&kSimpleNodeTable[0], FindRegistryNode(tables_, "com", NULL));
+  EXPECT_EQ(&kSimpleNodeTable[1], FindRegistryNode(tables_, "foo", NULL));
+  EXPECT_EQ(&kSimpleNodeTable[0],
+            FindRegistryNodeN(tables_, "comfoo", 3, NULL));
+
+  // Every hostname-part maps to some slot, so these must be rejected
+  // by the fingerprint or by the string comparison.
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "", NULL));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "co", NULL));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "comx", NULL));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "bar", NULL));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "*", NULL));
+
+  // Non-root searches are unaffected.
+  EXPECT_EQ(&kSimpleNodeTable[3],
+            FindRegistryNode(tables_, "bar", &kSimpleNodeTable[1]));
+}
+
+TEST_F(TrieSearchFingerprintTest, FindRegistryNode) {
+  EXPECT_EQ(&kSimpleNodeTable[0], FindRegistryNode(tables_, "com", NULL));
+  EXPECT_EQ(&kSimpleNodeTable[1], FindRegistryNode(tables_, "foo", NULL));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "bar", NULL));
+  EXPECT_EQ(&kSimpleNodeTable[4],
+            FindRegistryNode(tables_, "baz", &kSimpleNodeTable[1]));
+  EXPECT_EQ(&kSimpleNodeTable[3],
+            FindRegistryNode(tables_, "bar", &kSimpleNodeTable[1]));
+  EXPECT_EQ(&kSimpleNodeTable[3],
+            FindRegistryNodeN(tables_, "barfoo", 3, &kSimpleNodeTable[1]));
+  EXPECT_EQ(&kSimpleNodeTable[2],
+            FindRegistryNode(tables_, "zzz", &kSimpleNodeTable[1]));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "!baz", &kSimpleNodeTable[1]));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "*", &kSimpleNodeTable[1]));
+}
+
+TEST_F(TrieSearchFingerprintTest, FindRegistryLeafNode) {
+  EXPECT_EQ(&kSimpleStringTable[4],
+            FindRegistryLeafNode(tables_, "foo", &kSimpleNodeTable[0]));
+  EXPECT_EQ(NULL, FindRegistryLeafNode(tables_, "bar", &kSimpleNodeTable[0]));
+  EXPECT_EQ(&kSimpleStringTable[10],
+            FindRegistryLeafNode(tables_, "baz", &kSimpleNodeTable[2]));
+  EXPECT_EQ(&kSimpleStringTable[8],
+            FindRegistryLeafNode(tables_, "zzz", &kSimpleNodeTable[2]));
+  EXPECT_EQ(&kSimpleStringTable[8],
+            FindRegistryLeafNode(tables_, "baz", &kSimpleNodeTable[3]));
+  EXPECT_EQ(NULL, FindRegistryLeafNode(tables_, "!baz", &kSimpleNodeTable[2]));
+}
+
+TEST_F(TrieSearchWideFingerprintTest, FindRegistryNode) {
+  for (int i = 0; i < kNumWideNodes; ++i) {
+    EXPECT_EQ(&nodes_[i],
+              FindRegistryNode(tables_, string_table_.c_str() + 4 * i, NULL));
+  }
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "w", NULL));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "w30", NULL));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "w000", NULL));
+}
+
+TEST_F(TrieSearchWideFingerprintTest, FingerprintCollisions) {
+  // With every fingerprint the same, every node is a candidate, and
+  // only the string comparison tells them apart.
+  const char* last = string_table_.c_str() + 4 * (kNumWideNodes - 1);
+  for (int i = 0; i < kNumWideNodes; ++i) {
+    fingerprints_[i] = GetHostnamePartFingerprint(last, 3);
+  }
+  EXPECT_EQ(&nodes_[kNumWideNodes - 1], FindRegistryNode(tables_, last, NULL));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "w30", NULL));
+}
+
+TEST_F(TrieSearchLargeGroupTest, FindRegistryNode) {
+  for (int i = 0; i < kNumLargeGroupNodes; ++i) {
+    EXPECT_EQ(&nodes_[i],
+              FindRegistryNode(tables_, string_table_.c_str() + 4 * i, NULL));
+  }
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "w", NULL));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "w000", NULL));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "w505", NULL));
+  EXPECT_EQ(NULL, FindRegistryNode(tables_, "x", NULL));
+}
+
+TEST_F(TrieSearchLargeGroupTest, SearchesOneBlock) {
+  // With the fingerprints of all but the first node of each block
+  // changed, only the first nodes, which the binary search over the
+  // blocks compares as strings, are found. Groups stored in Eytzinger
+  // order do not use fingerprints, so every node is found.
+  for (int i = 0; i < kNumLargeGroupNodes; ++i) {
+    if (i % kFingerprintBlockSize != 0) {
+      fingerprints_[i] = (unsigned char) ~fingerprints_[i];
+    }
+  }
+  for (int i = 0; i < kNumLargeGroupNodes; ++i) {
+#ifdef DOMAIN_REGISTRY_EYTZINGER_LAYOUT
+    const bool found = true;
+#else
+    const bool found = i % kFingerprintBlockSize == 0;
+#endif
+    EXPECT_EQ(found ? &nodes_[i] : NULL,
+              FindRegistryNode(tables_, string_table_.c_str() + 4 * i, NULL))
+        << i;
+  }
 }
 
 TEST_F(TrieSearchTest, FindRegistryLeafNode) {
   // Simple leaf tests
-  EXPECT_EQ(NULL, FindRegistryLeafNode("", &kSimpleNodeTable[0]));
+  EXPECT_EQ(NULL, FindRegistryLeafNode(tables_, "", &kSimpleNodeTable[0]));
   EXPECT_EQ(&kSimpleStringTable[4],
-            FindRegistryLeafNode("foo", &kSimpleNodeTable[0]));
+            FindRegistryLeafNode(tables_, "foo", &kSimpleNodeTable[0]));
 
   EXPECT_EQ(&kSimpleStringTable[10],
-            FindRegistryLeafNode("baz", &kSimpleNodeTable[3]));
+            FindRegistryLeafNode(tables_, "baz", &kSimpleNodeTable[2]));
   EXPECT_EQ(&kSimpleStringTable[4],
-            FindRegistryLeafNode("foo", &kSimpleNodeTable[3]));
+            FindRegistryLeafNode(tables_, "foo", &kSimpleNodeTable[2]));
   EXPECT_EQ(&kSimpleStringTable[8],
-            FindRegistryLeafNode("zzz", &kSimpleNodeTable[3]));
+            FindRegistryLeafNode(tables_, "zzz", &kSimpleNodeTable[2]));
   EXPECT_EQ(&kSimpleStringTable[8],
-            FindRegistryLeafNode("wildcard", &kSimpleNodeTable[3]));
+            FindRegistryLeafNode(tables_, "wildcard", &kSimpleNodeTable[2]));
   EXPECT_EQ(&kSimpleStringTable[8],
-            FindRegistryLeafNode("wc", &kSimpleNodeTable[3]));
+            FindRegistryLeafNode(tables_, "wc", &kSimpleNodeTable[2]));
 
   EXPECT_EQ(&kSimpleStringTable[4],
-            FindRegistryLeafNode("foo", &kSimpleNodeTable[4]));
+            FindRegistryLeafNode(tables_, "foo", &kSimpleNodeTable[3]));
   EXPECT_EQ(&kSimpleStringTable[8],
-            FindRegistryLeafNode("zzz", &kSimpleNodeTable[4]));
+            FindRegistryLeafNode(tables_, "zzz", &kSimpleNodeTable[3]));
+  EXPECT_EQ(&kSimpleStringTable[8],
+            FindRegistryLeafNode(tables_, "baz", &kSimpleNodeTable[3]));
 
   // Tests to verify that searches for wildcard and exceptions never
   // match.
-  EXPECT_EQ(NULL, FindRegistryLeafNode("!baz", &kSimpleNodeTable[4]));
-  EXPECT_EQ(NULL, FindRegistryLeafNode("*", &kSimpleNodeTable[4]));
+  EXPECT_EQ(NULL, FindRegistryLeafNode(tables_, "!baz", &kSimpleNodeTable[3]));
+  EXPECT_EQ(NULL, FindRegistryLeafNode(tables_, "*", &kSimpleNodeTable[3]));
+  EXPECT_EQ(NULL, FindRegistryLeafNode(tables_, "!baz", &kSimpleNodeTable[2]));
 
   // Test to verify that a search for the empty string on a wildcard
   // node doesn't match.
-  EXPECT_EQ(NULL, FindRegistryLeafNode("", &kSimpleNodeTable[4]));
+  EXPECT_EQ(NULL, FindRegistryLeafNode(tables_, "", &kSimpleNodeTable[3]));
 }
 
 TEST_F(TrieSearchTest, GetHostnamePart) {
-  EXPECT_STREQ("com", GetHostnamePart(0));
-  EXPECT_STREQ("foo", GetHostnamePart(4));
+  EXPECT_STREQ("com", GetHostnamePart(tables_, 0));
+  EXPECT_STREQ("foo", GetHostnamePart(tables_, 4));
 }
 
 TEST_F(TrieSearchTest, HasLeafChildren) {
-  EXPECT_TRUE(HasLeafChildren(&kSimpleNodeTable[0]));
-  EXPECT_FALSE(HasLeafChildren(&kSimpleNodeTable[1]));
+  EXPECT_TRUE(HasLeafChildren(tables_, &kSimpleNodeTable[0]));
+  EXPECT_FALSE(HasLeafChildren(tables_, &kSimpleNodeTable[1]));
 }
 
 TEST_F(TrieSearchFindNodeTest, FindNodeInRangeSingleNode) {
   EXPECT_EQ(&kSimpleNodeTable[0],
-            FindNodeInRange("com", &kSimpleNodeTable[0], &kSimpleNodeTable[0]));
+            FindNodeInRange(tables_, "com",
+                            &kSimpleNodeTable[0], &kSimpleNodeTable[0]));
   EXPECT_EQ(NULL,
-            FindNodeInRange("co", &kSimpleNodeTable[0], &kSimpleNodeTable[0]));
+            FindNodeInRange(tables_, "co",
+                            &kSimpleNodeTable[0], &kSimpleNodeTable[0]));
   EXPECT_EQ(NULL,
-            FindNodeInRange("comm",
+            FindNodeInRange(tables_, "comm",
                             &kSimpleNodeTable[0],
                             &kSimpleNodeTable[0]));
   EXPECT_EQ(NULL,
-            FindNodeInRange("foo", &kSimpleNodeTable[0], &kSimpleNodeTable[0]));
+            FindNodeInRange(tables_, "foo",
+                            &kSimpleNodeTable[0], &kSimpleNodeTable[0]));
   EXPECT_EQ(NULL,
-            FindNodeInRange("", &kSimpleNodeTable[0], &kSimpleNodeTable[0]));
+            FindNodeInRange(tables_, "",
+                            &kSimpleNodeTable[0], &kSimpleNodeTable[0]));
 }
 
 TEST_F(TrieSearchFindNodeTest, FindNodeInRangeTwoNodes) {
   EXPECT_EQ(&kSimpleNodeTable[0],
-            FindNodeInRange("com", &kSimpleNodeTable[0], &kSimpleNodeTable[1]));
+            FindNodeInRange(tables_, "com",
+                            &kSimpleNodeTable[0], &kSimpleNodeTable[1]));
   EXPECT_EQ(&kSimpleNodeTable[1],
-            FindNodeInRange("foo", &kSimpleNodeTable[0], &kSimpleNodeTable[1]));
+            FindNodeInRange(tables_, "foo",
+                            &kSimpleNodeTable[0], &kSimpleNodeTable[1]));
   EXPECT_EQ(NULL,
-            FindNodeInRange("", &kSimpleNodeTable[0], &kSimpleNodeTable[1]));
+            FindNodeInRange(tables_, "",
+                            &kSimpleNodeTable[0], &kSimpleNodeTable[1]));
 }
 
 TEST_F(TrieSearchFindNodeTest, FindNodeInRangeThreeNodes) {
   EXPECT_EQ(&kSimpleNodeTable[2],
-            FindNodeInRange("!baz", &kSimpleNodeTable[2], &kSimpleNodeTable[4]));
+            FindNodeInRange(tables_, "*",
+                            &kSimpleNodeTable[2], &kSimpleNodeTable[4]));
   EXPECT_EQ(&kSimpleNodeTable[3],
-            FindNodeInRange("*", &kSimpleNodeTable[2], &kSimpleNodeTable[4]));
-  EXPECT_EQ(&kSimpleNodeTable[4],
-            FindNodeInRange("bar", &kSimpleNodeTable[2], &kSimpleNodeTable[4]));
+            FindNodeInRange(tables_, "bar",
+                            &kSimpleNodeTable[2], &kSimpleNodeTable[4]));
 
-  // exception and wildcard matches are not performed at this level,
-  // so we expect them to fail here.
+  // Exception rules are sorted under the hostname-part they are an
+  // exception for, so the search for that hostname-part finds them.
+  EXPECT_EQ(&kSimpleNodeTable[4],
+            FindNodeInRange(tables_, "baz",
+                            &kSimpleNodeTable[2], &kSimpleNodeTable[4]));
   EXPECT_EQ(NULL,
-            FindNodeInRange("baz", &kSimpleNodeTable[2], &kSimpleNodeTable[4]));
+            FindNodeInRange(tables_, "!baz",
+                            &kSimpleNodeTable[2], &kSimpleNodeTable[4]));
+
+  // wildcard matches are not performed at this level, so we expect
+  // them to fail here.
   EXPECT_EQ(NULL,
-            FindNodeInRange("wc", &kSimpleNodeTable[2], &kSimpleNodeTable[4]));
+            FindNodeInRange(tables_, "wc",
+                            &kSimpleNodeTable[2], &kSimpleNodeTable[4]));
 }
 
 TEST_F(TrieSearchFindNodeTest, FindLeafNodeInRangeSingleNode) {
   EXPECT_EQ(&kSimpleStringTable[10],
-            FindLeafNodeInRange("!baz",
-                                &kSimpleLeafNodeTable[0],
-                                &kSimpleLeafNodeTable[0]));
+            FindLeafNodeInRange(tables_, "baz",
+                                &kSimpleLeafNodeTable[1],
+                                &kSimpleLeafNodeTable[1]));
   EXPECT_EQ(NULL,
-            FindLeafNodeInRange("foo",
-                                &kSimpleLeafNodeTable[0],
-                                &kSimpleLeafNodeTable[0]));
+            FindLeafNodeInRange(tables_, "!baz",
+                                &kSimpleLeafNodeTable[1],
+                                &kSimpleLeafNodeTable[1]));
   EXPECT_EQ(NULL,
-            FindLeafNodeInRange("",
-                                &kSimpleLeafNodeTable[0],
-                                &kSimpleLeafNodeTable[0]));
+            FindLeafNodeInRange(tables_, "foo",
+                                &kSimpleLeafNodeTable[1],
+                                &kSimpleLeafNodeTable[1]));
   EXPECT_EQ(NULL,
-            FindLeafNodeInRange("!ba",
-                                &kSimpleLeafNodeTable[0],
-                                &kSimpleLeafNodeTable[0]));
+            FindLeafNodeInRange(tables_, "",
+                                &kSimpleLeafNodeTable[1],
+                                &kSimpleLeafNodeTable[1]));
   EXPECT_EQ(NULL,
-            FindLeafNodeInRange("!bazz",
-                                &kSimpleLeafNodeTable[0],
-                                &kSimpleLeafNodeTable[0]));
+            FindLeafNodeInRange(tables_, "ba",
+                                &kSimpleLeafNodeTable[1],
+                                &kSimpleLeafNodeTable[1]));
+  EXPECT_EQ(NULL,
+            FindLeafNodeInRange(tables_, "bazz",
+                                &kSimpleLeafNodeTable[1],
+                                &kSimpleLeafNodeTable[1]));
 }
 
 TEST_F(TrieSearchFindNodeTest, FindLeafNodeInRangeTwoNodes) {
   EXPECT_EQ(&kSimpleStringTable[10],
-            FindLeafNodeInRange("!baz",
+            FindLeafNodeInRange(tables_, "baz",
                                 &kSimpleLeafNodeTable[0],
                                 &kSimpleLeafNodeTable[1]));
   EXPECT_EQ(&kSimpleStringTable[8],
-            FindLeafNodeInRange("*",
+            FindLeafNodeInRange(tables_, "*",
                                 &kSimpleLeafNodeTable[0],
                                 &kSimpleLeafNodeTable[1]));
   EXPECT_EQ(&kSimpleStringTable[4],
-           FindLeafNodeInRange("foo",
+           FindLeafNodeInRange(tables_, "foo",
                                 &kSimpleLeafNodeTable[1],
                                 &kSimpleLeafNodeTable[2]));
 }
 
 TEST_F(TrieSearchFindNodeTest, FindLeafNodeInRangeThreeNodes) {
   EXPECT_EQ(&kSimpleStringTable[10],
-            FindLeafNodeInRange("!baz",
+            FindLeafNodeInRange(tables_, "baz",
                                 &kSimpleLeafNodeTable[0],
                                 &kSimpleLeafNodeTable[2]));
   EXPECT_EQ(&kSimpleStringTable[4],
-            FindLeafNodeInRange("foo",
+            FindLeafNodeInRange(tables_, "foo",
                                 &kSimpleLeafNodeTable[0],
                                 &kSimpleLeafNodeTable[2]));
   EXPECT_EQ(&kSimpleStringTable[8],
-            FindLeafNodeInRange("*",
+            FindLeafNodeInRange(tables_, "*",
                                 &kSimpleLeafNodeTable[0],
                                 &kSimpleLeafNodeTable[2]));
 }
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "domain_registry/private/url_host.h"
+
+/* Can c appear in a URL scheme? See RFC 3986, section 3.1. */
+static int IsSchemeChar(char c, int is_first) {
+  if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+    return 1;
+  }
+  if (is_first) {
+    return 0;
+  }
+  return (c >= '0' && c <= '9') || c == '+' || c == '-' || c == '.';
+}
+
+/* Does c end the authority (userinfo, host and port) of a URL? */
+static int IsAuthorityTerminator(char c) {
+  return c == '/' || c == '?' || c == '#' || c == '\\';
+}
+
+/*
+ * Returns the length of the scheme of the URL, not including the ':'
+ * that follows it, or 0 if the URL does not start with a scheme.
+ */
+static size_t GetSchemeLength(const char* url, size_t url_len) {
+  size_t i;
+  for (i = 0; i < url_len; ++i) {
+    if (url[i] == ':') {
+      return i;
+    }
+    if (!IsSchemeChar(url[i], i == 0)) {
+      return 0;
+    }
+  }
+  return 0;
+}
+
+/*
+ * Is the text between begin and end, which follows a ':', a port
+ * number rather than the rest of a URL without an authority?
+ */
+static int IsPort(const char* begin, const char* end) {
+  const char* p;
+  for (p = begin; p < end && !IsAuthorityTerminator(*p); ++p) {
+    if (*p < '0' || *p > '9') {
+      return 0;
+    }
+  }
+  return p > begin;
+}
+
+int FindUrlHost(const char* url,
+                size_t url_len,
+                size_t* host_offset,
+                size_t* host_len) {
+  const char* const end = url + url_len;
+  const char* authority = url;
+  const char* host;
+  const char* host_end;
+  const char* p;
+  size_t scheme_len;
+
+  /*
+   * Skip the scheme and the "//" that starts the authority. Without
+   * a "//", a scheme is either a host followed by a port (e.g.
+   * "google.com:80"), or belongs to a URL without an authority.
+   */
+  scheme_len = GetSchemeLength(url, url_len);
+  if (scheme_len > 0) {
+    const char* rest = url + scheme_len + 1;
+    if (end - rest >= 2 && rest[0] == '/' && rest[1] == '/') {
+      authority = rest + 2;
+    } else if (!IsPort(rest, end)) {
+      return 0;
+    }
+  } else if (url_len >= 2 && url[0] == '/' && url[1] == '/') {
+    authority = url + 2;
+  }
+
+  /* The host follows the last '@' of the authority, if any. */
+  host = authority;
+  for (p = authority; p < end && !IsAuthorityTerminator(*p); ++p) {
+    if (*p == '@') {
+      host = p + 1;
+    }
+  }
+  if (host < end && *host == '[') {
+    return 0;
+  }
+  host_end = host;
+  while (host_end < p && *host_end != ':') {
+    ++host_end;
+  }
+  if (host_end > host && host_end[-1] == '.') {
+    --host_end;
+  }
+  if (host_end == host) {
+    return 0;
+  }
+  *host_offset = host - url;
+  *host_len = host_end - host;
+  return 1;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2011 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ * Finds the host of a URL in place. These should not need to be
+ * invoked directly.
+ */
+
+#ifndef DOMAIN_REGISTRY_PRIVATE_URL_HOST_H_
+#define DOMAIN_REGISTRY_PRIVATE_URL_HOST_H_
+
+#include <stdlib.h>
+
+/*
+ * Finds the host of the URL of url_len bytes at url, which need not
+ * be null-terminated, and stores its offset from url and its length
+ * in host_offset and host_len. The URL is of the form
+ * scheme://userinfo@host:port/path?query#fragment, where every part
+ * but the host is optional, e.g. "www.google.com:80" or
+ * "//www.google.com/". A single trailing dot is not part of the host.
+ * Only the bytes up to the end of the host and port are read.
+ *
+ * Returns 0 if the URL has no host (e.g. "file:///tmp" or
+ * "mailto:foo@google.com"), or if the host is an IPv6 address in
+ * brackets. The host is not otherwise validated; see ScanHostname.
+ */
+int FindUrlHost(const char* url,
+                size_t url_len,
+                size_t* host_offset,
+                size_t* host_len);
+
+#endif  /* DOMAIN_REGISTRY_PRIVATE_URL_HOST_H_ */
@@ -0,0 +1,51 @@
+// Copyright 2011 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "domain_registry/testing/lookup_engine.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "domain_registry/private/dafsa_search.h"
+#include "domain_registry/private/init_registry_tables.h"
+#include "domain_registry/private/matcher_search.h"
+#include "domain_registry/private/suffix_hash_search.h"
+
+const char* const kLookupEngines[NUM_LOOKUP_ENGINES] = {
+  "trie", "suffix-hash", "dafsa", "matcher",
+};
+
+int InstallEngine(const char* engine) {
+  SetSuffixHashTable(NULL, 0, 0);
+  SetDafsa(NULL, 0);
+  SetRegistryMatcher(NULL);
+  if (strcmp(engine, "suffix-hash") == 0) {
+    InitializeSuffixHashTable();
+  } else if (strcmp(engine, "dafsa") == 0) {
+    InitializeDafsa();
+  } else if (strcmp(engine, "matcher") == 0) {
+    InitializeRegistryMatcher();
+  } else if (strcmp(engine, "trie") != 0) {
+    return 0;
+  }
+  return 1;
+}
+
+const char* GetFlagValue(const char* arg, const char* flag) {
+  const size_t len = strlen(flag);
+  if (strncmp(arg, flag, len) == 0 && arg[len] == '=') {
+    return arg + len + 1;
+  }
+  return NULL;
+}
@@ -0,0 +1,36 @@
+// Copyright 2011 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Helpers shared by the perf, scaling and fuzz tools, which switch
+// between the lookup engines and parse --flag=value arguments.
+
+#ifndef DOMAIN_REGISTRY_TESTING_LOOKUP_ENGINE_H_
+#define DOMAIN_REGISTRY_TESTING_LOOKUP_ENGINE_H_
+
+#define NUM_LOOKUP_ENGINES 4
+
+// The names of the lookup engines: "trie", "suffix-hash", "dafsa" and
+// "matcher".
+extern const char* const kLookupEngines[NUM_LOOKUP_ENGINES];
+
+// Install the named engine, replacing the one installed before.
+// Returns 0 if there is no engine of that name, in which case the
+// trie is left installed.
+int InstallEngine(const char* engine);
+
+// Returns the value of arg if it has the form flag=value, NULL
+// otherwise.
+const char* GetFlagValue(const char* arg, const char* flag);
+
+#endif  // DOMAIN_REGISTRY_TESTING_LOOKUP_ENGINE_H_
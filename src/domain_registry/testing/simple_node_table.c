@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <string.h>
+
 #include "domain_registry/private/registry_types.h"
 #include "domain_registry/private/trie_node.h"
 
@@ -23,23 +25,204 @@
 static const char kSimpleStringTable[] = "com\0foo\0*\0!baz\0bar\0";
 
 static const struct TrieNode kSimpleNodeTable[] = {
-  // TrieNode is a tuple with 4 fields (in order):
+  // TRIE_NODE takes the 6 fields of a node (in order):
   // 1. string_table_offset
   // 2. first_child_offset. Note that leaf table offsets start at 5.
   // 3. num_children
   // 4. is_terminal
-  { 0,  7, 1, 0 },  // com       (1 leaf child at offset 2)
-  { 4,  2, 3, 0 },  // foo       (3 non-leaf children at offset 2)
-  { 10, 0, 0, 1 },  // !baz.foo  (0 children)
-  { 8,  5, 3, 1 },  // *.foo     (3 leaf children at offset 0)
-  { 15, 6, 2, 1 },  // bar.foo   (2 leaf children at offset 1)
+  // 5. has_wildcard_child
+  // 6. has_exception_children
+  //
+  // Siblings are sorted with the wildcard first, and with exception
+  // rules sorted as though they had no leading '!'.
+  TRIE_NODE( 0, 7, 1, 0, 0, 0),  // com       (1 leaf child at offset 2)
+  TRIE_NODE( 4, 2, 3, 0, 1, 1),  // foo       (3 non-leaf children at offset 2)
+  TRIE_NODE( 8, 5, 3, 1, 1, 1),  // *.foo     (3 leaf children at offset 0)
+  TRIE_NODE(15, 8, 2, 1, 1, 0),  // bar.foo   (2 leaf children at offset 3)
+  TRIE_NODE(10, 0, 0, 1, 0, 0),  // !baz.foo  (0 children)
 };
 
-static const REGISTRY_U16 kSimpleLeafNodeTable[] = {
+static const TrieLeafNode kSimpleLeafNodeTable[] = {
+  8,   // *
   10,  // !baz
+  4,   // foo
   8,   // *
   4,   // foo
 };
 
 static const size_t kSimpleNumRootChildren = 2;
 static const size_t kSimpleLeafNodeTableOffset = 5;
+
+// Fingerprints of the hostname-parts in kSimpleNodeTable and
+// kSimpleLeafNodeTable, as built by
+// registry_tables_generator/root_hash_builder.py. Exception rules
+// have the fingerprint of the hostname-part they are an exception for.
+static const unsigned char kSimpleNodeFingerprintTable[] = {
+  0x2c,  // com
+  0x6d,  // foo
+  0x3d,  // *
+  0xc7,  // bar
+  0xd9,  // !baz
+};
+
+static const unsigned char kSimpleLeafFingerprintTable[] = {
+  0x3d,  // *
+  0xd9,  // !baz
+  0x6d,  // foo
+  0x3d,  // *
+  0x6d,  // foo
+};
+
+// Sections of the nodes in kSimpleNodeTable and kSimpleLeafNodeTable,
+// as built by registry_tables_generator/section_table_builder.py if
+// the rules "bar.foo" and "foo.bar.foo" are in the PRIVATE section:
+// bar.foo is NODE_SECTION_ICANN_NOT_TERMINAL (1), since the ICANN rule
+// *.bar.foo passes through it, and foo.bar.foo is
+// NODE_SECTION_PRIVATE_ICANN_WILDCARD (3). All other nodes are
+// NODE_SECTION_ICANN (0). Packed four to a byte, from the least
+// significant bits.
+static const unsigned char kSimpleNodeSectionTable[] = {
+  0x40,  // com, foo, *.foo, bar.foo
+  0x00,  // !baz.foo
+};
+
+static const unsigned char kSimpleLeafSectionTable[] = {
+  0x00,  // *, !baz, foo, *
+  0x03,  // foo
+};
+
+// Minimal perfect hash of the root nodes "com" and "foo", as built by
+// registry_tables_generator/root_hash_builder.py.
+static const REGISTRY_U16 kSimpleRootHashDisplacements[] = { 3 };
+static const size_t kSimpleNumRootHashBuckets = 1;
+static const struct RootHashEntry kSimpleRootHashTable[] = {
+  // 1. node_index
+  // 2. fingerprint
+  { 1, 23716 },  // foo
+  { 0,  2924 },  // com
+};
+
+// Hash table of the rule suffixes above, as built by
+// registry_tables_generator/suffix_hash_builder.py with seed 0.
+static const struct SuffixHashEntry kSimpleSuffixHashTable[] = {
+  // 1. hash
+  // 2. string_table_offset
+  // 3. is_terminal
+  // 4. has_wildcard_child
+  // 5. is_exception
+  // 6. has_children
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x89537c03,  8, 1, 1, 0, 1 },  // *.foo
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0xa9f37ed7,  4, 0, 1, 0, 1 },  // foo
+  { 0xc394225c, 10, 1, 0, 1, 0 },  // !baz.foo
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0xf8fd8d11,  4, 1, 0, 0, 0 },  // foo.*.foo
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0xadced94c,  8, 1, 0, 0, 0 },  // *.bar.foo
+  { 0xf18dd2de,  0, 0, 0, 0, 1 },  // com
+  { 0x132f9ee8,  4, 1, 0, 0, 0 },  // foo.com
+  { 0x0bf3cf8e,  4, 1, 0, 0, 0 },  // foo.bar.foo
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0xe8c59c47,  8, 1, 0, 0, 0 },  // *.*.foo
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0xcb942ef4, 15, 1, 1, 0, 1 },  // bar.foo
+  { 0xb642c0d0, 10, 1, 0, 1, 0 },  // !baz.*.foo
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x00000000,  0, 0, 0, 0, 0 },
+  { 0x00000000,  0, 0, 0, 0, 0 },
+};
+
+static const size_t kSimpleSuffixHashTableSize = 32;
+static const REGISTRY_U32 kSimpleSuffixHashSeed = 0;
+
+// DAFSA of the rules above, as built by
+// registry_tables_generator/dafsa_builder.py. Rules are stored
+// reversed, so e.g. "oof." matches the hostname suffix ".foo".
+static const unsigned char kSimpleDafsa[] = {
+  0x02, 0x9d,                    //  0: children at 2, 31
+  0x6f, 0x6f, 0x66, 0xae,        //  2: "oof."
+  0x03, 0x08, 0x88,              //  6: children at 9, 17, 25
+  0x72, 0x61, 0xe2,              //  9: "rab"
+  0x02, 0x86,                    // 12: children at 14, 20
+  0xae,                          // 14: "."
+  0x0e, 0x87,                    // 15: children at 29, 36
+  0xaa,                          // 17: "*"
+  0x02, 0x81,                    // 18: children at 20, 21
+  0x80,                          // 20: rule
+  0xae,                          // 21: "."
+  0x03, 0x04, 0x87,              // 22: children at 25, 29, 36
+  0x7a, 0x61, 0x62, 0x81,        // 25: "zab", exception rule
+  0x2a, 0x80,                    // 29: "*", rule
+  0x6d, 0x6f, 0x63, 0xae,        // 31: "moc."
+  0x81,                          // 35: child at 36
+  0x6f, 0x6f, 0x66, 0x80,        // 36: "oof", rule
+};
+
+static inline int IsSimpleHostnamePart(const char* component,
+                                       size_t component_len,
+                                       const char* hostname_part) {
+  return component_len == strlen(hostname_part) &&
+      memcmp(component, hostname_part, component_len) == 0;
+}
+
+// Matcher of the rules above, with the same results as the one
+// registry_tables_generator/matcher_builder.py would generate, but
+// comparing whole hostname-parts instead of switching on their bytes.
+// Nodes with children are numbered 0 (the root), 1 (com), 2 (foo),
+// 3 (*.foo) and 4 (bar.foo). Results hold the number of the node in
+// their upper bits, and its flags (1 terminal, 2 exception, 4
+// wildcard) in the lower 3 bits.
+static inline REGISTRY_U32 SimpleMatchRegistryRule(REGISTRY_U32 parent,
+                                                   const char* component,
+                                                   size_t component_len) {
+  switch (parent) {
+    case 0:
+      if (IsSimpleHostnamePart(component, component_len, "com")) {
+        return 0x8;   // com
+      }
+      if (IsSimpleHostnamePart(component, component_len, "foo")) {
+        return 0x10;  // foo
+      }
+      return 0;
+    case 1:
+      if (IsSimpleHostnamePart(component, component_len, "foo")) {
+        return 0x1;   // foo.com
+      }
+      return 0;
+    case 2:
+      if (IsSimpleHostnamePart(component, component_len, "bar")) {
+        return 0x21;  // bar.foo
+      }
+      if (IsSimpleHostnamePart(component, component_len, "baz")) {
+        return 0x3;   // !baz.foo
+      }
+      return 0x1d;    // *.foo
+    case 3:
+      if (IsSimpleHostnamePart(component, component_len, "baz")) {
+        return 0x3;   // !baz.*.foo
+      }
+      if (IsSimpleHostnamePart(component, component_len, "foo")) {
+        return 0x1;   // foo.*.foo
+      }
+      return 0x5;     // *.*.foo
+    case 4:
+      if (IsSimpleHostnamePart(component, component_len, "foo")) {
+        return 0x1;   // foo.bar.foo
+      }
+      return 0x5;     // *.bar.foo
+  }
+  return 0;
+}
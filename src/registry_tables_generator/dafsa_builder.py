@@ -0,0 +1,299 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Builds a byte-coded DAFSA of the rules. See class comment for details."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+import node_table_builder
+import suffix_hash_builder
+
+# Values stored at the end of each rule. Must match dafsa_search.c.
+VALUE_RULE = 0
+VALUE_EXCEPTION_RULE = 1
+
+# Value bytes are 0x80 | value. Label bytes are printable ASCII, with
+# 0x80 set on the last byte of a label that is followed by an offset
+# list. Since printable ASCII starts at 0x21, the two never overlap.
+_VALUE_BYTE = 0x80
+_LAST_LABEL_BYTE = 0x80
+_MIN_LABEL_CHAR = 0x21
+_MAX_LABEL_CHAR = 0x7e
+
+# Offset list entries are 1, 2 or 3 bytes. The top bit of the first
+# byte marks the last entry of a list, and the next two bits give its
+# length.
+_LAST_OFFSET = 0x80
+_TWO_BYTE_OFFSET = 0x40
+_THREE_BYTE_OFFSET = 0x60
+_MAX_ONE_BYTE_OFFSET = 2**6 - 1
+_MAX_TWO_BYTE_OFFSET = 2**13 - 1
+_MAX_THREE_BYTE_OFFSET = 2**21 - 1
+
+
+def GetRuleWord(node):
+  """Return the DAFSA word for the rule ending at a terminal node.
+
+  The word is the rule with the '!' of an exception rule removed,
+  reversed character by character and followed by its value, so that
+  a hostname can be matched from its last character to its first.
+  """
+  chain = [suffix_hash_builder.GetSearchKey(n) for n in
+           _GetNodeChain(node)]
+  if node.GetName().startswith('!'):
+    value = VALUE_EXCEPTION_RULE
+  else:
+    value = VALUE_RULE
+  return '.'.join(chain)[::-1] + chr(_VALUE_BYTE | value)
+
+
+def _GetNodeChain(node):
+  """Return the nodes from node to the root, not including the root."""
+  chain = []
+  while not node.IsRoot():
+    chain.append(node)
+    node = node.GetParent()
+  return chain
+
+
+def _IsValueNode(node):
+  """Whether node stores the value at the end of a word."""
+  return len(node.label) == 1 and ord(node.label) & _VALUE_BYTE != 0
+
+
+class _DafsaNode(object):
+  """A node of the DAFSA, labelled with one or more characters."""
+
+  def __init__(self, label):
+    self.label = label
+    self.children = []
+
+
+def _EncodeOffset(offset, size, is_last):
+  """Return the bytes of an offset list entry of the given size."""
+  if is_last:
+    last = _LAST_OFFSET
+  else:
+    last = 0
+  if size == 1:
+    return [last | offset]
+  if size == 2:
+    return [last | _TWO_BYTE_OFFSET | (offset >> 8), offset & 0xff]
+  return [last | _THREE_BYTE_OFFSET | (offset >> 16),
+          (offset >> 8) & 0xff,
+          offset & 0xff]
+
+
+def _GetOffsetSize(offset):
+  """Return the number of bytes needed to encode offset."""
+  if offset <= _MAX_ONE_BYTE_OFFSET:
+    return 1
+  if offset <= _MAX_TWO_BYTE_OFFSET:
+    return 2
+  if offset <= _MAX_THREE_BYTE_OFFSET:
+    return 3
+  raise OverflowError('DAFSA offset %d out of range.' % offset)
+
+
+class DafsaBuilder(object):
+  """DafsaBuilder builds a byte-coded DAFSA of the registry rules.
+
+  A DAFSA (deterministic acyclic finite-state automaton) is a trie
+  in which identical subtrees are shared, so that the common suffixes
+  of words are stored once, just as the common prefixes are in a
+  trie. Each rule becomes a word of the DAFSA (see GetRuleWord). The
+  words are added to a trie of characters, identical subtrees are
+  merged, and chains of nodes with a single child are merged into
+  multi-character labels. For instance the rules 'com', 'co.uk' and
+  'ac.uk' become the words 'moc', 'ku.oc' and 'ku.ca' (each followed
+  by a value), and the DAFSA stores the shared tail 'c' + value once:
+
+      source -> 'moc' -> value
+             -> 'ku.' -> 'o' -> 'c' -> value
+                      -> 'a' ---^
+
+  The DAFSA is serialized to an array of bytes. The array starts with
+  the offset list of the source node. Each node is serialized as its
+  label followed by either a value byte, if its only child is a value,
+  or by the offset list of its children. A child that is only a value
+  is serialized as a single value byte. An offset list holds one
+  entry per child, each giving the distance from the previous child,
+  or from the start of the list for the first child. Nodes are
+  serialized after their parents, so all offsets are positive.
+
+  Matching a hostname walks the DAFSA from the last character of the
+  hostname, which visits the same hostname-parts in the same order as
+  the trie search, so the same wildcard and exception rules apply.
+  """
+
+  def __init__(self):
+    self._dafsa = []
+
+  def BuildDafsa(self, hostname_part_trie):
+    """Build the DAFSA of all rules in hostname_part_trie."""
+    words = []
+    pending = [hostname_part_trie]
+    while pending:
+      node = pending.pop()
+      if not node.IsRoot() and node.IsTerminalNode():
+        words.append(GetRuleWord(node))
+      pending.extend(node_table_builder.GetSortedChildren(node))
+    for word in words:
+      for char in word[:-1]:
+        if not _MIN_LABEL_CHAR <= ord(char) <= _MAX_LABEL_CHAR:
+          raise ValueError('Unexpected character %r in rule.' % char)
+
+    source = self._BuildCharacterTrie(sorted(words))
+    source = self._MergeIdenticalNodes(source, {})
+    self._MergeLabels(source)
+    self._dafsa = self._Serialize(source)
+
+  @staticmethod
+  def _BuildCharacterTrie(words):
+    """Return the source node of a trie of the characters of words."""
+    source = _DafsaNode('')
+    for word in words:
+      node = source
+      for char in word:
+        for child in node.children:
+          if child.label == char:
+            node = child
+            break
+        else:
+          child = _DafsaNode(char)
+          node.children.append(child)
+          node = child
+    return source
+
+  def _MergeIdenticalNodes(self, node, canonical_nodes):
+    """Return the canonical node for the subtree rooted at node.
+
+    Two subtrees are identical if their labels match and their
+    children are the same canonical nodes.
+    """
+    node.children = [self._MergeIdenticalNodes(child, canonical_nodes)
+                     for child in node.children]
+    key = (node.label, tuple(id(child) for child in node.children))
+    return canonical_nodes.setdefault(key, node)
+
+  @staticmethod
+  def _GetInDegrees(source):
+    """Return a map from the id of each node to its number of parents."""
+    in_degrees = {}
+    visited = set()
+    pending = [source]
+    while pending:
+      node = pending.pop()
+      if id(node) in visited:
+        continue
+      visited.add(id(node))
+      for child in node.children:
+        in_degrees[id(child)] = in_degrees.get(id(child), 0) + 1
+        pending.append(child)
+    return in_degrees
+
+  def _MergeLabels(self, source):
+    """Merge each node with its only child, if it is the only parent."""
+    in_degrees = self._GetInDegrees(source)
+    visited = set()
+    pending = list(source.children)
+    while pending:
+      node = pending.pop()
+      if id(node) in visited:
+        continue
+      visited.add(id(node))
+      while (len(node.children) == 1 and
+             not _IsValueNode(node.children[0]) and
+             in_degrees[id(node.children[0])] == 1):
+        child = node.children[0]
+        node.label += child.label
+        node.children = child.children
+      pending.extend(node.children)
+
+  @staticmethod
+  def _HasInlineValue(node):
+    """Whether node is serialized with its only child as a value byte."""
+    return len(node.children) == 1 and _IsValueNode(node.children[0])
+
+  def _Serialize(self, source):
+    """Return the bytes of the DAFSA rooted at source.
+
+    Nodes are serialized in reverse, starting with the last node of
+    the array, so that the position of every child is known when its
+    parent's offset list is serialized.
+    """
+    # Positions are measured from the end of the array.
+    positions = {}
+    reversed_out = []
+
+    def SerializeOffsetList(children):
+      """Prepend the offset list of children to reversed_out."""
+      child_positions = sorted((positions[id(child)] for child in children),
+                               reverse=True)
+      entries = []
+      for i in range(len(child_positions) - 1, 0, -1):
+        offset = child_positions[i - 1] - child_positions[i]
+        entries = _EncodeOffset(offset,
+                                _GetOffsetSize(offset),
+                                i == len(child_positions) - 1) + entries
+      # The first entry is relative to the start of the list, which
+      # depends on the size of the entry itself.
+      list_end = len(reversed_out) + len(entries)
+      for size in (1, 2, 3):
+        offset = list_end + size - child_positions[0]
+        if _GetOffsetSize(offset) <= size:
+          break
+      entries = _EncodeOffset(offset, size, len(child_positions) == 1) + entries
+      reversed_out.extend(reversed(entries))
+
+    # Visit each node after all of its children.
+    order = []
+    visited = set()
+    pending = [(source, False)]
+    while pending:
+      node, children_done = pending.pop()
+      if children_done:
+        order.append(node)
+        continue
+      if id(node) in visited:
+        continue
+      visited.add(id(node))
+      pending.append((node, True))
+      if node is source or not self._HasInlineValue(node):
+        pending.extend((child, False) for child in reversed(node.children))
+
+    for node in order:
+      if node is source:
+        continue
+      label = [ord(char) for char in node.label]
+      if _IsValueNode(node):
+        out = label
+      elif self._HasInlineValue(node):
+        out = label + [ord(node.children[0].label)]
+      else:
+        SerializeOffsetList(node.children)
+        out = label[:-1] + [label[-1] | _LAST_LABEL_BYTE]
+      reversed_out.extend(reversed(out))
+      positions[id(node)] = len(reversed_out)
+
+    if source.children:
+      SerializeOffsetList(source.children)
+    reversed_out.reverse()
+    return reversed_out
+
+  def GetDafsa(self):
+    """Return the serialized DAFSA, as a list of byte values."""
+    return self._dafsa
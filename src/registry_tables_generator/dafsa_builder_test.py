@@ -0,0 +1,145 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Tests for dafsa_builder."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+import hashlib
+import unittest
+
+import dafsa_builder
+import trie_node
+
+
+def _ReadOffsets(dafsa, pos):
+  """Return the positions of the children in the offset list at pos."""
+  children = []
+  child = pos
+  while True:
+    b = dafsa[pos]
+    if b & 0x60 == 0x60:
+      offset = ((b & 0x1f) << 16) | (dafsa[pos + 1] << 8) | dafsa[pos + 2]
+      pos += 3
+    elif b & 0x40:
+      offset = ((b & 0x1f) << 8) | dafsa[pos + 1]
+      pos += 2
+    else:
+      offset = b & 0x3f
+      pos += 1
+    child += offset
+    children.append(child)
+    if b & 0x80:
+      return children
+
+
+def _ReadWords(dafsa, pos, prefix=''):
+  """Return all words of the DAFSA reachable from the offset list at pos."""
+  words = []
+  for child in _ReadOffsets(dafsa, pos):
+    word = prefix
+    while True:
+      b = dafsa[child]
+      if b & 0xe0 == 0x80:
+        words.append(word + chr(b))
+        break
+      word += chr(b & 0x7f)
+      child += 1
+      if b & 0x80:
+        words.extend(_ReadWords(dafsa, child, word))
+        break
+  return words
+
+
+class DafsaBuilderTest(unittest.TestCase):
+  """Test cases for the DafsaBuilder."""
+
+  def setUp(self):
+    self._hostname_part_trie = trie_node.TrieNode()
+    self._builder = dafsa_builder.DafsaBuilder()
+
+  def _AddRule(self, rule):
+    node = self._hostname_part_trie
+    for hostname_part in reversed(rule.split('.')):
+      node = node.GetOrCreateChild(hostname_part)
+    node.SetTerminalNode()
+    return node
+
+  def testEmptyDafsa(self):
+    """Tests a DAFSA with no rules."""
+    self._builder.BuildDafsa(self._hostname_part_trie)
+    self.assertEqual([], self._builder.GetDafsa())
+
+  def testGetRuleWord(self):
+    """Tests that rules are reversed, with the '!' removed."""
+    self.assertEqual('moc.elpmaxe\x80', dafsa_builder.GetRuleWord(
+        self._AddRule('example.com')))
+    self.assertEqual('pj.ikasawak.*\x80', dafsa_builder.GetRuleWord(
+        self._AddRule('*.kawasaki.jp')))
+    self.assertEqual('pj.ikasawak.ytic\x81', dafsa_builder.GetRuleWord(
+        self._AddRule('!city.kawasaki.jp')))
+
+  def testBasic(self):
+    """Tests that every rule is a word of the serialized DAFSA."""
+    rules = ('com', 'example.com', 'uk', 'co.uk', 'ac.uk', '*.kawasaki.jp',
+             '!city.kawasaki.jp')
+    for rule in rules:
+      self._AddRule(rule)
+    self._builder.BuildDafsa(self._hostname_part_trie)
+
+    dafsa = self._builder.GetDafsa()
+    self.assertEqual(sorted(['moc\x80', 'moc.elpmaxe\x80', 'ku\x80',
+                             'ku.oc\x80', 'ku.ca\x80', 'pj.ikasawak.*\x80',
+                             'pj.ikasawak.ytic\x81']),
+                     sorted(_ReadWords(dafsa, 0)))
+
+  def testSharedSuffixes(self):
+    """Tests that identical tails of words are stored once."""
+    for rule in ('co.uk', 'ac.uk', 'co.jp', 'ac.jp'):
+      self._AddRule(rule)
+    self._builder.BuildDafsa(self._hostname_part_trie)
+
+    dafsa = self._builder.GetDafsa()
+    self.assertEqual(sorted(['ku.oc\x80', 'ku.ca\x80',
+                             'pj.oc\x80', 'pj.ca\x80']),
+                     sorted(_ReadWords(dafsa, 0)))
+    # 'oc' and 'ca' are each stored once, and shared by 'ku.' and 'pj.'.
+    self.assertEqual(1, ''.join(chr(b & 0x7f) for b in dafsa).count('oc'))
+    self.assertEqual(1, ''.join(chr(b & 0x7f) for b in dafsa).count('ca'))
+
+  def testLargeOffsets(self):
+    """Tests offsets that need two or three bytes."""
+    # Rules with few shared characters, so the DAFSA is large.
+    rules = ['%s.example' % hashlib.md5(str(i).encode()).hexdigest()[:12]
+             for i in range(1000)]
+    for rule in rules:
+      self._AddRule(rule)
+    self._builder.BuildDafsa(self._hostname_part_trie)
+
+    dafsa = self._builder.GetDafsa()
+    self.assertTrue(len(dafsa) > 2**13)
+    self.assertEqual(sorted(rule[::-1] + '\x80' for rule in rules),
+                     sorted(_ReadWords(dafsa, 0)))
+
+  def testInvalidCharacter(self):
+    """Tests that rules must be printable ASCII."""
+    self._AddRule('foo bar.com')
+    self.assertRaises(ValueError,
+                      self._builder.BuildDafsa,
+                      self._hostname_part_trie)
+
+if __name__ == '__main__':
+  unittest.main()
@@ -0,0 +1,357 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Analyzes the layout of the trie tables. See class comment for details."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+import node_layout_builder
+import node_table_builder
+
+# The cache line size the lookups are modeled with, in bytes. The
+# tables are assumed to start at a cache line boundary.
+CACHE_LINE_SIZE = 64
+
+# The names of the tables a lookup reads, in the order they are
+# reported.
+_TABLES = ('kNodeTable', 'kLeafNodeTable', 'kStringTable')
+
+# A hostname-part that sorts after every hostname-part in the tables,
+# used to look up the hostname-parts that only match a wildcard.
+_UNMATCHED_HOSTNAME_PART = '\x7f'
+
+# The number of rules with the most cache lines listed in the report.
+_NUM_WORST_RULES = 10
+
+
+def _GetSearchKey(name):
+  """Return the key name is compared with, see _SiblingSortKey."""
+  if name.startswith('!'):
+    return name[1:]
+  return name
+
+
+def _GetCacheLines(offset, size):
+  """Return the cache lines holding the size bytes at offset."""
+  return range(offset // CACHE_LINE_SIZE,
+               (offset + size - 1) // CACHE_LINE_SIZE + 1)
+
+
+def _GetMaxProbes(num_nodes):
+  """Return the most probes a search of num_nodes siblings makes.
+
+  This is the height of the binary search tree, which is the same for
+  a binary search of the sorted siblings and a search of the siblings
+  in Eytzinger order.
+  """
+  return num_nodes.bit_length()
+
+
+class LayoutAnalyzer(object):
+  """Reports how the trie tables are laid out, and how lookups use them.
+
+  LayoutAnalyzer reports the distribution of the number of children of
+  the nodes of the trie, the distribution of the number of
+  hostname-parts of the rules, and the most probes a search of the
+  siblings of each level of the trie makes. It also simulates the
+  lookup of each rule in the trie tables, and counts the cache lines
+  of kNodeTable, kLeafNodeTable and kStringTable the lookup reads.
+  Finally it reports the bits of each node in the node layout (see
+  node_layout_builder.py) that no node uses.
+
+  The lookups are modeled on the binary and Eytzinger searches of
+  domain_registry/private/trie_search.c. The root hash and the
+  fingerprint searches, which the library uses by default for the root
+  and for sibling groups stored in sorted order, are not modeled: the
+  counts are those of the searches they replace. Each probe reads the
+  node and its hostname-part through its null terminator. A
+  hostname-part that only matches a wildcard is modeled by one that
+  sorts after all of its siblings.
+  """
+
+  def __init__(self, eytzinger_layout=False):
+    self._eytzinger_layout = eytzinger_layout
+    self._num_rules = 0
+    self._num_nodes = 0
+    self._num_leaf_nodes = 0
+    self._node_size = 0
+    self._leaf_node_size = 0
+    # Map from number of children to the number of nodes that have it.
+    self._fan_out = {}
+    # Map from number of hostname-parts to the number of rules.
+    self._depths = {}
+    # Map from level, starting at 1 for the top-level hostname-parts,
+    # to the size of the largest searchable sibling group.
+    self._max_siblings = {}
+    # List of (rule, map from table name to cache lines), in the order
+    # the rules are in the trie.
+    self._cache_lines = []
+    # List of (word name, bits, used bits) for each word of a node.
+    self._node_bits = []
+    self._padding_bits = 0
+    self._leaf_node_bits = (0, 0)
+    self._tables = None
+    self._strings = None
+
+  def AnalyzeLayout(self, hostname_part_trie, node_table, string_table,
+                    node_layout):
+    """Analyzes the tables built from hostname_part_trie.
+
+    Args:
+      hostname_part_trie: the trie the tables were built from.
+      node_table: the NodeTableBuilder of the trie.
+      string_table: the StringTableBuilder of the trie.
+      node_layout: the NodeLayoutBuilder of the tables.
+    """
+    self._tables = node_table
+    self._strings = string_table
+    self._num_nodes = len(self._tables.GetNodeTable())
+    self._num_leaf_nodes = len(self._tables.GetLeafNodeTable())
+    self._node_size = node_layout.GetNodeSize()
+    self._leaf_node_size = node_layout.GetLeafNodeSize()
+
+    self._fan_out = {}
+    self._depths = {}
+    self._max_siblings = {}
+    self._cache_lines = []
+    self._AnalyzeNode(hostname_part_trie, 1,
+                      dict((table, frozenset()) for table in _TABLES))
+    self._num_rules = len(self._cache_lines)
+    self._AnalyzeNodeLayout(node_layout)
+
+  def GetFanOut(self):
+    """Return a map from number of children to the number of nodes."""
+    return self._fan_out
+
+  def GetDepths(self):
+    """Return a map from number of hostname-parts to the number of rules."""
+    return self._depths
+
+  def GetMaxProbes(self):
+    """Return a map from each level to the most probes of its searches."""
+    return dict((level, _GetMaxProbes(num_siblings))
+                for level, num_siblings in self._max_siblings.items())
+
+  def GetCacheLines(self):
+    """Return a list of (rule, cache lines) for the lookup of each rule.
+
+    The cache lines are a map from each table name in _TABLES to the
+    number of its cache lines the lookup reads.
+    """
+    return self._cache_lines
+
+  def GetNodeBits(self):
+    """Return a list of (word name, bits, used bits) for each word."""
+    return self._node_bits
+
+  def GetPaddingBits(self):
+    """Return the number of bits of padding at the end of each node."""
+    return self._padding_bits
+
+  def GetWastedBits(self):
+    """Return the number of unused bits of each node."""
+    return self._padding_bits + sum(bits - used_bits
+                                    for _, bits, used_bits in self._node_bits)
+
+  def GetLeafNodeBits(self):
+    """Return a tuple of the bits and used bits of each leaf node."""
+    return self._leaf_node_bits
+
+  def GetCacheLineSummary(self):
+    """Return a one line summary of the cache lines per rule lookup."""
+    totals = [sum(lines.values()) for _, lines in self._cache_lines]
+    if not totals:
+      return 'Cache lines per rule lookup: no rules'
+    return 'Cache lines per rule lookup: mean %.2f, max %d' % (
+        float(sum(totals)) / len(totals), max(totals))
+
+  def GetReport(self):
+    """Return the report of the analysis as text."""
+    out = []
+    out.append('Rules: %d' % self._num_rules)
+    out.append('kNodeTable: %d nodes of %d bytes' % (self._num_nodes,
+                                                     self._node_size))
+    out.append('kLeafNodeTable: %d nodes of %d bytes' % (
+        self._num_leaf_nodes, self._leaf_node_size))
+
+    out.append('')
+    out.append('Sibling fan-out (children: nodes)')
+    for num_children in sorted(self._fan_out):
+      out.append('%6d: %d' % (num_children, self._fan_out[num_children]))
+
+    out.append('')
+    out.append('Rule depth (hostname-parts: rules)')
+    for depth in sorted(self._depths):
+      out.append('%6d: %d' % (depth, self._depths[depth]))
+
+    out.append('')
+    out.append('Worst-case search probes per level '
+               '(level: largest sibling group, probes)')
+    for level in sorted(self._max_siblings):
+      out.append('%6d: %d siblings, %d probes' % (
+          level, self._max_siblings[level],
+          _GetMaxProbes(self._max_siblings[level])))
+
+    out.append('')
+    out.append('Cache lines per rule lookup (%d byte lines)' %
+               CACHE_LINE_SIZE)
+    for table in _TABLES:
+      counts = [lines[table] for _, lines in self._cache_lines]
+      out.append('  %s: %s' % (table, self._FormatCounts(counts)))
+    totals = [sum(lines.values()) for _, lines in self._cache_lines]
+    out.append('  total: %s' % self._FormatCounts(totals))
+    distribution = {}
+    for total in totals:
+      distribution[total] = distribution.get(total, 0) + 1
+    for total in sorted(distribution):
+      out.append('%6d: %d rules' % (total, distribution[total]))
+    out.append('Rules with the most cache lines:')
+    worst = sorted(self._cache_lines,
+                   key=lambda rule_lines: -sum(rule_lines[1].values()))
+    for rule, lines in worst[:_NUM_WORST_RULES]:
+      out.append('  %s: %d (%s)' % (
+          rule, sum(lines.values()),
+          ', '.join('%s %d' % (table, lines[table]) for table in _TABLES)))
+
+    out.append('')
+    out.append('Bits per TrieNode (word: bits, used, wasted)')
+    for name, bits, used_bits in self._node_bits:
+      out.append('  %s: %d, %d, %d' % (name, bits, used_bits,
+                                       bits - used_bits))
+    out.append('  padding: %d, 0, %d' % (self._padding_bits,
+                                         self._padding_bits))
+    node_bits = self._node_size * 8
+    out.append('  total: %d of %d bits wasted, %d bytes in kNodeTable' % (
+        self.GetWastedBits(), node_bits,
+        self.GetWastedBits() * self._num_nodes // 8))
+    leaf_bits, leaf_used_bits = self._leaf_node_bits
+    out.append('Bits per TrieLeafNode: %d of %d bits wasted, '
+               '%d bytes in kLeafNodeTable' % (
+                   leaf_bits - leaf_used_bits, leaf_bits,
+                   (leaf_bits - leaf_used_bits) * self._num_leaf_nodes // 8))
+    return '\n'.join(out) + '\n'
+
+  @staticmethod
+  def _FormatCounts(counts):
+    """Return the mean and max of counts as text."""
+    if not counts:
+      return 'no rules'
+    return 'mean %.2f, max %d' % (float(sum(counts)) / len(counts),
+                                  max(counts))
+
+  def _AnalyzeNode(self, node, level, lines):
+    """Analyzes the children of node, and their descendants.
+
+    Args:
+      node: the node whose children to analyze.
+      level: the level of the children of node.
+      lines: map from each table name to the cache lines that the
+          lookup of node reads.
+    """
+    if not node.HasChildren():
+      return
+    children = node_table_builder.GetSortedChildren(node)
+    self._fan_out[len(children)] = self._fan_out.get(len(children), 0) + 1
+    has_wildcard_child = node_table_builder.NodeTableBuilder.HasWildcardChild(
+        node)
+    first = int(has_wildcard_child)
+    self._max_siblings[level] = max(self._max_siblings.get(level, 0),
+                                    len(children) - first)
+
+    offset = self._tables.GetChildNodeOffset(node)
+    if offset >= self._num_nodes:
+      table = 'kLeafNodeTable'
+      offset -= self._num_nodes
+      entry_size = self._leaf_node_size
+      siblings = self._tables.GetLeafNodeTable()
+    else:
+      table = 'kNodeTable'
+      entry_size = self._node_size
+      siblings = self._tables.GetNodeTable()
+    siblings = siblings[offset + first:offset + len(children)]
+
+    for child in children:
+      key = child.GetName()
+      if key == '*':
+        key = _UNMATCHED_HOSTNAME_PART
+      else:
+        key = _GetSearchKey(key)
+      table_lines = set(lines[table])
+      string_lines = set(lines['kStringTable'])
+      for i in self._SearchSiblings(key, siblings):
+        name = siblings[i].GetName()
+        table_lines.update(_GetCacheLines(
+            (offset + first + i) * entry_size, entry_size))
+        # The hostname-part is compared through its null terminator.
+        string_lines.update(_GetCacheLines(
+            self._strings.GetHostnamePartOffset(name), len(name) + 1))
+      if child.GetName() == '*':
+        # Falls back to the wildcard, whose hostname-part is not read.
+        table_lines.update(_GetCacheLines(offset * entry_size, entry_size))
+      child_lines = dict(lines)
+      child_lines[table] = frozenset(table_lines)
+      child_lines['kStringTable'] = frozenset(string_lines)
+
+      if child.IsTerminalNode():
+        self._depths[level] = self._depths.get(level, 0) + 1
+        self._cache_lines.append((
+            child.GetIdentifier('.'),
+            dict((name, len(child_lines[name])) for name in _TABLES)))
+      self._AnalyzeNode(child, level + 1, child_lines)
+
+  def _SearchSiblings(self, key, siblings):
+    """Return the indices into siblings that a search for key probes."""
+    probes = []
+    if (self._eytzinger_layout and
+        len(siblings) >= node_table_builder.EYTZINGER_MIN_SIBLINGS):
+      i = 0
+      while i < len(siblings):
+        probes.append(i)
+        candidate = _GetSearchKey(siblings[i].GetName())
+        if key == candidate:
+          break
+        i = 2 * i + 1 + int(key > candidate)
+      return probes
+    start = 0
+    end = len(siblings) - 1
+    while start <= end:
+      candidate = start + (end - start + 1) // 2
+      probes.append(candidate)
+      candidate_key = _GetSearchKey(siblings[candidate].GetName())
+      if key == candidate_key:
+        break
+      if key > candidate_key:
+        start = candidate + 1
+      else:
+        end = candidate - 1
+    return probes
+
+  def _AnalyzeNodeLayout(self, node_layout):
+    """Counts the bits of the node layout that the tables use."""
+    max_values, max_leaf_value = node_layout_builder.GetMaxValues(
+        self._tables, self._strings)
+    self._node_bits = []
+    for word in node_layout.GetWords():
+      used_bits = 0
+      if word.field is not None:
+        used_bits = max_values[word.field].bit_length()
+      if word.flags_shift is not None:
+        used_bits += len(node_layout_builder.NODE_FLAGS)
+      self._node_bits.append((word.name, word.size * 8, used_bits))
+    self._padding_bits = (self._node_size * 8 -
+                          sum(bits for _, bits, _ in self._node_bits))
+    self._leaf_node_bits = (self._leaf_node_size * 8,
+                            max_leaf_value.bit_length())
@@ -0,0 +1,114 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Tests for layout_analyzer."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+import unittest
+
+import layout_analyzer
+import node_layout_builder
+import node_table_builder
+import string_table_builder
+import registry_tables_generator
+
+
+class LayoutAnalyzerTest(unittest.TestCase):
+  """Test cases for the LayoutAnalyzer."""
+
+  def _Analyze(self, rules, eytzinger_layout=False):
+    hostname_part_trie = registry_tables_generator._BuildHostnameSuffixTrie(
+        rules)
+    node_table = node_table_builder.NodeTableBuilder(eytzinger_layout)
+    string_table = string_table_builder.StringTableBuilder()
+    node_layout = node_layout_builder.NodeLayoutBuilder()
+    node_table.BuildNodeTables(hostname_part_trie)
+    string_table.BuildStringTable(
+        hostname_part_trie,
+        registry_tables_generator._BuildStringTableSuffixTrie(rules))
+    node_layout.BuildNodeLayout(node_table, string_table)
+    analyzer = layout_analyzer.LayoutAnalyzer(eytzinger_layout)
+    analyzer.AnalyzeLayout(hostname_part_trie, node_table, string_table,
+                           node_layout)
+    return analyzer
+
+  def testDistributions(self):
+    """Tests the fan-out, depth and search probe distributions."""
+    analyzer = self._Analyze(['com', 'foo.com', 'bar.com', 'uk', 'co.uk',
+                              '*.ck', '!www.ck', 'a.b.c.ck'])
+    # The root has 3 children, com 2, ck 3, and uk, c and b 1 each.
+    self.assertEqual({1: 3, 2: 1, 3: 2}, analyzer.GetFanOut())
+    self.assertEqual({1: 2, 2: 5, 4: 1}, analyzer.GetDepths())
+    # The wildcard under ck is not searched.
+    self.assertEqual({1: 2, 2: 2, 3: 1, 4: 1}, analyzer.GetMaxProbes())
+
+  def testCacheLines(self):
+    """Tests that small tables are read from a single cache line each."""
+    analyzer = self._Analyze(['com', 'foo.com', 'bar.com', 'uk', 'co.uk',
+                              '*.ck', '!www.ck'])
+    cache_lines = dict(analyzer.GetCacheLines())
+    self.assertEqual(['!www.ck', '*.ck', 'bar.com', 'co.uk', 'com',
+                      'foo.com', 'uk'], sorted(cache_lines))
+    self.assertEqual({'kNodeTable': 1, 'kLeafNodeTable': 0,
+                      'kStringTable': 1}, cache_lines['com'])
+    self.assertEqual({'kNodeTable': 1, 'kLeafNodeTable': 1,
+                      'kStringTable': 1}, cache_lines['foo.com'])
+    self.assertEqual({'kNodeTable': 1, 'kLeafNodeTable': 1,
+                      'kStringTable': 1}, cache_lines['*.ck'])
+    self.assertEqual('Cache lines per rule lookup: mean 2.71, max 3',
+                     analyzer.GetCacheLineSummary())
+
+  def testCacheLinesOfLargeSiblingGroup(self):
+    """Tests that a search of many siblings reads several cache lines."""
+    rules = ['%04d' % i for i in range(1000)]
+    analyzer = self._Analyze(rules)
+    cache_lines = dict(analyzer.GetCacheLines())
+    self.assertEqual({1: 10}, analyzer.GetMaxProbes())
+    # The root's children are all leaves, 2 bytes each. The search
+    # probes 500, 250, 125, 62, 31, 15, 7, 3, 1 and 0, and the last 6
+    # are in the first cache line.
+    self.assertEqual({'kNodeTable': 0, 'kLeafNodeTable': 5,
+                      'kStringTable': 7}, cache_lines['0000'])
+    # The first probe finds the middle sibling.
+    self.assertEqual({'kNodeTable': 0, 'kLeafNodeTable': 1,
+                      'kStringTable': 1}, cache_lines['0500'])
+
+    # In Eytzinger order, the first probe finds the first sibling.
+    analyzer = self._Analyze(rules, True)
+    cache_lines = dict(analyzer.GetCacheLines())
+    first = node_table_builder.GetChildrenInTableOrder(
+        registry_tables_generator._BuildHostnameSuffixTrie(rules), True)[0]
+    self.assertEqual({'kNodeTable': 0, 'kLeafNodeTable': 1,
+                      'kStringTable': 1}, cache_lines[first.GetName()])
+    self.assertEqual({1: 10}, analyzer.GetMaxProbes())
+
+  def testWastedBits(self):
+    """Tests that the unused bits of each word are counted."""
+    analyzer = self._Analyze(['com', 'foo.com', 'bar.com', 'uk', 'co.uk'])
+    # The largest string table and child offsets are 4, and the flags
+    # share the word of num_children.
+    self.assertEqual([('string_table_offset', 8, 3),
+                      ('first_child_offset', 8, 3),
+                      ('num_children_and_flags', 8, 5)],
+                     analyzer.GetNodeBits())
+    self.assertEqual(0, analyzer.GetPaddingBits())
+    self.assertEqual(13, analyzer.GetWastedBits())
+    self.assertEqual((16, 4), analyzer.GetLeafNodeBits())
+    self.assertTrue('total: 13 of 24 bits wasted' in analyzer.GetReport())
+
+if __name__ == '__main__':
+  unittest.main()
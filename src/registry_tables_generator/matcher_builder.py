@@ -0,0 +1,138 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Builds a matcher of the rules in C code. See class comment for details."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+import node_table_builder
+import suffix_hash_builder
+
+# The flags of a match result, in its low bits. The id of the node
+# that matched, or 0 if it has no children, is in the remaining
+# bits. Must match matcher_search.h.
+MATCH_TERMINAL = 0x1
+MATCH_EXCEPTION = 0x2
+MATCH_WILDCARD = 0x4
+MATCH_NODE_SHIFT = 3
+
+# Node ids must fit in a REGISTRY_U32 along with the flags.
+_MAX_NODE_ID = 2**(32 - MATCH_NODE_SHIFT) - 1
+
+
+def GetMatchResult(node, node_id, is_wildcard):
+  """Return the value the matcher returns when node matches.
+
+  Args:
+    node: the node that matched
+    node_id: the id of node, or 0 if it has no children
+    is_wildcard: whether node is the wildcard '*'
+  """
+  result = node_id << MATCH_NODE_SHIFT
+  if node.IsTerminalNode():
+    result |= MATCH_TERMINAL
+  if node.GetName().startswith('!'):
+    result |= MATCH_EXCEPTION
+  if is_wildcard:
+    result |= MATCH_WILDCARD
+  return result
+
+
+class MatcherParent(object):
+  """A node of the trie with children, and how its children match.
+
+  Attributes:
+    node: the node
+    node_id: the id the matcher knows the node by
+    cases: list of (hostname-part, result, child) tuples, one for each
+        child other than the wildcard, sorted by the length and then
+        the bytes of the hostname-part. Exception rules are listed
+        under the hostname-part they are an exception for.
+    wildcard: tuple of (result, child) for the wildcard child, or None
+  """
+
+  def __init__(self, node, node_id):
+    self.node = node
+    self.node_id = node_id
+    self.cases = []
+    self.wildcard = None
+
+
+class MatcherBuilder(object):
+  """MatcherBuilder builds a matcher of the rules, to be compiled as C code.
+
+  Instead of tables that a search walks, the matcher is a function per
+  node of the trie with children, made of switch statements on the
+  length of the hostname-part and on its first byte, followed by a
+  memcmp of the remaining bytes against each child that has that
+  length and first byte. If no child matches, the function returns
+  the wildcard child, if any. The compiler turns the switch statements
+  into jump tables or branch trees and inlines the short memcmps, so a
+  lookup never loads a table entry, only code.
+
+  Nodes with children are numbered in breadth-first order, starting
+  with 0 for the root, and a single dispatch function selects the
+  function of the node by number. Each match returns the number of the
+  node that matched (or 0 if it has no children) along with its flags
+  (see GetMatchResult). A lookup passes that number back in to match
+  the next hostname-part.
+
+  Exception rules only apply where there is a wildcard sibling, like
+  in the trie search, so the builder leaves out those that have none.
+  """
+
+  def __init__(self):
+    self._parents = []
+
+  def BuildMatcher(self, hostname_part_trie):
+    """Build the matcher of all rules in hostname_part_trie."""
+    self._parents = [MatcherParent(hostname_part_trie, 0)]
+    i = 0
+    while i < len(self._parents):
+      parent = self._parents[i]
+      i += 1
+      children = node_table_builder.GetSortedChildren(parent.node)
+      has_wildcard = any(child.GetName() == '*' for child in children)
+      for child in children:
+        child_id = 0
+        if child.HasChildren():
+          child_id = len(self._parents)
+          if child_id > _MAX_NODE_ID:
+            raise OverflowError('Too many nodes for the matcher.')
+          self._parents.append(MatcherParent(child, child_id))
+        if child.GetName() == '*':
+          parent.wildcard = (GetMatchResult(child, child_id, True), child)
+        elif child.GetName().startswith('!') and not has_wildcard:
+          continue
+        else:
+          parent.cases.append((suffix_hash_builder.GetSearchKey(child),
+                               GetMatchResult(child, child_id, False),
+                               child))
+      parent.cases.sort(key=lambda case: (len(case[0]), case[0]))
+
+  def GetParents(self):
+    """Return the MatcherParent of each node with children, by id."""
+    return self._parents
+
+  def Match(self, node_id, hostname_part):
+    """Return what the matcher returns for hostname_part under node_id."""
+    parent = self._parents[node_id]
+    for key, result, _ in parent.cases:
+      if key == hostname_part:
+        return result
+    if parent.wildcard:
+      return parent.wildcard[0]
+    return 0
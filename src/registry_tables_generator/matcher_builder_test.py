@@ -0,0 +1,127 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Tests for matcher_builder."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+import unittest
+
+import matcher_builder
+import trie_node
+
+_TERMINAL = matcher_builder.MATCH_TERMINAL
+_EXCEPTION = matcher_builder.MATCH_EXCEPTION
+_WILDCARD = matcher_builder.MATCH_WILDCARD
+_SHIFT = matcher_builder.MATCH_NODE_SHIFT
+
+
+class MatcherBuilderTest(unittest.TestCase):
+  """Test cases for the MatcherBuilder."""
+
+  def setUp(self):
+    self._hostname_part_trie = trie_node.TrieNode()
+    self._builder = matcher_builder.MatcherBuilder()
+
+  def _AddRule(self, rule):
+    node = self._hostname_part_trie
+    for hostname_part in reversed(rule.split('.')):
+      node = node.GetOrCreateChild(hostname_part)
+    node.SetTerminalNode()
+
+  def _Match(self, hostname):
+    """Return the results of matching hostname, rootmost part first."""
+    results = []
+    node_id = 0
+    for hostname_part in reversed(hostname.split('.')):
+      result = self._builder.Match(node_id, hostname_part)
+      results.append(result)
+      node_id = result >> _SHIFT
+      if result == 0 or node_id == 0:
+        break
+    return results
+
+  def testEmptyMatcher(self):
+    """Tests a matcher with no rules."""
+    self._builder.BuildMatcher(self._hostname_part_trie)
+    parents = self._builder.GetParents()
+    self.assertEqual(1, len(parents))
+    self.assertEqual([], parents[0].cases)
+    self.assertEqual(None, parents[0].wildcard)
+    self.assertEqual([0], self._Match('com'))
+
+  def testNodeIds(self):
+    """Tests that nodes with children are numbered breadth first."""
+    for rule in ('foo.bar.com', 'com', 'uk', 'co.uk', 'ac.uk', 'a.b.ac.uk'):
+      self._AddRule(rule)
+    self._builder.BuildMatcher(self._hostname_part_trie)
+    self.assertEqual(['', 'com', 'uk', 'bar.com', 'ac.uk', 'b.ac.uk'],
+                     [parent.node.GetIdentifier('.')
+                      for parent in self._builder.GetParents()])
+    self.assertEqual([0, 1, 2, 3, 4, 5],
+                     [parent.node_id
+                      for parent in self._builder.GetParents()])
+    self.assertEqual([1 << _SHIFT | _TERMINAL, 3 << _SHIFT, _TERMINAL],
+                     self._Match('foo.bar.com'))
+    self.assertEqual([2 << _SHIFT | _TERMINAL, _TERMINAL],
+                     self._Match('www.co.uk'))
+    self.assertEqual([2 << _SHIFT | _TERMINAL, 0],
+                     self._Match('www.bb.uk'))
+    self.assertEqual([2 << _SHIFT | _TERMINAL, 4 << _SHIFT | _TERMINAL,
+                      5 << _SHIFT, _TERMINAL],
+                     self._Match('a.b.ac.uk'))
+
+  def testCasesSortedByLength(self):
+    """Tests that children are sorted by length, then by bytes."""
+    for rule in ('abc.com', 'b.com', 'aa.com', 'ab.com', 'a.com'):
+      self._AddRule(rule)
+    self._builder.BuildMatcher(self._hostname_part_trie)
+    self.assertEqual(['a', 'b', 'aa', 'ab', 'abc'],
+                     [case[0] for case in self._builder.GetParents()[1].cases])
+
+  def testWildcardAndExceptionRules(self):
+    """Tests that the wildcard matches where no other child does."""
+    for rule in ('*.jp', '!city.kobe.jp', '*.kobe.jp', 'foo.jp', '!www.jp'):
+      self._AddRule(rule)
+    self._builder.BuildMatcher(self._hostname_part_trie)
+    jp = self._builder.GetParents()[1]
+    self.assertEqual((_TERMINAL | _WILDCARD, jp.node.GetChild('*')),
+                     jp.wildcard)
+    self.assertEqual(['foo', 'www', 'kobe'], [case[0] for case in jp.cases])
+
+    self.assertEqual([1 << _SHIFT, _TERMINAL | _WILDCARD],
+                     self._Match('a.bar.jp'))
+    self.assertEqual([1 << _SHIFT, _TERMINAL],
+                     self._Match('a.foo.jp'))
+    self.assertEqual([1 << _SHIFT, _TERMINAL | _EXCEPTION],
+                     self._Match('www.jp'))
+    self.assertEqual([1 << _SHIFT, 2 << _SHIFT, _TERMINAL | _EXCEPTION],
+                     self._Match('city.kobe.jp'))
+    self.assertEqual([1 << _SHIFT, 2 << _SHIFT, _TERMINAL | _WILDCARD],
+                     self._Match('town.kobe.jp'))
+
+  def testExceptionRuleWithoutWildcard(self):
+    """Tests that exception rules without a wildcard are left out."""
+    for rule in ('!www.jp', 'foo.jp'):
+      self._AddRule(rule)
+    self._builder.BuildMatcher(self._hostname_part_trie)
+    self.assertEqual(['foo'],
+                     [case[0] for case in self._builder.GetParents()[1].cases])
+    self.assertEqual([1 << _SHIFT, 0], self._Match('www.jp'))
+
+
+if __name__ == '__main__':
+  unittest.main()
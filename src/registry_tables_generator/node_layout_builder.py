@@ -0,0 +1,235 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Chooses the layout of TrieNode. See class comment for more details."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+import struct
+
+# The fields of a TrieNode that hold numbers, in the order that the
+# TRIE_NODE initializer takes them. See
+# domain_registry/private/trie_node.h for a description of each.
+NODE_FIELDS = ('string_table_offset', 'first_child_offset', 'num_children')
+
+# The single bit fields of a TrieNode, which follow NODE_FIELDS.
+NODE_FLAGS = ('is_terminal', 'has_wildcard_child', 'has_exception_children')
+
+# The C type and struct format character of each word size in bytes.
+_WORD_TYPES = {1: ('unsigned char', 'B'),
+               2: ('REGISTRY_U16', 'H'),
+               4: ('REGISTRY_U32', 'I')}
+
+# The name of the word the flags are stored in, if no field has room
+# for them.
+_FLAGS_WORD = 'flags'
+
+
+def GetWordType(size):
+  """Return the C type of a word of size bytes."""
+  return _WORD_TYPES[size][0]
+
+
+def _GetWordSize(max_value):
+  """Return the size of the smallest word that holds max_value."""
+  for size in sorted(_WORD_TYPES):
+    if max_value < 1 << (size * 8):
+      return size
+  raise OverflowError('Value %d out of range.' % max_value)
+
+
+def _GetLog2(size):
+  """Return the base 2 logarithm of the word size size."""
+  return {1: 0, 2: 1, 4: 2}[size]
+
+
+def GetMaxValues(node_table_builder, string_table_builder):
+  """Return the largest values the nodes of the given tables hold.
+
+  Returns a tuple of a map from each of NODE_FIELDS to its largest
+  value in the node table, and the largest string table offset in the
+  leaf node table.
+  """
+  max_values = dict((field, 0) for field in NODE_FIELDS)
+  for node in node_table_builder.GetNodeTable():
+    max_values['string_table_offset'] = max(
+        max_values['string_table_offset'],
+        string_table_builder.GetHostnamePartOffset(node.GetName()))
+    if node.HasChildren():
+      max_values['first_child_offset'] = max(
+          max_values['first_child_offset'],
+          node_table_builder.GetChildNodeOffset(node))
+      max_values['num_children'] = max(
+          max_values['num_children'], len(node.GetChildren()))
+  max_leaf_value = 0
+  for node in node_table_builder.GetLeafNodeTable():
+    max_leaf_value = max(
+        max_leaf_value,
+        string_table_builder.GetHostnamePartOffset(node.GetName()))
+  return max_values, max_leaf_value
+
+
+class _Word(object):
+  """A word of a node: one field, or the flags, or both."""
+
+  def __init__(self, name, size, field, flags_shift):
+    self.name = name
+    self.size = size
+    # The field stored in the low bits of the word, or None.
+    self.field = field
+    # The bit at which the flags start, or None if they are elsewhere.
+    self.flags_shift = flags_shift
+
+  def GetFieldMask(self):
+    """Return the mask of the bits of the word that hold the field."""
+    bits = self.size * 8
+    if self.flags_shift is not None:
+      bits = self.flags_shift
+    return (1 << bits) - 1
+
+
+class NodeLayoutBuilder(object):
+  """Chooses how the fields of a TrieNode are stored.
+
+  Each field of a node is stored in its own word of 1, 2 or 4 bytes,
+  the smallest that holds the largest value of the field in the node
+  table. The three flags are stored in the top bits of the word with
+  the most unused bits, or in a word of their own if no word has 3
+  unused bits. Larger words come first, so that every word is at its
+  natural alignment and no field straddles two words. Reading a field
+  is then a single aligned load, at most followed by a mask.
+
+  Leaf nodes only hold a string table offset, which is stored in a
+  word of 2 or 4 bytes the same way.
+
+  The generator writes the struct and its accessors to a C header (see
+  TableSerializer.SerializeNodeLayout), and packs nodes into the
+  binary blob with PackNode, so that both always match.
+  """
+
+  def __init__(self):
+    self._words = []
+    self._node_size = 0
+    self._leaf_node_size = 0
+
+  def BuildNodeLayout(self, node_table_builder, string_table_builder):
+    """Choose the layout that fits the nodes of the given tables."""
+    self.BuildNodeLayoutForValues(
+        *GetMaxValues(node_table_builder, string_table_builder))
+
+  def BuildNodeLayoutForValues(self, max_values, max_leaf_value):
+    """Choose the layout that fits the given largest values.
+
+    Args:
+      max_values: map from each of NODE_FIELDS to its largest value.
+      max_leaf_value: the largest string table offset of a leaf node.
+    """
+    sizes = [_GetWordSize(max_values[field]) for field in NODE_FIELDS]
+    unused_bits = [size * 8 - max_values[field].bit_length()
+                   for field, size in zip(NODE_FIELDS, sizes)]
+    flags_index = None
+    if max(unused_bits) >= len(NODE_FLAGS):
+      flags_index = unused_bits.index(max(unused_bits))
+
+    self._words = []
+    for i, (field, size) in enumerate(zip(NODE_FIELDS, sizes)):
+      if i == flags_index:
+        self._words.append(_Word(field + '_and_flags', size, field,
+                                 size * 8 - len(NODE_FLAGS)))
+      else:
+        self._words.append(_Word(field, size, field, None))
+    # Sorting is stable, so fields of the same size keep their order.
+    self._words.sort(key=lambda word: -word.size)
+    if flags_index is None:
+      self._words.append(_Word(_FLAGS_WORD, 1, None, 0))
+
+    largest = self._words[0].size
+    total = sum(word.size for word in self._words)
+    self._node_size = (total + largest - 1) // largest * largest
+    self._leaf_node_size = max(2, _GetWordSize(max_leaf_value))
+
+  def GetWords(self):
+    """Return the words of a node, in the order they are stored."""
+    return self._words
+
+  def GetNodeSize(self):
+    """Return the size of a node in bytes, including any padding."""
+    return self._node_size
+
+  def GetLeafNodeSize(self):
+    """Return the size of a leaf node in bytes."""
+    return self._leaf_node_size
+
+  def GetLayoutId(self):
+    """Return an identifier of the layout, stored in the binary blob.
+
+    One nibble per field of NODE_FIELDS, from the least significant:
+    the base 2 logarithm of the size of its word, plus 4 if the flags
+    are stored in the word. Followed by a nibble with the base 2
+    logarithm of the size of a leaf node.
+    """
+    layout_id = 0
+    for i, field in enumerate(NODE_FIELDS):
+      word = self._GetFieldWord(field)
+      nibble = _GetLog2(word.size)
+      if word.flags_shift is not None:
+        nibble |= 4
+      layout_id |= nibble << (4 * i)
+    return layout_id | _GetLog2(self._leaf_node_size) << (4 * len(NODE_FIELDS))
+
+  def GetMaxValue(self, field):
+    """Return the largest value the layout can store in field."""
+    return self._GetFieldWord(field).GetFieldMask()
+
+  def GetMaxLeafValue(self):
+    """Return the largest string table offset of a leaf node."""
+    return (1 << (self._leaf_node_size * 8)) - 1
+
+  def PackNode(self, values):
+    """Return the little-endian binary representation of a node.
+
+    Args:
+      values: the values of NODE_FIELDS followed by NODE_FLAGS.
+    """
+    values = dict(zip(NODE_FIELDS + NODE_FLAGS, values))
+    for field in NODE_FIELDS:
+      if values[field] > self.GetMaxValue(field):
+        raise OverflowError('%s %d out of range.' % (field, values[field]))
+    out = b''
+    for word in self._words:
+      value = 0
+      if word.field is not None:
+        value = values[word.field]
+      if word.flags_shift is not None:
+        for i, flag in enumerate(NODE_FLAGS):
+          value |= int(values[flag]) << (word.flags_shift + i)
+      out += struct.pack('<' + _WORD_TYPES[word.size][1], value)
+    return out + b'\0' * (self._node_size - len(out))
+
+  def PackLeafNode(self, string_table_offset):
+    """Return the little-endian binary representation of a leaf node."""
+    if string_table_offset > self.GetMaxLeafValue():
+      raise OverflowError(
+          'string_table_offset %d out of range.' % string_table_offset)
+    return struct.pack('<' + _WORD_TYPES[self._leaf_node_size][1],
+                       string_table_offset)
+
+  def _GetFieldWord(self, field):
+    """Return the word that holds field."""
+    for word in self._words:
+      if word.field == field:
+        return word
+    raise ValueError('No such field %s.' % field)
@@ -0,0 +1,133 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Tests for node_layout_builder."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+import struct
+import unittest
+
+import node_layout_builder
+import node_table_builder
+import string_table_builder
+import registry_tables_generator
+
+
+class NodeLayoutBuilderTest(unittest.TestCase):
+  """Test cases for the NodeLayoutBuilder."""
+
+  def setUp(self):
+    self._builder = node_layout_builder.NodeLayoutBuilder()
+
+  def _Build(self, string_table_offset, first_child_offset, num_children,
+             leaf_string_table_offset):
+    self._builder.BuildNodeLayoutForValues(
+        {'string_table_offset': string_table_offset,
+         'first_child_offset': first_child_offset,
+         'num_children': num_children},
+        leaf_string_table_offset)
+
+  def _GetWords(self):
+    return [(word.name, word.size) for word in self._builder.GetWords()]
+
+  def testSmallTables(self):
+    """Tests that the flags share a word with spare bits."""
+    self._Build(43554, 12000, 1500, 43554)
+    self.assertEqual([('string_table_offset', 2),
+                      ('first_child_offset', 2),
+                      ('num_children_and_flags', 2)],
+                     self._GetWords())
+    self.assertEqual(6, self._builder.GetNodeSize())
+    self.assertEqual(2, self._builder.GetLeafNodeSize())
+    self.assertEqual(0xffff,
+                     self._builder.GetMaxValue('string_table_offset'))
+    self.assertEqual(0x1fff, self._builder.GetMaxValue('num_children'))
+    self.assertEqual(0x1511, self._builder.GetLayoutId())
+
+  def testLargeTables(self):
+    """Tests that larger words come first, so that all are aligned."""
+    self._Build(600000, 0x3ffffff, 40, 600000)
+    self.assertEqual([('string_table_offset_and_flags', 4),
+                      ('first_child_offset', 4),
+                      ('num_children', 1)],
+                     self._GetWords())
+    self.assertEqual(12, self._builder.GetNodeSize())
+    self.assertEqual(4, self._builder.GetLeafNodeSize())
+    self.assertEqual(0x1fffffff,
+                     self._builder.GetMaxValue('string_table_offset'))
+    self.assertEqual(0xffffffff,
+                     self._builder.GetMaxLeafValue())
+
+  def testFlagsWord(self):
+    """Tests that the flags get a word if no field has room for them."""
+    self._Build(0xffff, 0xfffe, 0x3fff, 0xffff)
+    self.assertEqual([('string_table_offset', 2),
+                      ('first_child_offset', 2),
+                      ('num_children', 2),
+                      ('flags', 1)],
+                     self._GetWords())
+    self.assertEqual(8, self._builder.GetNodeSize())
+    self.assertEqual(0x111, self._builder.GetLayoutId() & 0xfff)
+
+  def testTooLarge(self):
+    """Tests that values that do not fit 32 bits are rejected."""
+    self.assertRaises(OverflowError, self._Build, 2**32, 0, 0, 0)
+
+  def testPackNode(self):
+    """Tests the binary representation of nodes."""
+    self._Build(43554, 12000, 1500, 43554)
+    self.assertEqual(b'\x01\x00\x02\x00\x03\x00',
+                     self._builder.PackNode((1, 2, 3, 0, 0, 0)))
+    self.assertEqual(b'\x00\x00\x00\x00\x00\xe0',
+                     self._builder.PackNode((0, 0, 0, 1, 1, 1)))
+    self.assertEqual(b'\x00\x00\x00\x00\xff\x3f',
+                     self._builder.PackNode((0, 0, 0x1fff, 1, 0, 0)))
+    self.assertRaises(OverflowError, self._builder.PackNode,
+                      (0, 0, 0x2000, 0, 0, 0))
+    self.assertEqual(b'\x34\x12', self._builder.PackLeafNode(0x1234))
+    self.assertRaises(OverflowError, self._builder.PackLeafNode, 0x10000)
+
+  def testPackNodePadding(self):
+    """Tests that nodes are padded to the alignment of their words."""
+    self._Build(0x12345, 7, 3, 0)
+    self.assertEqual(8, self._builder.GetNodeSize())
+    self.assertEqual(b'\x45\x23\x01\x20\x07\x03\x00\x00',
+                     self._builder.PackNode((0x12345, 7, 3, 1, 0, 0)))
+    self.assertEqual(8, len(self._builder.PackNode((0, 0, 0, 0, 0, 0))))
+
+  def testBuildNodeLayout(self):
+    """Tests that the layout fits the values of the node tables."""
+    rules = ['com', 'foo.com', 'bar.com', 'uk', 'co.uk']
+    hostname_part_trie = registry_tables_generator._BuildHostnameSuffixTrie(
+        rules, frozenset())
+    node_table = node_table_builder.NodeTableBuilder()
+    string_table = string_table_builder.StringTableBuilder()
+    node_table.BuildNodeTables(hostname_part_trie)
+    string_table.BuildStringTable(
+        hostname_part_trie,
+        registry_tables_generator._BuildStringTableSuffixTrie(rules))
+    self._builder.BuildNodeLayout(node_table, string_table)
+    self.assertEqual([('string_table_offset', 1),
+                      ('first_child_offset', 1),
+                      ('num_children_and_flags', 1)],
+                     self._GetWords())
+    self.assertEqual(3, self._builder.GetNodeSize())
+    # Leaf nodes are at least 2 bytes.
+    self.assertEqual(2, self._builder.GetLeafNodeSize())
+
+if __name__ == '__main__':
+  unittest.main()
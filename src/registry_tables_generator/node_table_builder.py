@@ -18,6 +18,93 @@
 
 __author__ = 'bmcquade@google.com (Bryan McQuade)'
 
+def _SiblingSortKey(node):
+  """Return the key used to order a node among its siblings.
+
+  Exception rules sort under the hostname-part they apply to (i.e.
+  '!foo' sorts as 'foo'), so a single binary search for a hostname-part
+  finds either the exact match or the exception. The wildcard '*'
+  sorts before every valid hostname-part, so when present it is always
+  the first node in its sibling range.
+  """
+  name = node.GetName()
+  if name.startswith('!'):
+    return name[1:]
+  return name
+
+
+def GetSortedChildren(node):
+  """Return the children of node in the order they appear in the tables.
+
+  Raises ValueError if node has both a rule and an exception rule for
+  the same hostname-part, since those would be indistinguishable to a
+  search that ignores the exception marker.
+  """
+  children = sorted(node.GetChildren(), key=_SiblingSortKey)
+  for i in range(1, len(children)):
+    if _SiblingSortKey(children[i - 1]) == _SiblingSortKey(children[i]):
+      raise ValueError('Conflicting rules for %s.' %
+                       children[i].GetIdentifier('.'))
+  return children
+
+
+# Sibling groups with at least this many searchable (i.e. non-wildcard)
+# nodes are stored in Eytzinger order when the Eytzinger layout is
+# enabled. Must match EYTZINGER_MIN_SIBLINGS in
+# domain_registry/private/trie_search.c.
+EYTZINGER_MIN_SIBLINGS = 8
+
+
+def _EytzingerOrder(items):
+  """Return the sorted list items in Eytzinger (breadth-first) order.
+
+  The items are arranged as an implicit binary search tree, where the
+  children of the item at index i are at indices 2i+1 and 2i+2. For
+  instance [a, b, c, d, e, f, g] becomes [d, b, f, a, c, e, g]. A
+  search of this layout visits adjacent entries first, and its next
+  index can be computed without a branch.
+  """
+  out = [None] * len(items)
+  in_order = iter(items)
+
+  def _Fill(index):
+    if index < len(items):
+      _Fill(2 * index + 1)
+      out[index] = next(in_order)
+      _Fill(2 * index + 2)
+
+  _Fill(0)
+  return out
+
+
+def GetChildrenInTableOrder(node, eytzinger_layout):
+  """Return the children of node in the order they are stored.
+
+  Children are stored in the order given by GetSortedChildren. If
+  eytzinger_layout is set, large sibling groups are instead stored in
+  Eytzinger order, except that the wildcard (if any) remains first.
+  """
+  children = GetSortedChildren(node)
+  if not eytzinger_layout:
+    return children
+  num_prefix = 0
+  if _HasWildcardChild(node):
+    num_prefix = 1
+  if len(children) - num_prefix < EYTZINGER_MIN_SIBLINGS:
+    return children
+  return children[:num_prefix] + _EytzingerOrder(children[num_prefix:])
+
+
+def _HasWildcardChild(node):
+  """Determines whether one of the node's children is the wildcard '*'."""
+  return any(child.GetName() == '*' for child in node.GetChildren())
+
+
+def _HasExceptionChildren(node):
+  """Determines whether any of the node's children are exception rules."""
+  return any(child.GetName().startswith('!') for child in node.GetChildren())
+
+
 def _NodeHasAllLeafChildren(node):
   """Determines whether the given node's children are all leaf nodes.
 
@@ -39,19 +126,24 @@ def _ComputeLeafChildCacheKey(node):
     # there is a low hitrate for such duplicates and since the cache
     # keys would be substantially more complex.
     raise ValueError('Node has non-leaf children.')
-  return tuple([n.GetName() for n in node.GetChildren()])
+  # Leaves with the same name but rules from different sections of
+  # the public suffix list have different section table entries.
+  return tuple([(n.GetName(), n.IsPrivateNode())
+                for n in GetSortedChildren(node)])
 
 
 class _NodeTable(object):
   """Stores a table of TrieNodes and provides efficent lookup of node offset."""
 
-  def __init__(self, cache_key_func=None):
+  def __init__(self, cache_key_func=None, eytzinger_layout=False):
     """Instantiates a new _NodeTable.
 
     Args:
       cache_key_func: The function to use to compute the cache key for
                       the given node, if any. If unspecified, no cache
                       is used.
+      eytzinger_layout: Whether to store large sibling groups in
+                        Eytzinger order. See GetChildrenInTableOrder.
     """
     # Table of TrieNodes, in breadth-first order, with siblings
     # ordered lexicographically. For instance the hostnames
@@ -59,6 +151,8 @@ class _NodeTable(object):
     # 'au', 'com', 'edu', 'foo' ].
     self._nodes = []
 
+    self._eytzinger_layout = eytzinger_layout
+
     # Map from a node's hostname identifier (e.g. 'edu.au') to the
     # offset of that node's first child in the _nodes member. Enables
     # fast lookup of the index of a node's children.
@@ -99,7 +193,7 @@ class _NodeTable(object):
 
   def _DoAddChildren(self, node):
     """Add this node's children to the node table."""
-    children = node.GetChildren()
+    children = GetChildrenInTableOrder(node, self._eytzinger_layout)
     offset_of_children = len(self._nodes)
     self._first_child_offset_map[node.GetIdentifier('.')] = offset_of_children
     for child in children:
@@ -116,20 +210,33 @@ class NodeTableBuilder(object):
   leaf child table exists separately from the main table only because
   many nodes fit this criteria (all siblings are leaves) and these
   nodes can be represented more efficiently than nodes in the main
-  table (2 bytes per node, instead of 5 bytes per node).
+  table (2 bytes per node, instead of 6 bytes per node).
+
+  In both tables, siblings are ordered as described in
+  _SiblingSortKey: the wildcard (if any) comes first, and exception
+  rules are interleaved with the other hostname-parts as though they
+  had no leading '!'. If eytzinger_layout is set, sibling groups of
+  at least EYTZINGER_MIN_SIBLINGS nodes are then rearranged into
+  Eytzinger order, for a branchless search.
   """
 
-  def __init__(self):
-    self._node_table = _NodeTable()
-    self._leaf_child_node_table = _NodeTable(_ComputeLeafChildCacheKey)
+  def __init__(self, eytzinger_layout=False):
+    self._node_table = _NodeTable(eytzinger_layout=eytzinger_layout)
+    self._leaf_child_node_table = _NodeTable(_ComputeLeafChildCacheKey,
+                                             eytzinger_layout)
 
   def BuildNodeTables(self, node):
     """Constructs the node tables for the given root trie node."""
+    if node.IsRoot() and (_HasWildcardChild(node) or
+                          _HasExceptionChildren(node)):
+      # There is no TrieNode for the root to carry the wildcard and
+      # exception flags.
+      raise ValueError('Wildcard and exception rules must have a parent.')
     if _NodeHasAllLeafChildren(node):
       self._leaf_child_node_table.AddChildren(node)
     elif node.HasChildren():
       self._node_table.AddChildren(node)
-      children = node.GetChildren()
+      children = GetSortedChildren(node)
       for child in children:
         self.BuildNodeTables(child)
 
@@ -154,3 +261,13 @@ class NodeTableBuilder(object):
               self._leaf_child_node_table.GetFirstChildOffset(node))
     else:
       return self._node_table.GetFirstChildOffset(node)
+
+  @staticmethod
+  def HasWildcardChild(node):
+    """Return whether the node's first child in the tables is the wildcard."""
+    return _HasWildcardChild(node)
+
+  @staticmethod
+  def HasExceptionChildren(node):
+    """Return whether any of the node's children are exception rules."""
+    return _HasExceptionChildren(node)
@@ -49,5 +49,69 @@ class NodeTableBuilderTest(unittest.TestCase):
     self.assertEqual(2, self._builder.GetChildNodeOffset(com))
     self.assertEqual(4, self._builder.GetChildNodeOffset(uk))
 
+  def testWildcardAndExceptions(self):
+    """Tests sibling order and flags for wildcard and exception rules."""
+    jp = self._hostname_part_trie.GetOrCreateChild('jp')
+    kobe = jp.GetOrCreateChild('kobe')
+    city = kobe.GetOrCreateChild('!city')
+    wildcard = kobe.GetOrCreateChild('*')
+    aaa = kobe.GetOrCreateChild('aaa')
+    zzz = kobe.GetOrCreateChild('zzz')
+
+    self._builder.BuildNodeTables(self._hostname_part_trie)
+    self.assertEqual([jp, kobe], self._builder.GetNodeTable())
+    # The wildcard comes first, and the exception sorts as 'city'.
+    self.assertEqual([wildcard, aaa, city, zzz],
+                     self._builder.GetLeafNodeTable())
+    self.assertTrue(self._builder.HasWildcardChild(kobe))
+    self.assertTrue(self._builder.HasExceptionChildren(kobe))
+    self.assertFalse(self._builder.HasWildcardChild(jp))
+    self.assertFalse(self._builder.HasExceptionChildren(jp))
+
+  def testConflictingException(self):
+    """Tests that a rule and an exception for the same part are rejected."""
+    jp = self._hostname_part_trie.GetOrCreateChild('jp')
+    jp.GetOrCreateChild('*')
+    jp.GetOrCreateChild('!city')
+    jp.GetOrCreateChild('city')
+    self.assertRaises(ValueError,
+                      self._builder.BuildNodeTables,
+                      self._hostname_part_trie)
+
+  def testRootWildcard(self):
+    """Tests that wildcards at the root are rejected."""
+    self._hostname_part_trie.GetOrCreateChild('*')
+    self.assertRaises(ValueError,
+                      self._builder.BuildNodeTables,
+                      self._hostname_part_trie)
+
+  def testEytzingerLayout(self):
+    """Tests that large sibling groups are stored in Eytzinger order."""
+    builder = node_table_builder.NodeTableBuilder(eytzinger_layout=True)
+    jp = self._hostname_part_trie.GetOrCreateChild('jp')
+    wildcard = jp.GetOrCreateChild('*')
+    names = ['a', 'b', 'c', 'd', 'e', 'f', 'g', 'h']
+    children = dict((name, jp.GetOrCreateChild(name)) for name in names)
+    uk = self._hostname_part_trie.GetOrCreateChild('uk')
+    co = uk.GetOrCreateChild('co')
+    ac = uk.GetOrCreateChild('ac')
+
+    builder.BuildNodeTables(self._hostname_part_trie)
+    # The root and 'uk' have too few children to be rearranged.
+    self.assertEqual([jp, uk], builder.GetNodeTable())
+    # The wildcard remains first, followed by the other children of
+    # 'jp' in Eytzinger order.
+    self.assertEqual(
+        [wildcard] + [children[name] for name in 'ecgbdfha'] + [ac, co],
+        builder.GetLeafNodeTable())
+
+  def testEytzingerOrder(self):
+    """Tests the Eytzinger order of sorted lists."""
+    self.assertEqual([], node_table_builder._EytzingerOrder([]))
+    self.assertEqual([1], node_table_builder._EytzingerOrder([1]))
+    self.assertEqual([2, 1], node_table_builder._EytzingerOrder([1, 2]))
+    self.assertEqual([4, 2, 6, 1, 3, 5, 7],
+                     node_table_builder._EytzingerOrder(range(1, 8)))
+
 if __name__ == '__main__':
   unittest.main()
@@ -17,6 +17,10 @@
     'variables': {
       'domain_registry_provider_dat_file_path%': '../third_party/effective_tld_names/effective_tld_names.dat',
       'domain_registry_provider_out_dir%': '<(SHARED_INTERMEDIATE_DIR)/registry_tables_generator_out',
+
+      # Set to 1 to store large sibling groups in Eytzinger order. Must
+      # match the value used for domain_registry.gyp.
+      'domain_registry_eytzinger_layout%': 0,
     },
 
     'chromium_code': 1,
@@ -25,14 +29,30 @@
     'in_dat_file%': '<(domain_registry_provider_dat_file_path)',
     'out_registry_file': '<(domain_registry_provider_out_dir)/registry_tables_genfiles/registry_tables.h',
     'out_registry_test_file': '<(domain_registry_provider_out_dir)/registry_tables_genfiles/test_registry_tables.h',
+    'out_registry_node_layout_file': '<(domain_registry_provider_out_dir)/registry_tables_genfiles/trie_node_layout.h',
+    'out_registry_blob_file': '<(domain_registry_provider_out_dir)/registry_tables_genfiles/registry_tables.bin',
     'src_py_files': [
       'registry_tables_generator.py',
+      'dafsa_builder.py',
+      'layout_analyzer.py',
+      'matcher_builder.py',
+      'node_layout_builder.py',
       'node_table_builder.py',
+      'root_hash_builder.py',
+      'section_table_builder.py',
       'string_table_builder.py',
+      'suffix_hash_builder.py',
       'table_serializer.py',
       'test_table_builder.py',
       'trie_node.py',
     ],
+    'conditions': [
+      ['domain_registry_eytzinger_layout==1', {
+        'generator_flags': [ '--eytzinger_layout' ],
+      }, {
+        'generator_flags': [],
+      }],
+    ],
   },
   'targets': [
     {
@@ -59,13 +79,18 @@
           'outputs': [
             '<(out_registry_file)',
             '<(out_registry_test_file)',
+            '<(out_registry_node_layout_file)',
+            '<(out_registry_blob_file)',
           ],
           'action': [
             'python',
             '<(executable)',
+            '<@(generator_flags)',
             '<(in_dat_file)',
             '<(out_registry_file)',
             '<(out_registry_test_file)',
+            '<(out_registry_node_layout_file)',
+            '<(out_registry_blob_file)',
           ],
           'message': 'Generating C code from <(RULE_INPUT_PATH)',
         },
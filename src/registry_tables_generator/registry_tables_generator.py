@@ -22,8 +22,33 @@ needed to efficiently determine if a hostname is a valid public
 suffix. Three tables are generated: two tables of trie nodes to
 traverse the hostname-parts (see node_table_builder.py for additional
 details), and a string table that contains all unique hostname parts
-(see string_table_builder.py for additional details). See
-http://TODO(bmcquade) for more details.
+(see string_table_builder.py for additional details). A minimal
+perfect hash of the top-level hostname-parts is also generated, so
+the first step of each lookup can avoid a binary search (see
+root_hash_builder.py for additional details), as well as a hash table
+of all rule suffixes for the alternative suffix-hash lookup engine
+(see suffix_hash_builder.py for additional details) and a compact
+byte-coded DAFSA of all rules for the alternative DAFSA lookup engine
+(see dafsa_builder.py for additional details) and C functions that
+match all rules with nested switch statements for the alternative
+matcher engine (see matcher_builder.py for additional details). The
+section of the public suffix list (ICANN or PRIVATE) each node belongs
+to is stored in separate section tables (see section_table_builder.py
+for additional details). See http://TODO(bmcquade) for more details.
+
+The layout of trie nodes is chosen to fit the tables, and written to
+a separate C header that defines the TrieNode struct and its
+accessors, which the library is built with (see node_layout_builder.py
+for additional details).
+
+Optionally, a report of how the trie tables are laid out, and how
+many cache lines each rule lookup reads, is written to a separate file
+(see layout_analyzer.py for additional details).
+
+Optionally, the trie tables are also written to a binary blob that
+InitializeDomainRegistryFromFile() can load at runtime, so that the
+rules can be updated without recompiling (see table_serializer.py for
+a description of the format).
 
 For example, if we have a DAT file that contains the following
 registry suffixes:
@@ -48,7 +73,7 @@ The resulting C output to represent the trie would look like:
 
 struct TrieNode {
   // Index of the hostname-part in the kStringTable.
-  unsigned int component_offset  : 21;
+  unsigned int component_offset  : 19;
 
   // Index of the first child node in the kNodeTable or
   // kLeafNodeTable. A value >= kLeafChildOffset is an
@@ -65,6 +90,14 @@ struct TrieNode {
   // "foo.bar.com", the node for "foo" would be a terminal
   // node.
   unsigned int is_terminal       :  1;
+
+  // Whether the first child of this node is the wildcard "*".
+  unsigned int has_wildcard_child     : 1;
+
+  // Whether any children of this node are exception rules
+  // (e.g. "!foo"). Exception rules are sorted among their
+  // siblings as though they had no leading "!".
+  unsigned int has_exception_children : 1;
 };
 
 // Table that contains the string for all unique hostname-parts.
@@ -72,9 +105,9 @@ static const char kStringTable[] = "ac\0ad\0ae\0com\0edu\0nom\0co\0net\0";
 
 // Table that contains all nodes in the trie that have
 static const struct TrieNode kNodeTable[] = {
-{     0,     3,     2, 1 },  // ac, 2 children "com" and "edu" in leaf table
-{     3,     5,     1, 1 },  // ad, 1 child, "nom" in leaf table
-{     6,     6,     2, 0 },  // ae, 2 children, "co" and "net" in leaf table
+{     0,     3,     2, 1, 0, 0 },  // ac, children "com", "edu" in leaf table
+{     3,     5,     1, 1, 0, 0 },  // ad, child "nom" in leaf table
+{     6,     6,     2, 0, 0, 0 },  // ae, children "co", "net" in leaf table
 };
 
 // Index into kStringTable for each leaf node.
@@ -90,8 +123,15 @@ __author__ = 'bmcquade@google.com (Bryan McQuade)'
 
 import sys
 
+import dafsa_builder
+import layout_analyzer
+import matcher_builder
+import node_layout_builder
 import node_table_builder
+import root_hash_builder
+import section_table_builder
 import string_table_builder
+import suffix_hash_builder
 import table_serializer
 import test_table_builder
 import trie_node
@@ -102,21 +142,67 @@ except NameError:
   unicode = str  # Python 3
 
 
+# The markers of the sections of a publicsuffix.org rules file. Rules
+# outside of any section are treated as ICANN rules.
+_BEGIN_SECTION_MARKER = '// ===BEGIN '
+_ICANN_SECTION = 'ICANN DOMAINS'
+_PRIVATE_SECTION = 'PRIVATE DOMAINS'
+# Added by scripts/synthesize_entries.py, for the rules below them.
+_SYNTHESIZED_SECTION = 'DOMAIN REGISTRY PROVIDER SYNTHESIZED DOMAINS'
+
+# The flag that names the file to write the layout report to.
+_LAYOUT_REPORT_FLAG = '--layout_report='
+
+
 def _ReadRulesFromFile(infile):
   """Read the given dat file and generate a list of all rules.
 
+  Returns a tuple of the list of all rules and the set of those that
+  are only in the PRIVATE section. Synthesized rules are private if
+  all of the rules they were synthesized for are.
+
   Args:
     infile: an open, readable file handle for a publicsuffix.org rules file.
   """
-  # Get the idna representation of the rule. See
-  # http://en.wikipedia.org/wiki/Internationalized_domain_name for
-  # more information.
-  return [unicode(line.strip()).encode('idna')
-          for line in infile
-          if line.strip() and not line.strip().startswith('//')]
-
-
-def _BuildHostnameSuffixTrie(rules):
+  rules = []
+  private_rules = set()
+  icann_rules = set()
+  synthesized_rules = []
+  section = None
+  for line in infile:
+    line = line.strip()
+    if line.startswith(_BEGIN_SECTION_MARKER):
+      section = line[len(_BEGIN_SECTION_MARKER):].rstrip('=')
+    if not line or line.startswith('//'):
+      continue
+    # Get the idna representation of the rule. See
+    # http://en.wikipedia.org/wiki/Internationalized_domain_name for
+    # more information.
+    rule = unicode(line).encode('idna')
+    if not isinstance(rule, str):
+      # Under Python 3, keep the rule as text, like the rest of the
+      # generator expects.
+      rule = rule.decode('ascii')
+    rules.append(rule)
+    if section == _PRIVATE_SECTION:
+      private_rules.add(rule)
+    elif section == _SYNTHESIZED_SECTION:
+      synthesized_rules.append(rule)
+    else:
+      icann_rules.add(rule)
+  # Rules in both sections are ICANN rules.
+  private_rules -= icann_rules
+  # Rules may be synthesized for other synthesized rules, so visit the
+  # longest ones first.
+  synthesized_rules.sort(key=lambda rule: rule.count('.'), reverse=True)
+  for rule in synthesized_rules:
+    suffix = '.' + rule
+    if all(r in private_rules for r in rules if r.endswith(suffix)):
+      private_rules.add(rule)
+  return rules, private_rules
+
+
+def _BuildHostnameSuffixTrie(rules, private_rules=frozenset()):
   """Construct a suffix trie of the hostname-parts in each rule.
 
   For instance, if rules is [ foo.com, bar.com, ac.uk ], we would
@@ -129,6 +215,7 @@ def _BuildHostnameSuffixTrie(rules):
 
   Args:
     rules: list of hostnames
+    private_rules: set of the rules in the PRIVATE section
   """
   trie = trie_node.TrieNode()
   for rule in rules:
@@ -136,7 +223,7 @@ def _BuildHostnameSuffixTrie(rules):
     node = trie
     for hostname_part in reversed(hostname_parts):
       node = node.GetOrCreateChild(hostname_part)
-    node.SetTerminalNode()
+    node.SetTerminalNode(rule in private_rules)
   return trie
 
 
@@ -177,35 +264,55 @@ def _BuildStringTableSuffixTrie(rules):
   return trie
 
 
-def RegistryTablesGenerator(in_file, out_file, out_test_file):
+def RegistryTablesGenerator(in_file, out_file, out_test_file,
+                            eytzinger_layout=False, out_blob_file=None,
+                            out_node_layout_file=None,
+                            out_layout_report_file=None):
   """Generate registry suffix string tables, given a publicsuffix.org DAT file.
 
   Args:
     in_file: publicsuffix.org DAT file
     out_file: file to write registry suffix string tables to
     out_test_file: file to write registry suffix test cases to
+    eytzinger_layout: whether to store large sibling groups in
+        Eytzinger order (see node_table_builder.py). The library must
+        be built with DOMAIN_REGISTRY_EYTZINGER_LAYOUT to match.
+    out_blob_file: optional binary file to write the trie tables to
+    out_node_layout_file: optional file to write the definition of the
+        C TrieNode struct to, which the library is built with
+    out_layout_report_file: optional file to write the report of the
+        layout of the trie tables to
   """
-  rules = _ReadRulesFromFile(in_file)
+  rules, private_rules = _ReadRulesFromFile(in_file)
 
-  hostname_part_trie = _BuildHostnameSuffixTrie(rules)
+  hostname_part_trie = _BuildHostnameSuffixTrie(rules, private_rules)
   suffix_trie = _BuildStringTableSuffixTrie(rules)
 
   string_table = string_table_builder.StringTableBuilder()
-  node_table = node_table_builder.NodeTableBuilder()
+  node_table = node_table_builder.NodeTableBuilder(eytzinger_layout)
+  node_layout = node_layout_builder.NodeLayoutBuilder()
+  root_hash = root_hash_builder.RootHashBuilder()
+  sections = section_table_builder.SectionTableBuilder()
+  suffix_hash = suffix_hash_builder.SuffixHashBuilder()
+  dafsa = dafsa_builder.DafsaBuilder()
+  matcher = matcher_builder.MatcherBuilder()
   test_table = test_table_builder.TestTableBuilder()
+  layout = layout_analyzer.LayoutAnalyzer(eytzinger_layout)
 
+  num_root_children = len(hostname_part_trie.GetChildren())
   node_table.BuildNodeTables(hostname_part_trie)
+  root_hash.BuildRootHash(node_table, num_root_children)
+  sections.BuildSectionTables(node_table)
+  suffix_hash.BuildSuffixHash(hostname_part_trie)
+  dafsa.BuildDafsa(hostname_part_trie)
+  matcher.BuildMatcher(hostname_part_trie)
   string_table.BuildStringTable(hostname_part_trie, suffix_trie)
+  node_layout.BuildNodeLayout(node_table, string_table)
   test_table.BuildTestTable(rules)
+  layout.AnalyzeLayout(hostname_part_trie, node_table, string_table,
+                       node_layout)
 
-  # Specify the number of bits allocated to each field in the C
-  # TrieNode struct, so we can detect overflow during the
-  # serialization process. TODO(bmcquade): use this information to
-  # also generate the C header file with the necessary struct
-  # definitions so we don't duplicate the struct definitions.
-  serializer = table_serializer.TableSerializer(component_offset_bits = 21,
-                                                child_node_offset_bits = 14,
-                                                num_children_bits = 12)
+  serializer = table_serializer.TableSerializer(node_layout)
 
   out_file.write('/* Size of kStringTable %d */\n' %
                  len(string_table.GetStringTable()))
@@ -216,32 +323,133 @@ def RegistryTablesGenerator(in_file, out_file, out_test_file):
   out_file.write('/* Total size %d bytes */\n' % (
       # Each entry in the string table is a char (1 byte).
       len(string_table.GetStringTable()) +
-      # Each entry in the node table is 6 bytes:
-      # 21 bits + 14 bits + 12 bits + 1 bit = 48 bits = 6 bytes.
-      len(node_table.GetNodeTable()) * 6 +
-      # Each entry in the leaf node table is 2 bytes (1 uint16).
-      len(node_table.GetLeafNodeTable()) * 2))
+      # The sizes of node and leaf node table entries depend on the
+      # values they hold, see node_layout_builder.py.
+      len(node_table.GetNodeTable()) * node_layout.GetNodeSize() +
+      len(node_table.GetLeafNodeTable()) * node_layout.GetLeafNodeSize() +
+      # Each root hash displacement is 2 bytes (1 uint16), and each
+      # root hash slot is 4 bytes (2 uint16s).
+      len(root_hash.GetDisplacements()) * 2 +
+      len(root_hash.GetSlots()) * 4 +
+      # Each node and leaf node has a 1 byte fingerprint.
+      len(node_table.GetNodeTable()) +
+      len(node_table.GetLeafNodeTable()) +
+      # Each node and leaf node has a 2 bit section.
+      len(section_table_builder.PackSections(
+          sections.GetNodeSections())) +
+      len(section_table_builder.PackSections(
+          sections.GetLeafNodeSections()))))
+  # The suffix hash table is only linked in when the suffix-hash
+  # engine is enabled, so count it separately. Each entry is 8 bytes.
+  out_file.write('/* Size of kSuffixHashTable %d (%d bytes) */\n' % (
+      len(suffix_hash.GetSlots()), len(suffix_hash.GetSlots()) * 8))
+  # Likewise the DAFSA, which replaces all of the tables above.
+  out_file.write('/* Size of kDafsa %d bytes */\n' % len(dafsa.GetDafsa()))
+  # The matcher is code, whose size depends on the compiler.
+  out_file.write('/* Number of matcher functions %d */\n' %
+                 len(matcher.GetParents()))
+  out_file.write('/* %s */\n' % layout.GetCacheLineSummary())
   out_file.write('\n')
 
+  out_file.write('#define REGISTRY_TABLES_EYTZINGER_LAYOUT %d\n\n' %
+                 int(eytzinger_layout))
+
   out_file.write('static const char kStringTable[] =\n%s;\n\n' %
                  serializer.SerializeStringTable(string_table))
 
   out_file.write('static const struct TrieNode kNodeTable[] = {\n%s\n};\n\n' %
                  serializer.SerializeNodeTable(node_table, string_table))
 
-  out_file.write('static const REGISTRY_U16 kLeafNodeTable[] = {\n%s\n};\n\n' %
+  out_file.write('static const TrieLeafNode kLeafNodeTable[] = {\n%s\n};\n\n' %
                  serializer.SerializeLeafChildNodeTable(node_table,
                                                        string_table))
 
   out_file.write('static const size_t kLeafChildOffset = %d;\n' %
                  len(node_table.GetNodeTable()))
 
-  out_file.write('static const size_t kNumRootChildren = %d;\n' %
-                 len(hostname_part_trie.GetChildren()))
+  out_file.write('static const size_t kNumRootChildren = %d;\n\n' %
+                 num_root_children)
+
+  out_file.write('static const REGISTRY_U16 kRootHashDisplacements[] = {\n'
+                 '%s\n};\n\n' %
+                 serializer.SerializeRootHashDisplacements(root_hash))
+
+  out_file.write('static const size_t kNumRootHashBuckets = %d;\n\n' %
+                 len(root_hash.GetDisplacements()))
+
+  out_file.write('static const struct RootHashEntry kRootHashTable[] = {\n'
+                 '%s\n};\n' %
+                 serializer.SerializeRootHashTable(root_hash, node_table))
+
+  out_file.write('\nstatic const unsigned char kNodeFingerprintTable[] = {\n'
+                 '%s\n};\n\n' %
+                 serializer.SerializeFingerprintTable(
+                     node_table.GetNodeTable()))
+
+  out_file.write('static const unsigned char kLeafFingerprintTable[] = {\n'
+                 '%s\n};\n' %
+                 serializer.SerializeFingerprintTable(
+                     node_table.GetLeafNodeTable()))
+
+  out_file.write('\nstatic const unsigned char kNodeSectionTable[] = {\n'
+                 '%s\n};\n\n' %
+                 serializer.SerializeSectionTable(
+                     sections.GetNodeSections()))
+
+  out_file.write('static const unsigned char kLeafSectionTable[] = {\n'
+                 '%s\n};\n' %
+                 serializer.SerializeSectionTable(
+                     sections.GetLeafNodeSections()))
+
+  # The tables of the other engines are only compiled by the
+  # translation units that define the matching INCLUDE_ macro, so that
+  # builds that do not use an engine do not link its tables.
+  out_file.write('\n#ifdef INCLUDE_SUFFIX_HASH_TABLE\n')
+  out_file.write('\nstatic const REGISTRY_U32 kSuffixHashSeed = %d;\n\n' %
+                 suffix_hash.GetSeed())
+
+  out_file.write('static const size_t kSuffixHashTableSize = %d;\n\n' %
+                 len(suffix_hash.GetSlots()))
+
+  out_file.write('static const struct SuffixHashEntry kSuffixHashTable[] = {\n'
+                 '%s\n};\n' %
+                 serializer.SerializeSuffixHashTable(suffix_hash,
+                                                     node_table,
+                                                     string_table))
+  out_file.write('\n#endif  /* INCLUDE_SUFFIX_HASH_TABLE */\n')
+
+  out_file.write('\n#ifdef INCLUDE_DAFSA\n')
+  out_file.write('\nstatic const unsigned char kDafsa[] = {\n%s\n};\n' %
+                 serializer.SerializeDafsa(dafsa))
+  out_file.write('\n#endif  /* INCLUDE_DAFSA */\n')
+
+  out_file.write('\n#ifdef INCLUDE_REGISTRY_MATCHER\n')
+  out_file.write('\n%s\n' % serializer.SerializeMatcher(matcher))
+  out_file.write('\n#endif  /* INCLUDE_REGISTRY_MATCHER */\n')
 
   out_test_file.write('static const struct TestEntry kTestTable[] = {\n%s};\n' %
                       serializer.SerializeTestTable(test_table))
 
+  if out_node_layout_file:
+    out_node_layout_file.write(
+        '/* Generated by registry_tables_generator.py. Do not edit. */\n\n'
+        '#ifndef REGISTRY_TABLES_GENFILES_TRIE_NODE_LAYOUT_H_\n'
+        '#define REGISTRY_TABLES_GENFILES_TRIE_NODE_LAYOUT_H_\n\n'
+        '%s\n\n'
+        '#endif  /* REGISTRY_TABLES_GENFILES_TRIE_NODE_LAYOUT_H_ */\n' %
+        serializer.SerializeNodeLayout())
+
+  if out_layout_report_file:
+    out_layout_report_file.write(layout.GetReport())
+
+  if out_blob_file:
+    out_blob_file.write(serializer.SerializeBlob(node_table,
+                                                 string_table,
+                                                 root_hash,
+                                                 sections,
+                                                 num_root_children,
+                                                 eytzinger_layout))
+
 
 def OpenFileOrReturnNone(filename, mode):
   """Helper that performs file open and handles exceptions."""
@@ -259,23 +467,54 @@ def main(argv):
     argv[1]: in_file: the publicsuffix.org DAT file
     argv[2]: out_file: the file to write registry suffix string tables to
     argv[3]: out_test_file: the file to write registry suffix test cases to
+    argv[4]: out_node_layout_file: the file to write the definition of
+        the C TrieNode struct to
+    argv[5]: out_blob_file: optional, the file to write the binary
+        registry tables to
+    --eytzinger_layout: optional, store large sibling groups in
+        Eytzinger order
+    --layout_report=FILE: optional, write a report of the layout of
+        the trie tables to FILE
   """
-  if len(argv) != 4:
-    sys.stderr.writelines(['Usage: gen_string_table.py in_file out_file, out_test_file'])
+  eytzinger_layout = '--eytzinger_layout' in argv
+  argv = [arg for arg in argv if arg != '--eytzinger_layout']
+  layout_report_filename = None
+  for arg in argv:
+    if arg.startswith(_LAYOUT_REPORT_FLAG):
+      layout_report_filename = arg[len(_LAYOUT_REPORT_FLAG):]
+  argv = [arg for arg in argv if not arg.startswith(_LAYOUT_REPORT_FLAG)]
+  if len(argv) != 5 and len(argv) != 6:
+    sys.stderr.writelines(['Usage: gen_string_table.py [--eytzinger_layout] '
+                           '[--layout_report=FILE] '
+                           'in_file out_file out_test_file '
+                           'out_node_layout_file [out_blob_file]'])
     return 1
 
   in_filename = argv[1]
   out_filename = argv[2]
   out_test_filename = argv[3]
+  out_node_layout_filename = argv[4]
 
   in_file = OpenFileOrReturnNone(in_filename, 'r')
   out_file = OpenFileOrReturnNone(out_filename, 'w')
   out_test_file = OpenFileOrReturnNone(out_test_filename, 'w')
-  all_files_successful = in_file and out_file and out_test_file
+  out_node_layout_file = OpenFileOrReturnNone(out_node_layout_filename, 'w')
+  all_files_successful = (in_file and out_file and out_test_file and
+                          out_node_layout_file)
+  out_blob_file = None
+  if len(argv) == 6:
+    out_blob_file = OpenFileOrReturnNone(argv[5], 'wb')
+    all_files_successful = all_files_successful and out_blob_file
+  out_layout_report_file = None
+  if layout_report_filename:
+    out_layout_report_file = OpenFileOrReturnNone(layout_report_filename, 'w')
+    all_files_successful = all_files_successful and out_layout_report_file
 
   try:
     if all_files_successful:
-      RegistryTablesGenerator(in_file, out_file, out_test_file)
+      RegistryTablesGenerator(in_file, out_file, out_test_file,
+                              eytzinger_layout, out_blob_file,
+                              out_node_layout_file, out_layout_report_file)
   finally:
     if in_file:
       in_file.close()
@@ -283,6 +522,12 @@ def main(argv):
       out_file.close()
     if out_test_file:
       out_test_file.close()
+    if out_node_layout_file:
+      out_node_layout_file.close()
+    if out_blob_file:
+      out_blob_file.close()
+    if out_layout_report_file:
+      out_layout_report_file.close()
 
   if not all_files_successful:
     return 1
@@ -21,13 +21,29 @@ __author__ = 'bmcquade@google.com (Bryan McQuade)'
 import unittest
 
 import registry_tables_generator_test
+import dafsa_builder_test
+import layout_analyzer_test
+import matcher_builder_test
+import node_layout_builder_test
 import node_table_builder_test
+import root_hash_builder_test
+import section_table_builder_test
 import string_table_builder_test
+import suffix_hash_builder_test
+import table_serializer_test
 import trie_node_test
 
 ALL_TEST_CASES = (registry_tables_generator_test.RegistryTablesGeneratorTest,
+                  dafsa_builder_test.DafsaBuilderTest,
+                  layout_analyzer_test.LayoutAnalyzerTest,
+                  matcher_builder_test.MatcherBuilderTest,
+                  node_layout_builder_test.NodeLayoutBuilderTest,
                   node_table_builder_test.NodeTableBuilderTest,
+                  root_hash_builder_test.RootHashBuilderTest,
+                  section_table_builder_test.SectionTableBuilderTest,
                   string_table_builder_test.StringTableBuilderTest,
+                  suffix_hash_builder_test.SuffixHashBuilderTest,
+                  table_serializer_test.TableSerializerTest,
                   trie_node_test.TrieNodeTest)
 
 def _BuildTestSuite(loader):
@@ -20,6 +20,7 @@ __author__ = 'bmcquade@google.com (Bryan McQuade)'
 
 import filecmp
 import os
+import StringIO
 import unittest
 
 import registry_tables_generator
@@ -66,5 +67,35 @@ class RegistryTablesGeneratorTest(unittest.TestCase):
     self.assertTrue(filecmp.cmp(self._outfile, golden))
     self.assertTrue(filecmp.cmp(self._outtestfile, golden_test))
 
+  def testReadRuleSections(self):
+    """Tests that rules are read along with their section."""
+    infile = StringIO.StringIO(
+        '// com\n'
+        'com\n'
+        '// ===BEGIN ICANN DOMAINS===\n'
+        'uk\n'
+        'co.uk\n'
+        '// ===END ICANN DOMAINS===\n'
+        '// ===BEGIN PRIVATE DOMAINS===\n'
+        'blogspot.com\n'
+        'a.b.appspot.com\n'
+        'co.uk\n'
+        '// ===END PRIVATE DOMAINS===\n'
+        '// ===BEGIN DOMAIN REGISTRY PROVIDER SYNTHESIZED DOMAINS===\n'
+        'appspot.com\n'
+        'b.appspot.com\n'
+        'uk\n'
+        '// ===END DOMAIN REGISTRY PROVIDER SYNTHESIZED DOMAINS===\n')
+    rules, private_rules = registry_tables_generator._ReadRulesFromFile(infile)
+    self.assertEqual(['com', 'uk', 'co.uk', 'blogspot.com', 'a.b.appspot.com',
+                      'co.uk', 'appspot.com', 'b.appspot.com', 'uk'], rules)
+    # co.uk is also an ICANN rule. The synthesized uk has ICANN rules
+    # below it, so it is not private either. The synthesized
+    # appspot.com only has PRIVATE rules below it, including the
+    # synthesized b.appspot.com.
+    self.assertEqual(set(['blogspot.com', 'a.b.appspot.com', 'appspot.com',
+                          'b.appspot.com']),
+                     private_rules)
+
 if __name__ == '__main__':
   unittest.main()
@@ -0,0 +1,163 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Builds a perfect hash of the root nodes. See class comment for details."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+# The hash functions below must match those in
+# domain_registry/private/hash_util.h exactly.
+_MASK32 = 0xffffffff
+FNV_OFFSET_BASIS = 0x811c9dc5
+_FNV_PRIME = 0x01000193
+_DISPLACEMENT_MULTIPLIER = 0x9e3779b9
+
+# Average number of keys per bucket. Larger values make the
+# displacement table smaller but the displacements harder to find.
+_KEYS_PER_BUCKET = 3
+
+# Displacements are stored as 16 bit integers.
+_MAX_DISPLACEMENT = 0xffff
+
+
+def ContinueHash(h, s):
+  """Continue the 32 bit FNV-1a hash h over the string s."""
+  for char in s:
+    h ^= ord(char)
+    h = (h * _FNV_PRIME) & _MASK32
+  return h
+
+
+def HashHostnamePart(hostname_part):
+  """Return the 32 bit FNV-1a hash of hostname_part."""
+  return ContinueHash(FNV_OFFSET_BASIS, hostname_part)
+
+
+def MixHash(h):
+  """Return h with its bits mixed (the MurmurHash3 finalizer)."""
+  h ^= h >> 16
+  h = (h * 0x85ebca6b) & _MASK32
+  h ^= h >> 13
+  h = (h * 0xc2b2ae35) & _MASK32
+  h ^= h >> 16
+  return h
+
+
+def ReduceHash(h, n):
+  """Map the 32 bit value h onto the range [0, n) without a division."""
+  return (h * n) >> 32
+
+
+def GetBucket(h, num_buckets):
+  """Return the bucket for a key with hash h."""
+  return ReduceHash(MixHash(h), num_buckets)
+
+
+def GetFingerprint(h):
+  """Return the fingerprint stored for a key with hash h."""
+  return MixHash(h) & 0xffff
+
+
+def GetHostnamePartFingerprint(hostname_part):
+  """Return the 8 bit fingerprint of a hostname-part.
+
+  Used to skip sibling nodes without comparing strings.
+  """
+  return MixHash(HashHostnamePart(hostname_part)) >> 24
+
+
+def GetSlot(h, displacement, num_slots):
+  """Return the slot for a key with hash h in a bucket with displacement."""
+  return ReduceHash(
+      MixHash(h ^ ((displacement * _DISPLACEMENT_MULTIPLIER) & _MASK32)),
+      num_slots)
+
+
+class RootHashBuilder(object):
+  """RootHashBuilder builds a minimal perfect hash of the root nodes.
+
+  The first step of every lookup is a search of the root nodes (the
+  top-level domains). Rather than binary searching them, we map each
+  root hostname-part to its node with a minimal perfect hash built
+  using the hash and displace method: each key is first hashed into
+  one of a small number of buckets. For each bucket, we pick a
+  displacement that sends every key in the bucket to a distinct,
+  unused slot. There is exactly one slot per root node.
+
+  Each slot stores the index of its root node, and a 16 bit
+  fingerprint of the key that maps to it. Since every hostname-part
+  maps to some slot, a lookup must compare the hostname-part with the
+  slot's node, but the fingerprint lets it reject nearly all unknown
+  hostname-parts without reading the string table.
+  """
+
+  def __init__(self):
+    self._displacements = []
+    self._slots = []
+
+  def BuildRootHash(self, node_table_builder, num_root_children):
+    """Build the hash of the first num_root_children nodes.
+
+    Args:
+      node_table_builder: the NodeTableBuilder for the trie. Root
+          nodes are the first num_root_children nodes in its node table.
+      num_root_children: the number of root nodes.
+    """
+    root_nodes = node_table_builder.GetNodeTable()[:num_root_children]
+    num_slots = len(root_nodes)
+    num_buckets = max(1, (num_slots + _KEYS_PER_BUCKET - 1) //
+                      _KEYS_PER_BUCKET)
+
+    hashes = {}
+    buckets = [[] for _ in range(num_buckets)]
+    for index, node in enumerate(root_nodes):
+      h = HashHostnamePart(node.GetName())
+      if h in hashes:
+        raise ValueError('Hash collision between %s and %s.' %
+                         (node.GetName(), root_nodes[hashes[h]].GetName()))
+      hashes[h] = index
+      buckets[GetBucket(h, num_buckets)].append((h, index))
+
+    # Place the largest buckets first, while there are many free slots.
+    displacements = [0] * num_buckets
+    slots = [None] * num_slots
+    order = sorted(range(num_buckets), key=lambda b: (-len(buckets[b]), b))
+    for bucket in order:
+      keys = buckets[bucket]
+      if not keys:
+        break
+      for displacement in range(_MAX_DISPLACEMENT + 1):
+        candidate = [GetSlot(h, displacement, num_slots) for h, _ in keys]
+        if (len(set(candidate)) == len(candidate) and
+            all(slots[slot] is None for slot in candidate)):
+          break
+      else:
+        raise ValueError('Unable to find a displacement for bucket %d.' %
+                         bucket)
+      displacements[bucket] = displacement
+      for slot, (h, index) in zip(candidate, keys):
+        slots[slot] = (index, GetFingerprint(h))
+
+    self._displacements = displacements
+    self._slots = slots
+
+  def GetDisplacements(self):
+    """Return the displacement of each bucket."""
+    return self._displacements
+
+  def GetSlots(self):
+    """Return a (node index, fingerprint) tuple for each slot."""
+    return self._slots
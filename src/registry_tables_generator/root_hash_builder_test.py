@@ -0,0 +1,94 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Tests for root_hash_builder."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+import unittest
+
+import node_table_builder
+import root_hash_builder
+import trie_node
+
+class RootHashBuilderTest(unittest.TestCase):
+  """Test cases for the RootHashBuilder."""
+
+  def setUp(self):
+    self._hostname_part_trie = trie_node.TrieNode()
+    self._node_table = node_table_builder.NodeTableBuilder()
+    self._builder = root_hash_builder.RootHashBuilder()
+
+  def _Lookup(self, hostname_part):
+    """Return the root node index hostname_part maps to, or None."""
+    displacements = self._builder.GetDisplacements()
+    slots = self._builder.GetSlots()
+    h = root_hash_builder.HashHostnamePart(hostname_part)
+    displacement = displacements[
+        root_hash_builder.GetBucket(h, len(displacements))]
+    node_index, fingerprint = slots[
+        root_hash_builder.GetSlot(h, displacement, len(slots))]
+    if fingerprint != root_hash_builder.GetFingerprint(h):
+      return None
+    return node_index
+
+  def testHashHostnamePart(self):
+    """Tests the FNV-1a hash against known values."""
+    self.assertEqual(0x811c9dc5, root_hash_builder.HashHostnamePart(''))
+    self.assertEqual(0xe40c292c, root_hash_builder.HashHostnamePart('a'))
+    self.assertEqual(0xbf9cf968, root_hash_builder.HashHostnamePart('foobar'))
+
+  def testGetHostnamePartFingerprint(self):
+    """Tests that fingerprints are the top byte of the mixed hash."""
+    for hostname_part in ('com', 'foo', 'xn--p1ai'):
+      self.assertEqual(
+          root_hash_builder.MixHash(
+              root_hash_builder.HashHostnamePart(hostname_part)) >> 24,
+          root_hash_builder.GetHostnamePartFingerprint(hostname_part))
+    # Matches kSimpleNodeFingerprintTable in simple_node_table.c.
+    self.assertEqual(0x2c, root_hash_builder.GetHostnamePartFingerprint('com'))
+
+  def testEmptyTable(self):
+    """Tests a root hash with no root nodes."""
+    self._node_table.BuildNodeTables(self._hostname_part_trie)
+    self._builder.BuildRootHash(self._node_table, 0)
+    self.assertEqual([0], self._builder.GetDisplacements())
+    self.assertEqual([], self._builder.GetSlots())
+
+  def testManyRoots(self):
+    """Tests that every root node maps to its own slot."""
+    names = ['%s%d' % (prefix, i)
+             for prefix in ('a', 'xn--', 'co')
+             for i in range(300)]
+    for name in names:
+      self._hostname_part_trie.GetOrCreateChild(name).AddChild('foo')
+    self._node_table.BuildNodeTables(self._hostname_part_trie)
+    self._builder.BuildRootHash(self._node_table, len(names))
+
+    node_table = self._node_table.GetNodeTable()
+    slots = self._builder.GetSlots()
+    self.assertEqual(len(names), len(slots))
+    self.assertEqual(list(range(len(names))),
+                     sorted(index for index, _ in slots))
+    for name in names:
+      self.assertEqual(name, node_table[self._Lookup(name)].GetName())
+    # Unknown hostname-parts are almost always rejected by the
+    # fingerprint alone.
+    misses = [self._Lookup('unknown%d' % i) for i in range(1000)]
+    self.assertTrue(misses.count(None) > 950)
+
+if __name__ == '__main__':
+  unittest.main()
@@ -0,0 +1,116 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Builds the section tables. See class comment for more details."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+# How a node is treated by a search that only considers the ICANN
+# section of the public suffix list. Must match enum NodeSection in
+# domain_registry/private/trie_node.h.
+#
+# ICANN rules pass through the node, and end at it if it is terminal.
+NODE_SECTION_ICANN = 0
+# ICANN rules pass through the node, but only PRIVATE rules end at it.
+NODE_SECTION_ICANN_NOT_TERMINAL = 1
+# Only PRIVATE rules pass through the node.
+NODE_SECTION_PRIVATE = 2
+# Only PRIVATE rules pass through the node, but its sibling wildcard
+# is an ICANN rule, which matches in its place.
+NODE_SECTION_PRIVATE_ICANN_WILDCARD = 3
+
+# Each entry is 2 bits, packed from the least significant bits of
+# each byte.
+SECTIONS_PER_BYTE = 4
+
+
+def PackSections(sections):
+  """Return the list of sections packed SECTIONS_PER_BYTE to a byte."""
+  out = []
+  for i in range(0, len(sections), SECTIONS_PER_BYTE):
+    byte = 0
+    for j, section in enumerate(sections[i:i + SECTIONS_PER_BYTE]):
+      byte |= section << (2 * j)
+    out.append(byte)
+  return out
+
+
+class SectionTableBuilder(object):
+  """Builds the section of each node in the node tables.
+
+  The public suffix list is split into ICANN and PRIVATE sections.
+  Searches that find the registry under both the ICANN rules alone and
+  all rules in a single walk of the trie (see GetRegistryLengths in
+  domain_registry.h) need to know, for each node they visit, what a
+  search of a trie of only the ICANN rules would have found there. The
+  section tables hold this for each entry of the node table and of
+  the leaf node table, as one of the NODE_SECTION values above.
+
+  A search of the ICANN rules alone stops where it reaches a node that
+  only PRIVATE rules pass through, except where the ICANN trie has a
+  wildcard that matches instead. That wildcard must be a leaf, so that
+  the ICANN search ends there too.
+  """
+
+  def __init__(self):
+    self._node_sections = []
+    self._leaf_node_sections = []
+    self._has_icann_rules = {}
+
+  def BuildSectionTables(self, node_table_builder):
+    """Compute the sections of the nodes in the given node tables."""
+    self._node_sections = [self._GetSection(node)
+                           for node in node_table_builder.GetNodeTable()]
+    self._leaf_node_sections = [
+        self._GetSection(node)
+        for node in node_table_builder.GetLeafNodeTable()]
+
+  def GetNodeSections(self):
+    """Return the section of each entry in the node table."""
+    return self._node_sections
+
+  def GetLeafNodeSections(self):
+    """Return the section of each entry in the leaf node table."""
+    return self._leaf_node_sections
+
+  def _HasIcannRules(self, node):
+    """Return whether any ICANN rules end at or below node."""
+    identifier = node.GetIdentifier('.')
+    if identifier not in self._has_icann_rules:
+      self._has_icann_rules[identifier] = (
+          (node.IsTerminalNode() and not node.IsPrivateNode()) or
+          any(self._HasIcannRules(child) for child in node.GetChildren()))
+    return self._has_icann_rules[identifier]
+
+  def _GetSection(self, node):
+    """Return the section of node."""
+    if self._HasIcannRules(node):
+      if node.IsPrivateNode():
+        return NODE_SECTION_ICANN_NOT_TERMINAL
+      return NODE_SECTION_ICANN
+    parent = node.GetParent()
+    if parent.IsRoot() or node.GetName() == '*':
+      return NODE_SECTION_PRIVATE
+    try:
+      wildcard = parent.GetChild('*')
+    except ValueError:
+      return NODE_SECTION_PRIVATE
+    if not self._HasIcannRules(wildcard):
+      return NODE_SECTION_PRIVATE
+    if wildcard.HasChildren() or wildcard.IsPrivateNode():
+      raise ValueError('Unsupported ICANN wildcard rule above %s.' %
+                       node.GetIdentifier('.'))
+    return NODE_SECTION_PRIVATE_ICANN_WILDCARD
@@ -0,0 +1,130 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Tests for section_table_builder."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+import unittest
+
+import node_table_builder
+import section_table_builder
+import trie_node
+
+ICANN = section_table_builder.NODE_SECTION_ICANN
+ICANN_NOT_TERMINAL = section_table_builder.NODE_SECTION_ICANN_NOT_TERMINAL
+PRIVATE = section_table_builder.NODE_SECTION_PRIVATE
+PRIVATE_ICANN_WILDCARD = (
+    section_table_builder.NODE_SECTION_PRIVATE_ICANN_WILDCARD)
+
+class SectionTableBuilderTest(unittest.TestCase):
+  """Test cases for the SectionTableBuilder."""
+
+  def setUp(self):
+    self._hostname_part_trie = trie_node.TrieNode()
+    self._node_table = node_table_builder.NodeTableBuilder()
+    self._builder = section_table_builder.SectionTableBuilder()
+
+  def _AddRule(self, rule, is_private=False):
+    node = self._hostname_part_trie
+    for hostname_part in reversed(rule.split('.')):
+      node = node.GetOrCreateChild(hostname_part)
+    node.SetTerminalNode(is_private)
+
+  def _Build(self):
+    self._node_table.BuildNodeTables(self._hostname_part_trie)
+    self._builder.BuildSectionTables(self._node_table)
+
+  def _GetSectionsByIdentifier(self):
+    """Return a map from the identifier of each node to its section."""
+    sections = {}
+    for nodes, node_sections in (
+        (self._node_table.GetNodeTable(), self._builder.GetNodeSections()),
+        (self._node_table.GetLeafNodeTable(),
+         self._builder.GetLeafNodeSections())):
+      self.assertEqual(len(nodes), len(node_sections))
+      for node, section in zip(nodes, node_sections):
+        sections[node.GetIdentifier('.')] = section
+    return sections
+
+  def testSimple(self):
+    """Tests the rules of domain_registry/testing/simple_node_table.c."""
+    for rule in ('*.foo', '!baz.foo', '*.bar.foo', '*.*.foo', '!baz.*.foo',
+                 'foo.*.foo'):
+      self._AddRule(rule)
+    for rule in ('foo.com', 'bar.foo', 'foo.bar.foo'):
+      self._AddRule(rule, is_private=True)
+    self._Build()
+
+    self.assertEqual({'com': PRIVATE,
+                      'foo': ICANN,
+                      '*.foo': ICANN,
+                      'bar.foo': ICANN_NOT_TERMINAL,
+                      '!baz.foo': ICANN,
+                      'foo.com': PRIVATE,
+                      '*.*.foo': ICANN,
+                      '!baz.*.foo': ICANN,
+                      'foo.*.foo': ICANN,
+                      '*.bar.foo': ICANN,
+                      'foo.bar.foo': PRIVATE_ICANN_WILDCARD},
+                     self._GetSectionsByIdentifier())
+
+  def testIcannOnly(self):
+    """Tests that without PRIVATE rules, all nodes are ICANN."""
+    for rule in ('com', 'foo.com', '*.bar', 'a.b.c'):
+      self._AddRule(rule)
+    self._Build()
+    self.assertEqual([ICANN] * 4, self._builder.GetNodeSections())
+    self.assertEqual([ICANN] * 3, self._builder.GetLeafNodeSections())
+
+  def testPrivateSubtree(self):
+    """Tests that ICANN searches stop at PRIVATE-only subtrees."""
+    self._AddRule('com')
+    self._AddRule('blogspot.com', is_private=True)
+    self._AddRule('a.blogspot.com', is_private=True)
+    self._AddRule('co.uk')
+    self._Build()
+    self.assertEqual(['com', 'uk', 'blogspot'],
+                     [n.GetName() for n in self._node_table.GetNodeTable()])
+    self.assertEqual([ICANN, ICANN, PRIVATE],
+                     self._builder.GetNodeSections())
+    self.assertEqual([PRIVATE, ICANN], self._builder.GetLeafNodeSections())
+
+  def testSharedLeaves(self):
+    """Tests that leaves from different sections are not shared."""
+    self._AddRule('foo.com')
+    self._AddRule('foo.net', is_private=True)
+    self._AddRule('foo.org')
+    self._Build()
+    self.assertEqual([ICANN, PRIVATE], self._builder.GetLeafNodeSections())
+
+  def testWildcardWithChildren(self):
+    """Tests that ICANN wildcards a PRIVATE rule falls back to are leaves."""
+    self._AddRule('*.foo')
+    self._AddRule('a.*.foo')
+    self._AddRule('bar.foo', is_private=True)
+    self._node_table.BuildNodeTables(self._hostname_part_trie)
+    self.assertRaises(ValueError, self._builder.BuildSectionTables,
+                      self._node_table)
+
+  def testPackSections(self):
+    """Tests that sections are packed from the least significant bits."""
+    self.assertEqual([], section_table_builder.PackSections([]))
+    self.assertEqual([0xe4, 0x01],
+                     section_table_builder.PackSections([0, 1, 2, 3, 1]))
+
+if __name__ == '__main__':
+  unittest.main()
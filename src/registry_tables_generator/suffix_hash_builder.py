@@ -0,0 +1,135 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Builds a hash table of rule suffixes. See class comment for details."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+import node_table_builder
+import root_hash_builder
+
+# Number of seeds to try before giving up on finding a seed for which
+# all suffix hashes are distinct.
+_MAX_SEEDS = 256
+
+
+def GetSearchKey(node):
+  """Return the hostname-part a node is found under.
+
+  Exception rules are found under the hostname-part they are an
+  exception for (i.e. '!foo' is found under 'foo').
+  """
+  name = node.GetName()
+  if name.startswith('!'):
+    return name[1:]
+  return name
+
+
+def HashSuffix(parent_hash, hostname_part):
+  """Return the hash of hostname_part under a node with parent_hash.
+
+  Args:
+    parent_hash: the hash of the parent node.
+    hostname_part: the search key of the node.
+  """
+  return root_hash_builder.ContinueHash(parent_hash, '.' + hostname_part)
+
+
+def HashRootSuffix(seed, hostname_part):
+  """Return the hash of a top-level hostname-part."""
+  return root_hash_builder.ContinueHash(
+      root_hash_builder.FNV_OFFSET_BASIS ^ seed, hostname_part)
+
+
+def GetSlot(h, table_size):
+  """Return the first slot probed for hash h."""
+  return root_hash_builder.MixHash(h) & (table_size - 1)
+
+
+class SuffixHashBuilder(object):
+  """SuffixHashBuilder builds an open-addressed hash table of rule suffixes.
+
+  Each node of the hostname-part trie other than the root becomes an
+  entry in the table, keyed by the hash of the right-anchored suffix
+  it represents. For instance the rule 'foo.example.com' adds entries
+  for 'com', 'example.com' and 'foo.example.com'. The hash of a
+  suffix is computed from the hash of its parent suffix and its
+  leftmost hostname-part, so a lookup can hash each suffix of a
+  hostname in a single right-to-left pass.
+
+  Wildcard rules are stored under the hostname-part '*', and exception
+  rules under the hostname-part they are an exception for. Each entry
+  carries the same flags as the corresponding TrieNode, so a lookup
+  applies the same rules as the trie search.
+
+  The seed is chosen so that no two entries have the same hash, and no
+  entry has the hash 0, which marks an empty slot. Since each hashing
+  step is a bijection, a lookup that matches an entry's hash and
+  hostname-part has also matched its parent, without storing it.
+  Slots are probed linearly, and the table is at most half full.
+  """
+
+  def __init__(self):
+    self._seed = 0
+    self._slots = []
+
+  def BuildSuffixHash(self, hostname_part_trie):
+    """Build the suffix hash of all nodes in hostname_part_trie."""
+    for seed in range(_MAX_SEEDS):
+      entries = self._ComputeEntries(hostname_part_trie, seed)
+      hashes = set(h for h, _ in entries)
+      if len(hashes) == len(entries) and 0 not in hashes:
+        break
+    else:
+      raise ValueError('Unable to find a seed with distinct suffix hashes.')
+
+    table_size = 1
+    while table_size < 2 * len(entries):
+      table_size *= 2
+    slots = [None] * table_size
+    for h, node in entries:
+      slot = GetSlot(h, table_size)
+      while slots[slot] is not None:
+        slot = (slot + 1) & (table_size - 1)
+      slots[slot] = (h, node)
+    self._seed = seed
+    self._slots = slots
+
+  @staticmethod
+  def _ComputeEntries(hostname_part_trie, seed):
+    """Return a (hash, node) tuple for each non-root node."""
+    entries = []
+    pending = [(None, child)
+               for child in node_table_builder.GetSortedChildren(
+                   hostname_part_trie)]
+    while pending:
+      parent_hash, node = pending.pop()
+      if parent_hash is None:
+        h = HashRootSuffix(seed, GetSearchKey(node))
+      else:
+        h = HashSuffix(parent_hash, GetSearchKey(node))
+      entries.append((h, node))
+      pending.extend((h, child)
+                     for child in node_table_builder.GetSortedChildren(node))
+    return entries
+
+  def GetSeed(self):
+    """Return the seed of the root hash."""
+    return self._seed
+
+  def GetSlots(self):
+    """Return a (hash, node) tuple or None for each slot of the table."""
+    return self._slots
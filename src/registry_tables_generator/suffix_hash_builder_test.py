@@ -0,0 +1,95 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Tests for suffix_hash_builder."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+import unittest
+
+import suffix_hash_builder
+import trie_node
+
+class SuffixHashBuilderTest(unittest.TestCase):
+  """Test cases for the SuffixHashBuilder."""
+
+  def setUp(self):
+    self._hostname_part_trie = trie_node.TrieNode()
+    self._builder = suffix_hash_builder.SuffixHashBuilder()
+
+  def _AddRule(self, rule):
+    node = self._hostname_part_trie
+    for hostname_part in reversed(rule.split('.')):
+      node = node.GetOrCreateChild(hostname_part)
+    node.SetTerminalNode()
+
+  def _Lookup(self, hostname_parts):
+    """Return the node for the suffix hostname_parts, or None.
+
+    Args:
+      hostname_parts: the search keys of the suffix, rootmost first.
+    """
+    slots = self._builder.GetSlots()
+    h = suffix_hash_builder.HashRootSuffix(self._builder.GetSeed(),
+                                           hostname_parts[0])
+    for hostname_part in hostname_parts[1:]:
+      h = suffix_hash_builder.HashSuffix(h, hostname_part)
+    slot = suffix_hash_builder.GetSlot(h, len(slots))
+    while slots[slot] is not None:
+      if slots[slot][0] == h:
+        return slots[slot][1]
+      slot = (slot + 1) % len(slots)
+    return None
+
+  def testEmptyTable(self):
+    """Tests a suffix hash with no rules."""
+    self._builder.BuildSuffixHash(self._hostname_part_trie)
+    self.assertEqual([None], self._builder.GetSlots())
+
+  def testBasic(self):
+    """Tests that every suffix of every rule is in the table."""
+    for rule in ('com', 'example.com', 'uk', 'co.uk', '*.kawasaki.jp',
+                 '!city.kawasaki.jp'):
+      self._AddRule(rule)
+    self._builder.BuildSuffixHash(self._hostname_part_trie)
+
+    slots = self._builder.GetSlots()
+    self.assertEqual(16, len(slots))
+    self.assertEqual(8, len([slot for slot in slots if slot is not None]))
+    self.assertEqual('example.com',
+                     self._Lookup(['com', 'example']).GetIdentifier('.'))
+    self.assertEqual('co.uk', self._Lookup(['uk', 'co']).GetIdentifier('.'))
+    self.assertEqual('jp', self._Lookup(['jp']).GetIdentifier('.'))
+    # Wildcards are stored under '*', and exceptions under the
+    # hostname-part they are an exception for.
+    self.assertEqual('*.kawasaki.jp',
+                     self._Lookup(['jp', 'kawasaki', '*']).GetIdentifier('.'))
+    self.assertEqual(
+        '!city.kawasaki.jp',
+        self._Lookup(['jp', 'kawasaki', 'city']).GetIdentifier('.'))
+    self.assertEqual(None, self._Lookup(['jp', 'kawasaki', '!city']))
+    self.assertEqual(None, self._Lookup(['example']))
+    self.assertEqual(None, self._Lookup(['com', 'co']))
+
+  def testSuffixHashesAreNotConcatenations(self):
+    """Tests that hostname-parts are separated in the suffix hash."""
+    h1 = suffix_hash_builder.HashSuffix(
+        suffix_hash_builder.HashRootSuffix(0, 'co'), 'm')
+    h2 = suffix_hash_builder.HashRootSuffix(0, 'com')
+    self.assertNotEqual(h1, h2)
+
+if __name__ == '__main__':
+  unittest.main()
@@ -18,24 +18,152 @@
 
 __author__ = 'bmcquade@google.com (Bryan McQuade)'
 
+import struct
+import zlib
 
-def _GetMaxValueForNumBits(num_bits):
-  """Return max value for an unsigned integer of width num_bits."""
-  return 2**num_bits - 1
+import node_layout_builder
+import root_hash_builder
+import section_table_builder
+import suffix_hash_builder
+
+# The binary blob format. Must match domain_registry/private/registry_blob.h.
+#
+# The blob is a header followed by the tables, each starting at a
+# multiple of BLOB_ALIGNMENT bytes. All integers are little-endian. The
+# header is BLOB_HEADER_SIZE bytes of 32-bit fields:
+#
+#   magic, version, size of the blob, checksum, flags,
+#   number of root nodes, number of nodes in the node table,
+#   number of root hash buckets, node layout,
+#
+# followed by the offset and size in bytes of each table, in the order
+# of BLOB_SECTIONS. The checksum is the CRC-32 of everything after the
+# checksum field. Node and leaf node table entries are laid out as
+# described by the node layout, see node_layout_builder.py. Section
+# tables have 2 bits per node, see section_table_builder.py.
+BLOB_MAGIC = 0x42545244  # 'DRTB'
+BLOB_VERSION = 3
+BLOB_FLAG_EYTZINGER_LAYOUT = 1
+BLOB_ALIGNMENT = 8
+BLOB_SECTIONS = ('string_table',
+                 'node_table',
+                 'leaf_node_table',
+                 'root_hash_displacements',
+                 'root_hash_table',
+                 'node_fingerprints',
+                 'leaf_fingerprints',
+                 'node_sections',
+                 'leaf_sections')
+BLOB_HEADER_SIZE = 9 * 4 + len(BLOB_SECTIONS) * 8
+_BLOB_CHECKSUM_END = 16
+
+# The string table offset of a SuffixHashEntry is a 28 bit field.
+_MAX_SUFFIX_HASH_COMPONENT_OFFSET = 2**28 - 1
+
+# The names of the accessors of the flags of a TrieNode, in the order
+# of node_layout_builder.NODE_FLAGS.
+_FLAG_ACCESSORS = ('IsTrieNodeTerminal',
+                   'TrieNodeHasWildcardChild',
+                   'TrieNodeHasExceptionChildren')
+
+
+def _GetFingerprints(nodes):
+  """Return the fingerprint of the hostname-part of each node.
+
+  Exception rules have the fingerprint of the hostname-part they are
+  an exception for, since that is what they are searched by.
+  """
+  return [root_hash_builder.GetHostnamePartFingerprint(
+              suffix_hash_builder.GetSearchKey(node))
+          for node in nodes]
+
+
+def _GetFieldAccessor(field):
+  """Return the name of the accessor of a field of a TrieNode."""
+  return 'GetTrieNode' + ''.join(part.capitalize()
+                                 for part in field.split('_'))
+
+
+def _GetCharLiteral(char):
+  """Return the C character literal of a character of a hostname-part."""
+  if char in '\'"\\?' or not 0x20 < ord(char) < 0x7f:
+    return "'\\%03o'" % ord(char)
+  return "'%s'" % char
+
+
+def _GetStringLiteralChars(value):
+  """Return value escaped for use in a C string literal."""
+  return ''.join(_GetCharLiteral(char)[1:-1] if char in '"\\?' else char
+                 for char in value)
+
+
+def _SerializeMatcherCases(cases, pos, indent, out):
+  """Append to out the C code that matches the hostname-part to cases.
+
+  All hostname-parts of cases have the same length, and the same bytes
+  before pos. Switches on the byte at pos while more than one case
+  remains, then compares the remaining bytes of the last one. Returns
+  whether the code always returns, so that no break needs to follow.
+
+  Args:
+    cases: list of (hostname-part, result, child) tuples, sorted
+    pos: the position of the first byte not yet matched
+    indent: the indentation of the code
+    out: list of lines of C code
+  """
+  if len(cases) == 1:
+    key, result, child = cases[0]
+    comment = '/* %s */' % child.GetIdentifier('.')
+    if pos == len(key):
+      out.append('%sreturn 0x%x;  %s' % (indent, result, comment))
+      return True
+    start = 'component + %d' % pos if pos > 0 else 'component'
+    out.append('%sif (memcmp(%s, "%s", %d) == 0) {' % (
+        indent, start, _GetStringLiteralChars(key[pos:]), len(key) - pos))
+    out.append('%s  return 0x%x;  %s' % (indent, result, comment))
+    out.append('%s}' % indent)
+    return False
+  out.append('%sswitch (component[%d]) {' % (indent, pos))
+  i = 0
+  while i < len(cases):
+    char = cases[i][0][pos]
+    j = i
+    while j < len(cases) and cases[j][0][pos] == char:
+      j += 1
+    out.append('%s  case %s:' % (indent, _GetCharLiteral(char)))
+    if not _SerializeMatcherCases(cases[i:j], pos + 1, indent + '    ', out):
+      out.append('%s    break;' % indent)
+    i = j
+  out.append('%s}' % indent)
+  return False
+
+
+def _GetWordInitializer(word):
+  """Return the lines of the C expression TRIE_NODE stores in word."""
+  c_type = node_layout_builder.GetWordType(word.size)
+  terms = []
+  if word.field is not None:
+    terms.append('(%s) (%s)' % (c_type, word.field))
+  if word.flags_shift is not None:
+    for i, flag in enumerate(node_layout_builder.NODE_FLAGS):
+      terms.append('(%s) (%s) << %d' % (c_type, flag, word.flags_shift + i))
+  if len(terms) == 1:
+    return terms
+  return (['(%s) (%s |' % (c_type, terms[0])] +
+          ['    %s |' % term for term in terms[1:-1]] +
+          ['    %s)' % terms[-1]])
 
 
 class TableSerializer(object):
-  """TableSerializer serializes the table builders to C code."""
-
-  def __init__(self,
-               component_offset_bits,
-               child_node_offset_bits,
-               num_children_bits):
-    self.max_component_offset = _GetMaxValueForNumBits(
-      component_offset_bits)
-    self.max_child_node_offset = _GetMaxValueForNumBits(
-      child_node_offset_bits)
-    self.max_num_children = _GetMaxValueForNumBits(num_children_bits)
+  """TableSerializer serializes the table builders to C code.
+
+  The trie tables can also be serialized to a binary blob, which the
+  library can load at runtime instead of the compiled in tables.
+  """
+
+  def __init__(self, node_layout):
+    """Create a serializer for tables with the given NodeLayoutBuilder."""
+    self._node_layout = node_layout
 
   def SerializeNodeTable(self, node_table_builder, string_table_builder):
     """Generate a C representation of the node table.
@@ -46,31 +174,52 @@ class TableSerializer(object):
     """
     out = []
     for node in node_table_builder.GetNodeTable():
-      component_offset = (
-          string_table_builder.GetHostnamePartOffset(node.GetName()))
-      num_children = len(node.GetChildren())
-      if num_children > 0:
-        child_node_offset = node_table_builder.GetChildNodeOffset(node)
-      else:
-        child_node_offset = 0
-      if node.IsTerminalNode():
-        is_root = 1
-      else:
-        is_root = 0
-      if (component_offset > self.max_component_offset or
-          child_node_offset > self.max_child_node_offset or
-          num_children > self.max_num_children):
-          raise OverflowError(
-              'Values %d %d %d out of range.' %
-              (component_offset, child_node_offset, num_children))
-      out.append(r'  { %5d, %5d, %5d, %d },  /* %s */' % (
-          component_offset,
-          child_node_offset,
-          num_children,
-          is_root,
-          node.GetIdentifier('.')))
+      fields = self._GetNodeFields(node, node_table_builder,
+                                   string_table_builder)
+      out.append(r'  TRIE_NODE(%5d, %5d, %5d, %d, %d, %d),  /* %s */' % (
+          fields + (node.GetIdentifier('.'),)))
     return '\n'.join(out)
 
+  def _GetNodeFields(self, node, node_table_builder, string_table_builder):
+    """Return the values of the fields of the TrieNode for node."""
+    component_offset = (
+        string_table_builder.GetHostnamePartOffset(node.GetName()))
+    num_children = len(node.GetChildren())
+    if num_children > 0:
+      child_node_offset = node_table_builder.GetChildNodeOffset(node)
+    else:
+      child_node_offset = 0
+    if node.IsTerminalNode():
+      is_root = 1
+    else:
+      is_root = 0
+    has_wildcard_child = int(node_table_builder.HasWildcardChild(node))
+    has_exception_children = int(
+        node_table_builder.HasExceptionChildren(node))
+    if (component_offset >
+        self._node_layout.GetMaxValue('string_table_offset') or
+        child_node_offset >
+        self._node_layout.GetMaxValue('first_child_offset') or
+        num_children > self._node_layout.GetMaxValue('num_children')):
+      raise OverflowError(
+          'Values %d %d %d out of range.' %
+          (component_offset, child_node_offset, num_children))
+    return (component_offset,
+            child_node_offset,
+            num_children,
+            is_root,
+            has_wildcard_child,
+            has_exception_children)
+
+  def _GetLeafNodeComponentOffset(self, node, string_table_builder):
+    """Return the string table offset of the leaf node."""
+    component_offset = (
+      string_table_builder.GetHostnamePartOffset(node.GetName()))
+    if component_offset > self._node_layout.GetMaxLeafValue():
+      raise OverflowError(
+          'component_offset %d out of range.' % component_offset)
+    return component_offset
+
   def SerializeLeafChildNodeTable(self,
                                   node_table_builder,
                                   string_table_builder):
@@ -82,15 +231,229 @@ class TableSerializer(object):
     """
     out = []
     for node in node_table_builder.GetLeafNodeTable():
-      component_offset = (
-        string_table_builder.GetHostnamePartOffset(node.GetName()))
-      if component_offset > self.max_component_offset:
-          raise OverflowError(
-              'component_offset %d out of range.' % component_offset)
+      component_offset = self._GetLeafNodeComponentOffset(
+          node, string_table_builder)
       out.append(r'%5d,  /* %s */' % (
           component_offset, node.GetIdentifier('.')))
     return '\n'.join(out)
 
+  def SerializeNodeLayout(self):
+    """Generate the C definition of TrieNode and of its accessors."""
+    layout = self._node_layout
+    words = layout.GetWords()
+    out = ['/*']
+    for field in node_layout_builder.NODE_FIELDS:
+      out.append(' * %s: up to %d' % (field, layout.GetMaxValue(field)))
+    out.append(' * leaf string_table_offset: up to %d' %
+               layout.GetMaxLeafValue())
+    out.append(' */')
+    out.append('#define TRIE_NODE_LAYOUT 0x%x' % layout.GetLayoutId())
+    out.append('')
+
+    out.append('struct TrieNode {')
+    for word in words:
+      out.append('  %s %s;' % (node_layout_builder.GetWordType(word.size),
+                               word.name))
+    out.append('};')
+    out.append('')
+    out.append('typedef %s TrieLeafNode;' %
+               node_layout_builder.GetWordType(layout.GetLeafNodeSize()))
+    out.append('')
+
+    out.append('#define TRIE_NODE(%s, \\' %
+               ', '.join(node_layout_builder.NODE_FIELDS))
+    out.append('                  %s) \\' %
+               ', '.join(node_layout_builder.NODE_FLAGS))
+    lines = []
+    for word in words:
+      initializer = _GetWordInitializer(word)
+      if lines:
+        lines[-1] += ','
+      lines.extend(initializer)
+    lines = ['  { ' + lines[0]] + ['    ' + line for line in lines[1:]]
+    lines[-1] += ' }'
+    out.extend(line + ' \\' for line in lines[:-1])
+    out.append(lines[-1])
+
+    for field in node_layout_builder.NODE_FIELDS:
+      word = [w for w in words if w.field == field][0]
+      value = 'node->%s' % word.name
+      if word.flags_shift is not None:
+        value = '%s & 0x%x' % (value, word.GetFieldMask())
+      out.append('')
+      out.append('static __inline__ size_t %s(' % _GetFieldAccessor(field))
+      out.append('    const struct TrieNode* node) {')
+      out.append('  return %s;' % value)
+      out.append('}')
+    flags_word = [w for w in words if w.flags_shift is not None][0]
+    for i, accessor in enumerate(_FLAG_ACCESSORS):
+      out.append('')
+      out.append('static __inline__ int %s(' % accessor)
+      out.append('    const struct TrieNode* node) {')
+      out.append('  return (node->%s >> %d) & 1;' % (
+          flags_word.name, flags_word.flags_shift + i))
+      out.append('}')
+    return '\n'.join(out)
+
+  @staticmethod
+  def SerializeRootHashDisplacements(root_hash_builder):
+    """Generate a C representation of the root hash displacements.
+
+    Args:
+      root_hash_builder: The root hash to use when serializing.
+    """
+    displacements = root_hash_builder.GetDisplacements()
+    out = []
+    for i in range(0, len(displacements), 10):
+      out.append(' ' + ''.join(
+          '%6d,' % d for d in displacements[i:i + 10]))
+    return '\n'.join(out)
+
+  @staticmethod
+  def SerializeRootHashTable(root_hash_builder, node_table_builder):
+    """Generate a C representation of the root hash slots.
+
+    Args:
+      root_hash_builder: The root hash to use when serializing.
+      node_table_builder: The node table the root hash refers to.
+    """
+    node_table = node_table_builder.GetNodeTable()
+    out = []
+    for node_index, fingerprint in root_hash_builder.GetSlots():
+      out.append(r'  { %5d, %5d },  /* %s */' % (
+          node_index, fingerprint, node_table[node_index].GetName()))
+    return '\n'.join(out)
+
+  def SerializeSuffixHashTable(self,
+                               suffix_hash_builder,
+                               node_table_builder,
+                               string_table_builder):
+    """Generate a C representation of the suffix hash table.
+
+    Args:
+      suffix_hash_builder: The suffix hash to use when serializing.
+      node_table_builder: The node table to use when serializing.
+      string_table_builder: The string table to use when serializing.
+    """
+    out = []
+    for slot in suffix_hash_builder.GetSlots():
+      if slot is None:
+        out.append(r'  { 0x00000000,      0, 0, 0, 0, 0 },')
+        continue
+      h, node = slot
+      component_offset = (
+          string_table_builder.GetHostnamePartOffset(node.GetName()))
+      if component_offset > _MAX_SUFFIX_HASH_COMPONENT_OFFSET:
+        raise OverflowError(
+            'component_offset %d out of range.' % component_offset)
+      out.append(r'  { 0x%08x, %6d, %d, %d, %d, %d },  /* %s */' % (
+          h,
+          component_offset,
+          int(node.IsTerminalNode()),
+          int(node_table_builder.HasWildcardChild(node)),
+          int(node.GetName().startswith('!')),
+          int(node.HasChildren()),
+          node.GetIdentifier('.')))
+    return '\n'.join(out)
+
+  @staticmethod
+  def SerializeFingerprintTable(nodes):
+    """Generate a C representation of the fingerprints of nodes.
+
+    Args:
+      nodes: The node table to use when serializing.
+    """
+    fingerprints = _GetFingerprints(nodes)
+    out = []
+    for i in range(0, len(fingerprints), 12):
+      out.append(' ' + ''.join(' 0x%02x,' % f
+                               for f in fingerprints[i:i + 12]))
+    return '\n'.join(out)
+
+  @staticmethod
+  def SerializeSectionTable(sections):
+    """Generate a C representation of the packed sections of nodes.
+
+    Args:
+      sections: The section of each node, as built by
+          section_table_builder.
+    """
+    packed = section_table_builder.PackSections(sections)
+    out = []
+    for i in range(0, len(packed), 12):
+      out.append(' ' + ''.join(' 0x%02x,' % b for b in packed[i:i + 12]))
+    return '\n'.join(out)
+
+  @staticmethod
+  def SerializeDafsa(dafsa_builder):
+    """Generate a C representation of the DAFSA.
+
+    Args:
+      dafsa_builder: The DAFSA to use when serializing.
+    """
+    dafsa = dafsa_builder.GetDafsa()
+    out = []
+    for i in range(0, len(dafsa), 12):
+      out.append(' ' + ''.join(' 0x%02x,' % b for b in dafsa[i:i + 12]))
+    return '\n'.join(out)
+
+  @staticmethod
+  def SerializeMatcher(matcher_builder):
+    """Generate the C functions of the matcher.
+
+    Emits one function per node with children, and the function
+    MatchRegistryRule that dispatches to them by node id. See
+    matcher_builder.py for details.
+
+    Args:
+      matcher_builder: The matcher to use when serializing.
+    """
+    parents = matcher_builder.GetParents()
+    out = []
+    for parent in parents:
+      out.append('/* %s */' % (parent.node.GetIdentifier('.') or '(root)'))
+      out.append('static REGISTRY_U32 MatchChildrenOfNode%d(\n'
+                 '    const char* component, size_t component_len) {' %
+                 parent.node_id)
+      if parent.cases:
+        out.append('  switch (component_len) {')
+        i = 0
+        while i < len(parent.cases):
+          length = len(parent.cases[i][0])
+          j = i
+          while j < len(parent.cases) and len(parent.cases[j][0]) == length:
+            j += 1
+          out.append('    case %d:' % length)
+          if not _SerializeMatcherCases(parent.cases[i:j], 0, '      ', out):
+            out.append('      break;')
+          i = j
+        out.append('  }')
+      else:
+        # Only the wildcard or nothing matches the children of this
+        # node, whatever the hostname-part.
+        out.append('  (void) component;')
+        out.append('  (void) component_len;')
+      if parent.wildcard:
+        result, child = parent.wildcard
+        out.append('  return 0x%x;  /* %s */' % (result,
+                                                 child.GetIdentifier('.')))
+      else:
+        out.append('  return 0;')
+      out.append('}\n')
+
+    out.append('static REGISTRY_U32 MatchRegistryRule(REGISTRY_U32 parent,\n'
+               '                                      const char* component,\n'
+               '                                      size_t component_len) {')
+    out.append('  switch (parent) {')
+    for parent in parents:
+      out.append('    case %d:' % parent.node_id)
+      out.append('      return MatchChildrenOfNode%d(component, '
+                 'component_len);' % parent.node_id)
+    out.append('  }')
+    out.append('  return 0;')
+    out.append('}')
+    return '\n'.join(out)
+
   @staticmethod
   def SerializeStringTable(string_table_builder):
     """Generate a C representation of the string table.
@@ -121,6 +484,85 @@ class TableSerializer(object):
     out.append('"')
     return ''.join(out)
 
+  def SerializeBlob(self,
+                    node_table_builder,
+                    string_table_builder,
+                    root_hash_builder,
+                    section_table,
+                    num_root_children,
+                    eytzinger_layout):
+    """Generate the binary blob of the trie tables.
+
+    See the description of the format at the top of this file.
+
+    Args:
+      node_table_builder: The node table to use when serializing.
+      string_table_builder: The string table to use when serializing.
+      root_hash_builder: The root hash to use when serializing.
+      section_table: The SectionTableBuilder to use when serializing.
+      num_root_children: The number of root nodes.
+      eytzinger_layout: Whether the node tables are in Eytzinger order.
+    """
+    node_table = node_table_builder.GetNodeTable()
+    leaf_node_table = node_table_builder.GetLeafNodeTable()
+    string_table = ''.join(string_table_builder.GetStringTable())
+    if any(ord(char) > 127 for char in string_table):
+      raise ValueError("Encountered unexpected multibyte character.")
+    sections = [
+        # With the extra null byte that ends the C string literal.
+        bytearray(string_table.encode('ascii') + b'\0'),
+        bytearray(b''.join(
+            self._node_layout.PackNode(
+                self._GetNodeFields(node,
+                                    node_table_builder,
+                                    string_table_builder))
+            for node in node_table)),
+        bytearray(b''.join(
+            self._node_layout.PackLeafNode(
+                self._GetLeafNodeComponentOffset(node, string_table_builder))
+            for node in leaf_node_table)),
+        bytearray(b''.join(struct.pack('<H', d)
+                           for d in root_hash_builder.GetDisplacements())),
+        bytearray(b''.join(struct.pack('<HH', node_index, fingerprint)
+                           for node_index, fingerprint
+                           in root_hash_builder.GetSlots())),
+        bytearray(_GetFingerprints(node_table)),
+        bytearray(_GetFingerprints(leaf_node_table)),
+        bytearray(section_table_builder.PackSections(
+            section_table.GetNodeSections())),
+        bytearray(section_table_builder.PackSections(
+            section_table.GetLeafNodeSections())),
+    ]
+
+    section_table = []
+    body = bytearray()
+    for section in sections:
+      # The header is not necessarily a multiple of BLOB_ALIGNMENT bytes.
+      body += bytearray(-(BLOB_HEADER_SIZE + len(body)) % BLOB_ALIGNMENT)
+      offset = BLOB_HEADER_SIZE + len(body)
+      section_table.append(struct.pack('<II', offset, len(section)))
+      body += section
+    body += bytearray(-(BLOB_HEADER_SIZE + len(body)) % BLOB_ALIGNMENT)
+
+    flags = 0
+    if eytzinger_layout:
+      flags |= BLOB_FLAG_EYTZINGER_LAYOUT
+    checked = bytearray(struct.pack('<IIIII',
+                                    flags,
+                                    num_root_children,
+                                    len(node_table),
+                                    len(root_hash_builder.GetDisplacements()),
+                                    self._node_layout.GetLayoutId()))
+    checked += bytearray(b''.join(section_table))
+    checked += body
+    return bytes(bytearray(struct.pack('<IIII',
+                                       BLOB_MAGIC,
+                                       BLOB_VERSION,
+                                       _BLOB_CHECKSUM_END + len(checked),
+                                       zlib.crc32(bytes(checked)) &
+                                       0xffffffff)) +
+                 checked)
+
   @staticmethod
   def SerializeTestTable(test_table_builder):
     """Generate a C representation of the test table.
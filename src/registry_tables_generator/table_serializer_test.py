@@ -0,0 +1,274 @@
+#!/usr/bin/python2.4
+#
+# Copyright 2011 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Tests for table_serializer."""
+
+__author__ = 'bmcquade@google.com (Bryan McQuade)'
+
+import struct
+import unittest
+import zlib
+
+import matcher_builder
+import node_layout_builder
+import node_table_builder
+import registry_tables_generator
+import root_hash_builder
+import section_table_builder
+import string_table_builder
+import table_serializer
+
+
+def _UnpackTrieNode(node_layout, data):
+  """Return the fields of the binary representation of a TrieNode."""
+  fields = {}
+  flags = None
+  offset = 0
+  for word in node_layout.GetWords():
+    value = struct.unpack_from(
+        '<' + {1: 'B', 2: 'H', 4: 'I'}[word.size], data, offset)[0]
+    offset += word.size
+    if word.field is not None:
+      fields[word.field] = value & word.GetFieldMask()
+    if word.flags_shift is not None:
+      flags = value >> word.flags_shift
+  return (tuple(fields[field] for field in node_layout_builder.NODE_FIELDS) +
+          tuple((flags >> i) & 1
+                for i in range(len(node_layout_builder.NODE_FLAGS))))
+
+
+class TableSerializerTest(unittest.TestCase):
+  """Test cases for the TableSerializer."""
+
+  def _SerializeBlob(self, rules, eytzinger_layout=False,
+                     private_rules=frozenset()):
+    """Build the tables for rules and return them as a blob."""
+    hostname_part_trie = registry_tables_generator._BuildHostnameSuffixTrie(
+        rules, private_rules)
+    self._string_table = string_table_builder.StringTableBuilder()
+    self._node_table = node_table_builder.NodeTableBuilder(eytzinger_layout)
+    self._root_hash = root_hash_builder.RootHashBuilder()
+    self._sections = section_table_builder.SectionTableBuilder()
+    num_root_children = len(hostname_part_trie.GetChildren())
+    self._node_table.BuildNodeTables(hostname_part_trie)
+    self._root_hash.BuildRootHash(self._node_table, num_root_children)
+    self._sections.BuildSectionTables(self._node_table)
+    self._string_table.BuildStringTable(
+        hostname_part_trie,
+        registry_tables_generator._BuildStringTableSuffixTrie(rules))
+    self._node_layout = node_layout_builder.NodeLayoutBuilder()
+    self._node_layout.BuildNodeLayout(self._node_table, self._string_table)
+    self._serializer = table_serializer.TableSerializer(self._node_layout)
+    return self._serializer.SerializeBlob(self._node_table,
+                                          self._string_table,
+                                          self._root_hash,
+                                          self._sections,
+                                          num_root_children,
+                                          eytzinger_layout)
+
+  def _GetSections(self, blob):
+    """Return the contents of each section of the blob."""
+    sections = []
+    for i in range(len(table_serializer.BLOB_SECTIONS)):
+      offset, size = struct.unpack_from('<II', blob, 36 + i * 8)
+      self.assertEqual(0, offset % table_serializer.BLOB_ALIGNMENT)
+      self.assertTrue(offset >= table_serializer.BLOB_HEADER_SIZE)
+      self.assertTrue(offset + size <= len(blob))
+      sections.append(blob[offset:offset + size])
+    return sections
+
+  def testBlobHeader(self):
+    """Tests the header of the blob."""
+    blob = self._SerializeBlob(['com', 'foo.com', 'uk', 'co.uk'])
+    (magic, version, size, checksum, flags, num_root_children,
+     num_nodes, num_root_hash_buckets,
+     node_layout) = struct.unpack_from('<9I', blob)
+    self.assertEqual(table_serializer.BLOB_MAGIC, magic)
+    self.assertEqual(b'DRTB', blob[:4])
+    self.assertEqual(table_serializer.BLOB_VERSION, version)
+    self.assertEqual(len(blob), size)
+    self.assertEqual(zlib.crc32(blob[16:]) & 0xffffffff, checksum)
+    self.assertEqual(0, flags)
+    self.assertEqual(2, num_root_children)
+    self.assertEqual(len(self._node_table.GetNodeTable()), num_nodes)
+    self.assertEqual(len(self._root_hash.GetDisplacements()),
+                     num_root_hash_buckets)
+    self.assertEqual(self._node_layout.GetLayoutId(), node_layout)
+
+  def testBlobSections(self):
+    """Tests that the sections match the generated C tables."""
+    blob = self._SerializeBlob(['com', 'foo.com', 'uk', 'co.uk', '*.jp',
+                                '!city.kobe.jp', '*.kobe.jp'])
+    (string_table, node_table, leaf_node_table, displacements,
+     root_hash_table, node_fingerprints, leaf_fingerprints,
+     node_sections, leaf_sections) = self._GetSections(blob)
+
+    self.assertEqual(
+        ''.join(self._string_table.GetStringTable()).encode('ascii') + b'\0',
+        string_table)
+
+    nodes = self._node_table.GetNodeTable()
+    node_size = self._node_layout.GetNodeSize()
+    self.assertEqual(len(nodes) * node_size, len(node_table))
+    for i, node in enumerate(nodes):
+      self.assertEqual(
+          self._serializer._GetNodeFields(node,
+                                          self._node_table,
+                                          self._string_table),
+          _UnpackTrieNode(self._node_layout,
+                          node_table[i * node_size:(i + 1) * node_size]))
+
+    leaf_nodes = self._node_table.GetLeafNodeTable()
+    self.assertEqual(2, self._node_layout.GetLeafNodeSize())
+    self.assertEqual(
+        [self._string_table.GetHostnamePartOffset(node.GetName())
+         for node in leaf_nodes],
+        list(struct.unpack('<%dH' % len(leaf_nodes), leaf_node_table)))
+
+    self.assertEqual(
+        self._root_hash.GetDisplacements(),
+        list(struct.unpack('<%dH' % (len(displacements) // 2),
+                           displacements)))
+    slots = struct.unpack('<%dH' % (len(root_hash_table) // 2),
+                          root_hash_table)
+    self.assertEqual([tuple(slot) for slot in self._root_hash.GetSlots()],
+                     list(zip(slots[0::2], slots[1::2])))
+
+    self.assertEqual(len(nodes), len(node_fingerprints))
+    self.assertEqual(len(leaf_nodes), len(leaf_fingerprints))
+    self.assertEqual(root_hash_builder.GetHostnamePartFingerprint('com'),
+                     bytearray(node_fingerprints)[nodes.index(
+                         [n for n in nodes if n.GetName() == 'com'][0])])
+
+    self.assertEqual((len(nodes) + 3) // 4, len(node_sections))
+    self.assertEqual((len(leaf_nodes) + 3) // 4, len(leaf_sections))
+
+  def testBlobSectionTables(self):
+    """Tests that the section tables hold the packed sections."""
+    blob = self._SerializeBlob(['com', 'foo.com', 'blogspot.com', 'uk',
+                                'co.uk', 'blogspot.co.uk'],
+                               private_rules=set(['blogspot.com',
+                                                  'blogspot.co.uk']))
+    node_sections, leaf_sections = self._GetSections(blob)[-2:]
+    self.assertEqual(
+        section_table_builder.PackSections(self._sections.GetNodeSections()),
+        list(bytearray(node_sections)))
+    self.assertEqual(
+        section_table_builder.PackSections(
+            self._sections.GetLeafNodeSections()),
+        list(bytearray(leaf_sections)))
+    self.assertTrue(section_table_builder.NODE_SECTION_PRIVATE in
+                    self._sections.GetLeafNodeSections())
+
+  def testBlobEytzingerLayout(self):
+    """Tests that the Eytzinger layout is recorded in the flags."""
+    blob = self._SerializeBlob(['com', 'uk'], eytzinger_layout=True)
+    self.assertEqual(table_serializer.BLOB_FLAG_EYTZINGER_LAYOUT,
+                     struct.unpack_from('<I', blob, 16)[0])
+
+  def testSerializeNodeLayout(self):
+    """Tests the C definition of TrieNode."""
+    node_layout = node_layout_builder.NodeLayoutBuilder()
+    node_layout.BuildNodeLayoutForValues(
+        {'string_table_offset': 43554,
+         'first_child_offset': 12000,
+         'num_children': 1500},
+        43554)
+    out = table_serializer.TableSerializer(node_layout).SerializeNodeLayout()
+    self.assertTrue('#define TRIE_NODE_LAYOUT 0x1511\n' in out)
+    self.assertTrue('struct TrieNode {\n'
+                    '  REGISTRY_U16 string_table_offset;\n'
+                    '  REGISTRY_U16 first_child_offset;\n'
+                    '  REGISTRY_U16 num_children_and_flags;\n'
+                    '};\n' in out)
+    self.assertTrue('typedef REGISTRY_U16 TrieLeafNode;\n' in out)
+    self.assertTrue('  return node->num_children_and_flags & 0x1fff;\n' in out)
+    self.assertTrue('  return (node->num_children_and_flags >> 15) & 1;\n'
+                    in out)
+
+  def testSerializeNodeTable(self):
+    """Tests that nodes are written with the TRIE_NODE initializer."""
+    self._SerializeBlob(['com', 'foo.com'])
+    self.assertEqual(
+        '  TRIE_NODE(    0,     1,     1, 1, 0, 0),  /* com */',
+        self._serializer.SerializeNodeTable(self._node_table,
+                                            self._string_table))
+
+  def testSerializeMatcher(self):
+    """Tests the C functions of the matcher."""
+    matcher = matcher_builder.MatcherBuilder()
+    matcher.BuildMatcher(registry_tables_generator._BuildHostnameSuffixTrie(
+        ['ac', 'ad', 'bd', '*.bd', 'ab.bd', 'ba.bd', 'abc.bd']))
+    out = table_serializer.TableSerializer.SerializeMatcher(matcher)
+    # The top-level hostname-parts have the same length, and differ in
+    # both bytes.
+    self.assertTrue('  switch (component_len) {\n'
+                    '    case 2:\n'
+                    '      switch (component[0]) {\n'
+                    '        case \'a\':\n'
+                    '          switch (component[1]) {\n'
+                    '            case \'c\':\n'
+                    '              return 0x1;  /* ac */\n'
+                    '            case \'d\':\n'
+                    '              return 0x1;  /* ad */\n'
+                    '          }\n'
+                    '          break;\n'
+                    '        case \'b\':\n'
+                    '          if (memcmp(component + 1, "d", 1) == 0) {\n'
+                    '            return 0x9;  /* bd */\n'
+                    '          }\n'
+                    '          break;\n'
+                    '      }\n'
+                    '      break;\n'
+                    '  }\n'
+                    '  return 0;\n' in out)
+    # The children of bd fall back to the wildcard.
+    self.assertTrue('/* bd */\n'
+                    'static REGISTRY_U32 MatchChildrenOfNode1(\n' in out)
+    self.assertTrue('    case 3:\n'
+                    '      if (memcmp(component, "abc", 3) == 0) {\n'
+                    '        return 0x1;  /* abc.bd */\n'
+                    '      }\n'
+                    '      break;\n'
+                    '  }\n'
+                    '  return 0x5;  /* *.bd */\n' in out)
+    self.assertTrue('  switch (parent) {\n'
+                    '    case 0:\n'
+                    '      return MatchChildrenOfNode0(component, '
+                    'component_len);\n'
+                    '    case 1:\n'
+                    '      return MatchChildrenOfNode1(component, '
+                    'component_len);\n'
+                    '  }\n' in out)
+
+  def testSerializeWildcardOnlyMatcher(self):
+    """Tests the matcher of a node whose only child is a wildcard."""
+    matcher = matcher_builder.MatcherBuilder()
+    matcher.BuildMatcher(registry_tables_generator._BuildHostnameSuffixTrie(
+        ['ck', '*.ck']))
+    out = table_serializer.TableSerializer.SerializeMatcher(matcher)
+    # The hostname-part is not used, since the wildcard matches all of
+    # them.
+    self.assertTrue('/* ck */\n'
+                    'static REGISTRY_U32 MatchChildrenOfNode1(\n'
+                    '    const char* component, size_t component_len) {\n'
+                    '  (void) component;\n'
+                    '  (void) component_len;\n'
+                    '  return 0x5;  /* *.ck */\n'
+                    '}\n' in out)
+
+if __name__ == '__main__':
+  unittest.main()
@@ -42,6 +42,7 @@ class TrieNode(object):
     self._name = name
     self._children = {}
     self._is_terminal = False
+    self._is_private = False
     if (not self._parent) != (not self._name):
       raise ValueError("Mismatched parent and name attributes.")
 
@@ -139,7 +140,21 @@ class TrieNode(object):
     """
     return self._is_terminal
 
-  def SetTerminalNode(self):
-    """Mark this node as a terminal node."""
+  def SetTerminalNode(self, is_private=False):
+    """Mark this node as a terminal node.
+
+    Args:
+      is_private: Whether the rule that ends at this node is in the
+          PRIVATE section of the public suffix list. A node is private
+          only if all rules that end at it are.
+    """
+    if self._is_terminal:
+      self._is_private = self._is_private and is_private
+    else:
+      self._is_private = is_private
     self._is_terminal = True
 
+  def IsPrivateNode(self):
+    """Return whether only PRIVATE rules end at this terminal node."""
+    return self._is_terminal and self._is_private
+
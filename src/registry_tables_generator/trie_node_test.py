@@ -81,6 +81,24 @@ class TrieNodeTest(unittest.TestCase):
     self.assertEqual([ab1, ab2], ab.GetChildren())
     self.assertEqual([ab, ac], a.GetChildren())
 
+  def testPrivateNode(self):
+    """Tests that a node is private only if all its rules are."""
+    root = trie_node.TrieNode()
+    a = root.GetOrCreateChild('a')
+    b = root.GetOrCreateChild('b')
+    self.assertFalse(a.IsPrivateNode())
+
+    a.SetTerminalNode(is_private=True)
+    self.assertTrue(a.IsPrivateNode())
+    a.SetTerminalNode()
+    self.assertFalse(a.IsPrivateNode())
+    a.SetTerminalNode(is_private=True)
+    self.assertFalse(a.IsPrivateNode())
+
+    b.SetTerminalNode()
+    b.SetTerminalNode(is_private=True)
+    self.assertFalse(b.IsPrivateNode())
+
 if __name__ == '__main__':
   unittest.main()
 